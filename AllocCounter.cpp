@@ -0,0 +1,141 @@
+#include "AllocCounter.hpp"
+#include <new>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+
+/*
+Счетчики одного потока. Их пишет только сам поток (load + store без блокирующих инструкций),
+а allocationCounters() читает, поэтому они атомарные. Каждый занимает свою кэш-линию: иначе
+многопоточные бенчмарки измеряли бы еще и борьбу потоков за общие счетчики.
+Потоки связаны в список без выделений памяти (он строится внутри operator new); при завершении
+потока его счетчики прибавляются к retired, туда же идут выделения после этого (из деструкторов
+других thread_local-объектов потока).
+*/
+struct alignas(64) ThreadCounters {
+
+    std::atomic<size_t> allocations{0};
+    std::atomic<size_t> bytes{0};
+    ThreadCounters* next = nullptr;
+    bool registered = false;
+    bool finished = false;
+
+    ~ThreadCounters();
+};
+
+static std::mutex registryMutex;
+static ThreadCounters* registry = nullptr;
+static AllocationCounters retired;
+
+ThreadCounters::~ThreadCounters() {
+
+    if (!registered)
+        return;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    retired.allocations += allocations.load(std::memory_order_relaxed);
+    retired.bytes += bytes.load(std::memory_order_relaxed);
+    for (ThreadCounters** link = &registry; *link; link = &(*link)->next) {
+        if (*link == this) {
+            *link = next;
+            break;
+        }
+    }
+    registered = false;
+    finished = true;
+}
+
+static thread_local ThreadCounters threadCounters;
+
+AllocationCounters allocationCounters() {
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    AllocationCounters counters = retired;
+    for (const ThreadCounters* thread = registry; thread; thread = thread->next) {
+        counters.allocations += thread->allocations.load(std::memory_order_relaxed);
+        counters.bytes += thread->bytes.load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЗАМЕНА ГЛОБАЛЬНЫХ OPERATOR NEW / DELETE
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+В библиотеке (libmathexpr, флаг EXPR_NO_ALLOC_COUNTER) operator new не заменяется: он общий для
+всего процесса, в который библиотека встроена. Счетчики там остаются нулевыми.
+*/
+#ifndef EXPR_NO_ALLOC_COUNTER
+
+void* operator new(std::size_t size) {
+
+    ThreadCounters& counters = threadCounters;
+    if (!counters.registered) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (counters.finished) {
+            retired.allocations++;
+            retired.bytes += size;
+        }
+        else {
+            counters.next = registry;
+            registry = &counters;
+            counters.registered = true;
+        }
+    }
+    if (counters.registered) {
+        counters.allocations.store(counters.allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        counters.bytes.store(counters.bytes.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+    }
+
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+
+    try {
+        return operator new(size);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+#endif
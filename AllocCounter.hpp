@@ -0,0 +1,23 @@
+#ifndef EXPR_ALLOC_COUNTER_HPP
+#define EXPR_ALLOC_COUNTER_HPP
+
+#include <cstddef>
+
+/*
+Счетчики выделений памяти через глобальный operator new.
+AllocCounter.o заменяет operator new/delete и линкуется во все программы вместе с Expression.o
+(учет выделений памяти по операциям в Expression::allocationStatistics).
+В библиотеке libmathexpr замены нет (EXPR_NO_ALLOC_COUNTER), и счетчики равны нулю.
+*/
+struct AllocationCounters {
+
+    size_t allocations = 0; // Количество вызовов operator new.
+    size_t bytes = 0;       // Суммарно запрошено байт.
+};
+
+/*
+Текущие значения счетчиков с момента запуска программы: сумма по всем потокам, включая завершенные.
+*/
+AllocationCounters allocationCounters();
+
+#endif
@@ -0,0 +1,1870 @@
+#include "Expression.hpp"
+#include "Solver.hpp"
+#include "Integrator.hpp"
+#include "AllocCounter.hpp"
+#include "Generator.hpp"
+#include "Program.hpp"
+#include "Polynomial.hpp"
+#include "EvaluationServer.hpp"
+#include "LazyDerivative.hpp"
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <fstream>
+#include <thread>
+
+// ---------------------------------------------------------------------------------------------------- //
+// ИНФРАСТРУКТУРА БЕНЧМАРКОВ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Результат одного бенчмарка. Все величины — в расчете на одну итерацию.
+В counters складываются дополнительные показатели (погрешности, число итераций и т.п.).
+*/
+struct BenchResult {
+
+    std::string name;
+    size_t iterations = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+    double bytesPerOp = 0;
+    double nodesPerOp = 0;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+static std::vector<BenchResult> benchResults;
+static std::string benchFilter;      // Запускаются только бенчмарки, в имени которых есть эта подстрока.
+static double benchMinTime = 0.1;    // Минимальное суммарное время замера, секунды.
+
+/*
+Замер бенчмарка с подбором числа итераций (как в Google Benchmark): сначала одна пробная итерация,
+затем столько итераций, чтобы замер длился не меньше benchMinTime.
+nodes — количество узлов выражения, обрабатываемого за одну итерацию (для нормировки).
+*/
+template <typename F>
+BenchResult& BENCH_CASE(const std::string& name, F&& body, double nodes = 0) {
+
+    static BenchResult skipped;
+    if (name.find(benchFilter) == std::string::npos)
+        return skipped = BenchResult();
+
+    auto measure = [&body](size_t iterations, BenchResult& result) {
+
+        AllocationCounters before = allocationCounters();
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+            body();
+        auto stop = std::chrono::steady_clock::now();
+        AllocationCounters after = allocationCounters();
+
+        result.iterations = iterations;
+        result.nsPerOp = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+        result.allocsPerOp = double(after.allocations - before.allocations) / iterations;
+        result.bytesPerOp = double(after.bytes - before.bytes) / iterations;
+    };
+
+    BenchResult result;
+    result.name = name;
+    result.nodesPerOp = nodes;
+    measure(1, result);
+
+    if (result.nsPerOp < benchMinTime * 1e9) {
+        double iterations = std::min(1e7, std::ceil(benchMinTime * 1e9 / std::max(result.nsPerOp, 1.0)));
+        measure(static_cast<size_t>(iterations), result);
+    }
+
+    std::cout << std::left << std::setw(64) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << result.nsPerOp << " ns/op"
+              << std::setw(10) << result.allocsPerOp << " allocs/op";
+    if (nodes) std::cout << std::setw(10) << std::setprecision(0) << nodes << " nodes";
+    std::cout << std::endl;
+
+    benchResults.push_back(result);
+    return benchResults.back();
+}
+
+/*
+Дополнительный показатель последнего замера (выводится и попадает в JSON).
+*/
+static void BENCH_COUNTER(BenchResult& result, const std::string& name, double value) {
+
+    if (result.name.empty()) return;
+    result.counters.emplace_back(name, value);
+    std::cout << "    " << name << " = " << std::setprecision(6) << std::defaultfloat << value << std::endl;
+}
+
+/*
+Запись всех результатов в JSON (формат близок к выводу Google Benchmark, чтобы прогоны можно было сравнивать).
+*/
+static void writeJson(const std::string& path) {
+
+    std::ofstream out(path);
+    std::time_t now = std::time(nullptr);
+    char date[64];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << date << "\",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+        << "    \"min_time\": " << benchMinTime << "\n  },\n"
+        << "  \"benchmarks\": [\n";
+
+    out << std::setprecision(10);
+    for (size_t i = 0; i < benchResults.size(); i++) {
+
+        const BenchResult& r = benchResults[i];
+        out << "    {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+            << ", \"real_time\": " << r.nsPerOp << ", \"time_unit\": \"ns\""
+            << ", \"allocs_per_op\": " << r.allocsPerOp << ", \"bytes_per_op\": " << r.bytesPerOp
+            << ", \"nodes_per_op\": " << r.nodesPerOp;
+        for (const auto& [name, value] : r.counters)
+            out << ", \"" << name << "\": " << value;
+        out << "}" << (i + 1 < benchResults.size() ? "," : "") << "\n";
+    }
+
+    out << "  ]\n}\n";
+}
+
+/*
+Чтобы компилятор не выкинул вычисления, результаты складываются сюда.
+*/
+static volatile long double sink;
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОРПУС ВЫРАЖЕНИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Выражение корпуса: имя, формула и подстановка значений всех переменных.
+*/
+struct CorpusEntry {
+
+    std::string name;
+    std::string formula;
+    std::string subs;
+};
+
+/*
+Сгенерированные выражения четырех видов:
+small — формула из тестов; medium — сумма нескольких десятков разнородных слагаемых;
+deep — глубокая вложенность функций; wide — длинная сумма одночленов.
+Комплексный вариант домножает формулу на комплексное число и подставляет комплексные значения.
+*/
+static std::vector<CorpusEntry> corpus(bool complex) {
+
+    std::vector<CorpusEntry> entries;
+
+    entries.push_back({"small", "-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x)", "x = 0.5 y = 2"});
+
+    std::string medium;
+    for (int i = 1; i <= 24; i++) {
+        if (i > 1) medium += (i % 3 ? " + " : " - ");
+        switch (i % 4) {
+            case 0: medium += std::to_string(i) + "sin(" + std::to_string(i % 7 + 1) + "x + y)"; break;
+            case 1: medium += "exp(0.0" + std::to_string(i) + "x*y) / (x + " + std::to_string(i) + ")"; break;
+            case 2: medium += "ln(x^2 + " + std::to_string(i) + ") * cos(y)"; break;
+            case 3: medium += std::to_string(i) + "x^" + std::to_string(i % 5 + 1) + " * y"; break;
+        }
+    }
+    entries.push_back({"medium", medium, "x = 0.5 y = 2"});
+
+    std::string deep = "x";
+    for (int i = 0; i < 40; i++) {
+        switch (i % 3) {
+            case 0: deep = "sin(" + deep + " + 0.5y)"; break;
+            case 1: deep = "ln(2 + cos(" + deep + "))"; break;
+            case 2: deep = "(" + deep + " * y - x)"; break;
+        }
+    }
+    entries.push_back({"deep", deep, "x = 0.5 y = 0.9"});
+
+    std::string wide;
+    for (int i = 1; i <= 400; i++)
+        wide += (i > 1 ? " + " : "") + std::to_string(i % 13 + 1) + "x^" + std::to_string(i % 5 + 1) + " * y";
+    entries.push_back({"wide", wide, "x = 0.5 y = 2"});
+
+    if (complex) {
+        for (auto& entry : entries) {
+            entry.formula = "(" + entry.formula + ") * (1 + 0.5I)";
+            entry.subs = "x = 0.5 + 0.1I y = 0.9 - 0.2I";
+        }
+    }
+
+    return entries;
+}
+
+/*
+Основные операции над каждым выражением корпуса: разбор строки, toString, копирование (copyTree),
+подстановка, вычисление и производные 1–4 порядка.
+*/
+template <typename T>
+static void corpusBenchmarks(const std::string& type) {
+
+    std::cout << "\nCorpus, " << type << "\n";
+
+    for (const auto& entry : corpus(isComplex<T>)) {
+
+        std::string prefix = "corpus/" + type + "/" + entry.name + "/";
+        const char* formula = entry.formula.c_str();
+        Expression<T> expr(formula);
+        double nodes = expr.nodeCount();
+
+        // Память на узел — отслеживается между версиями по bench_results.json.
+        auto memory = expr.memoryUsage();
+        BenchResult& parse = BENCH_CASE(prefix + "parse", [&] { Expression<T> parsed(formula); sink = parsed.nodeCount(); }, nodes);
+        BENCH_COUNTER(parse, "bytes_per_node", double(memory.bytes()) / nodes);
+        BENCH_COUNTER(parse, "heap_bytes_per_node", double(memory.heapBytes) / nodes);
+        BENCH_CASE(prefix + "toString", [&] { sink = expr.toString().size(); }, nodes);
+        BENCH_CASE(prefix + "copyTree", [&] { Expression<T> copy(expr); sink = copy.nodeCount(); }, nodes);
+        BENCH_CASE(prefix + "subsVar (with copy)", [&] { Expression<T> copy(expr); copy.subsVar(entry.subs); }, nodes);
+
+        Expression<T> substituted = expr;
+        substituted.subsVar(entry.subs);
+        BENCH_CASE(prefix + "evaluate", [&] { sink = std::abs(substituted.evaluate()); }, nodes);
+        typename Expression<T>::Profile profile;
+        BENCH_CASE(prefix + "evaluateProfiled", [&] { sink = std::abs(substituted.evaluateProfiled(profile)); }, nodes);
+
+        Expression<T> derivative = expr;
+        for (int order = 1; order <= 4 && derivative.nodeCount() < 100000; order++) {
+            derivative = derivative.differentiate("x");
+            BenchResult& result = BENCH_CASE(prefix + "differentiate/order_" + std::to_string(order), [&] {
+                Expression<T> result = expr;
+                for (int i = 0; i < order; i++)
+                    result = result.differentiate("x");
+            }, derivative.nodeCount());
+            BENCH_COUNTER(result, "bytes", derivative.memoryUsage().bytes());
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СЛУЧАЙНЫЕ ВЫРАЖЕНИЯ (ТА ЖЕ НАГРУЗКА, ЧТО И В FUZZ)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Набор из 64 выражений генератора с фиксированным зерном, определенных в точке x, y.
+За одну итерацию обрабатывается весь набор; nodes — суммарное число узлов.
+*/
+template <typename T>
+static void generatedBenchmarks(const std::string& type, size_t depth) {
+
+    std::cout << "\nGenerated expressions, " << type << ", depth " << depth << "\n";
+
+    typename ExpressionGenerator<T>::Options options;
+    options.maxDepth = depth;
+    options.functions = {"sin", "cos", "ln", "exp"}; // Прежний набор: замеры сравнимы с ранними.
+    ExpressionGenerator<T> generator(options, 2024);
+    std::unordered_map<std::string, T> point = generator.point();
+
+    std::vector<std::string> formulas;
+    std::vector<Expression<T>> exprs;
+    double nodes = 0;
+
+    while (exprs.size() < 64) {
+        std::string formula = generator.expression().toString();
+        Expression<T> expr(formula.c_str());
+        try {
+            if (!std::isfinite(std::abs(expr.evaluate(point)))) continue;
+        }
+        catch (const std::runtime_error&) {
+            continue;
+        }
+        nodes += expr.nodeCount();
+        formulas.push_back(formula);
+        exprs.push_back(std::move(expr));
+    }
+
+    const size_t POINTS = 1024;
+    std::unordered_map<std::string, std::vector<T>> columns;
+    for (const auto& [name, value] : point)
+        columns[name].assign(POINTS, value);
+
+    std::string prefix = "generated/" + type + "/depth_" + std::to_string(depth) + "/";
+    BENCH_CASE(prefix + "parse", [&] {
+        for (const auto& formula : formulas) { Expression<T> parsed(formula.c_str()); sink = parsed.nodeCount(); }
+    }, nodes);
+    BENCH_CASE(prefix + "evaluate", [&] {
+        for (const auto& expr : exprs) sink = std::abs(expr.evaluate(point));
+    }, nodes);
+    BenchResult& batch = BENCH_CASE(prefix + "evaluateBatch_1024", [&] {
+        for (const auto& expr : exprs) sink = std::abs(expr.evaluateBatch(columns)[0]);
+    }, nodes * POINTS);
+    BENCH_COUNTER(batch, "ns_per_point", batch.nsPerOp / POINTS);
+    BENCH_CASE(prefix + "differentiate", [&] {
+        for (const auto& expr : exprs) sink = expr.differentiate("x").nodeCount();
+    }, nodes);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ТОЧНОСТЬ И СКОРОСТЬ ВЫЧИСЛЕНИЙ В РАЗНЫХ ТИПАХ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Одно и то же выражение считается во всех инстанциациях и в смешанной точности.
+Эталоном служит значение в long double.
+*/
+static void precisionBenchmarks(const std::string& label, const char* formula, const char* subs) {
+
+    std::cout << "\nPrecision, " << formula << "\n";
+
+    Expression<float> exprFloat(formula);
+    Expression<double> exprDouble(formula);
+    Expression<long double> exprLong(formula);
+    exprFloat.subsVar(subs);
+    exprDouble.subsVar(subs);
+    exprLong.subsVar(subs);
+
+    long double reference = exprLong.evaluate();
+    auto relError = [reference](long double value) {
+        return double(reference == 0 ? std::fabs(value) : std::fabs((value - reference) / reference));
+    };
+
+    std::string prefix = "precision/" + label + "/";
+    double nodes = exprLong.nodeCount();
+    BENCH_COUNTER(BENCH_CASE(prefix + "evaluate<float>", [&] { sink = exprFloat.evaluate(); }, nodes),
+        "rel_error", relError(exprFloat.evaluate()));
+    BENCH_COUNTER(BENCH_CASE(prefix + "evaluate<double>", [&] { sink = exprDouble.evaluate(); }, nodes),
+        "rel_error", relError(exprDouble.evaluate()));
+    BENCH_CASE(prefix + "evaluate<long double>", [&] { sink = exprLong.evaluate(); }, nodes);
+    BENCH_COUNTER(BENCH_CASE(prefix + "evaluateMixed<long double>", [&] { sink = exprLong.evaluateMixed(); }, nodes),
+        "rel_error", relError(exprLong.evaluateMixed()));
+}
+
+/*
+То же самое для комплексных инстанциаций.
+*/
+static void complexPrecisionBenchmarks(const std::string& label, const char* formula, const char* subs) {
+
+    std::cout << "\nPrecision, " << formula << "\n";
+
+    Expression<std::complex<double>> exprDouble(formula);
+    Expression<std::complex<long double>> exprLong(formula);
+    exprDouble.subsVar(subs);
+    exprLong.subsVar(subs);
+
+    std::complex<long double> reference = exprLong.evaluate();
+    auto relError = [reference](std::complex<long double> value) {
+        return double(std::abs(value - reference) / std::abs(reference));
+    };
+
+    std::string prefix = "precision/" + label + "/";
+    double nodes = exprLong.nodeCount();
+    BENCH_COUNTER(BENCH_CASE(prefix + "evaluate<complex<double>>", [&] { sink = exprDouble.evaluate().real(); }, nodes),
+        "rel_error", relError(std::complex<long double>(exprDouble.evaluate())));
+    BENCH_CASE(prefix + "evaluate<complex<long double>>", [&] { sink = exprLong.evaluate().real(); }, nodes);
+    BENCH_COUNTER(BENCH_CASE(prefix + "evaluateMixed<complex<long double>>", [&] { sink = exprLong.evaluateMixed().real(); }, nodes),
+        "rel_error", relError(exprLong.evaluateMixed()));
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПАКЕТНОЕ ВЫЧИСЛЕНИЕ КОМПЛЕКСНЫХ ВЫРАЖЕНИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Выражение из Test 7: поточечное вычисление через std::complex против пакетного
+с раздельными массивами вещественных и мнимых частей.
+*/
+template <typename C>
+static void complexBatchBenchmarks(const std::string& type) {
+
+    Expression<C> expr = Expression<C>("   0014.05ln   (4   y+1    )") / Expression<C>("exp(y*0.145x^2)");
+    expr = expr ^ (Expression<C>("-001.012   sin(t+1)") * Expression<C>("-cos(x^2)"));
+
+    const size_t N = 4096;
+    std::unordered_map<std::string, std::vector<C>> columns;
+    for (size_t i = 0; i < N; i++) {
+        columns["x"].push_back(C(-1 + 0.001 * i, 1));
+        columns["y"].push_back(C(12, -3 + 0.001 * i));
+        columns["t"].push_back(C(11, 0.0001 * i));
+    }
+
+    Expression<C> pointwise = expr;
+    pointwise.subsVar("x = -1+  I y = 12 - I003.00t = 11");
+
+    std::cout << "\nTest 7 workload, " << type << ", " << N << " points\n";
+    std::string prefix = "complex_batch/" + type + "/";
+    double nodes = expr.nodeCount();
+    BENCH_CASE(prefix + "evaluate (std::complex, per point)", [&] { sink = pointwise.evaluate().real(); }, nodes);
+    BenchResult& batch = BENCH_CASE(prefix + "evaluateBatch (split re/im, 4096 points)", [&] {
+        sink = expr.evaluateBatch(columns)[0].real();
+    }, nodes * N);
+    BENCH_COUNTER(batch, "ns_per_point", batch.nsPerOp / N);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ИНТЕРВАЛЬНОЕ ВЫЧИСЛЕНИЕ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Скорость интервального вычисления в узлах в секунду в сравнении с точечным.
+*/
+template <typename R>
+static void intervalBenchmarks(const std::string& type) {
+
+    Expression<R> expr("-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x) + ln(y+1) / exp(x^2) * cos(x^2)");
+    Expression<R> pointwise = expr;
+    pointwise.subsVar("x = 0.5 y = 2");
+    std::unordered_map<std::string, Interval<R>> box = {{"x", {0.25, 0.75}}, {"y", {1.5, 2.5}}};
+
+    double nodes = expr.nodeCount();
+    std::cout << "\nInterval evaluation, " << type << "\n";
+    BenchResult& point = BENCH_CASE("interval/" + type + "/evaluate", [&] { sink = pointwise.evaluate(); }, nodes);
+    BENCH_COUNTER(point, "Mnodes_per_s", nodes / point.nsPerOp * 1e3);
+    BenchResult& interval = BENCH_CASE("interval/" + type + "/evaluateInterval", [&] { sink = expr.evaluateInterval(box).lo; }, nodes);
+    BENCH_COUNTER(interval, "Mnodes_per_s", nodes / interval.nsPerOp * 1e3);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОИСК КОРНЕЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Пакетный решатель против цикла Ньютона по одной точке через subsVar + evaluate.
+*/
+static void solverBenchmarks() {
+
+    Expression<long double> f("x^3 - 2x - 5 + sin(x)");
+    const size_t N = 2000;
+    std::vector<long double> starts(N);
+    for (size_t i = 0; i < N; i++)
+        starts[i] = 0.5L + 10.0L * i / N;
+
+    std::cout << "\nNewton root finding, " << N << " starting points\n";
+
+    Solver<long double> newtonSolver(f, "x"), halleySolver(f, "x", Solver<long double>::Method::Halley);
+    Solver<long double>::Options options;
+    Solver<long double>::Result result;
+
+    BenchResult& newton = BENCH_CASE("solver/newton_batch", [&] { result = newtonSolver.solve(starts, options); });
+    BENCH_COUNTER(newton, "converged", result.statistics.converged);
+    BENCH_COUNTER(newton, "iterations", result.statistics.iterations);
+
+    BenchResult& halley = BENCH_CASE("solver/halley_batch", [&] { result = halleySolver.solve(starts, options); });
+    BENCH_COUNTER(halley, "converged", result.statistics.converged);
+    BENCH_COUNTER(halley, "iterations", result.statistics.iterations);
+
+    Expression<long double> df = f.differentiate("x");
+    BENCH_CASE("solver/per_point_loop (subsVar + evaluate)", [&] {
+        for (long double x : starts) {
+            for (int iteration = 0; iteration < 100; iteration++) {
+                Expression<long double> fx = f, dfx = df;
+                std::ostringstream subs;
+                subs << std::setprecision(21) << "x = " << x;
+                fx.subsVar(subs.str());
+                dfx.subsVar(subs.str());
+                long double step;
+                try {
+                    step = fx.evaluate() / dfx.evaluate();
+                }
+                catch (const std::runtime_error&) {
+                    break;
+                }
+                x -= step;
+                if (std::fabs(step) <= 1e-15L * (1 + std::fabs(x))) break;
+            }
+            sink = x;
+        }
+    });
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ИНТЕГРИРОВАНИЕ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Адаптивные квадратуры против наивного цикла subsVar + evaluate по средним точкам
+с тем же числом вычислений подынтегральной функции.
+*/
+static void integrationBenchmarks() {
+
+    Expression<long double> f1("sin(10x) * exp(x) + ln(x + 1)");
+    Expression<long double> f2("exp(x*y) * cos(x + y)");
+    Integrator<long double>::Options options;
+    options.relTolerance = 1e-12;
+    Integrator<long double>::Result result;
+
+    std::cout << "\nIntegration\n";
+    BenchResult& gk = BENCH_CASE("integration/gaussKronrod_1d", [&] {
+        result = Integrator<long double>(f1).gaussKronrod("x", 0, 5, options);
+    });
+    BENCH_COUNTER(gk, "error", result.error);
+    BENCH_COUNTER(gk, "evaluations", result.evaluations);
+
+    size_t points = result.evaluations;
+    BENCH_CASE("integration/naive_midpoint_1d (subsVar + evaluate, same points)", [&] {
+        long double sum = 0;
+        for (size_t i = 0; i < points; i++) {
+            Expression<long double> point = f1;
+            std::ostringstream subs;
+            subs << std::setprecision(21) << "x = " << 5.0L * (i + 0.5L) / points;
+            point.subsVar(subs.str());
+            sum += point.evaluate();
+        }
+        sink = sum * 5 / points;
+    });
+
+    BenchResult& cubature = BENCH_CASE("integration/cubature_2d", [&] {
+        result = Integrator<long double>(f2).cubature({"x", "y"}, {{0, 2}, {0, 2}}, options);
+    });
+    BENCH_COUNTER(cubature, "error", result.error);
+    BENCH_COUNTER(cubature, "evaluations", result.evaluations);
+
+    options.samples = 1000000;
+    BenchResult& mc = BENCH_CASE("integration/monteCarlo_2d_1e6", [&] {
+        result = Integrator<long double>(f2).monteCarlo({"x", "y"}, {{0, 2}, {0, 2}}, options);
+    });
+    BENCH_COUNTER(mc, "error", result.error);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// МНОГОВЫХОДНЫЕ ПРОГРАММЫ (f И ЧАСТНЫЕ ПРОИЗВОДНЫЕ)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+f, ∂f/∂x и ∂f/∂y для выражений корпуса: три отдельных evaluate против одного прохода
+по программе с общими подвыражениями на уровнях оптимизации 0–3.
+*/
+template <typename T>
+static void programBenchmarks(const std::string& type) {
+
+    std::cout << "\nMulti-output program (f and gradient), " << type << "\n";
+
+    for (const auto& entry : corpus(isComplex<T>)) {
+
+        std::string prefix = "program/" + type + "/" + entry.name + "/";
+        Expression<T> f(entry.formula.c_str());
+        std::vector<Expression<T>> outputs = {f, f.differentiate("x"), f.differentiate("y")};
+
+        Expression<T> valueX("x"), valueY("y");
+        valueX.subsVar(entry.subs);
+        valueY.subsVar(entry.subs);
+        std::unordered_map<std::string, T> point = {{"x", valueX.evaluate()}, {"y", valueY.evaluate()}};
+
+        double nodes = 0;
+        for (const auto& output : outputs) nodes += output.nodeCount();
+
+        double separateNs = BENCH_CASE(prefix + "separate_evaluate", [&] {
+            for (const auto& output : outputs) sink = std::abs(output.evaluate(point));
+        }, nodes).nsPerOp;
+
+        for (unsigned level = 0; level <= 3; level++) {
+
+            Program<T> program(outputs, level);
+            std::vector<T> arguments, results, registers;
+            for (const auto& name : program.variables())
+                arguments.push_back(point.at(name));
+
+            BenchResult& compiled = BENCH_CASE(prefix + "program_evaluate/O" + std::to_string(level), [&] {
+                program.evaluate(arguments, results, registers);
+                sink = std::abs(results[0]);
+            }, nodes);
+            BENCH_COUNTER(compiled, "shared_fraction", program.statistics().sharedFraction());
+            BENCH_COUNTER(compiled, "instructions", program.statistics().instructions);
+            for (const auto& [rule, count] : program.statistics().rewrites)
+                BENCH_COUNTER(compiled, "rewrites_" + rule, count);
+            if (separateNs > 0 && compiled.nsPerOp > 0)
+                BENCH_COUNTER(compiled, "speedup", separateNs / compiled.nsPerOp);
+        }
+
+        BENCH_CASE(prefix + "compile/O0", [&] { sink = Program<T>(outputs).statistics().instructions; }, nodes);
+        BENCH_CASE(prefix + "compile/O2", [&] { sink = Program<T>(outputs, 2).statistics().instructions; }, nodes);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СТЕПЕНИ С КОНСТАНТНЫМ ПОКАЗАТЕЛЕМ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Выражение со степенями и то же выражение, в котором показатели вынесены в переменные
+(их вид неизвестен при построении, и степени считаются через pow).
+*/
+struct PowerWorkload {
+
+    std::string name;
+    std::string formula;
+    std::string general;
+    std::vector<std::pair<std::string, long double>> exponents;
+    bool realOnly = false;
+};
+
+/*
+Полиномиальные нагрузки: степени, распознанные при построении выражения (умножения, sqrt, cbrt),
+против pow с тем же показателем — для evaluate, evaluateBatch и Program.
+*/
+template <typename T>
+static void powerBenchmarks(const std::string& type) {
+
+    const std::vector<PowerWorkload> workloads = {
+        {"polynomial", "3x^7 - 2x^5 + x^4 - 6x^3 + x^2 - x + 1", "3x^a - 2x^b + x^c - 6x^d + x^e - x + 1",
+         {{"a", 7}, {"b", 5}, {"c", 4}, {"d", 3}, {"e", 2}}},
+        {"bivariate", "(x^2 + y^2)^3 - x^2 * y^3 + (x - y)^4 / (1 + x^2)", "(x^a + y^a)^b - x^a * y^b + (x - y)^c / (1 + x^a)",
+         {{"a", 2}, {"b", 3}, {"c", 4}}},
+        {"roots", "x^(1/3) + x^(2/3) + y^0.5 - x^(5/3) * y^(1/3)", "x^a + x^b + y^c - x^d * y^a",
+         {{"a", 1.0L / 3}, {"b", 2.0L / 3}, {"c", 0.5L}, {"d", 5.0L / 3}}, true}
+    };
+
+    std::cout << "\nPowers with constant exponents, " << type << "\n";
+
+    for (const auto& workload : workloads) {
+
+        if (workload.realOnly && isComplex<T>) continue;
+
+        std::string prefix = "power/" + type + "/" + workload.name + "/";
+        Expression<T> classified(workload.formula.c_str()), general(workload.general.c_str());
+
+        std::unordered_map<std::string, T> point = {{"x", static_cast<T>(0.75)}, {"y", static_cast<T>(1.25)}};
+        std::unordered_map<std::string, std::vector<T>> columns;
+        for (size_t i = 0; i < 1024; i++) {
+            columns["x"].push_back(static_cast<T>(0.5 + i / 1024.0));
+            columns["y"].push_back(static_cast<T>(1.5 - i / 1024.0));
+        }
+        auto generalPoint = point;
+        auto generalColumns = columns;
+        for (const auto& [name, value] : workload.exponents) {
+            generalPoint[name] = static_cast<T>(static_cast<RealOf<T>>(value));
+            generalColumns[name].assign(1024, static_cast<T>(static_cast<RealOf<T>>(value)));
+        }
+
+        double nodes = classified.nodeCount();
+
+        double powNs = BENCH_CASE(prefix + "evaluate/pow", [&] { sink = std::abs(general.evaluate(generalPoint)); }, nodes).nsPerOp;
+        BenchResult& fast = BENCH_CASE(prefix + "evaluate/classified", [&] { sink = std::abs(classified.evaluate(point)); }, nodes);
+        if (fast.nsPerOp > 0)
+            BENCH_COUNTER(fast, "speedup", powNs / fast.nsPerOp);
+
+        double batchPowNs = BENCH_CASE(prefix + "evaluateBatch_1024/pow", [&] { 
+            sink = std::abs(general.evaluateBatch(generalColumns)[0]); }, nodes * 1024).nsPerOp;
+        BenchResult& batch = BENCH_CASE(prefix + "evaluateBatch_1024/classified", [&] { 
+            sink = std::abs(classified.evaluateBatch(columns)[0]); }, nodes * 1024);
+        if (batch.nsPerOp > 0)
+            BENCH_COUNTER(batch, "speedup", batchPowNs / batch.nsPerOp);
+
+        Program<T> program({classified}), programPow({general});
+        std::vector<T> arguments, argumentsPow, results, registers;
+        for (const auto& name : program.variables()) arguments.push_back(point.at(name));
+        for (const auto& name : programPow.variables()) argumentsPow.push_back(generalPoint.at(name));
+
+        double programPowNs = BENCH_CASE(prefix + "program_evaluate/pow", [&] {
+            programPow.evaluate(argumentsPow, results, registers);
+            sink = std::abs(results[0]);
+        }, nodes).nsPerOp;
+        BenchResult& compiled = BENCH_CASE(prefix + "program_evaluate/classified", [&] {
+            program.evaluate(arguments, results, registers);
+            sink = std::abs(results[0]);
+        }, nodes);
+        if (compiled.nsPerOp > 0)
+            BENCH_COUNTER(compiled, "speedup", programPowNs / compiled.nsPerOp);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// МНОГОЧЛЕНЫ ВЫСОКОЙ СТЕПЕНИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Строка многочлена с коэффициентами вида k / 4 (точно представимы): одночлены x^i * y^j
+для всех пар из exponents.
+*/
+static std::string polynomialFormula(const std::vector<std::pair<unsigned, unsigned>>& exponents) {
+
+    std::string formula;
+    for (size_t k = 0; k < exponents.size(); k++) {
+        int numerator = static_cast<int>(k % 7) - 3;
+        if (numerator == 0) numerator = 1;
+        formula += (k == 0 ? (numerator < 0 ? "-" : "") : (numerator < 0 ? " - " : " + "));
+        formula += std::to_string(std::abs(numerator) / 4.0).substr(0, 4);
+        auto [i, j] = exponents[k];
+        if (i) formula += "*x^" + std::to_string(i);
+        if (j) formula += "*y^" + std::to_string(j);
+    }
+    return formula;
+}
+
+/*
+Вычисление многочленов высокой степени: дерево (evaluate), Polynomial по Горнеру и Эстрину,
+дерево после hornerize; а также стоимость перевода в Polynomial.
+*/
+template <typename T>
+static void polynomialBenchmarks(const std::string& type) {
+
+    using Poly = Polynomial<T>;
+
+    std::vector<std::pair<std::string, std::vector<std::pair<unsigned, unsigned>>>> workloads;
+    for (unsigned degree : {8, 32, 128}) {
+        std::vector<std::pair<unsigned, unsigned>> dense;
+        for (unsigned i = 0; i <= degree; i++) dense.push_back({degree - i, 0});
+        workloads.push_back({"dense_" + std::to_string(degree), dense});
+    }
+    workloads.push_back({"sparse_256", {{256, 0}, {200, 0}, {129, 0}, {64, 0}, {17, 0}, {5, 0}, {1, 0}, {0, 0}}});
+    std::vector<std::pair<unsigned, unsigned>> bivariate;
+    for (unsigned i = 0; i <= 12; i++)
+        for (unsigned j = 0; i + j <= 12; j++) bivariate.push_back({i, j});
+    workloads.push_back({"bivariate_12", bivariate});
+
+    std::cout << "\nHigh-degree polynomials, " << type << "\n";
+
+    for (const auto& [name, exponents] : workloads) {
+
+        std::string prefix = "polynomial/" + type + "/" + name + "/";
+        std::string formula = polynomialFormula(exponents);
+        Expression<T> expr(formula.c_str());
+        Poly polynomial(expr);
+        Expression<T> horner = Poly::hornerize(expr);
+
+        std::unordered_map<std::string, T> point = {{"x", static_cast<T>(0.96875)}, {"y", static_cast<T>(-0.53125)}};
+        std::vector<T> values, scratch;
+        for (const auto& variable : polynomial.variables()) values.push_back(point.at(variable));
+
+        double nodes = expr.nodeCount();
+        double treeNs = BENCH_CASE(prefix + "tree_evaluate", [&] { sink = std::abs(expr.evaluate(point)); }, nodes).nsPerOp;
+
+        auto compare = [&](BenchResult& result) {
+            BENCH_COUNTER(result, "terms", polynomial.terms().size());
+            if (result.nsPerOp > 0) BENCH_COUNTER(result, "speedup", treeNs / result.nsPerOp);
+        };
+        compare(BENCH_CASE(prefix + "horner", [&] { 
+            sink = std::abs(polynomial.evaluate(values, Poly::Scheme::Horner, scratch)); }, nodes));
+        compare(BENCH_CASE(prefix + "estrin", [&] { 
+            sink = std::abs(polynomial.evaluate(values, Poly::Scheme::Estrin, scratch)); }, nodes));
+        BenchResult& hornerTree = BENCH_CASE(prefix + "hornerized_tree_evaluate", [&] { sink = std::abs(horner.evaluate(point)); }, nodes);
+        BENCH_COUNTER(hornerTree, "tree_nodes", horner.nodeCount());
+        if (hornerTree.nsPerOp > 0) BENCH_COUNTER(hornerTree, "speedup", treeNs / hornerTree.nsPerOp);
+
+        BENCH_CASE(prefix + "convert", [&] { sink = Poly(expr).terms().size(); }, nodes);
+        BENCH_CASE(prefix + "differentiate", [&] { sink = polynomial.differentiate("x").terms().size(); }, nodes);
+        BENCH_CASE(prefix + "tree_differentiate", [&] { sink = expr.differentiate("x").nodeCount(); }, nodes);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СПЕЦИАЛИЗАЦИЯ ПО ЧАСТИ ПЕРЕМЕННЫХ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Параметры t и y связываются один раз, затем x пробегает 1000 точек: subsVar (значения остаются
+узлами дерева, sin(t + 1) считается каждый раз) против specialize, в том числе после компиляции
+в Program.
+*/
+template <typename T>
+static void specializationBenchmarks(const std::string& type) {
+
+    const char* formula = "14ln(4y+1) / exp(y*x^2) * sin(t+1) * cos(x^2) + t*x - ln(y+1) / exp(t) * sin(x)";
+    const size_t SWEEP = 1000;
+
+    Expression<T> expr(formula), substituted(formula);
+    substituted.subsVar("t = 11 y = 12");
+    typename Expression<T>::Specialization report;
+    Expression<T> specialized = expr.specialize({{"t", static_cast<T>(11)}, {"y", static_cast<T>(12)}}, &report);
+
+    std::vector<T> sweep;
+    for (size_t i = 0; i < SWEEP; i++) sweep.push_back(static_cast<T>(-1 + 2.0 * i / SWEEP));
+
+    std::string prefix = "specialize/" + type + "/";
+    double nodes = substituted.nodeCount() * SWEEP;
+    std::cout << "\nSpecialization (t, y bound, x swept), " << type << "\n";
+
+    double subsNs = BENCH_CASE(prefix + "subsVar_sweep", [&] {
+        std::unordered_map<std::string, T> point = {{"x", T()}};
+        for (const T& x : sweep) { point["x"] = x; sink = std::abs(substituted.evaluate(point)); }
+    }, nodes).nsPerOp;
+
+    BenchResult& fast = BENCH_CASE(prefix + "specialize_sweep", [&] {
+        std::unordered_map<std::string, T> point = {{"x", T()}};
+        for (const T& x : sweep) { point["x"] = x; sink = std::abs(specialized.evaluate(point)); }
+    }, nodes);
+    BENCH_COUNTER(fast, "eliminated_fraction", report.eliminatedFraction());
+    BENCH_COUNTER(fast, "remaining_nodes", report.remainingNodes);
+    if (fast.nsPerOp > 0) BENCH_COUNTER(fast, "speedup", subsNs / fast.nsPerOp);
+
+    auto programSweep = [&](const std::string& name, const Expression<T>& source) {
+        Program<T> program({source});
+        std::vector<T> arguments(1), results, registers;
+        BenchResult& result = BENCH_CASE(prefix + name, [&] {
+            for (const T& x : sweep) {
+                arguments[0] = x;
+                program.evaluate(arguments, results, registers);
+                sink = std::abs(results[0]);
+            }
+        }, nodes);
+        BENCH_COUNTER(result, "instructions", program.statistics().instructions);
+        if (result.nsPerOp > 0) BENCH_COUNTER(result, "speedup", subsNs / result.nsPerOp);
+    };
+    programSweep("program_subsVar_sweep", substituted);
+    programSweep("program_specialize_sweep", specialized);
+
+    BENCH_CASE(prefix + "specialize", [&] { 
+        sink = expr.specialize({{"t", static_cast<T>(11)}, {"y", static_cast<T>(12)}}).nodeCount(); }, expr.nodeCount());
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// РАЗБОР КОРРЕКТНЫХ И ОШИБОЧНЫХ СТРОК
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Пропускная способность разбора на строках корпуса и на тех же строках, испорченных в середине
+(лишняя ')', "x(" или оборванный конец): parse без исключений против конструктора с try/catch.
+typo — те же ошибки в короткой формуле (small), где доля раскрутки стека наибольшая.
+*/
+template <typename T>
+static void parserBenchmarks(const std::string& type) {
+
+    std::vector<std::string> valid, invalid, typos;
+    for (const auto& entry : corpus(isComplex<T>)) {
+        const std::string& formula = entry.formula;
+        std::vector<std::string>& broken = entry.name == "small" ? typos : invalid;
+        valid.push_back(formula);
+        broken.push_back(formula.substr(0, formula.size() / 2) + ")" + formula.substr(formula.size() / 2));
+        broken.push_back(formula.substr(0, formula.size() / 2) + " x(" + formula.substr(formula.size() / 2));
+        broken.push_back(formula + " * ");
+    }
+
+    auto totalBytes = [](const std::vector<std::string>& formulas) {
+        double bytes = 0;
+        for (const auto& formula : formulas) bytes += formula.size();
+        return bytes;
+    };
+
+    std::string prefix = "parser/" + type + "/";
+    std::cout << "\nParser throughput, " << type << "\n";
+
+    BenchResult& validParse = BENCH_CASE(prefix + "valid_parse", [&] {
+        for (const auto& formula : valid) sink = Expression<T>::parse(formula).hasValue();
+    });
+    BENCH_COUNTER(validParse, "bytes_per_us", totalBytes(valid) / validParse.nsPerOp * 1000);
+
+    auto rejection = [&](const std::string& name, const std::vector<std::string>& formulas) {
+
+        BenchResult& parse = BENCH_CASE(prefix + name + "_parse", [&] {
+            for (const auto& formula : formulas) sink = Expression<T>::parse(formula).error().offset;
+        });
+        BENCH_COUNTER(parse, "bytes_per_us", totalBytes(formulas) / parse.nsPerOp * 1000);
+
+        BenchResult& thrown = BENCH_CASE(prefix + name + "_constructor_catch", [&] {
+            for (const auto& formula : formulas) {
+                try { Expression<T> expr(formula.c_str()); sink = expr.nodeCount(); } 
+                catch (const std::runtime_error&) { sink = 0; }
+            }
+        });
+        BENCH_COUNTER(thrown, "bytes_per_us", totalBytes(formulas) / thrown.nsPerOp * 1000);
+        if (parse.nsPerOp > 0) BENCH_COUNTER(thrown, "slowdown", thrown.nsPerOp / parse.nsPerOp);
+    };
+    rejection("invalid", invalid);
+    rejection("typo", typos);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПАРАЛЛЕЛЬНЫЙ РАЗБОР БОЛЬШИХ СУММ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Машинно сгенерированная сумма произведений (около 8 МБ): parseParallel на 1, 2, 4, ... потоках
+(до числа аппаратных) против последовательного parse. Счетчик gb_per_s — гигабайты строки в секунду.
+*/
+template <typename T>
+static void parallelParserBenchmarks(const std::string& type) {
+
+    std::string formula = "x";
+    for (int i = 1; formula.size() < (size_t(8) << 20); i++)
+        formula += std::string(i % 3 ? " + " : " - ") + std::to_string(i % 97) + "." + std::to_string(i % 10) + 
+                   "x*y^" + std::to_string(i % 4) + (i % 5 ? " * sin(x - 0.5y)" : " / (x + 2.25)");
+
+    std::string prefix = "parallel_parse/" + type + "/";
+    std::cout << "\nParallel parsing, " << type << ", " << formula.size() / 1024 << " KB\n";
+    double bytes = formula.size();
+
+    BenchResult& sequential = BENCH_CASE(prefix + "parse", [&] {
+        sink = Expression<T>::parse(formula).hasValue();
+    });
+    BENCH_COUNTER(sequential, "gb_per_s", bytes / sequential.nsPerOp);
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; ; threads = std::min(threads * 2, cores)) {
+        BenchResult& result = BENCH_CASE(prefix + "threads_" + std::to_string(threads), [&] {
+            sink = Expression<T>::parseParallel(formula, threads).hasValue();
+        });
+        BENCH_COUNTER(result, "gb_per_s", bytes / result.nsPerOp);
+        if (result.nsPerOp > 0) BENCH_COUNTER(result, "speedup", sequential.nsPerOp / result.nsPerOp);
+        if (threads == cores) break;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ДЛИННЫЕ СУММЫ: ПЕРЕСТРОЙКА ЦЕПОЧЕК И СУММИРОВАНИЕ С КОМПЕНСАЦИЕЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Сумма n слагаемых разных знаков и порядков в double: цепочка после разбора (глубина n) против 
+rebalance (глубина log n) и rebalance(CompensatedSum), также после компиляции в Program. 
+rel_error — относительная погрешность по сравнению с вычислением цепочки в long double.
+*/
+static void longSumBenchmarks() {
+
+    std::unordered_map<std::string, double> point = {{"x", 0.7}, {"y", 1.3}};
+    std::unordered_map<std::string, long double> widePoint = {{"x", 0.7L}, {"y", 1.3L}};
+
+    for (int terms : {1000, 20000}) {
+
+        std::string formula = "x";
+        for (int i = 1; i < terms; i++)
+            formula += std::string(i % 3 ? " + " : " - ") + std::to_string(i % 97 + 1) + std::string(i % 7, '0') + 
+                       "." + std::to_string(i % 10) + "1x*y";
+
+        Expression<double> chain(formula.c_str());
+        Expression<double> balanced = chain.rebalance();
+        Expression<double> compensated = chain.rebalance(Expression<double>::CompensatedSum);
+        long double reference = Expression<long double>(formula.c_str()).evaluate(widePoint);
+
+        std::string prefix = "long_sum/" + std::to_string(terms) + "/";
+        std::cout << "\nLong sum, " << terms << " terms, double\n";
+        double nodes = chain.nodeCount();
+
+        auto measure = [&](const std::string& name, const Expression<double>& expr, double depth) {
+            BenchResult& result = BENCH_CASE(prefix + name, [&] { sink = expr.evaluate(point); }, nodes);
+            BENCH_COUNTER(result, "depth", depth);
+            BENCH_COUNTER(result, "rel_error", std::abs((expr.evaluate(point) - reference) / reference));
+        };
+        measure("chain", chain, terms); // statistics() на такой глубине переполнил бы стек.
+        measure("rebalanced", balanced, balanced.statistics().depth);
+        measure("compensated", compensated, compensated.statistics().depth);
+
+        for (const auto& [name, expr] : {std::make_pair("program_chain", &chain), std::make_pair("program_rebalanced", &balanced)}) {
+            Program<double> program({*expr});
+            std::vector<double> arguments = {0.7, 1.3}, results, registers;
+            if (program.variables()[0] != "x") std::swap(arguments[0], arguments[1]);
+            BENCH_CASE(prefix + name, [&] { program.evaluate(arguments, results, registers); sink = results[0]; }, nodes);
+        }
+
+        BENCH_CASE(prefix + "rebalance", [&] { sink = chain.rebalance().nodeCount(); }, nodes);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// N-АРНЫЕ СУММЫ И ПРОИЗВЕДЕНИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Широкие суммы и произведения, разобранные цепочками бинарных узлов (Chains::Binary) и n-арными 
+узлами (Chains::Nary): вычисление, копирование и дифференцирование. Счетчики — байты дерева 
+(memoryUsage), узлы и глубина дерева, узлы производной.
+*/
+static void naryBenchmarks() {
+
+    using Chains = Expression<double>::Chains;
+    std::unordered_map<std::string, double> point = {{"x", 0.7}, {"y", 1.3}};
+    std::vector<std::pair<std::string, std::string>> formulas;
+
+    for (int terms : {100, 2000}) {
+        std::string sum = "x";
+        for (int i = 1; i < terms; i++)
+            sum += std::string(i % 3 ? " + " : " - ") + std::to_string(i % 17 + 1) + ".5x*y";
+        formulas.emplace_back("sum_" + std::to_string(terms), sum);
+    }
+    for (int factors : {8, 32}) {
+        std::string product = "x";
+        for (int i = 1; i < factors; i++)
+            product += i % 4 ? (i % 2 ? "*y" : "*x") : "*sin(x*y)";
+        formulas.emplace_back("product_" + std::to_string(factors), product);
+    }
+
+    for (const auto& [label, formula] : formulas) {
+
+        std::cout << "\nN-ary nodes, " << label << ", double\n";
+
+        for (Chains chains : {Chains::Binary, Chains::Nary}) {
+
+            Expression<double> expr = Expression<double>::parse(formula, chains).value();
+            Expression<double> derivative = expr.differentiate("x");
+            std::string prefix = "nary/" + label + (chains == Chains::Nary ? "/nary/" : "/binary/");
+            double nodes = expr.nodeCount();
+
+            BenchResult& evaluated = BENCH_CASE(prefix + "evaluate", [&] { sink = expr.evaluate(point); }, nodes);
+            BENCH_COUNTER(evaluated, "bytes", expr.memoryUsage().bytes());
+            BENCH_COUNTER(evaluated, "nodes", nodes);
+            BENCH_COUNTER(evaluated, "depth", expr.statistics().depth);
+            BENCH_CASE(prefix + "copy", [&] { sink = Expression<double>(expr).nodeCount(); }, nodes);
+            BenchResult& differentiated = BENCH_CASE(prefix + "differentiate", [&] { 
+                sink = expr.differentiate("x").nodeCount(); }, nodes);
+            BENCH_COUNTER(differentiated, "derivative_nodes", derivative.nodeCount());
+            BENCH_COUNTER(differentiated, "derivative_bytes", derivative.memoryUsage().bytes());
+            BENCH_CASE(prefix + "evaluate_derivative", [&] { sink = derivative.evaluate(point); }, derivative.nodeCount());
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ТОЧНОСТЬ SIN, COS, EXP И LN
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+sin, cos, exp и ln от 4096 точек в каждом режиме Accuracy: пакетное вычисление в double и 
+long double, также поточечное вычисление дерева с четырьмя функциями. max_rel_error — наибольшая 
+относительная ошибка по сравнению с libm в long double. У sin и cos половина точек — ближайшие
+к k pi / 2 числа double на всей области приведения |x| <= 1e5, где ошибка приведения заметнее всего.
+*/
+template <typename T>
+static void accuracyBenchmarks(const std::string& type) {
+
+    const size_t n = 4096;
+    const std::pair<Accuracy, const char*> modes[] = {
+        {Accuracy::Exact, "exact"}, {Accuracy::Ulp, "ulp"}, {Accuracy::Fast, "fast"}, {Accuracy::Coarse, "coarse"}
+    };
+
+    std::cout << "\nTranscendental accuracy modes, " << n << " points, " << type << "\n";
+
+    for (const char* function : {"sin", "cos", "exp", "ln"}) {
+
+        std::vector<T> xs(n);
+        std::vector<long double> reference(n);
+        for (size_t i = 0; i < n; i++) {
+            long double t = static_cast<long double>(i) / n;
+            xs[i] = static_cast<T>(function[0] == 'l' ? std::exp(-30 + 60 * t) : function[0] == 'e' ? -300 + 600 * t 
+                                                                                                   : -50 + 100 * t);
+            if ((function[0] == 's' || function[0] == 'c') && i % 2) {
+                long double k = std::round((-1 + 2 * t) * 63661);
+                xs[i] = static_cast<T>(static_cast<double>(k * 1.57079632679489661923132169163975144L));
+            }
+            long double x = xs[i];
+            reference[i] = function[0] == 's' ? std::sin(x) : function[0] == 'c' ? std::cos(x) : 
+                           function[0] == 'e' ? std::exp(x) : std::log(x);
+        }
+        Expression<T> expr((std::string(function) + "(x)").c_str());
+        std::unordered_map<std::string, std::vector<T>> columns = {{"x", xs}};
+
+        for (const auto& [accuracy, label] : modes) {
+
+            auto values = expr.evaluateBatch(columns, accuracy);
+            long double worst = 0;
+            for (size_t i = 0; i < n; i++)
+                worst = std::max(worst, std::abs((values[i] - reference[i]) / reference[i]));
+
+            BenchResult& result = BENCH_CASE("accuracy/" + type + "/" + function + "/" + label, [&] { 
+                sink = expr.evaluateBatch(columns, accuracy)[n - 1]; }, n);
+            BENCH_COUNTER(result, "max_rel_error", static_cast<double>(worst));
+        }
+    }
+
+    Expression<T> tree("sin(3x) * cos(y) + exp(x - y) + ln(y)");
+    std::unordered_map<std::string, T> point = {{"x", static_cast<T>(0.37)}, {"y", static_cast<T>(2.9)}};
+    for (const auto& [accuracy, label] : modes) {
+        BENCH_CASE("accuracy/" + type + "/tree_evaluate/" + label, [&] { sink = tree.evaluate(point, accuracy); }, 
+                   tree.nodeCount());
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// БИБЛИОТЕКА ФУНКЦИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Каждая встроенная функция от 4096 точек: evaluateBatch (векторизуемый цикл ядра) против evaluate 
+в цикле; также пользовательская функция двух аргументов с пакетным ядром и только со скалярным. 
+Время — на точку.
+*/
+static void functionBenchmarks() {
+
+    const size_t n = 4096;
+    std::vector<double> xs(n);
+    for (size_t i = 0; i < n; i++)
+        xs[i] = 0.1 + 1.7 * static_cast<double>(i) / n;
+    std::unordered_map<std::string, std::vector<double>> columns = {{"x", xs}};
+
+    Expression<double>::registerFunction({"benchhyp", 2, 
+        [](const double* args) { return std::hypot(args[0], args[1]); },
+        [](const double* const* args, size_t count, double* result) {
+            const double* __restrict a = args[0];
+            const double* __restrict b = args[1];
+            for (size_t i = 0; i < count; i++) 
+                result[i] = std::sqrt(a[i] * a[i] + b[i] * b[i]); 
+        }, {}});
+    Expression<double>::registerFunction({"benchhypscalar", 2, 
+        [](const double* args) { return std::sqrt(args[0] * args[0] + args[1] * args[1]); }, {}, {}});
+
+    std::vector<std::string> formulas = {"tan(x)", "sqrt(x)", "abs(x - 1)", "sign(x - 1)", "atan(x)", "sinh(x)",
+        "cosh(x)", "tanh(x)", "log10(x)", "erf(x)", "min(x, 1)", "max(x, 1)", "pow(x, 2.5)", 
+        "benchhyp(x, 2)", "benchhypscalar(x, 2)"};
+
+    std::cout << "\nFunction library, " << n << " points, double\n";
+
+    for (const auto& formula : formulas) {
+
+        Expression<double> expr(formula.c_str());
+        std::string prefix = "functions/" + formula.substr(0, formula.find('(')) + "/";
+        std::unordered_map<std::string, double> point = {{"x", 0.0}};
+
+        BENCH_CASE(prefix + "batch", [&] { sink = expr.evaluateBatch(columns)[n - 1]; }, n);
+        BENCH_CASE(prefix + "scalar", [&] { 
+            double sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                point["x"] = xs[i];
+                sum += expr.evaluate(point);
+            }
+            sink = sum;
+        }, n);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СОВМЕСТНЫЕ SIN И COS
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Программа из выражения с тригонометрией и всех его частных производных (в производных sin и cos 
+одного аргумента встречаются парами) на 4096 точках: с объединением sin и cos и без него, 
+поточечно и пакетно, точно и с Accuracy::Ulp. Время — на точку.
+*/
+template <typename T>
+static void sinCosBenchmarks(const std::string& type) {
+
+    const size_t n = 4096;
+    const std::vector<std::pair<std::string, std::string>> formulas = {
+        {"rotation", "sin(x*y) * cos(x*y) + sin(t) * x - cos(t) * y"},
+        {"mixed", "14ln(4y+1) / exp(y*x^2) * sin(t+1) * cos(x^2) + t*x"},
+        {"waves", "sin(x) * cos(2y) + exp(cos(x + t)) + sin(x + t) / (2 + cos(y))"}
+    };
+
+    std::cout << "\nFused sin and cos, " << n << " points, " << type << "\n";
+
+    std::unordered_map<std::string, std::vector<T>> columns = {{"x", {}}, {"y", {}}, {"t", {}}};
+    for (size_t i = 0; i < n; i++) {
+        T u = static_cast<T>(i) / n;
+        columns["x"].push_back(static_cast<T>(0.1) + 2 * u);
+        columns["y"].push_back(static_cast<T>(0.5) + 3 * u);
+        columns["t"].push_back(static_cast<T>(-20) + 40 * u);
+    }
+
+    for (const auto& [name, formula] : formulas) {
+
+        Expression<T> f(formula.c_str());
+        std::vector<Expression<T>> outputs = {f, f.differentiate("x"), f.differentiate("y"), f.differentiate("t")};
+        std::string prefix = "sincos/" + type + "/" + name + "/";
+
+        for (bool fuse : {false, true}) {
+
+            Program<T> program(outputs, 2, fuse);
+            std::string variant = fuse ? "fused/" : "separate/";
+            std::vector<T> arguments(program.variables().size()), results, registers;
+            std::vector<const T*> sources;
+            for (const auto& variable : program.variables())
+                sources.push_back(columns[variable].data());
+
+            for (Accuracy accuracy : {Accuracy::Exact, Accuracy::Ulp}) {
+
+                std::string label = accuracy == Accuracy::Exact ? "exact" : "ulp";
+
+                BenchResult& scalar = BENCH_CASE(prefix + variant + "scalar/" + label, [&] {
+                    T sum = 0;
+                    for (size_t i = 0; i < n; i++) {
+                        for (size_t k = 0; k < arguments.size(); k++)
+                            arguments[k] = sources[k][i];
+                        program.evaluate(arguments, results, registers, accuracy);
+                        sum += results[1];
+                    }
+                    sink = sum;
+                }, n);
+                BENCH_COUNTER(scalar, "fused_pairs", program.statistics().fusedSinCos);
+
+                BENCH_CASE(prefix + variant + "batch/" + label, [&] { 
+                    sink = program.evaluateBatch(columns, accuracy)[1][n - 1]; }, n);
+            }
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СЕРВЕР ВЫЧИСЛЕНИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Генератор нагрузки: producers потоков отправляют всего count запросов с суммарной частотой rate
+в секунду (0 — без пауз, при переполнении очереди запрос повторяется) и ждут всех ответов.
+Задержка каждого запроса (от отправки до обратного вызова, микросекунды) дописывается в latencies.
+*/
+static void serverLoad(EvaluationServer<double>& server, size_t count, double rate, unsigned producers, 
+                       std::vector<double>& latencies) {
+
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> measured(count);
+    std::atomic<size_t> done{0};
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back([&, p] {
+            for (size_t i = p; i < count; i += producers) {
+
+                if (rate > 0)
+                    std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<long long>(i * 1e9 / rate)));
+
+                double u = static_cast<double>(i % 1000) / 1000;
+                std::vector<double> values = {0.3 + u, 12 - u, 11 + u};
+                for (;;) {
+                    auto sent = Clock::now();
+                    try {
+                        server.submit(0, std::move(values), [&measured, &done, i, sent](const double& value, std::exception_ptr) {
+                            measured[i] = std::chrono::duration<double, std::micro>(Clock::now() - sent).count();
+                            sink = value;
+                            done++;
+                        });
+                        break;
+                    }
+                    catch (const std::runtime_error&) { // Очередь полна.
+                        std::this_thread::yield();
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+    while (done.load() < count)
+        std::this_thread::yield();
+
+    latencies.insert(latencies.end(), measured.begin(), measured.end());
+}
+
+/*
+Задержка (p50, p99) и пропускная способность сервера при разных параметрах пакетизации
+и частоте запросов; unbatched — каждый запрос вычисляется отдельно (maxBatch = 1).
+Время итерации — прогон из 4000 запросов.
+*/
+static void serverBenchmarks() {
+
+    const size_t count = 4000;
+    const char* formula = "14ln(4y+1) / exp(y*x^2) * sin(t+1) * cos(x^2) + t*x";
+    const std::vector<std::tuple<std::string, size_t, long>> configs = {
+        {"unbatched", 1, 0}, {"batch64_100us", 64, 100}, {"batch256_500us", 256, 500}
+    };
+
+    std::cout << "\nEvaluation server, " << formula << "\n";
+
+    for (const auto& [label, maxBatch, latency] : configs) {
+
+        EvaluationServer<double>::Options options;
+        options.maxBatch = maxBatch;
+        options.maxLatency = std::chrono::microseconds(latency);
+        EvaluationServer<double> server({Expression<double>(formula)}, options);
+
+        for (double rate : {20000.0, 100000.0, 0.0}) {
+
+            std::string load = rate > 0 ? std::to_string(static_cast<long>(rate / 1000)) + "k_per_s" : "unpaced";
+            std::vector<double> latencies;
+            auto before = server.statistics();
+
+            BenchResult& result = BENCH_CASE("server/" + label + "/" + load, [&] { 
+                serverLoad(server, count, rate, 2, latencies); }, count);
+            if (latencies.empty()) continue;
+
+            auto after = server.statistics();
+            std::sort(latencies.begin(), latencies.end());
+            BENCH_COUNTER(result, "p50_us", latencies[latencies.size() / 2]);
+            BENCH_COUNTER(result, "p99_us", latencies[latencies.size() * 99 / 100]);
+            BENCH_COUNTER(result, "throughput_per_s", count * 1e9 / result.nsPerOp);
+            BENCH_COUNTER(result, "average_batch", static_cast<double>(after.completed - before.completed) / 
+                                                   std::max<size_t>(1, after.batches - before.batches));
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЛЕНИВЫЕ ПРОИЗВОДНЫЕ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Производные высоких порядков: дерево производной (Expression::differentiate n раз) против ленивой
+производной (LazyDerivative), которая считает значение обходом исходного дерева. У дерева
+замеряются построение и вычисление, счетчики — его узлы и байты (memoryUsage); ленивой
+производной строить нечего, замеряется только вычисление (allocs/op и байты — все, что ей нужно).
+Дерево строится до 4-го порядка: на 5-м в нем около миллиона узлов, на 6-м — больше 16 миллионов.
+Последний случай — смешанная производная d^3 / dx^2 dy.
+*/
+static void lazyDerivativeBenchmarks() {
+
+    const char* formula = "sin(x) * exp(x^2/10) / (1 + x^2)";
+    Expression<double> expr(formula);
+    std::unordered_map<std::string, double> point = {{"x", 0.7}, {"y", 1.3}};
+
+    std::cout << "\nLazy derivatives, " << formula << ", double\n";
+
+    Expression<double> eager = expr;
+    for (unsigned order : {1, 2, 3, 4, 8, 16}) {
+
+        std::string prefix = "lazy/order_" + std::to_string(order) + "/";
+
+        if (order <= 4) {
+            eager = eager.differentiate("x");
+            double nodes = eager.nodeCount();
+            BenchResult& built = BENCH_CASE(prefix + "eager_differentiate", [&] {
+                Expression<double> derivative = expr;
+                for (unsigned k = 0; k < order; k++)
+                    derivative = derivative.differentiate("x");
+                sink = derivative.nodeCount();
+            }, nodes);
+            BENCH_COUNTER(built, "derivative_nodes", nodes);
+            BENCH_COUNTER(built, "derivative_bytes", eager.memoryUsage().bytes());
+            BENCH_CASE(prefix + "eager_evaluate", [&] { sink = eager.evaluate(point); }, nodes);
+        }
+
+        LazyDerivative<double> lazy(expr, "x", order);
+        BenchResult& lazyResult = BENCH_CASE(prefix + "lazy_evaluate", [&] { sink = lazy.evaluate(point); }, 
+                                             expr.nodeCount());
+        if (order <= 4)
+            BENCH_COUNTER(lazyResult, "relative_difference", 
+                          std::abs(lazy.evaluate(point) - eager.evaluate(point)) / std::abs(eager.evaluate(point)));
+    }
+
+    Expression<double> mixed("sin(x*y) * exp(x/y) + x^2 * ln(y)");
+    Expression<double> mixedEager = mixed.differentiate("x").differentiate("x").differentiate("y");
+    LazyDerivative<double> mixedLazy = LazyDerivative<double>(mixed, "x", 2).differentiate("y");
+    BenchResult& mixedBuilt = BENCH_CASE("lazy/mixed_xxy/eager_differentiate", [&] {
+        sink = mixed.differentiate("x").differentiate("x").differentiate("y").nodeCount(); }, mixedEager.nodeCount());
+    BENCH_COUNTER(mixedBuilt, "derivative_nodes", mixedEager.nodeCount());
+    BENCH_COUNTER(mixedBuilt, "derivative_bytes", mixedEager.memoryUsage().bytes());
+    BENCH_CASE("lazy/mixed_xxy/eager_evaluate", [&] { sink = mixedEager.evaluate(point); }, mixedEager.nodeCount());
+    BENCH_CASE("lazy/mixed_xxy/lazy_evaluate", [&] { sink = mixedLazy.evaluate(point); }, mixed.nodeCount());
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СТРУКТУРНОЕ СРАВНЕНИЕ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Сравнение больших деревьев производных: operator== (хеши узлов + обход) против сравнения строк
+toString. equal — копия того же дерева (обход до конца, хеши только подтверждают совпадение),
+differ — производная выражения с другой константой в глубине (различие видно по хешу корня).
+Отдельно — hash() и canonicalize(); counter derivative_nodes — размер дерева.
+*/
+static void equalityBenchmarks() {
+
+    Expression<double> expr("sin(x) * exp(x^2/10) / (1 + x^2)");
+    Expression<double> other("sin(x) * exp(x^2/10) / (1 + x^3)");
+
+    std::cout << "\nStructural equality, derivatives of sin(x) * exp(x^2/10) / (1 + x^2), double\n";
+
+    Expression<double> derivative = expr, otherDerivative = other;
+    for (unsigned order = 1; order <= 4; order++) {
+
+        derivative = derivative.differentiate("x");
+        otherDerivative = otherDerivative.differentiate("x");
+        Expression<double> copy = derivative;
+        double nodes = derivative.nodeCount();
+        std::string prefix = "equality/order_" + std::to_string(order) + "/";
+
+        BenchResult& equal = BENCH_CASE(prefix + "equal/operator", [&] { sink = derivative == copy; }, nodes);
+        BENCH_COUNTER(equal, "derivative_nodes", nodes);
+        BENCH_CASE(prefix + "equal/to_string", [&] { sink = derivative.toString() == copy.toString(); }, nodes);
+        BENCH_CASE(prefix + "differ/operator", [&] { sink = derivative == otherDerivative; }, nodes);
+        BENCH_CASE(prefix + "differ/to_string", [&] {
+            sink = derivative.toString() == otherDerivative.toString(); }, nodes);
+        BENCH_CASE(prefix + "hash", [&] { sink = derivative.hash(); }, nodes);
+        BENCH_CASE(prefix + "canonicalize", [&] { sink = derivative.canonicalize().hash(); }, nodes);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+/*
+Аргументы: --json ФАЙЛ (куда записать результаты), --filter ПОДСТРОКА, --min-time СЕКУНДЫ.
+*/
+int main(int argc, char* argv[]) {
+
+    std::string json = "bench_results.json";
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--json") json = argv[i + 1];
+        else if (flag == "--filter") benchFilter = argv[i + 1];
+        else if (flag == "--min-time") benchMinTime = std::stod(argv[i + 1]);
+        else {
+            std::cout << "Unknown flag: " << flag << std::endl;
+            return 1;
+        }
+    }
+
+    corpusBenchmarks<long double>("real");
+    corpusBenchmarks<std::complex<long double>>("complex");
+    generatedBenchmarks<double>("real", 6);
+    generatedBenchmarks<double>("real", 10);
+    generatedBenchmarks<std::complex<double>>("complex", 6);
+    precisionBenchmarks("polynomial_exp", "-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x)", "x = 0.5 y = 2");
+    precisionBenchmarks("cancellation", "(x + 0.000001)^2 - x^2 - 0.000002x", "x = 1000");
+    precisionBenchmarks("trigonometric", "ln(y+1) / exp(x^2) * sin(t+1) * cos(x^2)", "x = 0.3 y = 12 t = 11");
+    complexPrecisionBenchmarks("complex_exp", "exp((-12I + 3) * x) * sin(y) - ln(x + y)", "x = 0.5 y = 2 - I");
+    complexBatchBenchmarks<std::complex<long double>>("complex<long double>");
+    complexBatchBenchmarks<std::complex<double>>("complex<double>");
+    intervalBenchmarks<double>("double");
+    intervalBenchmarks<long double>("long double");
+    solverBenchmarks();
+    integrationBenchmarks();
+    programBenchmarks<long double>("real");
+    programBenchmarks<std::complex<long double>>("complex");
+    powerBenchmarks<double>("double");
+    powerBenchmarks<long double>("long double");
+    powerBenchmarks<std::complex<double>>("complex<double>");
+    polynomialBenchmarks<double>("double");
+    polynomialBenchmarks<std::complex<double>>("complex<double>");
+    specializationBenchmarks<double>("double");
+    specializationBenchmarks<std::complex<double>>("complex<double>");
+    parserBenchmarks<double>("double");
+    parserBenchmarks<std::complex<double>>("complex<double>");
+    parallelParserBenchmarks<double>("double");
+    longSumBenchmarks();
+    naryBenchmarks();
+    functionBenchmarks();
+    accuracyBenchmarks<double>("double");
+    accuracyBenchmarks<long double>("long double");
+    sinCosBenchmarks<double>("double");
+    sinCosBenchmarks<long double>("long double");
+    serverBenchmarks();
+    lazyDerivativeBenchmarks();
+    equalityBenchmarks();
+
+    writeJson(json);
+    std::cout << "\nResults written to " << json << std::endl;
+}
@@ -0,0 +1,165 @@
+/*
+Бенчмарк C-интерфейса (MathExpr.h): программа на C, собранная с libmathexpr.so.
+Выражение и его частные производные компилируются в одну программу; замеряются разбор,
+производная, вычисление дерева, поточечное и пакетное вычисление программы (пакет — прямо
+в буферах вызывающего) при каждой точности.
+Аргументы: [ВЫРАЖЕНИЕ] [ЧИСЛО ТОЧЕК].
+*/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "MathExpr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MIN_TIME 0.2        /* Минимальное время замера, секунды. */
+#define MAX_VARIABLES 16
+
+static double now(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile double sink;
+
+static void check(mathexpr_status status, const char* what) {
+
+    if (status != MATHEXPR_OK) {
+        fprintf(stderr, "%s failed (%d): %s\n", what, (int) status, mathexpr_last_error());
+        exit(1);
+    }
+}
+
+static void report(const char* name, double seconds, double operations, const char* unit) {
+
+    printf("%-40s %12.1f ns/%s\n", name, seconds * 1e9 / operations, unit);
+}
+
+int main(int argc, char* argv[]) {
+
+    const char* formula = argc > 1 ? argv[1] : "14ln(4y+1) / exp(y*x^2) * sin(t+1) * cos(x^2) + t*x";
+    size_t n = argc > 2 ? (size_t) atoll(argv[2]) : 65536;
+    const mathexpr_accuracy accuracies[] = {MATHEXPR_EXACT, MATHEXPR_ULP, MATHEXPR_FAST, MATHEXPR_COARSE};
+    const char* accuracyNames[] = {"exact", "ulp", "fast", "coarse"};
+
+    printf("C API, %s, %zu points\n", formula, n);
+
+    /* Разбор. */
+    mathexpr_expression* expressions[MAX_VARIABLES + 1];
+    size_t repeats = 0;
+    double start = now(), elapsed;
+    do {
+        mathexpr_expression* parsed;
+        check(mathexpr_parse(formula, strlen(formula), &parsed, NULL), "parse");
+        mathexpr_free(parsed);
+        repeats++;
+    } while ((elapsed = now() - start) < MIN_TIME);
+    report("parse", elapsed, repeats, "op");
+
+    check(mathexpr_parse(formula, strlen(formula), &expressions[0], NULL), "parse");
+
+    /* Переменные — по программе из одного выражения. */
+    mathexpr_program* single;
+    check(mathexpr_compile((const mathexpr_expression* const*) expressions, 1, 0, &single), "compile");
+    size_t variables = mathexpr_program_variable_count(single);
+    if (variables > MAX_VARIABLES) {
+        fprintf(stderr, "Too many variables\n");
+        return 1;
+    }
+    const char* names[MAX_VARIABLES];
+    for (size_t i = 0; i < variables; i++)
+        names[i] = mathexpr_program_variable_name(single, i);
+
+    /* Производные. */
+    if (variables > 0) {
+        repeats = 0;
+        start = now();
+        do {
+            mathexpr_expression* derivative;
+            check(mathexpr_differentiate(expressions[0], names[0], &derivative), "differentiate");
+            mathexpr_free(derivative);
+            repeats++;
+        } while ((elapsed = now() - start) < MIN_TIME);
+        report("differentiate", elapsed, repeats, "op");
+    }
+
+    for (size_t i = 0; i < variables; i++)
+        check(mathexpr_differentiate(expressions[0], names[i], &expressions[i + 1]), "differentiate");
+
+    mathexpr_program* program;
+    check(mathexpr_compile((const mathexpr_expression* const*) expressions, variables + 1, 2, &program), "compile");
+    size_t outputs = mathexpr_program_output_count(program);
+
+    /* Точки: столбцы в порядке переменных программы. */
+    double* columnData = malloc(sizeof(double) * n * (variables ? variables : 1));
+    double* outputData = malloc(sizeof(double) * n * outputs);
+    const double* columns[MAX_VARIABLES];
+    double* results[MAX_VARIABLES + 1];
+    for (size_t i = 0; i < variables; i++) {
+        double* column = columnData + i * n;
+        for (size_t j = 0; j < n; j++)
+            column[j] = 0.25 + (double) (j % 1000) / 1000 + i;
+        columns[i] = column;
+    }
+    for (size_t k = 0; k < outputs; k++)
+        results[k] = outputData + k * n;
+
+    /* Вычисление дерева. */
+    double point[MAX_VARIABLES], value;
+    for (size_t i = 0; i < variables; i++)
+        point[i] = columns[i][0];
+    repeats = 0;
+    start = now();
+    do {
+        check(mathexpr_evaluate(expressions[0], names, point, variables, MATHEXPR_EXACT, &value), "evaluate");
+        sink = value;
+        repeats++;
+    } while ((elapsed = now() - start) < MIN_TIME);
+    report("tree_evaluate/exact", elapsed, repeats, "point");
+
+    for (size_t a = 0; a < sizeof(accuracies) / sizeof(accuracies[0]); a++) {
+
+        char name[64];
+        double outputsAtPoint[MAX_VARIABLES + 1];
+
+        /* Поточечно. */
+        repeats = 0;
+        start = now();
+        do {
+            for (size_t j = 0; j < n; j++) {
+                for (size_t i = 0; i < variables; i++)
+                    point[i] = columns[i][j];
+                check(mathexpr_program_evaluate(program, point, accuracies[a], outputsAtPoint), "program_evaluate");
+            }
+            sink = outputsAtPoint[0];
+            repeats++;
+        } while ((elapsed = now() - start) < MIN_TIME);
+        snprintf(name, sizeof(name), "program_evaluate/%s", accuracyNames[a]);
+        report(name, elapsed, (double) repeats * n, "point");
+
+        /* Пакетно. */
+        repeats = 0;
+        start = now();
+        do {
+            check(mathexpr_program_evaluate_batch(program, columns, n, accuracies[a], results), "program_evaluate_batch");
+            sink = results[0][n - 1];
+            repeats++;
+        } while ((elapsed = now() - start) < MIN_TIME);
+        snprintf(name, sizeof(name), "program_evaluate_batch/%s", accuracyNames[a]);
+        report(name, elapsed, (double) repeats * n, "point");
+    }
+
+    printf("outputs: %zu, f(first point) = %.17g\n", outputs, results[0][0]);
+
+    free(columnData);
+    free(outputData);
+    mathexpr_program_free(single);
+    mathexpr_program_free(program);
+    for (size_t i = 0; i <= variables; i++)
+        mathexpr_free(expressions[i]);
+    return 0;
+}
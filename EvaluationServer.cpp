@@ -0,0 +1,366 @@
+#include "EvaluationServer.hpp"
+#include <algorithm>
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР И ОСТАНОВКА
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Компиляция выражений и запуск диспетчеров.
+*/
+template <typename T>
+EvaluationServer<T>::EvaluationServer(const std::vector<Expression<T>>& exprs, const Options& options)
+    : options(options), queue(options.queueCapacity) {
+
+    if (options.maxBatch == 0 || options.dispatchers == 0)
+        throw std::runtime_error("Server needs a positive batch size and at least one dispatcher");
+
+    programs.reserve(exprs.size());
+    for (const auto& expr : exprs)
+        programs.emplace_back(std::vector<Expression<T>>{expr}, options.level);
+
+    for (unsigned i = 0; i < options.dispatchers; i++)
+        workers.emplace_back([this] { dispatch(); });
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+EvaluationServer<T>::EvaluationServer(const std::vector<Expression<T>>& exprs)
+    : EvaluationServer(exprs, Options()) {}
+
+// --------------------------------------------------------------- //
+
+/*
+Остановка. Диспетчеры досчитывают очередь и все группы, не дожидаясь сроков.
+*/
+template <typename T>
+EvaluationServer<T>::~EvaluationServer() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Запрос с результатом в std::future.
+*/
+template <typename T>
+std::future<T> EvaluationServer<T>::submit(uint32_t expression, std::vector<T> values) {
+
+    Request request;
+    request.expression = expression;
+    request.values = std::move(values);
+    std::future<T> future = request.promise.emplace().get_future();
+    enqueue(request);
+    return future;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Запрос с функцией обратного вызова.
+*/
+template <typename T>
+void EvaluationServer<T>::submit(uint32_t expression, std::vector<T> values, Callback callback) {
+
+    Request request;
+    request.expression = expression;
+    request.values = std::move(values);
+    request.callback = std::move(callback);
+    enqueue(request);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Имена переменных выражения.
+*/
+template <typename T>
+const std::vector<std::string>& EvaluationServer<T>::variables(uint32_t expression) const {
+
+    if (expression >= programs.size())
+        throw std::runtime_error("Unknown expression " + std::to_string(expression));
+    return programs[expression].variables();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Число выражений.
+*/
+template <typename T>
+size_t EvaluationServer<T>::expressions() const {
+
+    return programs.size();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Снимок счетчиков.
+*/
+template <typename T>
+typename EvaluationServer<T>::Statistics EvaluationServer<T>::statistics() const {
+
+    Statistics stats;
+    stats.requests = requests.load();
+    stats.completed = completed.load();
+    stats.batches = batches.load();
+    stats.fullBatches = fullBatches.load();
+    stats.largestBatch = largestBatch.load();
+    stats.rejected = rejected.load();
+    return stats;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Средний размер пакета.
+*/
+template <typename T>
+double EvaluationServer<T>::Statistics::averageBatch() const {
+
+    return batches ? static_cast<double>(completed) / batches : 0.0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ДИСПЕТЧЕР
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Проверка запроса и постановка в очередь. Спящий диспетчер будится, только если он есть:
+барьеры здесь и в dispatch гарантируют, что либо производитель увидит sleeping > 0,
+либо диспетчер увидит запрос в очереди до того, как уснет.
+*/
+template <typename T>
+void EvaluationServer<T>::enqueue(Request& request) {
+
+    if (request.values.size() != variables(request.expression).size())
+        throw std::runtime_error("Expression " + std::to_string(request.expression) + " expects " +
+                                 std::to_string(variables(request.expression).size()) + " variable values");
+
+    request.arrival = Clock::now();
+    if (!queue.push(request)) {
+        rejected++;
+        throw std::runtime_error("Evaluation queue is full");
+    }
+    requests++;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.notify_one();
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Цикл диспетчера. Признак остановки читается до разбора очереди: все запросы, принятые до
+остановки, к этому моменту уже в очереди и будут вычислены на последнем проходе.
+*/
+template <typename T>
+void EvaluationServer<T>::dispatch() {
+
+    std::vector<Group> groups(programs.size());
+    Request request;
+
+    for (;;) {
+
+        bool stop = stopping.load();
+
+        while (queue.pop(request)) {
+
+            uint32_t expression = request.expression;
+            Group& group = groups[expression];
+            if (group.requests.empty())
+                group.oldest = request.arrival;
+            group.requests.push_back(std::move(request));
+
+            if (group.requests.size() >= options.maxBatch)
+                run(expression, group.requests, true);
+        }
+
+        auto now = Clock::now();
+        auto next = Clock::time_point::max();
+        for (uint32_t i = 0; i < groups.size(); i++) {
+
+            Group& group = groups[i];
+            if (group.requests.empty()) continue;
+
+            if (stop || now - group.oldest >= options.maxLatency)
+                run(i, group.requests, false);
+            else
+                next = std::min(next, group.oldest + options.maxLatency);
+        }
+
+        if (stop) return;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queue.size() == 0 && !stopping) {
+            if (next == Clock::time_point::max())
+                ready.wait(lock);
+            else
+                ready.wait_until(lock, next);
+        }
+        sleeping--;
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Меньше стольких запросов выгоднее считать по одному: пакет всегда обрабатывает целый блок
+Program::evaluateBatch.
+*/
+static constexpr size_t SERVER_MIN_BATCH = 8;
+
+/*
+Вычисление группы и выдача результатов; группа очищается.
+*/
+template <typename T>
+void EvaluationServer<T>::run(uint32_t expression, std::vector<Request>& group, bool full) {
+
+    const Program<T>& program = programs[expression];
+    const auto& names = program.variables();
+    size_t n = group.size();
+
+    std::vector<T> values;
+    if (n >= SERVER_MIN_BATCH) {
+        try {
+            std::unordered_map<std::string, std::vector<T>> columns;
+            for (size_t k = 0; k < names.size(); k++) {
+                std::vector<T>& column = columns[names[k]];
+                column.reserve(n);
+                for (const auto& request : group)
+                    column.push_back(request.values[k]);
+            }
+            values = program.evaluateBatch(columns, options.accuracy)[0];
+        }
+        catch (const std::runtime_error&) {
+            values.clear();
+        }
+    }
+
+    std::vector<T> outputs, registers;
+
+    for (size_t i = 0; i < n; i++) {
+
+        Request& request = group[i];
+        T value{};
+        std::exception_ptr error;
+
+        if (values.empty()) { // Маленькая группа или ошибка в пакете.
+            try {
+                program.evaluate(request.values, outputs, registers, options.accuracy);
+                value = outputs[0];
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        }
+        else {
+            value = values[names.empty() ? 0 : i]; // Без переменных пакет из одного значения.
+        }
+
+        if (request.callback) {
+            try { request.callback(value, error); }
+            catch (...) {} // Исключение обратного вызова не должно остановить диспетчер.
+        }
+        else if (error) {
+            request.promise->set_exception(error);
+        }
+        else {
+            request.promise->set_value(value);
+        }
+    }
+
+    completed += n;
+    batches++;
+    if (full) fullBatches++;
+    size_t largest = largestBatch.load();
+    while (n > largest && !largestBatch.compare_exchange_weak(largest, n)) {}
+
+    group.clear();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class EvaluationServer<float>;
+template class EvaluationServer<double>;
+template class EvaluationServer<long double>;
+template class EvaluationServer<std::complex<double>>;
+template class EvaluationServer<std::complex<long double>>;
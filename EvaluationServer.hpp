@@ -0,0 +1,141 @@
+#ifndef EXPR_EVALUATION_SERVER_HPP
+#define EXPR_EVALUATION_SERVER_HPP
+
+#include "Program.hpp"
+#include "MpmcQueue.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+/*
+Сервер вычислений внутри процесса: отдельные запросы «значение выражения i в точке» приходят
+из любых потоков, складываются в очередь без блокировок, а потоки-диспетчеры разбирают ее,
+группируют запросы по выражению и вычисляют каждую группу пакетно (Program::evaluateBatch).
+Группа отправляется на вычисление, когда в ней maxBatch запросов или когда самый старый ее
+запрос ждет maxLatency (адаптивная пакетизация: под нагрузкой пакеты большие, без нагрузки
+задержка не больше maxLatency). Результат возвращается через std::future или функцию обратного вызова.
+*/
+template <typename T>
+class EvaluationServer {
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    /*
+    Результат запроса для функции обратного вызова: значение или исключение (error не пусто).
+    Функция вызывается в потоке диспетчера и не должна долго работать.
+    */
+    using Callback = std::function<void(const T& value, std::exception_ptr error)>;
+
+    struct Options {
+
+        size_t maxBatch = 256;                              // Наибольший размер пакета.
+        std::chrono::microseconds maxLatency{200};          // Наибольшее ожидание запроса в группе.
+        size_t queueCapacity = size_t(1) << 16;             // Емкость очереди запросов.
+        unsigned dispatchers = 1;                           // Потоков-диспетчеров.
+        Accuracy accuracy = Accuracy::Exact;                // Точность sin, cos, exp и ln.
+        unsigned level = 2;                                 // Уровень оптимизации программ.
+    };
+
+    /*
+    Счетчики с момента запуска (читаются без остановки сервера).
+    */
+    struct Statistics {
+
+        size_t requests = 0;        // Принято запросов.
+        size_t completed = 0;       // Выполнено (со значением или с исключением).
+        size_t batches = 0;         // Пакетных вычислений.
+        size_t fullBatches = 0;     // Из них отправлено по размеру (остальные — по задержке или при остановке).
+        size_t largestBatch = 0;
+        size_t rejected = 0;        // Отклонено из-за переполнения очереди.
+
+        double averageBatch() const;
+    };
+
+    /*
+    Сервер для набора выражений; номер выражения в запросе — его индекс в exprs.
+    Выражения компилируются в Program<T> один раз.
+    */
+    explicit EvaluationServer(const std::vector<Expression<T>>& exprs, const Options& options);
+
+    explicit EvaluationServer(const std::vector<Expression<T>>& exprs);
+
+    EvaluationServer(const EvaluationServer&) = delete;
+    EvaluationServer& operator=(const EvaluationServer&) = delete;
+
+    /*
+    Остановка: принятые запросы вычисляются, затем потоки диспетчеров завершаются.
+    */
+    ~EvaluationServer();
+
+    /*
+    Запрос: values — значения переменных выражения expression в порядке variables(expression).
+    Если очередь полна, бросается std::runtime_error (запрос не принимается).
+    */
+    std::future<T> submit(uint32_t expression, std::vector<T> values);
+
+    void submit(uint32_t expression, std::vector<T> values, Callback callback);
+
+    const std::vector<std::string>& variables(uint32_t expression) const;
+
+    size_t expressions() const;
+
+    Statistics statistics() const;
+
+private:
+
+    struct Request {
+
+        uint32_t expression = 0;
+        std::vector<T> values;
+        Clock::time_point arrival;
+        std::optional<std::promise<T>> promise; // Только без callback (создается в submit).
+        Callback callback;          // Пусто — результат в promise.
+    };
+
+    /*
+    Запросы одного выражения, ждущие вычисления.
+    */
+    struct Group {
+
+        std::vector<Request> requests;
+        Clock::time_point oldest;
+    };
+
+    Options options;
+    std::vector<Program<T>> programs;
+    MpmcQueue<Request> queue;
+    std::vector<std::thread> workers;
+
+    // Пробуждение спящих диспетчеров: производитель берет mutex, только если кто-то спит.
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::atomic<unsigned> sleeping{0};
+    std::atomic<bool> stopping{false};
+
+    std::atomic<size_t> requests{0}, completed{0}, batches{0}, fullBatches{0}, largestBatch{0}, rejected{0};
+
+    /*
+    Постановка запроса в очередь.
+    */
+    void enqueue(Request&);
+
+    /*
+    Цикл диспетчера: забрать запросы из очереди, отправить готовые группы, уснуть до ближайшего срока.
+    */
+    void dispatch();
+
+    /*
+    Пакетное вычисление группы; если пакет бросил исключение (область определения), запросы
+    группы вычисляются по одному, и исключение получает только тот, кто его вызвал.
+    */
+    void run(uint32_t expression, std::vector<Request>& group, bool full);
+};
+
+#endif
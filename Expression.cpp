@@ -1,4 +1,16 @@
 #include "Expression.hpp"
+#include <chrono>
+#include <iomanip>
+#include <numeric>
+#include <algorithm>
+#include "AllocCounter.hpp"
+#include "ThreadPool.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 // ---------------------------------------------------------------------------------------------------- //
 // КОНСТРУКТОРЫ И ДЕСТРУКТОРЫ
@@ -18,11 +30,10 @@ Expression<T>::Expression() : root{nullptr} {}
 template <typename T>
 Expression<T>::Expression(const char* arg) { 
 
-    size_t pos = 0;
-    std::vector<std::string> tokens = tokenize(arg);
-    root = parseExpression(tokens, pos);
-    if (pos != tokens.size())
-        throw std::runtime_error("Invalid expression");
+    ParseError error;
+    root = parseRoot(arg, error);
+    if (!root)
+        throw std::runtime_error(error.toString(arg));
 }
 
 // --------------------------------------------------------------- //
@@ -33,20 +44,17 @@ Expression<T>::Expression(const char* arg) {
 template <typename T>
 Expression<T>::Expression(const T &arg) {
     
-    size_t pos = 0;
-    std::vector<std::string> tokens;
+    std::string number;
 
-    if constexpr (std::is_same_v<T, std::complex<long double>>) {
-        std::string number = numToString(arg.real()) + '+' + numToString(arg.imag()) + 'I';
-        tokens = tokenize(number);
-    }
-    else {
-        tokens = tokenize(numToString(arg));
-    }
+    if constexpr (isComplex<T>) 
+        number = numToString(arg.real()) + '+' + numToString(arg.imag()) + 'I';
+    else 
+        number = numToString(arg);
     
-    root = parseExpression(tokens, pos);
-    if (pos != tokens.size())
-        throw std::runtime_error("Invalid expression");
+    ParseError error;
+    root = parseRoot(number, error);
+    if (!root)
+        throw std::runtime_error(error.toString(number));
 }
 
 // --------------------------------------------------------------- //
@@ -68,6 +76,23 @@ Expression<T>::Expression(const Expression<T>& other) {
 template <typename T>
 Expression<T>::Expression(Expression<T>&& other) noexcept : root(std::move(other.root)) {}
 
+// --------------------------------------------------------------- //
+
+/*
+Разбор строки без исключений.
+*/
+template <typename T>
+ParseResult<T> Expression<T>::parse(std::string_view source, Chains chains) {
+
+    ParseError error;
+    Expression<T> expr;
+    expr.root = parseRoot(source, error, chains);
+
+    if (!expr.root)
+        return ParseResult<T>(error);
+    return ParseResult<T>(std::move(expr));
+}
+
 
 
 
@@ -138,10 +163,10 @@ void Expression<T>::subsVar(const std::string& varStr) {
                 }
             }
 
-            if constexpr (std::is_same_v<T, std::complex<long double>>)
-                varMap[varName] = varValue;
+            if constexpr (isComplex<T>)
+                varMap[varName] = T(varValue);
             else
-                varMap[varName] = varValue.real();
+                varMap[varName] = static_cast<T>(varValue.real());
             
             i--;
         }
@@ -170,110 +195,129 @@ T Expression<T>::evaluate() const {
 // --------------------------------------------------------------- //
 
 /*
-Продифференцировать по переменной.
+Вычислить значение выражения при заданных значениях переменных.
 */
 template <typename T>
-Expression<T> Expression<T>::differentiate(const std::string& var) const {
-    Expression<T> result;
-    result.root = differentiateHelper(this->root.get(), var);
-    return result;
-}
-
-
-
-
-
-
-
-
+T Expression<T>::evaluate(const std::unordered_map<std::string, T>& vars, Accuracy accuracy) const {
 
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
 
+    return evaluateHelper(root.get(), &vars, nullptr, accuracy);
+}
 
+// --------------------------------------------------------------- //
 
+/*
+Вычислить значение выражения в смешанной точности.
+Если итог в double переполнился, возвращается значение корня в long double.
+*/
+template <typename T>
+T Expression<T>::evaluateMixed() const {
 
+    using Wide = std::conditional_t<isComplex<T>, std::complex<long double>, long double>;
 
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
 
+    MixedValue value = evaluateMixedHelper(root.get());
+    if (!std::isfinite(std::abs(value.fast)))
+        return static_cast<T>(value.widened ? value.wide : evaluateHelper<Wide>(root.get()));
 
+    return static_cast<T>(value.fast);
+}
 
+// --------------------------------------------------------------- //
 
+/*
+Пакетное вычисление выражения.
+*/
+template <typename T>
+std::vector<T> Expression<T>::evaluateBatch(const std::unordered_map<std::string, std::vector<T>>& vars, 
+                                            Accuracy accuracy) const {
 
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
 
+    size_t n = vars.empty() ? 1 : vars.begin()->second.size();
+    std::unordered_map<std::string, Batch> columns;
 
+    for (const auto& [name, values] : vars) {
 
-// ---------------------------------------------------------------------------------------------------- //
-// МЕТОДЫ УЗЛОВ AST
-// ---------------------------------------------------------------------------------------------------- //
+        if (values.size() != n)
+            throw std::runtime_error("Batch columns have different sizes");
 
-/*
-Узел с числом в строку.
-*/
-template <typename T>
-std::string 
-Expression<T>::NumberNode::nodeToString() const {
+        Batch& column = columns[name];
+        column.re.resize(n);
+        if constexpr (isComplex<T>) {
+            column.im.resize(n);
+            for (size_t i = 0; i < n; i++) {
+                column.re[i] = values[i].real();
+                column.im[i] = values[i].imag();
+            }
+        }
+        else {
+            column.re = values;
+        }
+    }
 
-    std::string str_value;
+    Batch result = evaluateBatchHelper(root.get(), columns, n, accuracy);
 
-    if constexpr (std::is_same_v<T, long double>) {
-        str_value = numToString(value);
-    }
-    else {
-        if (value.real()) 
-            str_value = numToString(value.real());
-        else 
-            str_value = numToString(value.imag()) + 'I';
+    std::vector<T> out(n);
+    for (size_t i = 0; i < n; i++) {
+        if constexpr (isComplex<T>)
+            out[i] = T(result.re[i], result.im[i]);
+        else
+            out[i] = result.re[i];
     }
 
-    return str_value;
+    return out;
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Узел с переменной в строку.
+Интервальное вычисление.
+Использует тот же обход дерева, что и evaluate(), но в арифметике отрезков.
 */
 template <typename T>
-std::string Expression<T>::VariableNode::nodeToString() const {
-
-    return name;
-}
+Interval<RealOf<T>> 
+Expression<T>::evaluateInterval(const std::unordered_map<std::string, Interval<RealOf<T>>>& vars) const {
 
-// --------------------------------------------------------------- //
-
-/*
-Узел с бин. операцией в строку.
-*/
-template <typename T>
-std::string Expression<T>::BinaryOperationNode::nodeToString() const {
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
 
-    std::string leftStr = left->nodeToString();
-    std::string rightStr = right->nodeToString();
-    
-    if (operation == '^')
-        return "(" + leftStr + "^" + rightStr + ")";
+    if constexpr (isComplex<T>)
+        throw std::runtime_error("Interval evaluation of complex expressions is not supported");
     else
-        return "(" + leftStr + " " + operation + " " + rightStr + ")";
+        return evaluateHelper<Interval<T>>(root.get(), &vars);
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Узел с унарной операцией в строку.
+Количество узлов в дереве.
 */
 template <typename T>
-std::string Expression<T>::UnaryOperationNode::nodeToString() const {
+size_t Expression<T>::nodeCount() const {
 
-    return "(" + std::string(1, operation) + arg->nodeToString() + ")";
+    return countNodes(root.get());
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Узел с функцией в строку.
+Продифференцировать по переменной.
 */
 template <typename T>
-std::string Expression<T>::FunctionNode::nodeToString() const {
-
-    return function + "(" + arg->nodeToString() + ")";
+Expression<T> Expression<T>::differentiate(const std::string& var) const {
+    Expression<T> result;
+    result.root = differentiateHelper(this->root.get(), var);
+    return result;
 }
 
 
@@ -294,113 +338,145 @@ std::string Expression<T>::FunctionNode::nodeToString() const {
 
 
 
+
 
 // ---------------------------------------------------------------------------------------------------- //
-// ПЕРЕГРУЗКИ ОПЕРАТОРОВ ДЛЯ EXPRESSION
+// СТАТИСТИКА И ПРОФИЛИРОВАНИЕ
 // ---------------------------------------------------------------------------------------------------- //
 
-std::ostream& operator<<(std::ostream& os, const std::complex<long double>& c) {
+/*
+Статистика дерева.
+*/
+template <typename T>
+typename Expression<T>::Statistics Expression<T>::statistics() const {
 
-    char beautify_with_space = '\0';
-    if (c.real() && c.imag()) beautify_with_space = ' ';
-    
-    if (!c.real() && !c.imag()) 
-        return os << 0;
-    
-    if (c.real())
-        os << c.real();  
-    
-    if (c.imag() > 0) {
-        if (c.real()) os << beautify_with_space << "+" << beautify_with_space;
-        os << c.imag() << 'I';  
-    }
-    else if (c.imag() < 0)
-        os << beautify_with_space << "-" << beautify_with_space << -c.imag() << "I"; 
+    Statistics stats;
+    if (!root) return stats;
 
-    return os;
-}
+    std::unordered_map<std::string, size_t> subtrees;
+    std::unordered_set<std::string> names;
+    statisticsHelper(root.get(), 0, stats, subtrees, names);
 
+    stats.uniqueSubtrees = subtrees.size();
+    stats.distinctVariables = names.size();
+    return stats;
+}
 
 // --------------------------------------------------------------- //
 
+/*
+Вычисление с профилированием.
+*/
 template <typename T>
-Expression<T> Expression<T>::operator+(const Expression<T>& other) {
-    
-    Expression<T> result;
-    result.root = std::make_unique<BinaryOperationNode>(
-        '+', copyTree(this->root.get()), copyTree(other.root.get()));
-    return result; 
+T Expression<T>::evaluateProfiled(Profile& profile) const {
+
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
+
+    T value = evaluateHelper<T, true>(root.get(), nullptr, &profile);
+    profile.evaluations++;
+    profile.totalTicks += profile.lastTicks;
+    return value;
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Вычисление с профилированием при заданных значениях переменных.
+*/
 template <typename T>
-Expression<T> Expression<T>::operator-(const Expression<T>& other) {
+T Expression<T>::evaluateProfiled(Profile& profile, const std::unordered_map<std::string, T>& vars) const {
 
-    Expression<T> result;
-    result.root = std::make_unique<BinaryOperationNode>
-        ('-', copyTree(this->root.get()), copyTree(other.root.get()));
-    return result; 
+    if (!root) {
+        throw std::runtime_error("Expression tree is empty");
+    }
+
+    T value = evaluateHelper<T, true>(root.get(), &vars, &profile);
+    profile.evaluations++;
+    profile.totalTicks += profile.lastTicks;
+    return value;
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Статистика в строку (таблица для вывода в консоль).
+*/
 template <typename T>
-Expression<T> Expression<T>::operator*(const Expression<T>& other) {
+std::string Expression<T>::Statistics::toString() const {
 
-    Expression<T> result;
-    result.root = std::make_unique<BinaryOperationNode>
-        ('*', copyTree(this->root.get()), copyTree(other.root.get()));
-    return result; 
+    std::ostringstream out;
+    out << "nodes:              " << nodes << "\n"
+        << "  numbers:          " << numbers << "\n"
+        << "  variables:        " << variables << "\n"
+        << "  binary ops:       " << binaryOperations << "\n"
+        << "  unary ops:        " << unaryOperations << "\n"
+        << "  n-ary ops:        " << naryOperations << "\n"
+        << "  functions:        " << functions << "\n"
+        << "depth:              " << depth << "\n"
+        << "unique subtrees:    " << uniqueSubtrees << "\n"
+        << "distinct variables: " << distinctVariables << "\n"
+        << "estimated cost:     " << estimatedCost << " cycles\n";
+    return out.str();
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Название вида узла.
+*/
 template <typename T>
-Expression<T> Expression<T>::operator/(const Expression<T>& other) {
+const char* Expression<T>::Profile::kindName(size_t kind) {
 
-    Expression<T> result;
-    result.root = std::make_unique<BinaryOperationNode>
-        ('/', copyTree(this->root.get()), copyTree(other.root.get()));
-    return result; 
+    static const char* NAMES[KINDS] = {
+        "number", "variable", "+", "-", "*", "/", "^", "unary -", "sin", "cos", "ln", "exp", "sum", "product",
+        "function"
+    };
+    return kind < KINDS ? NAMES[kind] : "?";
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Единица измерения времени в профиле.
+*/
 template <typename T>
-Expression<T> Expression<T>::operator^(const Expression<T>& other) {
+const char* Expression<T>::Profile::tickUnit() {
 
-    Expression<T> result;
-    result.root = std::make_unique<BinaryOperationNode>
-        ('^', copyTree(this->root.get()), copyTree(other.root.get()));
-    return result; 
+#if defined(__x86_64__) || defined(__i386__)
+    return "cycles";
+#else
+    return "ns";
+#endif
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Профиль в строку: виды узлов, которые вызывались, с числом вызовов, собственным временем,
+временем в библиотечной функции и долей от полного времени.
+*/
 template <typename T>
-Expression<T>& Expression<T>::operator=(const Expression<T>& other) { // Оператор копирования.
-
-    if (this != &other) {
+std::string Expression<T>::Profile::toString() const {
 
-        if (other.root)
-            root = copyTree(other.root.get());
-        else 
-            root.reset(nullptr);
-    }
-    
-    return *this;
-}
+    std::ostringstream out;
+    out << "evaluations: " << evaluations << ", total: " << totalTicks << " " << tickUnit() << "\n";
+    out << std::left << std::setw(10) << "node" << std::right << std::setw(12) << "calls" 
+        << std::setw(16) << "self" << std::setw(16) << "in libm" << std::setw(9) << "share" << "\n";
 
-// --------------------------------------------------------------- //
+    for (size_t kind = 0; kind < KINDS; kind++) {
 
-template <typename T>
-Expression<T>& Expression<T>::operator=(Expression<T>&& other) noexcept { // Оператор перемещения.
+        const Counter& counter = counters[kind];
+        if (counter.calls == 0) continue;
 
-    if (this != &other) {
-        root = std::move(other.root);
+        double share = totalTicks ? 100.0 * counter.ticks / totalTicks : 0;
+        out << std::left << std::setw(10) << kindName(kind) << std::right << std::setw(12) << counter.calls 
+            << std::setw(16) << counter.ticks << std::setw(16) << counter.mathTicks 
+            << std::setw(8) << std::fixed << std::setprecision(1) << share << "%\n";
     }
-    return *this;
+
+    return out.str();
 }
 
 
@@ -421,61 +497,96 @@ Expression<T>& Expression<T>::operator=(Expression<T>&& other) noexcept { // О
 
 
 
+
 
 // ---------------------------------------------------------------------------------------------------- //
-// НУЛЕВОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (ХРАНЕНИЕ В AST-ДЕРЕВЕ)
+// УЧЕТ ПАМЯТИ
 // ---------------------------------------------------------------------------------------------------- //
 
 /*
-Токенизация выражения для последующего парсинга.
+Память, занимаемая выражением.
 */
 template <typename T>
-std::vector<std::string> Expression<T>::tokenize(const std::string& expr) { 
+typename Expression<T>::MemoryUsage Expression<T>::memoryUsage() const {
+
+    MemoryUsage usage;
+    usage.objectBytes = sizeof(*this);
+    memoryHelper(root.get(), usage);
+    return usage;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Выделения памяти по операциям. Каждая операция выполняется один раз, между замерами 
+счетчиков ничего другого не делается (результаты освобождаются уже после замера).
+*/
+template <typename T>
+std::vector<typename Expression<T>::OperationAllocations> 
+Expression<T>::allocationStatistics(const char* formula, const std::string& subs, const std::string& var) {
+
+    std::vector<OperationAllocations> result;
 
+    auto measure = [&](const std::string& operation, auto&& body) {
+        AllocationCounters before = allocationCounters();
+        body();
+        AllocationCounters after = allocationCounters();
+        result.push_back({operation, after.allocations - before.allocations, after.bytes - before.bytes});
+    };
+
+    Expression<T> expr;
     std::vector<std::string> tokens;
-    
-    for (unsigned i = 0; i < expr.size(); ++i) {
+    measure("tokenize", [&] { tokens = expr.tokenize(formula); });
+    measure("parse", [&] { expr = Expression<T>(formula); });
 
-        if (std::isspace(expr[i])) continue;
+    Expression<T> copy;
+    measure("copyTree", [&] { copy = Expression<T>(expr); });
+    measure("subsVar", [&] { copy.subsVar(subs); });
 
-        if (std::isdigit(expr[i]) || 
-            expr[i] == '.' ||
-            (expr[i] == 'I' && 
-            (i + 1 < expr.size() || 
-             !std::isalnum(expr[i+1])))) { 
+    Expression<T> derivative;
+    if (!var.empty())
+        measure("differentiate", [&] { derivative = expr.differentiate(var); });
 
-            std::string num;
+    std::string str;
+    measure("toString", [&] { str = expr.toString(); });
 
-            while (i < expr.size() && 
-                  (std::isdigit(expr[i]) || 
-                   expr[i] == '.' || 
-                   expr[i] == 'I')) {
-                num += expr[i++];
-            }
+    return result;
+}
 
-            tokens.push_back(num);
-            --i;
-        } 
-        else if (std::isalpha(expr[i])) { // Переменная или функция
+// --------------------------------------------------------------- //
+
+/*
+Выделения памяти по операциям в строку (таблица для вывода в консоль).
+*/
+template <typename T>
+std::string Expression<T>::allocationsToString(const std::vector<OperationAllocations>& operations) {
 
-            if (!tokens.empty() && std::isdigit(tokens.back()[0])) 
-                tokens.push_back("*");
+    std::ostringstream out;
+    out << std::left << std::setw(24) << "operation" << std::right << std::setw(12) << "allocs" 
+        << std::setw(14) << "bytes" << "\n";
+    for (const auto& operation : operations)
+        out << std::left << std::setw(24) << operation.operation << std::right << std::setw(12) 
+            << operation.allocations << std::setw(14) << operation.bytes << "\n";
+    return out.str();
+}
 
-            std::string name;
+// --------------------------------------------------------------- //
 
-            while (i < expr.size() && std::isalnum(expr[i])) 
-                name += std::tolower(expr[i++]);
+/*
+Память в строку.
+*/
+template <typename T>
+std::string Expression<T>::MemoryUsage::toString() const {
 
-            tokens.push_back(name);
-            --i; 
-        } 
-        else {
-            tokens.push_back(std::string(1, expr[i])); // Операторы, "()" или "=" 
-                                                       // (для функции замены переменных на значения)
-        }
-    }
-    
-    return tokens;
+    std::ostringstream out;
+    out << "nodes:          " << nodes << "\n"
+        << "node bytes:     " << nodeBytes << "\n"
+        << "string bytes:   " << stringBytes << "\n"
+        << "link bytes:     " << linkBytes << "\n"
+        << "object bytes:   " << objectBytes << "\n"
+        << "total bytes:    " << bytes() << (nodes ? " (" + numToString(static_cast<long double>(bytes()) / nodes) + " per node)" : "") << "\n"
+        << "heap bytes:     " << heapBytes << "\n";
+    return out.str();
 }
 
 
@@ -493,69 +604,888 @@ std::vector<std::string> Expression<T>::tokenize(const std::string& expr) {
 
 
 
+
+
+
+
 
 
 // ---------------------------------------------------------------------------------------------------- //
-// ПЕРВЫЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ ОПЕРАЦИЙ В СООТВЕТСВИИ С PEMDAS)
+// ЧАСТИЧНОЕ ВЫЧИСЛЕНИЕ
 // ---------------------------------------------------------------------------------------------------- //
 
 /*
-Сложение, вычитание.
+Специализация по связанным переменным.
 */
 template <typename T>
-std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseExpression(const std::vector<std::string>& tokens, size_t& pos) {
+Expression<T> Expression<T>::specialize(const std::unordered_map<std::string, T>& bindings, Specialization* report) const {
 
-    auto left = parseTerm(tokens, pos);
-    while (pos < tokens.size() && (tokens[pos] == "+" || tokens[pos] == "-")) {
+    if (!root)
+        throw std::runtime_error("Expression tree is empty");
 
-        char op = tokens[pos++][0];
-        auto right = parseTerm(tokens, pos);
-        left = std::make_unique<BinaryOperationNode>
-            (op, std::move(left), std::move(right));
+    Expression<T> result;
+    bool bound = false;
+    size_t folded = 0;
+    result.root = specializeHelper(root.get(), bindings, bound, folded);
+    if (bound)
+        result.root = foldSubtree(root.get(), std::move(result.root), bindings, folded);
+
+    if (report) {
+        report->nodes = nodeCount();
+        report->remainingNodes = result.nodeCount();
+        report->foldedSubtrees = folded;
+        report->cost = statistics().estimatedCost;
+        report->remainingCost = result.statistics().estimatedCost;
     }
 
-    return left;
+    return result;
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Умножение, деление.
+Доля устраненной работы.
 */
 template <typename T>
-std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseTerm(const std::vector<std::string>& tokens, size_t& pos) {
-
-    auto left = parseExponent(tokens, pos);
-    while (pos < tokens.size() && (tokens[pos] == "*" || tokens[pos] == "/")) {
+double Expression<T>::Specialization::eliminatedFraction() const {
 
-        char op = tokens[pos++][0];
-        auto right = parseExponent(tokens, pos);
-        left = std::make_unique<BinaryOperationNode>
-            (op, std::move(left), std::move(right));
-    }
-
-    return left;
+    return cost > 0 ? 1.0 - remainingCost / cost : 0.0;
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Степень.
+Отчет о специализации в строку.
 */
 template <typename T>
-std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseExponent(const std::vector<std::string>& tokens, size_t& pos) {
+std::string Expression<T>::Specialization::toString() const {
 
-    auto left = parseFactor(tokens, pos);
-    while (pos < tokens.size() && tokens[pos] == "^") {
+    std::ostringstream out;
+    out << "nodes:              " << nodes << " -> " << remainingNodes << "\n"
+        << "folded subtrees:    " << foldedSubtrees << "\n"
+        << "estimated cost:     " << cost << " -> " << remainingCost << " cycles\n"
+        << "work eliminated:    " << std::fixed << std::setprecision(1) << 100 * eliminatedFraction() << "%\n";
+    return out.str();
+}
 
-        ++pos; // Пропускаем "^"
-        auto right = parseFactor(tokens, pos); 
-        left = std::make_unique<BinaryOperationNode>
-            ('^', std::move(left), std::move(right));
-    }
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// БИБЛИОТЕКА ФУНКЦИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Реестр типа T создается при первом обращении и содержит встроенные функции и "pow".
+*/
+template <typename T>
+typename Expression<T>::FunctionRegistry& Expression<T>::functionRegistry() {
+
+    static FunctionRegistry registry{[] {
+        std::unordered_map<std::string, uint16_t> ids;
+        for (uint16_t id = 0; id < static_cast<uint16_t>(Function::BUILTINS); id++)
+            ids.emplace(functionInfo(static_cast<Function>(id)).name, id);
+        ids.emplace("pow", POW_ALIAS);
+        return ids;
+    }()};
+    return registry;
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+uint16_t Expression<T>::registerFunction(FunctionDefinition definition) {
+
+    std::string& name = definition.name;
+    for (char& c : name) c = std::tolower(static_cast<unsigned char>(c));
+
+    bool identifier = !name.empty() && std::isalpha(static_cast<unsigned char>(name[0])) && 
+        std::all_of(name.begin(), name.end(), [](unsigned char c) { return std::isalnum(c); });
+    if (!identifier)
+        throw std::runtime_error("Invalid function name: " + name);
+    if (definition.arity < 1 || definition.arity > FunctionNode::MAX_ARITY)
+        throw std::runtime_error("Function " + name + " must take 1 or 2 arguments");
+    if (!definition.scalar)
+        throw std::runtime_error("Function " + name + " has no scalar kernel");
+
+    FunctionRegistry& registry = functionRegistry();
+    std::unique_lock lock(registry.mutex);
+    if (registry.ids.count(name))
+        throw std::runtime_error("Function " + name + " is already defined");
+    size_t id = static_cast<size_t>(Function::BUILTINS) + registry.definitions.size();
+    if (id >= UNKNOWN_FUNCTION)
+        throw std::runtime_error("Too many functions");
+
+    registry.ids.emplace(name, static_cast<uint16_t>(id));
+    registry.definitions.push_back(std::move(definition));
+    return static_cast<uint16_t>(id);
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+void Expression<T>::unregisterFunction(const std::string& name) {
+
+    std::string key = name;
+    for (char& c : key) c = std::tolower(static_cast<unsigned char>(c));
+
+    FunctionRegistry& registry = functionRegistry();
+    std::unique_lock lock(registry.mutex);
+    auto found = registry.ids.find(key);
+    if (found == registry.ids.end())
+        throw std::runtime_error("Unknown function: " + name);
+    if (found->second < static_cast<uint16_t>(Function::BUILTINS) || found->second == POW_ALIAS)
+        throw std::runtime_error("Built-in function " + key + " cannot be unregistered");
+    registry.ids.erase(found);
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+uint16_t Expression<T>::functionId(const std::string& name) {
+
+    FunctionRegistry& registry = functionRegistry();
+    std::shared_lock lock(registry.mutex);
+    auto found = registry.ids.find(name);
+    return found == registry.ids.end() ? UNKNOWN_FUNCTION : found->second;
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+const typename Expression<T>::FunctionDefinition& Expression<T>::functionDefinition(uint16_t id) {
+
+    FunctionRegistry& registry = functionRegistry();
+    std::shared_lock lock(registry.mutex);
+    return registry.definitions[id - static_cast<uint16_t>(Function::BUILTINS)];
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::call(const std::string& name, std::vector<Expression<T>> args) {
+
+    std::string key = name;
+    for (char& c : key) c = std::tolower(static_cast<unsigned char>(c));
+
+    uint16_t id = functionId(key);
+    if (id == UNKNOWN_FUNCTION)
+        throw std::runtime_error("Unknown function: " + name);
+
+    if (args.size() != (id == POW_ALIAS ? 2 : functionArity(id)))
+        throw std::runtime_error("Wrong number of arguments of " + key);
+    for (const auto& arg : args) {
+        if (!arg.root)
+            throw std::runtime_error("Empty argument of " + key);
+    }
+
+    Expression<T> result;
+    if (id == POW_ALIAS)
+        result.root = powerNode(std::move(args[0].root), std::move(args[1].root));
+    else
+        result.root = std::make_unique<FunctionNode>(id, std::move(args[0].root), 
+            args.size() > 1 ? std::move(args[1].root) : nullptr);
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+const std::string& Expression<T>::functionName(uint16_t id) {
+
+    if (id < static_cast<uint16_t>(Function::BUILTINS)) {
+        static const std::vector<std::string> NAMES = [] {
+            std::vector<std::string> names;
+            for (uint16_t i = 0; i < static_cast<uint16_t>(Function::BUILTINS); i++)
+                names.emplace_back(functionInfo(static_cast<Function>(i)).name);
+            return names;
+        }();
+        return NAMES[id];
+    }
+    return functionDefinition(id).name;
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+unsigned Expression<T>::functionArity(uint16_t id) {
+
+    if (id < static_cast<uint16_t>(Function::BUILTINS))
+        return functionInfo(static_cast<Function>(id)).arity;
+    return functionDefinition(id).arity;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Встроенные функции — по номеру, без обращения к реестру. Ядро пользовательской функции 
+считает в T: аргументы другой точности приводятся к T и обратно.
+*/
+template <typename T>
+template <typename U>
+U Expression<T>::callFunction(uint16_t id, const U& first, const U& second) {
+
+    if (id < static_cast<uint16_t>(Function::BUILTINS))
+        return applyFunction(static_cast<Function>(id), first, second);
+
+    const FunctionDefinition& definition = functionDefinition(id);
+    if constexpr (std::is_same_v<U, T>) {
+        T args[FunctionNode::MAX_ARITY] = {first, second};
+        return definition.scalar(args);
+    }
+    else if constexpr (std::is_same_v<U, Interval<RealOf<T>>>) {
+        throw std::runtime_error("User function " + definition.name + " is not supported in interval evaluation");
+    }
+    else {
+        T args[FunctionNode::MAX_ARITY] = {static_cast<T>(first), static_cast<T>(second)};
+        return static_cast<U>(definition.scalar(args));
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// МЕТОДЫ УЗЛОВ AST
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Узел с числом в строку.
+*/
+template <typename T>
+std::string 
+Expression<T>::NumberNode::nodeToString() const {
+
+    std::string str_value;
+
+    if constexpr (!isComplex<T>) {
+        str_value = numToString(value);
+    }
+    else {
+        if (value.real()) 
+            str_value = numToString(value.real());
+        else 
+            str_value = numToString(value.imag()) + 'I';
+    }
+
+    return str_value;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел с переменной в строку.
+*/
+template <typename T>
+std::string Expression<T>::VariableNode::nodeToString() const {
+
+    return name;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел с бин. операцией в строку.
+*/
+template <typename T>
+std::string Expression<T>::BinaryOperationNode::nodeToString() const {
+
+    if ((chain & ChainNotation) && (chain & ChainRoot)) { // Перестроенная цепочка в исходном виде.
+
+        std::vector<std::pair<bool, const Node*>> links;
+        collectChain(this, links);
+        bool additive = operation == '+' || operation == '-';
+
+        std::string result(links.size() - 1, '(');
+        result += links[0].second->nodeToString();
+        for (size_t i = 1; i < links.size(); i++) {
+            char op = links[i].first ? (additive ? '-' : '/') : (additive ? '+' : '*');
+            result += std::string(" ") + op + " " + links[i].second->nodeToString() + ")";
+        }
+        return result;
+    }
+
+    std::string leftStr = left->nodeToString();
+    std::string rightStr = right->nodeToString();
+    
+    if (operation == '^')
+        return "(" + leftStr + "^" + rightStr + ")";
+    else
+        return "(" + leftStr + " " + operation + " " + rightStr + ")";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел суммы в строку: (a + b - c), как цепочка, но с одной парой скобок.
+*/
+template <typename T>
+std::string Expression<T>::SumNode::nodeToString() const {
+
+    std::string result = "(" + terms[0].second->nodeToString();
+    for (size_t i = 1; i < terms.size(); i++)
+        result += std::string(" ") + terms[i].first + " " + terms[i].second->nodeToString();
+    return result + ")";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел произведения в строку: (a * b * c).
+*/
+template <typename T>
+std::string Expression<T>::ProductNode::nodeToString() const {
+
+    std::string result = "(" + factors[0]->nodeToString();
+    for (size_t i = 1; i < factors.size(); i++)
+        result += " * " + factors[i]->nodeToString();
+    return result + ")";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел с унарной операцией в строку.
+*/
+template <typename T>
+std::string Expression<T>::UnaryOperationNode::nodeToString() const {
+
+    return "(" + std::string(1, operation) + arg->nodeToString() + ")";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел с функцией в строку.
+*/
+template <typename T>
+std::string Expression<T>::FunctionNode::nodeToString() const {
+
+    std::string result = functionName(id) + "(" + args[0]->nodeToString();
+    for (unsigned i = 1; i < arity; i++)
+        result += ", " + args[i]->nodeToString();
+    return result + ")";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Перемешивание хэша seed со значением value (финализатор splitmix64): у соседних значений
+хэши различаются во всех разрядах.
+*/
+static size_t hashCombine(size_t seed, size_t value) {
+
+    uint64_t x = seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return static_cast<size_t>(x ^ (x >> 31));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш числа. Нули разного знака равны, поэтому их хэш один.
+*/
+template <typename T>
+void Expression<T>::NumberNode::rehash() {
+
+    auto part = [](auto number) { return number == 0 ? size_t(0) : std::hash<decltype(number)>()(number); };
+    if constexpr (isComplex<T>)
+        this->hash = hashCombine(hashCombine('n', part(value.real())), part(value.imag()));
+    else
+        this->hash = hashCombine('n', part(value));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш переменной.
+*/
+template <typename T>
+void Expression<T>::VariableNode::rehash() {
+
+    this->hash = hashCombine('v', std::hash<std::string>()(name));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш бинарной операции (флаги chain не учитываются).
+*/
+template <typename T>
+void Expression<T>::BinaryOperationNode::rehash() {
+
+    this->hash = hashCombine(hashCombine(hashCombine('b', operation), left->hash), right->hash);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш унарной операции.
+*/
+template <typename T>
+void Expression<T>::UnaryOperationNode::rehash() {
+
+    this->hash = hashCombine(hashCombine('u', operation), arg->hash);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш вызова функции.
+*/
+template <typename T>
+void Expression<T>::FunctionNode::rehash() {
+
+    this->hash = hashCombine(hashCombine('f', id), arity);
+    for (unsigned k = 0; k < arity; k++)
+        this->hash = hashCombine(this->hash, args[k]->hash);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш суммы — свертка звеньев слева направо, поэтому звено в конце дописывается к хэшу за O(1).
+*/
+template <typename T>
+void Expression<T>::SumNode::rehash() {
+
+    this->hash = 's';
+    for (const auto& [sign, term] : terms)
+        this->hash = hashCombine(hashCombine(this->hash, sign), term->hash);
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+void Expression<T>::SumNode::append(char sign, std::unique_ptr<Node> term) {
+
+    this->hash = hashCombine(hashCombine(this->hash, sign), term->hash);
+    terms.emplace_back(sign, std::move(term));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Хэш произведения (как у суммы).
+*/
+template <typename T>
+void Expression<T>::ProductNode::rehash() {
+
+    this->hash = 'p';
+    for (const auto& factor : factors)
+        this->hash = hashCombine(this->hash, factor->hash);
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+void Expression<T>::ProductNode::append(std::unique_ptr<Node> factor) {
+
+    this->hash = hashCombine(this->hash, factor->hash);
+    factors.push_back(std::move(factor));
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПЕРЕГРУЗКИ ОПЕРАТОРОВ ДЛЯ EXPRESSION
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Общее тело вывода комплексного числа для всех вещественных типов.
+*/
+template <typename R>
+static std::ostream& printComplex(std::ostream& os, const std::complex<R>& c) {
+
+    char beautify_with_space = '\0';
+    if (c.real() && c.imag()) beautify_with_space = ' ';
+    
+    if (!c.real() && !c.imag()) 
+        return os << 0;
+    
+    if (c.real())
+        os << c.real();  
+    
+    if (c.imag() > 0) {
+        if (c.real()) os << beautify_with_space << "+" << beautify_with_space;
+        os << c.imag() << 'I';  
+    }
+    else if (c.imag() < 0)
+        os << beautify_with_space << "-" << beautify_with_space << -c.imag() << "I"; 
+
+    return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const std::complex<long double>& c) {
+    return printComplex(os, c);
+}
+
+std::ostream& operator<<(std::ostream& os, const std::complex<double>& c) {
+    return printComplex(os, c);
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::operator+(const Expression<T>& other) {
+    
+    Expression<T> result;
+    result.root = std::make_unique<BinaryOperationNode>(
+        '+', copyTree(this->root.get()), copyTree(other.root.get()));
+    return result; 
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::operator-(const Expression<T>& other) {
+
+    Expression<T> result;
+    result.root = std::make_unique<BinaryOperationNode>
+        ('-', copyTree(this->root.get()), copyTree(other.root.get()));
+    return result; 
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::operator*(const Expression<T>& other) {
+
+    Expression<T> result;
+    result.root = std::make_unique<BinaryOperationNode>
+        ('*', copyTree(this->root.get()), copyTree(other.root.get()));
+    return result; 
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::operator/(const Expression<T>& other) {
+
+    Expression<T> result;
+    result.root = std::make_unique<BinaryOperationNode>
+        ('/', copyTree(this->root.get()), copyTree(other.root.get()));
+    return result; 
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T> Expression<T>::operator^(const Expression<T>& other) {
+
+    Expression<T> result;
+    result.root = powerNode(copyTree(this->root.get()), copyTree(other.root.get()));
+    return result; 
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T>& Expression<T>::operator=(const Expression<T>& other) { // Оператор копирования.
+
+    if (this != &other) {
+
+        if (other.root)
+            root = copyTree(other.root.get());
+        else 
+            root.reset(nullptr);
+    }
+    
+    return *this;
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+Expression<T>& Expression<T>::operator=(Expression<T>&& other) noexcept { // Оператор перемещения.
+
+    if (this != &other) {
+        root = std::move(other.root);
+    }
+    return *this;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// НУЛЕВОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (ХРАНЕНИЕ В AST-ДЕРЕВЕ)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Токенизация выражения для последующего парсинга.
+*/
+template <typename T>
+std::vector<std::string> Expression<T>::tokenize(const std::string& expr) { 
+
+    std::vector<std::string> tokens;
+    Cursor cursor{expr};
+
+    for (nextToken(cursor); cursor.token.kind != Token::End; nextToken(cursor)) {
+
+        const Token& token = cursor.token;
+        if (token.length == 0) { // Неявное умножение
+            tokens.push_back("*");
+            continue;
+        }
+
+        std::string text = expr.substr(token.offset, token.length);
+        if (token.kind == Token::Identifier)
+            for (char& c : text) c = std::tolower(static_cast<unsigned char>(c));
+        tokens.push_back(text);
+    }
+    
+    return tokens;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Следующая лексема. Число — цифры, '.' и 'I' ("12", "0.5", "3I", "I2"); идентификатор — буква 
+(кроме 'I') и далее буквы и цифры. Между числом и идентификатором вставляется '*' нулевой длины.
+*/
+template <typename T>
+void Expression<T>::nextToken(Cursor& cursor) {
+
+    std::string_view source = cursor.source;
+    size_t i = cursor.pos;
+    while (i < source.size() && std::isspace(static_cast<unsigned char>(source[i]))) ++i;
+
+    Token& token = cursor.token;
+    bool afterNumber = token.kind == Token::Number;
+    token = {Token::End, 0, i, 0};
+
+    if (i >= source.size()) {
+        cursor.pos = i;
+        return;
+    }
+
+    unsigned char c = source[i];
+    size_t end = i + 1;
+
+    if (std::isdigit(c) || c == '.' || c == 'I') {
+
+        token.kind = Token::Number;
+        while (end < source.size() && 
+              (std::isdigit(static_cast<unsigned char>(source[end])) || source[end] == '.' || source[end] == 'I'))
+            ++end;
+    }
+    else if (std::isalpha(c)) { // Переменная или функция
+
+        if (afterNumber) {
+            token.kind = Token::Operator;
+            token.symbol = '*';
+            cursor.pos = i;
+            return;
+        }
+
+        token.kind = Token::Identifier;
+        while (end < source.size() && std::isalnum(static_cast<unsigned char>(source[end])))
+            ++end;
+    }
+    else {
+        switch (c) {
+            case '+': case '-': case '*': case '/': case '^': 
+                token.kind = Token::Operator; 
+                token.symbol = c; 
+                break;
+            case '(': token.kind = Token::Open; break;
+            case ')': token.kind = Token::Close; break;
+            case ',': token.kind = Token::Comma; break;
+            default: token.kind = Token::Other; // "=" (для функции замены переменных на значения) 
+                                                // или посторонний символ
+        }
+    }
+
+    token.length = end - i;
+    cursor.pos = end;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПЕРВЫЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ ОПЕРАЦИЙ В СООТВЕТСВИИ С PEMDAS)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Бинарная операция: символ, приоритет и ассоциативность. '^' правоассоциативна: a^b^c = a^(b^c).
+Унарный минус связывает сильнее любой бинарной операции: -x^2 = (-x)^2.
+*/
+struct BinaryOperator {
+
+    char symbol;
+    int precedence;
+    bool rightAssociative;
+};
+
+static constexpr BinaryOperator BINARY_OPERATORS[] = {
+    {'+', 1, false}, {'-', 1, false}, {'*', 2, false}, {'/', 2, false}, {'^', 3, true}
+};
+
+static const BinaryOperator& binaryOperator(char symbol) {
+
+    for (const BinaryOperator& op : BINARY_OPERATORS)
+        if (op.symbol == symbol) return op;
+    return BINARY_OPERATORS[0]; // Недостижимо: лексер выдает только операторы из таблицы.
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Вся строка: выражение, за которым ничего нет.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::parseRoot(std::string_view source, ParseError& error, Chains chains) {
+
+    Cursor cursor{source};
+    cursor.nary = chains == Chains::Nary;
+    nextToken(cursor);
+
+    auto root = parseBinary(cursor, 1);
+    if (root && cursor.token.kind != Token::End)
+        root = fail(cursor, ParseError::TrailingInput);
+
+    error = cursor.error;
+    return root;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Восхождение по приоритетам: правый операнд левоассоциативной операции разбирается с приоритетом 
+на единицу выше, правоассоциативной — с тем же. В режиме Nary звено добавляется в сумму 
+(произведение) слева, если она есть, — порядок вычисления от этого не меняется, (a + b) + c 
+и a + b + c считаются одинаково.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::parseBinary(Cursor& cursor, int minPrecedence) {
+
+    auto left = parseOperand(cursor);
+    while (left && cursor.token.kind == Token::Operator) {
+
+        const BinaryOperator& op = binaryOperator(cursor.token.symbol);
+        if (op.precedence < minPrecedence) 
+            break;
+
+        nextToken(cursor);
+        auto right = parseBinary(cursor, op.rightAssociative ? op.precedence : op.precedence + 1);
+        if (!right) 
+            return nullptr;
+
+        if (cursor.nary && (op.symbol == '+' || op.symbol == '-')) {
+            if (auto* sumNode = dynamic_cast<SumNode*>(left.get())) {
+                sumNode->append(op.symbol, std::move(right));
+                continue;
+            }
+            std::vector<SignedTerm> terms;
+            terms.emplace_back('+', std::move(left));
+            terms.emplace_back(op.symbol, std::move(right));
+            left = std::make_unique<SumNode>(std::move(terms));
+        }
+        else if (cursor.nary && op.symbol == '*') {
+            if (auto* productNode = dynamic_cast<ProductNode*>(left.get())) {
+                productNode->append(std::move(right));
+                continue;
+            }
+            std::vector<std::unique_ptr<Node>> factors;
+            factors.push_back(std::move(left));
+            factors.push_back(std::move(right));
+            left = std::make_unique<ProductNode>(std::move(factors));
+        }
+        else if (op.symbol == '^') {
+            left = powerNode(std::move(left), std::move(right));
+        }
+        else {
+            left = std::make_unique<BinaryOperationNode>
+                (op.symbol, std::move(left), std::move(right));
+        }
+    }
 
     return left;
 }
@@ -563,47 +1493,978 @@ Expression<T>::parseExponent(const std::vector<std::string>& tokens, size_t& pos
 // --------------------------------------------------------------- //
 
 /*
-Скобки.
+Операнд бинарной операции.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::parseOperand(Cursor& cursor) {
+
+    switch (cursor.token.kind) {
+
+        case Token::Number:
+            return parseNumber(cursor);
+
+        case Token::Identifier:
+            return parseIdentifier(cursor);
+
+        case Token::Open: {
+
+            nextToken(cursor);
+            auto node = parseBinary(cursor, 1);
+            if (!node) 
+                return nullptr;
+            if (cursor.token.kind != Token::Close)
+                return fail(cursor, ParseError::ExpectedParenthesis);
+            nextToken(cursor);
+            return node;
+        }
+
+        case Token::Operator:
+            if (cursor.token.symbol == '-') {
+                nextToken(cursor);
+                auto operand = parseOperand(cursor);
+                if (!operand) 
+                    return nullptr;
+                return std::make_unique<UnaryOperationNode>('-', std::move(operand));
+            }
+            return fail(cursor, ParseError::UnexpectedToken);
+
+        case Token::End:
+            return fail(cursor, ParseError::UnexpectedEnd);
+
+        default:
+            return fail(cursor, ParseError::UnexpectedToken);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВТОРОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ АТОМАРНЫХ ЭЛЕМЕНТОВ)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Десятичное число без знака: цифры и не более одной точки, хотя бы одна цифра.
+*/
+static bool isDecimal(std::string_view text) {
+
+    size_t digits = 0, dots = 0;
+    for (char c : text) {
+        if (c == '.') ++dots;
+        else if (std::isdigit(static_cast<unsigned char>(c))) ++digits;
+        else return false;
+    }
+    return digits > 0 && dots <= 1;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Числа: "t", "tI", "Ik" или "I" (README, п. 2).
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::parseNumber(Cursor& cursor) { // Парсинг числа
+    
+    std::string_view text = cursor.source.substr(cursor.token.offset, cursor.token.length);
+    size_t pos_I = text.find('I');
+
+    bool valid = pos_I == std::string_view::npos ? isDecimal(text) :
+        text.find('I', pos_I + 1) == std::string_view::npos &&
+        (pos_I == 0 || isDecimal(text.substr(0, pos_I))) &&
+        (pos_I + 1 == text.size() || isDecimal(text.substr(pos_I + 1)));
+    if (!valid)
+        return fail(cursor, ParseError::InvalidNumber);
+
+    std::complex<long double> value = interpretComplex(std::string(text));
+    nextToken(cursor);
+
+    if constexpr (!isComplex<T>) 
+        return std::make_unique<NumberNode>(static_cast<T>(value.real()));
+    else 
+        return std::make_unique<NumberNode>(T(value));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Переменные и функции. Идентификатор перед '(' — функция, любой другой — переменная, поэтому
+имена функций (abs, min, erf, ...) остаются допустимыми именами переменных. Аргументы перечисляются через запятую, их число должно совпадать с арностью функции.
+Номер функции берется из реестра один раз, здесь; pow(a, b) разбирается в a ^ b.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::parseIdentifier(Cursor& cursor) {
+
+    Token identifier = cursor.token;
+    std::string name(cursor.source.substr(identifier.offset, identifier.length));
+    for (char& c : name) c = std::tolower(static_cast<unsigned char>(c));
+
+    nextToken(cursor);
+    if (cursor.token.kind != Token::Open)
+        return std::make_unique<VariableNode>(name);
+
+    uint16_t id = functionId(name);
+    if (id == UNKNOWN_FUNCTION) {
+        cursor.token = identifier;
+        return fail(cursor, ParseError::UnknownFunction);
+    }
+
+    unsigned arity = id == POW_ALIAS ? 2 : functionArity(id);
+    std::unique_ptr<Node> args[FunctionNode::MAX_ARITY];
+
+    for (unsigned i = 0; i < arity; i++) {
+
+        nextToken(cursor); // Пропускаем "(" или ","
+        args[i] = parseBinary(cursor, 1);
+        if (!args[i])
+            return nullptr;
+
+        bool last = i + 1 == arity;
+        if (cursor.token.kind == (last ? Token::Comma : Token::Close))
+            return fail(cursor, ParseError::ArgumentCount);
+        if (cursor.token.kind != (last ? Token::Close : Token::Comma))
+            return fail(cursor, ParseError::ExpectedParenthesis);
+    }
+
+    nextToken(cursor); // Пропускаем ")"
+    if (id == POW_ALIAS)
+        return powerNode(std::move(args[0]), std::move(args[1]));
+    return std::make_unique<FunctionNode>(id, std::move(args[0]), std::move(args[1]));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Ошибка в текущей лексеме. Разбор прекращается: вызывающие функции возвращают nullptr дальше.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::fail(Cursor& cursor, ParseError::Code code) {
+
+    cursor.error = {code, cursor.token.offset, cursor.token.length};
+    return nullptr;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПАРАЛЛЕЛЬНЫЙ РАЗБОР
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Размер блока строки при поиске разрезов и примерный размер куска разбора. Не зависит от числа
+потоков, поэтому форма дерева одна и та же при любом их числе.
+*/
+static constexpr size_t PARSE_BLOCK = size_t(1) << 18;
+
+/*
+'+' или '-' в позиции pos — бинарная операция: перед ней (без пробелов) конец операнда.
+*/
+static bool isBinaryAdditive(std::string_view source, size_t pos) {
+
+    if (source[pos] != '+' && source[pos] != '-')
+        return false;
+
+    while (pos > 0 && std::isspace(static_cast<unsigned char>(source[pos - 1]))) --pos;
+    if (pos == 0) 
+        return false;
+
+    unsigned char c = source[pos - 1];
+    return std::isalnum(c) || c == '.' || c == ')';
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Три прохода: (1) параллельно — изменение глубины скобок в каждом блоке, затем префиксная сумма;
+(2) параллельно — в каждом блоке первая '+' или '-' на нулевой глубине (разрез);
+(3) параллельно — разбор кусков между разрезами в сбалансированные суммы, затем их соединение.
+Некорректная строка разбирается заново последовательно, чтобы ошибка и смещение совпали с parse.
+*/
+template <typename T>
+ParseResult<T> Expression<T>::parseParallel(std::string_view source, unsigned threads) {
+
+    size_t blocks = std::max<size_t>(1, (source.size() + PARSE_BLOCK - 1) / PARSE_BLOCK);
+    std::unique_ptr<ThreadPool> pool;
+    if (blocks > 1 && threads != 1) 
+        pool = std::make_unique<ThreadPool>(threads);
+
+    auto forEachBlock = [&](size_t count, auto&& body) {
+        if (!pool) {
+            for (size_t i = 0; i < count; i++) body(i);
+            return;
+        }
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < count; i++)
+            futures.push_back(pool->submit([&body, i] { body(i); }));
+        for (auto& future : futures)
+            future.get();
+    };
+
+    std::vector<long> depth(blocks + 1, 0);
+    forEachBlock(blocks, [&](size_t block) {
+        long delta = 0;
+        for (size_t i = block * PARSE_BLOCK; i < std::min(source.size(), (block + 1) * PARSE_BLOCK); i++)
+            delta += (source[i] == '(') - (source[i] == ')');
+        depth[block + 1] = delta;
+    });
+    std::partial_sum(depth.begin(), depth.end(), depth.begin());
+    if (depth[blocks] != 0)
+        return parse(source);
+
+    std::vector<size_t> cuts(blocks, source.size());
+    forEachBlock(blocks, [&](size_t block) {
+        long level = depth[block];
+        for (size_t i = std::max<size_t>(block * PARSE_BLOCK, 1); i < std::min(source.size(), (block + 1) * PARSE_BLOCK); i++) {
+            if (level == 0 && isBinaryAdditive(source, i)) {
+                cuts[block] = i;
+                return;
+            }
+            level += (source[i] == '(') - (source[i] == ')');
+        }
+    });
+
+    std::vector<size_t> starts = {0};   // Начало куска (после знака).
+    std::vector<char> signs = {'+'};    // Знак перед куском.
+    for (size_t cut : cuts) {
+        if (cut == source.size() || cut < starts.back()) 
+            continue;
+        starts.push_back(cut + 1);
+        signs.push_back(source[cut]);
+    }
+
+    std::vector<SignedTerm> chunks(starts.size());
+    forEachBlock(starts.size(), [&](size_t chunk) {
+        size_t end = chunk + 1 < starts.size() ? starts[chunk + 1] - 1 : source.size();
+        chunks[chunk] = parseTerms(source.substr(starts[chunk], end - starts[chunk]), signs[chunk]);
+    });
+
+    for (const SignedTerm& chunk : chunks)
+        if (!chunk.second)
+            return parse(source);
+
+    // Первый кусок со знаком '+', и вся сумма тоже. toString печатает сумму, как после parse.
+    Expression<T> expr;
+    expr.root = joinTerms(chunks, 0, chunks.size(), ChainNode | ChainNotation).second;
+    if (auto* sum = dynamic_cast<BinaryOperationNode*>(expr.root.get()); sum && (sum->chain & ChainNode))
+        sum->chain |= ChainRoot;
+    return ParseResult<T>(std::move(expr));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Кусок: слагаемое (операции старше '+' и '-') и далее '+' или '-' и слагаемое, до конца куска.
+*/
+template <typename T>
+typename Expression<T>::SignedTerm Expression<T>::parseTerms(std::string_view chunk, char sign) {
+
+    std::vector<SignedTerm> terms;
+    Cursor cursor{chunk};
+    nextToken(cursor);
+
+    for (;;) {
+
+        auto term = parseBinary(cursor, binaryOperator('*').precedence);
+        if (!term)
+            return {sign, nullptr};
+        terms.emplace_back(sign, std::move(term));
+
+        if (cursor.token.kind == Token::End) 
+            break;
+        if (cursor.token.kind != Token::Operator || (cursor.token.symbol != '+' && cursor.token.symbol != '-'))
+            return {sign, nullptr};
+
+        sign = cursor.token.symbol;
+        nextToken(cursor);
+    }
+
+    return joinTerms(terms, 0, terms.size(), ChainNode | ChainNotation);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Половины соединяются знаком по правилам: (+A) + (±B) = +(A ± B), (-A) + (±B) = -(A ∓ B);
+для умножения так же: (/A) * (*B) = /(A / B) и т.д.
+*/
+template <typename T>
+typename Expression<T>::SignedTerm 
+Expression<T>::joinTerms(std::vector<SignedTerm>& terms, size_t begin, size_t end, uint8_t chain) {
+
+    if (end - begin == 1)
+        return std::move(terms[begin]);
+
+    size_t middle = begin + (end - begin) / 2;
+    SignedTerm left = joinTerms(terms, begin, middle, chain);
+    SignedTerm right = joinTerms(terms, middle, end, chain);
+
+    bool additive = left.first == '+' || left.first == '-';
+    char op = left.first == right.first ? (additive ? '+' : '*') : (additive ? '-' : '/');
+    auto node = std::make_unique<BinaryOperationNode>(op, std::move(left.second), std::move(right.second));
+    node->chain = chain;
+    return {left.first, std::move(node)};
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПЕРЕСТРОЙКА АССОЦИАТИВНЫХ ЦЕПОЧЕК
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Цепочки короче не перестраиваются: выигрыш в глубине мал, а порядок округлений меняется.
+*/
+static constexpr size_t REBALANCE_MIN_TERMS = 8;
+
+/*
+Семейство операции: 1 — '+' и '-', 2 — '*' и '/', 0 — остальные.
+*/
+static int operationFamily(char operation) {
+
+    if (operation == '+' || operation == '-') return 1;
+    if (operation == '*' || operation == '/') return 2;
+    return 0;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Сложение с компенсацией (Ноймайер): compensation накапливает потерянные младшие разряды,
+итог — sum + compensation. Комплексные числа — покомпонентно.
+*/
+template <typename U>
+static void compensatedAdd(U& sum, U& compensation, const U& value) {
+
+    if constexpr (isComplex<U>) {
+        RealOf<U> re = sum.real(), im = sum.imag(), reComp = compensation.real(), imComp = compensation.imag();
+        compensatedAdd(re, reComp, value.real());
+        compensatedAdd(im, imComp, value.imag());
+        sum = U(re, im);
+        compensation = U(reComp, imComp);
+    }
+    else {
+        U total = sum + value;
+        compensation += std::abs(sum) >= std::abs(value) ? (sum - total) + value : (value - total) + sum;
+        sum = total;
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Перестройка цепочек.
+*/
+template <typename T>
+Expression<T> Expression<T>::rebalance(unsigned mode) const {
+
+    Expression<T> result;
+    result.root = rebalanceHelper(root.get(), mode);
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Звенья цепочки. Обычная цепочка обходится без рекурсии (ее глубина может быть огромной),
+перестроенная — рекурсивно (ее глубина логарифмическая).
+*/
+template <typename T>
+void Expression<T>::collectChain(const Node* node, std::vector<std::pair<bool, const Node*>>& links) {
+
+    const auto* top = static_cast<const BinaryOperationNode*>(node);
+    int family = operationFamily(top->operation);
+
+    if (top->chain & ChainNode) {
+
+        auto collect = [&](const Node* link, bool negative, auto& self) -> void {
+            const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(link);
+            if (binOpNode && (binOpNode->chain & ChainNode) && (link == node || !(binOpNode->chain & ChainRoot))) {
+                self(binOpNode->left.get(), negative, self);
+                self(binOpNode->right.get(), negative != (binOpNode->operation == '-' || binOpNode->operation == '/'), self);
+            }
+            else {
+                links.emplace_back(negative, link);
+            }
+        };
+        collect(node, false, collect);
+        return;
+    }
+
+    size_t first = links.size();
+    const Node* current = node;
+    for (;;) {
+        const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(current);
+        if (!binOpNode || binOpNode->chain || operationFamily(binOpNode->operation) != family)
+            break;
+        links.emplace_back(binOpNode->operation == '-' || binOpNode->operation == '/', binOpNode->right.get());
+        current = binOpNode->left.get();
+    }
+    links.emplace_back(false, current);
+    std::reverse(links.begin() + first, links.end());
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Копия поддерева; цепочка из REBALANCE_MIN_TERMS и более звеньев собирается заново через joinTerms.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::rebalanceHelper(const Node* node, unsigned mode) const {
+
+    if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+
+        int family = operationFamily(binOpNode->operation);
+        std::vector<std::pair<bool, const Node*>> links;
+        if (family) 
+            collectChain(node, links);
+
+        if (links.size() < REBALANCE_MIN_TERMS) {
+            auto copy = std::make_unique<BinaryOperationNode>(binOpNode->operation, 
+                rebalanceHelper(binOpNode->left.get(), mode), rebalanceHelper(binOpNode->right.get(), mode));
+            copy->chain = binOpNode->chain;
+            copy->exponent = binOpNode->exponent;
+            return copy;
+        }
+
+        bool additive = family == 1;
+        uint8_t chain = ChainNode | (mode & KeepNotation ? ChainNotation : 0) | 
+                        (additive && (mode & CompensatedSum) ? ChainCompensated : 0);
+
+        std::vector<SignedTerm> terms;
+        terms.reserve(links.size());
+        for (const auto& [negative, link] : links)
+            terms.emplace_back(negative ? (additive ? '-' : '/') : (additive ? '+' : '*'), rebalanceHelper(link, mode));
+
+        auto root = joinTerms(terms, 0, terms.size(), chain).second; // Первое звено всегда со знаком '+' ('*').
+        static_cast<BinaryOperationNode*>(root.get())->chain |= ChainRoot;
+        return root;
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
+        return std::make_unique<UnaryOperationNode>(unaryOpNode->operation, rebalanceHelper(unaryOpNode->arg.get(), mode));
+    }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
+        return std::make_unique<FunctionNode>(funcNode->id, rebalanceHelper(funcNode->args[0].get(), mode), 
+            funcNode->arity > 1 ? rebalanceHelper(funcNode->args[1].get(), mode) : nullptr);
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) { // Уже плоская, глубина 1.
+        std::vector<SignedTerm> terms;
+        terms.reserve(sumNode->terms.size());
+        for (const auto& [sign, term] : sumNode->terms)
+            terms.emplace_back(sign, rebalanceHelper(term.get(), mode));
+        return std::make_unique<SumNode>(std::move(terms));
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+        std::vector<std::unique_ptr<Node>> factors;
+        factors.reserve(productNode->factors.size());
+        for (const auto& factor : productNode->factors)
+            factors.push_back(rebalanceHelper(factor.get(), mode));
+        return std::make_unique<ProductNode>(std::move(factors));
+    }
+
+    return copyTree(node);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// СТРУКТУРНОЕ СРАВНЕНИЕ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Хэш корня (у пустого выражения 0).
+*/
+template <typename T>
+size_t Expression<T>::hash() const {
+
+    return root ? root->hash : 0;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Структурное равенство.
+*/
+template <typename T>
+bool Expression<T>::operator==(const Expression<T>& other) const {
+
+    return equalNodes(root.get(), other.root.get());
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+bool Expression<T>::operator!=(const Expression<T>& other) const {
+
+    return !(*this == other);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Тело равенства: разные хэши — сразу false, один и тот же узел — сразу true.
+*/
+template <typename T>
+bool Expression<T>::equalNodes(const Node* a, const Node* b) {
+
+    if (a == b) return true;
+    if (!a || !b || a->hash != b->hash) return false;
+
+    if (const auto* numNode = dynamic_cast<const NumberNode*>(a)) {
+        const auto* other = dynamic_cast<const NumberNode*>(b);
+        return other && numNode->value == other->value;
+    }
+    else if (const auto* varNode = dynamic_cast<const VariableNode*>(a)) {
+        const auto* other = dynamic_cast<const VariableNode*>(b);
+        return other && varNode->name == other->name;
+    }
+    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(a)) {
+        const auto* other = dynamic_cast<const BinaryOperationNode*>(b);
+        return other && binOpNode->operation == other->operation && 
+               equalNodes(binOpNode->left.get(), other->left.get()) && 
+               equalNodes(binOpNode->right.get(), other->right.get());
+    }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(a)) {
+        const auto* other = dynamic_cast<const FunctionNode*>(b);
+        if (!other || funcNode->id != other->id || funcNode->arity != other->arity) return false;
+        for (unsigned k = 0; k < funcNode->arity; k++)
+            if (!equalNodes(funcNode->args[k].get(), other->args[k].get())) return false;
+        return true;
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(a)) {
+        const auto* other = dynamic_cast<const UnaryOperationNode*>(b);
+        return other && unaryOpNode->operation == other->operation && 
+               equalNodes(unaryOpNode->arg.get(), other->arg.get());
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(a)) {
+        const auto* other = dynamic_cast<const SumNode*>(b);
+        if (!other || sumNode->terms.size() != other->terms.size()) return false;
+        for (size_t i = 0; i < sumNode->terms.size(); i++)
+            if (sumNode->terms[i].first != other->terms[i].first || 
+                !equalNodes(sumNode->terms[i].second.get(), other->terms[i].second.get())) return false;
+        return true;
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(a)) {
+        const auto* other = dynamic_cast<const ProductNode*>(b);
+        if (!other || productNode->factors.size() != other->factors.size()) return false;
+        for (size_t i = 0; i < productNode->factors.size(); i++)
+            if (!equalNodes(productNode->factors[i].get(), other->factors[i].get())) return false;
+        return true;
+    }
+
+    return false;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Каноническая копия.
+*/
+template <typename T>
+Expression<T> Expression<T>::canonicalize() const {
+
+    Expression<T> result;
+    result.root = canonicalHelper(root.get());
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Тело canonicalize. Звенья сначала приводятся к каноническому виду (их хэши от этого меняются),
+потом упорядочиваются: положительные раньше отрицательных, внутри — по хэшу. Первое звено
+цепочки всегда положительное, поэтому после сортировки цепочка начинается с положительного.
 */
 template <typename T>
-std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseFactor(const std::vector<std::string>& tokens, size_t& pos) { // Парсинг фактора 
-                                                                                  // и атомарных элементов
+std::unique_ptr<typename Expression<T>::Node> Expression<T>::canonicalHelper(const Node* node) const {
+
+    if (!node) return nullptr;
+
+    auto byHash = [](const auto& x, const auto& y) { 
+        return x.first != y.first ? x.first < y.first : x.second->hash < y.second->hash; };
+
+    if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+
+        int family = operationFamily(binOpNode->operation);
+        if (family == 0) {
+            auto copy = std::make_unique<BinaryOperationNode>(binOpNode->operation, 
+                canonicalHelper(binOpNode->left.get()), canonicalHelper(binOpNode->right.get()));
+            copy->exponent = binOpNode->exponent;
+            return copy;
+        }
 
-    if (pos >= tokens.size()) {
-        throw std::runtime_error("Unexpected end of expression");
+        std::vector<std::pair<bool, const Node*>> links;
+        collectChain(node, links);
+        std::vector<std::pair<bool, std::unique_ptr<Node>>> sorted;
+        sorted.reserve(links.size());
+        for (const auto& [negative, link] : links)
+            sorted.emplace_back(negative, canonicalHelper(link));
+        std::stable_sort(sorted.begin(), sorted.end(), byHash);
+
+        std::unique_ptr<Node> chain = std::move(sorted[0].second);
+        for (size_t i = 1; i < sorted.size(); i++) {
+            char operation = family == 1 ? (sorted[i].first ? '-' : '+') : (sorted[i].first ? '/' : '*');
+            chain = std::make_unique<BinaryOperationNode>(operation, std::move(chain), std::move(sorted[i].second));
+        }
+        return chain;
     }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
 
-    if (tokens[pos] == "-") { 
-        ++pos; 
-        auto operand = parseFactor(tokens, pos); 
-        return std::make_unique<UnaryOperationNode>('-', std::move(operand));
+        std::unique_ptr<Node> first = canonicalHelper(funcNode->args[0].get());
+        std::unique_ptr<Node> second = canonicalHelper(funcNode->args[1].get());
+        Function function = static_cast<Function>(funcNode->id);
+        if ((function == Function::Min || function == Function::Max) && second->hash < first->hash)
+            std::swap(first, second);
+        return std::make_unique<FunctionNode>(funcNode->id, std::move(first), std::move(second));
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
+        return std::make_unique<UnaryOperationNode>(unaryOpNode->operation, canonicalHelper(unaryOpNode->arg.get()));
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+
+        std::vector<SignedTerm> terms;
+        terms.reserve(sumNode->terms.size());
+        for (const auto& [sign, term] : sumNode->terms)
+            terms.emplace_back(sign, canonicalHelper(term.get()));
+        std::stable_sort(terms.begin(), terms.end(), byHash); // '+' < '-'.
+        return std::make_unique<SumNode>(std::move(terms));
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+
+        std::vector<std::unique_ptr<Node>> factors;
+        factors.reserve(productNode->factors.size());
+        for (const auto& factor : productNode->factors)
+            factors.push_back(canonicalHelper(factor.get()));
+        std::stable_sort(factors.begin(), factors.end(), [](const auto& x, const auto& y) { return x->hash < y->hash; });
+        return std::make_unique<ProductNode>(std::move(factors));
     }
 
-    if (tokens[pos] == "(") {
+    return copyTree(node);
+}
 
-        ++pos; 
-        auto node = parseExpression(tokens, pos);
-        if (pos >= tokens.size() || tokens[pos] != ")") {
-            throw std::runtime_error("Expected ')'");
-        }
-        ++pos; 
-        return node;
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯДРА ПАКЕТНОГО ВЫЧИСЛЕНИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Поэлементная операция над столбцом: a[i] = f(a[i], b[i]).
+Циклы без ветвлений и с __restrict, чтобы компилятор мог их векторизовать.
+*/
+template <typename R, typename F>
+static void binaryKernel(R* __restrict a, const R* __restrict b, size_t n, F f) {
+
+    for (size_t i = 0; i < n; i++)
+        a[i] = f(a[i], b[i]);
+}
+
+/*
+Поэлементная операция над столбцом: a[i] = f(a[i]).
+*/
+template <typename R, typename F>
+static void unaryKernel(R* __restrict a, size_t n, F f) {
+
+    for (size_t i = 0; i < n; i++)
+        a[i] = f(a[i]);
+}
+
+/*
+Поэлементная комплексная операция над столбцами с раздельными частями:
+(ar[i], ai[i]) = f(ar[i], ai[i], br[i], bi[i]).
+*/
+template <typename R, typename F>
+static void complexKernel(R* __restrict ar, R* __restrict ai, 
+                          const R* __restrict br, const R* __restrict bi, size_t n, F f) {
+
+    for (size_t i = 0; i < n; i++) {
+        R re, im;
+        f(ar[i], ai[i], br[i], bi[i], re, im);
+        ar[i] = re;
+        ai[i] = im;
+    }
+}
+
+/*
+Все ли элементы столбца равны 0 или лежат по модулю в [2^-509, 2^510] (для double; для других
+типов — те же доли диапазона порядков). Тогда произведения и суммы произведений двух таких чисел
+не переполняются и не уходят в денормализованные числа. NaN и бесконечности вне диапазона.
+Без ветвлений в цикле.
+*/
+template <typename R>
+static bool allInSafeRange(const R* a, size_t n) {
+
+    const R lo = std::ldexp(R(1), std::numeric_limits<R>::min_exponent / 2 + 1);
+    const R hi = std::ldexp(R(1), std::numeric_limits<R>::max_exponent / 2 - 2);
+    bool safe = true;
+    for (size_t i = 0; i < n; i++) {
+        R magnitude = std::fabs(a[i]);
+        safe &= (magnitude == 0) | ((magnitude >= lo) & (magnitude <= hi));
     }
+    return safe;
+}
+
+// --------------------------------------------------------------- //
 
-    if (std::isdigit(tokens[pos][0]) || tokens[pos][0] == '.' || tokens[pos][0] == 'I') {
-        return parseNumber(tokens, pos);
+/*
+Комплексное умножение. Если все части входов в безопасном диапазоне (allInSafeRange), 
+специальные случаи из приложения G стандарта C (бесконечности, NaN) невозможны, а прямая 
+формула не переполняется в промежуточных произведениях. Иначе — поэлементно через std::complex.
+*/
+template <typename R>
+static void complexMultiply(R* ar, R* ai, const R* br, const R* bi, size_t n) {
+
+    if (allInSafeRange(ar, n) && allInSafeRange(ai, n) && allInSafeRange(br, n) && allInSafeRange(bi, n)) {
+        complexKernel(ar, ai, br, bi, n, [](R a, R b, R c, R d, R& re, R& im) {
+            re = a * c - b * d;
+            im = a * d + b * c;
+        });
+        return;
     }
 
-    if (std::isalpha(tokens[pos][0])) {
+    complexKernel(ar, ai, br, bi, n, [](R a, R b, R c, R d, R& re, R& im) {
+        std::complex<R> value = std::complex<R>(a, b) * std::complex<R>(c, d);
+        re = value.real();
+        im = value.imag();
+    });
+}
 
-        if (pos + 1 < tokens.size() && tokens[pos + 1] == "(") 
-            return parseFunction(tokens, pos);
-        else 
-            return parseVariable(tokens, pos);
+/*
+Комплексное деление. Быстрая формула применяется, если все части входов в безопасном 
+диапазоне (allInSafeRange) и знаменатель c^2 + d^2 не равен нулю; иначе — поэлементно 
+через std::complex (с масштабированием).
+Числители делятся на знаменатель, а не умножаются на обратное к нему: лишнее округление
+давало, например, z / z = 1 - 2^-53.
+*/
+template <typename R>
+static void complexDivide(R* ar, R* ai, const R* br, const R* bi, size_t n) {
+
+    bool safe = allInSafeRange(ar, n) && allInSafeRange(ai, n) && allInSafeRange(br, n) && allInSafeRange(bi, n);
+
+    for (size_t i = 0; i < n && safe; i++) {
+        R denominator = br[i] * br[i] + bi[i] * bi[i];
+        safe = std::isnormal(denominator);
+    }
+
+    if (safe) {
+        complexKernel(ar, ai, br, bi, n, [](R a, R b, R c, R d, R& re, R& im) {
+            R denominator = c * c + d * d;
+            re = (a * c + b * d) / denominator;
+            im = (b * c - a * d) / denominator;
+        });
+        return;
+    }
+
+    complexKernel(ar, ai, br, bi, n, [](R a, R b, R c, R d, R& re, R& im) {
+        std::complex<R> value = std::complex<R>(a, b) / std::complex<R>(c, d);
+        re = value.real();
+        im = value.imag();
+    });
+}
+
+/*
+Комплексная экспонента: exp(x + iy) = e^x * (cos(y) + i sin(y)).
+При e^x = 0 результат 0 и для бесконечного y (как в std::exp), а не 0 * NaN.
+*/
+template <typename R>
+static void complexExp(R* __restrict re, R* __restrict im, size_t n) {
+
+    for (size_t i = 0; i < n; i++) {
+        R modulus = std::exp(re[i]);
+        R angle = im[i];
+        re[i] = modulus == 0 ? R(0) : modulus * std::cos(angle);
+        im[i] = modulus == 0 ? R(0) : modulus * std::sin(angle);
+    }
+}
+
+/*
+Комплексный логарифм: ln(x + iy) = ln|x + iy| + i arg(x + iy).
+*/
+template <typename R>
+static void complexLog(R* __restrict re, R* __restrict im, size_t n) {
+
+    for (size_t i = 0; i < n; i++) {
+        R modulus = std::hypot(re[i], im[i]);
+        R angle = std::atan2(im[i], re[i]);
+        re[i] = std::log(modulus);
+        im[i] = angle;
+    }
+}
+
+/*
+Комплексный синус и косинус:
+sin(x + iy) = sin(x)ch(y) + i cos(x)sh(y), cos(x + iy) = cos(x)ch(y) - i sin(x)sh(y).
+*/
+template <typename R>
+static void complexSin(R* __restrict re, R* __restrict im, size_t n) {
+
+    for (size_t i = 0; i < n; i++) {
+        R x = re[i], y = im[i];
+        re[i] = std::sin(x) * std::cosh(y);
+        im[i] = std::cos(x) * std::sinh(y);
+    }
+}
+
+template <typename R>
+static void complexCos(R* __restrict re, R* __restrict im, size_t n) {
+
+    for (size_t i = 0; i < n; i++) {
+        R x = re[i], y = im[i];
+        re[i] = std::cos(x) * std::cosh(y);
+        im[i] = -std::sin(x) * std::sinh(y);
+    }
+}
+
+/*
+Комплексная степень: a^b = exp(b * ln(a)), 0^b = 0 (как в std::pow).
+*/
+template <typename R>
+static void complexPow(R* ar, R* ai, const R* br, const R* bi, size_t n) {
+
+    std::vector<R> zero(n);
+    for (size_t i = 0; i < n; i++)
+        zero[i] = (ar[i] == 0 && ai[i] == 0);
+
+    complexLog(ar, ai, n);
+    complexMultiply(ar, ai, br, bi, n);
+    complexExp(ar, ai, n);
+
+    for (size_t i = 0; i < n; i++) {
+        ar[i] = zero[i] ? 0 : ar[i];
+        ai[i] = zero[i] ? 0 : ai[i];
     }
+}
+
+/*
+Степень с константным показателем известного вида (см. ExponentClass): целые степени — умножениями,
+корни — sqrt и cbrt, p / q с нечетным q — через |a| (показатель берется из br).
+*/
+template <typename T>
+static void powerKernel(RealOf<T>* ar, RealOf<T>* ai, const RealOf<T>* br, size_t n, const ExponentClass& cls) {
+
+    using R = RealOf<T>;
 
-    throw std::runtime_error("Unexpected token: " + tokens[pos]);
+    if constexpr (isComplex<T>) {
+        for (size_t i = 0; i < n; i++) {
+            T value = raisePower(T(ar[i], ai[i]), T(), cls);
+            ar[i] = value.real();
+            ai[i] = value.imag();
+        }
+    }
+    else {
+        long exponent = cls.numerator;
+        bool oddNumerator = cls.numerator % 2 != 0;
+        switch (cls.kind) {
+            case ExponentClass::Integer:
+                unaryKernel(ar, n, [exponent](R a) { return integerPower(a, exponent); });
+                break;
+            case ExponentClass::SquareRoot:
+                for (size_t i = 0; i < n; i++) {
+                    if (ar[i] < 0)
+                        throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+                }
+                unaryKernel(ar, n, [](R a) { return std::sqrt(a); });
+                break;
+            case ExponentClass::CubeRoot:
+                unaryKernel(ar, n, [](R a) { return std::cbrt(a); });
+                break;
+            default:
+                binaryKernel(ar, br, n, [oddNumerator](R a, R b) { return rationalPower(a, b, oddNumerator); });
+                break;
+        }
+    }
 }
 
 
@@ -623,260 +2484,950 @@ Expression<T>::parseFactor(const std::vector<std::string>& tokens, size_t& pos)
 
 
 
+
+
 
 // ---------------------------------------------------------------------------------------------------- //
-// ВТОРОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ АТОМАРНЫХ ЭЛЕМЕНТОВ)
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
 // ---------------------------------------------------------------------------------------------------- //
 
 /*
-Числа.
+Отметка времени для профилирования: счетчик тактов процессора на x86, иначе steady_clock (нс).
+*/
+static inline uint64_t profileTicks() {
+
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Оценка стоимости узла в условных тактах (порядок — как в Profile::Kind): 
+строка 0 — вещественный тип, строка 1 — комплексный. У суммы и произведения — стоимость одного звена.
+*/
+static const double NODE_COST[2][15] = {
+    {1, 2, 1, 1, 1, 15, 60, 1, 40, 40, 30, 30, 1, 1, 40},
+    {2, 2, 2, 2, 4, 30, 150, 2, 100, 100, 80, 80, 2, 4, 100}
+};
+
+// --------------------------------------------------------------- //
+
+/*
+Вид показателя степени. Значение показателя считается в T, и дробь p / q принимается, только если
+p / q, вычисленное в T, совпадает с ним точно (1 / 3, 2 / 3, -5 / 7 и т.п.).
+*/
+template <typename T>
+ExponentClass Expression<T>::classifyExponent(const Node* node) {
+
+    using Real = RealOf<T>;
+
+    auto hasVariables = [](const Node* node, auto& self) -> bool {
+        if (dynamic_cast<const VariableNode*>(node)) return true;
+        if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node))
+            return self(binOpNode->left.get(), self) || self(binOpNode->right.get(), self);
+        if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node))
+            return self(funcNode->args[0].get(), self) || (funcNode->arity > 1 && self(funcNode->args[1].get(), self));
+        if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node))
+            return self(unaryOpNode->arg.get(), self);
+        if (const auto* sumNode = dynamic_cast<const SumNode*>(node))
+            return std::any_of(sumNode->terms.begin(), sumNode->terms.end(), 
+                               [&](const SignedTerm& term) { return self(term.second.get(), self); });
+        if (const auto* productNode = dynamic_cast<const ProductNode*>(node))
+            return std::any_of(productNode->factors.begin(), productNode->factors.end(), 
+                               [&](const std::unique_ptr<Node>& factor) { return self(factor.get(), self); });
+        return false;
+    };
+
+    if (!node || hasVariables(node, hasVariables)) return {};
+
+    T value;
+    try {
+        value = Expression<T>().evaluateHelper(node);
+    }
+    catch (const std::runtime_error&) {
+        return {}; // Ошибка проявится при вычислении.
+    }
+
+    Real re;
+    if constexpr (isComplex<T>) {
+        if (value.imag() != 0) return {};
+        re = value.real();
+    }
+    else {
+        re = value;
+    }
+
+    if (!std::isfinite(re)) return {};
+    if (std::trunc(re) == re && std::abs(re) <= 16)
+        return {ExponentClass::Integer, static_cast<long>(re), 1};
+    if (re == static_cast<Real>(0.5))
+        return {ExponentClass::SquareRoot, 1, 2};
+
+    if constexpr (!isComplex<T>) {
+        if (re == static_cast<Real>(1) / 3)
+            return {ExponentClass::CubeRoot, 1, 3};
+        for (long q : {3, 5, 7, 9}) {
+            Real p = std::round(re * q);
+            if (std::abs(p) <= 64 && p / q == re && std::gcd(static_cast<long>(p), q) == 1)
+                return {ExponentClass::OddRoot, static_cast<long>(p), q};
+        }
+    }
+
+    return {};
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел степени с видом показателя (показатель вычисляется один раз, если в нем нет переменных).
 */
 template <typename T>
 std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseNumber(const std::vector<std::string>& tokens, size_t& pos) { // Парсинг числа
-    
-    std::complex<long double> value = interpretComplex(tokens[pos++]);
+Expression<T>::powerNode(std::unique_ptr<Node> base, std::unique_ptr<Node> exponent) {
 
-    if constexpr (std::is_same_v<T, long double>) 
-        return std::make_unique<NumberNode>(value.real());
-    else 
-        return std::make_unique<NumberNode>(value);
+    auto node = std::make_unique<BinaryOperationNode>('^', std::move(base), std::move(exponent));
+    node->exponent = classifyExponent(node->right.get());
+    return node;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Узел с числом value. Отрицательные части записываются через унарный минус, а комплексное число
+с обеими ненулевыми частями — суммой двух узлов (узел числа печатает только одну часть).
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> Expression<T>::valueNode(const T& value) {
+
+    if constexpr (isComplex<T>) {
+
+        if (value.real() != 0 && value.imag() != 0) { // Если обе части ненулевые, раздваиваем узел.
+
+            std::unique_ptr<Node> realNode, imagNode;
+
+            if (value.real() < 0) 
+                realNode = std::make_unique<UnaryOperationNode>
+                ('-', std::make_unique<NumberNode>
+                    (T(-value.real(), 0)));
+            else
+                realNode = std::make_unique<NumberNode>
+                    (T(value.real(), 0));
+            
+            if (value.imag() < 0) 
+                imagNode = std::make_unique<UnaryOperationNode>
+                    ('-', std::make_unique<NumberNode>
+                        (T(0, -value.imag())));
+            else
+                imagNode = std::make_unique<NumberNode>
+                    (T(0, value.imag()));
+
+            return std::make_unique<BinaryOperationNode>
+                ('+', std::move(realNode), std::move(imagNode));
+        } 
+        else if (value.real()) { // Если только реальная часть ненулевая, заменяем значение на реальное.
+
+            if (value.real() < 0) 
+                return std::make_unique<UnaryOperationNode>
+                    ('-', std::make_unique<NumberNode>
+                        (T(-value.real(), 0)));
+            else
+                return std::make_unique<NumberNode>
+                    (T(value.real(), 0));
+        } 
+        else { // Если только мнимая часть ненулевая, заменяем значение на мнимое.
+
+            if (value.imag() < 0) 
+                return std::make_unique<UnaryOperationNode>
+                    ('-', std::make_unique<NumberNode>
+                        (T(0, -value.imag())));
+            else
+                return std::make_unique<NumberNode>
+                    (T(0, value.imag()));
+        }
+    } 
+    else {
+
+        if (value >= 0)
+            return std::make_unique<NumberNode>(value);
+        else
+            return std::make_unique<UnaryOperationNode>
+                ('-', std::make_unique<NumberNode>(-value));
+    }
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Переменные.
+Тело функции специализации: копия дерева, в которой связанные переменные заменены числами,
+а наибольшие связанные поддеревья — их значениями.
 */
 template <typename T>
 std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseVariable(const std::vector<std::string>& tokens, size_t& pos) { // Парсинг переменной
+Expression<T>::specializeHelper(const Node* node, const std::unordered_map<std::string, T>& bindings, 
+                                bool& bound, size_t& folded) const {
+
+    // Связанный потомок узла, зависящего от свободных переменных, сворачивается.
+    auto finish = [&](const Node* arg, std::unique_ptr<Node> copy, bool argBound) {
+        return !bound && argBound ? foldSubtree(arg, std::move(copy), bindings, folded) : std::move(copy);
+    };
+
+    if (const auto* varNode = dynamic_cast<const VariableNode*>(node)) {
+
+        auto it = bindings.find(varNode->name);
+        bound = it != bindings.end();
+        return bound ? valueNode(it->second) : copyTree(node);
+    }
+    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+
+        bool leftBound = false, rightBound = false;
+        auto left = specializeHelper(binOpNode->left.get(), bindings, leftBound, folded);
+        auto right = specializeHelper(binOpNode->right.get(), bindings, rightBound, folded);
+        bound = leftBound && rightBound;
+        auto copy = std::make_unique<BinaryOperationNode>(binOpNode->operation,
+            finish(binOpNode->left.get(), std::move(left), leftBound),
+            finish(binOpNode->right.get(), std::move(right), rightBound));
+        copy->chain = binOpNode->chain;
+        copy->exponent = binOpNode->exponent;
+        if (binOpNode->operation == '^' && binOpNode->exponent.kind == ExponentClass::General && rightBound)
+            copy->exponent = classifyExponent(copy->right.get()); // Показатель свернут в число.
+        return copy;
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
+
+        auto arg = specializeHelper(unaryOpNode->arg.get(), bindings, bound, folded);
+        return std::make_unique<UnaryOperationNode>(unaryOpNode->operation, std::move(arg));
+    }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
+
+        if (funcNode->arity == 1) {
+            auto arg = specializeHelper(funcNode->args[0].get(), bindings, bound, folded);
+            return std::make_unique<FunctionNode>(funcNode->id, std::move(arg));
+        }
+
+        bool firstBound = false, secondBound = false;
+        auto first = specializeHelper(funcNode->args[0].get(), bindings, firstBound, folded);
+        auto second = specializeHelper(funcNode->args[1].get(), bindings, secondBound, folded);
+        bound = firstBound && secondBound;
+        return std::make_unique<FunctionNode>(funcNode->id, 
+            finish(funcNode->args[0].get(), std::move(first), firstBound),
+            finish(funcNode->args[1].get(), std::move(second), secondBound));
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+
+        std::vector<SignedTerm> terms;
+        std::vector<char> termBound(sumNode->terms.size(), false);
+        bound = true;
+        for (size_t i = 0; i < sumNode->terms.size(); i++) {
+            bool argBound = false;
+            terms.emplace_back(sumNode->terms[i].first, 
+                               specializeHelper(sumNode->terms[i].second.get(), bindings, argBound, folded));
+            termBound[i] = argBound;
+            bound = bound && argBound;
+        }
+        for (size_t i = 0; i < terms.size(); i++)
+            terms[i].second = finish(sumNode->terms[i].second.get(), std::move(terms[i].second), termBound[i]);
+        return std::make_unique<SumNode>(std::move(terms));
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+
+        std::vector<std::unique_ptr<Node>> factors;
+        std::vector<char> factorBound(productNode->factors.size(), false);
+        bound = true;
+        for (size_t i = 0; i < productNode->factors.size(); i++) {
+            bool argBound = false;
+            factors.push_back(specializeHelper(productNode->factors[i].get(), bindings, argBound, folded));
+            factorBound[i] = argBound;
+            bound = bound && argBound;
+        }
+        for (size_t i = 0; i < factors.size(); i++)
+            factors[i] = finish(productNode->factors[i].get(), std::move(factors[i]), factorBound[i]);
+        return std::make_unique<ProductNode>(std::move(factors));
+    }
 
-    std::string name = tokens[pos++];
-    return std::make_unique<VariableNode>(name);
+    bound = true; // Число.
+    return copyTree(node);
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Функции.
+Свертка связанного поддерева. Число (в том числе записанное через унарный минус) уже свернуто.
 */
 template <typename T>
 std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::parseFunction(const std::vector<std::string>& tokens, size_t& pos) { // Парсинг функции
+Expression<T>::foldSubtree(const Node* node, std::unique_ptr<Node> copy, 
+                           const std::unordered_map<std::string, T>& bindings, size_t& folded) const {
+
+    const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(copy.get());
+    const Node* leaf = unaryOpNode ? unaryOpNode->arg.get() : copy.get();
+    if (dynamic_cast<const NumberNode*>(leaf) || dynamic_cast<const VariableNode*>(node))
+        return copy;
+
+    try {
+        T value = evaluateHelper(node, &bindings);
+        folded++;
+        return valueNode(value);
+    }
+    catch (const std::runtime_error&) {
+        return copy;
+    }
+}
 
-    std::string function = tokens[pos++];
-    std::unordered_set<std::string> FUNCS = {"sin", "cos", "ln", "exp"};
+// --------------------------------------------------------------- //
 
-    if (FUNCS.find(function) == FUNCS.end())
-        throw std::runtime_error("Unknown function identifier");
+/*
+Тело функции замены переменных.
+*/
+template <typename T>
+std::unique_ptr<typename Expression<T>::Node> 
+Expression<T>::subsVarHelper(std::unique_ptr<Node> node,
+                             const std::unordered_map<std::string, T>& varMap) { // Основное тело 
+                                                                                 // функции subsVar() 
+                                                                                 // для замены переменной в узле
+    
+    if (!node) return nullptr;
 
-    ++pos; // Пропускаем "("
-    auto arg = parseExpression(tokens, pos);
+    if (auto* varNode = dynamic_cast<VariableNode*>(node.get())) { // Узел переменной?
 
-    if (pos >= tokens.size() || tokens[pos] != ")")
-        throw std::runtime_error("Expected ')'");
+        auto it = varMap.find(varNode->name);
+        
+        if (it != varMap.end()) 
+            return valueNode(it->second);
+    } 
+    else if (auto* binOpNode = dynamic_cast<BinaryOperationNode*>(node.get())) { // Узел бинарной операции?
+        binOpNode->left = subsVarHelper(std::move(binOpNode->left), varMap);
+        binOpNode->right = subsVarHelper(std::move(binOpNode->right), varMap);
+        if (binOpNode->operation == '^' && binOpNode->exponent.kind == ExponentClass::General) 
+            binOpNode->exponent = classifyExponent(binOpNode->right.get()); // Показатель мог стать константой.
+        binOpNode->rehash();
+    } 
+    else if (auto* funcNode = dynamic_cast<FunctionNode*>(node.get())) { // Узел функции?
+        for (unsigned i = 0; i < funcNode->arity; i++)
+            funcNode->args[i] = subsVarHelper(std::move(funcNode->args[i]), varMap);
+        funcNode->rehash();
+    }
+    else if (auto* unaryOpNode = dynamic_cast<UnaryOperationNode*>(node.get())) { // Узел унарной операции?
+        unaryOpNode->arg = subsVarHelper(std::move(unaryOpNode->arg), varMap);
+        unaryOpNode->rehash();
+    }
+    else if (auto* sumNode = dynamic_cast<SumNode*>(node.get())) { // Узел суммы?
+        for (auto& term : sumNode->terms)
+            term.second = subsVarHelper(std::move(term.second), varMap);
+        sumNode->rehash();
+    }
+    else if (auto* productNode = dynamic_cast<ProductNode*>(node.get())) { // Узел произведения?
+        for (auto& factor : productNode->factors)
+            factor = subsVarHelper(std::move(factor), varMap);
+        productNode->rehash();
+    }
 
-    ++pos; // Пропускаем ")"
-    return std::make_unique<FunctionNode>(function, std::move(arg));
+    return node;
 }
 
+// --------------------------------------------------------------- //
+
+/*
+Тело функции для вычисления выражения.
+Числа из дерева приводятся к типу U, в котором и ведутся все вычисления.
+Собственное время узла — его полное время за вычетом полного времени потомков 
+(потомок оставляет свое полное время в profile->lastTicks).
+*/
+template <typename T>
+template <typename U, bool Profiled>
+U Expression<T>::evaluateHelper(const Node* node, const std::unordered_map<std::string, U>* vars, 
+                                Profile* profile, Accuracy accuracy) const {
+
+    using std::pow, std::sin, std::cos, std::log, std::exp; // Для Interval находятся по ADL.
+
+    [[maybe_unused]] uint64_t start = 0, children = 0;
+    if constexpr (Profiled) 
+        start = profileTicks();
+
+    // Значение потомка (с учетом его времени).
+    auto child = [&](const Node* arg) {
+        U value = evaluateHelper<U, Profiled>(arg, vars, profile, accuracy);
+        if constexpr (Profiled) 
+            children += profile->lastTicks;
+        return value;
+    };
+
+    // Вызов библиотечной функции (с замером ее времени).
+    auto math = [&]([[maybe_unused]] typename Profile::Kind kind, auto call) -> U {
+        if constexpr (Profiled) {
+            uint64_t begin = profileTicks();
+            U value = call();
+            profile->counters[kind].mathTicks += profileTicks() - begin;
+            return value;
+        }
+        else {
+            return call();
+        }
+    };
+
+    // Возврат значения узла (с записью его вызова и собственного времени).
+    auto finish = [&]([[maybe_unused]] typename Profile::Kind kind, U value) -> U {
+        if constexpr (Profiled) {
+            uint64_t total = profileTicks() - start;
+            profile->counters[kind].calls++;
+            profile->counters[kind].ticks += total - children;
+            profile->lastTicks = total;
+        }
+        return value;
+    };
+
+    if (const auto* numNode = dynamic_cast<const NumberNode*>(node)) {
+        return finish(Profile::Number, static_cast<U>(numNode->value));
+    }
+    else if (const auto* varNode = dynamic_cast<const VariableNode*>(node); varNode && vars) {
+
+        auto it = vars->find(varNode->name);
+        if (it == vars->end())
+            throw std::runtime_error("Unbound variable: " + varNode->name);
+        return finish(Profile::Variable, it->second);
+    }
+    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
 
+        constexpr bool point = std::is_floating_point_v<U> || isComplex<U>;
+
+        // Сумма после rebalance(CompensatedSum): звенья по порядку, сложение с компенсацией.
+        if constexpr (point) {
+            if ((binOpNode->chain & ChainCompensated) && (binOpNode->chain & ChainRoot)) {
+
+                U sum = static_cast<U>(0), compensation = static_cast<U>(0);
+                auto accumulate = [&](const Node* link, bool negative, auto& self) -> void {
+                    const auto* chainNode = dynamic_cast<const BinaryOperationNode*>(link);
+                    if (chainNode && (chainNode->chain & ChainNode) && !(chainNode->chain & ChainRoot)) {
+                        self(chainNode->left.get(), negative, self);
+                        self(chainNode->right.get(), negative != (chainNode->operation == '-'), self);
+                        return;
+                    }
+                    U value = child(link);
+                    compensatedAdd(sum, compensation, negative ? -value : value);
+                };
+                accumulate(binOpNode->left.get(), false, accumulate);
+                accumulate(binOpNode->right.get(), binOpNode->operation == '-', accumulate);
+                return finish(Profile::Add, sum + compensation);
+            }
+        }
 
+        U leftValue = child(binOpNode->left.get());
 
+        // Показатель вида Integer, SquareRoot или CubeRoot не нужен для вычисления степени.
+        ExponentClass::Kind kind = binOpNode->operation == '^' ? binOpNode->exponent.kind : ExponentClass::General;
+        bool skipRight = point && (kind == ExponentClass::Integer || kind == ExponentClass::SquareRoot || 
+                                   kind == ExponentClass::CubeRoot);
+        U rightValue = skipRight ? leftValue : child(binOpNode->right.get());
+        
+        switch (binOpNode->operation) {
 
+            case '+': return finish(Profile::Add, leftValue + rightValue);
 
+            case '-': return finish(Profile::Subtract, leftValue - rightValue);
 
+            case '*': return finish(Profile::Multiply, leftValue * rightValue);
 
+            case '/': 
+                if (rightValue == static_cast<U>(0))
+                    throw std::runtime_error("Division by zero");
+                return finish(Profile::Divide, leftValue / rightValue);
 
+            case '^': 
+                if constexpr (point) {
+                    return finish(Profile::Power, math(Profile::Power, [&] { 
+                        return raisePower(leftValue, rightValue, binOpNode->exponent); }));
+                }
+                else if (kind == ExponentClass::CubeRoot || kind == ExponentClass::OddRoot) {
+                    const ExponentClass& cls = binOpNode->exponent;
+                    return finish(Profile::Power, math(Profile::Power, [&] { 
+                        return rootPower(leftValue, cls.numerator, cls.denominator); }));
+                }
+                else {
+                    return finish(Profile::Power, math(Profile::Power, [&] { return pow(leftValue, rightValue); }));
+                }
 
+            default: throw std::runtime_error("Unknown binary operator");
+        }
+    }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
 
+        U first = child(funcNode->args[0].get());
+        U second = funcNode->arity > 1 ? child(funcNode->args[1].get()) : first;
 
+        // sin, cos, ln и exp — первые номера Function и отдельные счетчики профиля.
+        bool elementary = funcNode->id <= static_cast<uint16_t>(Function::Exp);
+        auto kind = elementary ? static_cast<typename Profile::Kind>(Profile::Sin + funcNode->id) : Profile::Function;
 
+        if constexpr (std::is_floating_point_v<U>) {
+            if (elementary && accuracy != Accuracy::Exact) {
+                Function function = static_cast<Function>(funcNode->id);
+                if (function == Function::Ln && first <= 0)
+                    throw std::runtime_error("Argument of ln <= 0 is not allowed");
+                return finish(kind, math(kind, [&] { 
+                    return static_cast<U>(approximate(accuracy, function, static_cast<double>(first))); }));
+            }
+        }
+        return finish(kind, math(kind, [&] { return callFunction<U>(funcNode->id, first, second); }));
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
 
+        U argValue = child(unaryOpNode->arg.get());
 
+        switch (unaryOpNode->operation) {
+            case '-': return finish(Profile::Negate, -argValue);
+            default:
+                throw std::runtime_error("Unknown unary operator");
+        }
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) {
 
+        U sum = child(sumNode->terms[0].second.get());
+        for (size_t i = 1; i < sumNode->terms.size(); i++) {
+            U value = child(sumNode->terms[i].second.get());
+            sum = sumNode->terms[i].first == '-' ? sum - value : sum + value;
+        }
+        return finish(Profile::Sum, sum);
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
 
+        U product = child(productNode->factors[0].get());
+        for (size_t i = 1; i < productNode->factors.size(); i++)
+            product = product * child(productNode->factors[i].get());
+        return finish(Profile::Product, product);
+    }
 
+    throw std::runtime_error("Invalid node type in evaluation");
+}
 
+// --------------------------------------------------------------- //
 
+/*
+Тело функции для вычисления выражения в смешанной точности.
+Каждый узел считается в double; если операция в узле плохо обусловлена при полученных 
+аргументах (например, x - y при x ≈ y теряет почти все значащие разряды double), 
+узел пересчитывается в long double из значений потомков в long double и округляется обратно.
+Значение в long double есть у каждого узла на пути от плохо обусловленного узла к корню, а прочие
+поддеревья пересчитываются один раз, поэтому каждый узел вычисляется в long double не больше одного раза.
+*/
+template <typename T>
+typename Expression<T>::MixedValue Expression<T>::evaluateMixedHelper(const Node* node) const {
+
+    using Fast = std::conditional_t<isComplex<T>, std::complex<double>, double>;
+    using Wide = std::conditional_t<isComplex<T>, std::complex<long double>, long double>;
+
+    const double CANCELLATION = 0x1p-20; // Допустимая доля оставшихся разрядов при сложении.
+    const double LARGE = 0x1p10;         // Порог коэффициента обусловленности для ^, exp, ln.
+    const double PERIODIC = 0x1p20;      // Порог аргумента sin/cos (потеря точности при редукции).
+
+    // Значение потомка в long double.
+    auto wide = [&](const MixedValue& value, const Node* child) -> Wide {
+        return value.widened ? value.wide : evaluateHelper<Wide>(child);
+    };
+
+    // Итог узла. recompute() (тот же узел в long double) вызывается, если узел плохо обусловлен
+    // или у потомков уже есть значения в long double.
+    auto finish = [&](Fast result, bool illConditioned, bool widened, auto recompute) -> MixedValue {
+        illConditioned = illConditioned || !std::isfinite(std::abs(result));
+        if (!illConditioned && !widened)
+            return {result};
+        Wide wideResult = recompute();
+        return {illConditioned ? static_cast<Fast>(wideResult) : result, wideResult, true};
+    };
 
+    if (const auto* numNode = dynamic_cast<const NumberNode*>(node)) {
+        return {static_cast<Fast>(numNode->value)};
+    }
+    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
 
+        MixedValue left = evaluateMixedHelper(binOpNode->left.get());
+        MixedValue right = evaluateMixedHelper(binOpNode->right.get());
+        Fast result;
+        bool illConditioned = false;
 
+        switch (binOpNode->operation) {
 
+            case '+': 
+            case '-': 
+                result = binOpNode->operation == '+' ? left.fast + right.fast : left.fast - right.fast;
+                illConditioned = std::abs(result) < CANCELLATION * (std::abs(left.fast) + std::abs(right.fast));
+                break;
 
+            case '*': 
+                result = left.fast * right.fast;
+                break;
 
+            case '/': 
+                if (right.fast == static_cast<Fast>(0))
+                    throw std::runtime_error("Division by zero");
+                result = left.fast / right.fast;
+                break;
 
-// ---------------------------------------------------------------------------------------------------- //
-// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
-// ---------------------------------------------------------------------------------------------------- //
+            case '^': {
+                // Обусловленность по основанию |y|, по показателю |y ln x|. Постоянный целый
+                // показатель точен, и у него остается только |n|; ln — только от основания > 0.
+                result = raisePower(left.fast, right.fast, binOpNode->exponent);
+                illConditioned = std::abs(right.fast) > LARGE;
+                bool positive;
+                if constexpr (isComplex<T>) positive = left.fast.imag() == 0 && left.fast.real() > 0;
+                else positive = left.fast > 0;
+                if (binOpNode->exponent.kind != ExponentClass::Integer && positive)
+                    illConditioned = illConditioned || std::abs(right.fast * std::log(left.fast)) > LARGE;
+                break;
+            }
 
-/*
-Тело функции замены переменных.
-*/
-template <typename T>
-std::unique_ptr<typename Expression<T>::Node> 
-Expression<T>::subsVarHelper(std::unique_ptr<Node> node,
-                             const std::unordered_map<std::string, T>& varMap) { // Основное тело 
-                                                                                 // функции subsVar() 
-                                                                                 // для замены переменной в узле
-    
-    if (!node) return nullptr;
+            default: throw std::runtime_error("Unknown binary operator");
+        }
 
-    if (auto* varNode = dynamic_cast<VariableNode*>(node.get())) { // Узел переменной?
+        return finish(result, illConditioned, left.widened || right.widened, [&]() -> Wide {
+            Wide leftValue = wide(left, binOpNode->left.get());
+            Wide rightValue = wide(right, binOpNode->right.get());
+            switch (binOpNode->operation) {
+                case '+': return leftValue + rightValue;
+                case '-': return leftValue - rightValue;
+                case '*': return leftValue * rightValue;
+                case '/': return leftValue / rightValue;
+                default: return raisePower(leftValue, rightValue, binOpNode->exponent);
+            }
+        });
+    }
+    else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
 
-        auto it = varMap.find(varNode->name);
-        
-        if (it != varMap.end()) { 
+        MixedValue arg = evaluateMixedHelper(funcNode->args[0].get());
+        MixedValue second = funcNode->arity > 1 ? evaluateMixedHelper(funcNode->args[1].get()) : arg;
+        Fast result = callFunction<Fast>(funcNode->id, arg.fast, second.fast);
+        bool illConditioned = false;
+
+        switch (static_cast<Function>(funcNode->id)) {
+            case Function::Sin: case Function::Cos: case Function::Tan:
+                illConditioned = std::abs(arg.fast) > PERIODIC;
+                break;
+            case Function::Ln: case Function::Log10:
+                illConditioned = std::abs(arg.fast - static_cast<Fast>(1)) < 1 / LARGE;
+                break;
+            case Function::Exp: case Function::Sinh: case Function::Cosh:
+                illConditioned = std::abs(arg.fast) > LARGE / 4;
+                break;
+            default: break;
+        }
 
-            if constexpr (std::is_same_v<T, std::complex<long double>>) {
+        return finish(result, illConditioned, arg.widened || second.widened, [&] {
+            Wide argValue = wide(arg, funcNode->args[0].get());
+            Wide secondValue = funcNode->arity > 1 ? wide(second, funcNode->args[1].get()) : argValue;
+            return callFunction<Wide>(funcNode->id, argValue, secondValue);
+        });
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
 
-                std::complex<long double> value = it->second;
-    
-                if (value.real() != 0 && value.imag() != 0) { // Если обе части ненулевые, раздваиваем узел.
-
-                    std::unique_ptr<Node> realNode, imagNode;
-
-                    if (value.real() < 0) 
-                        realNode = std::make_unique<UnaryOperationNode>
-                        ('-', std::make_unique<NumberNode>
-                            (std::complex<long double>(-value.real(), 0)));
-                    else
-                        realNode = std::make_unique<NumberNode>
-                            (std::complex<long double>(value.real(), 0));
-                    
-                    if (value.imag() < 0) 
-                        imagNode = std::make_unique<UnaryOperationNode>
-                            ('-', std::make_unique<NumberNode>
-                                (std::complex<long double>(0, -value.imag())));
-                    else
-                        imagNode = std::make_unique<NumberNode>
-                            (std::complex<long double>(0, value.imag()));
+        MixedValue arg = evaluateMixedHelper(unaryOpNode->arg.get());
 
-                    return std::make_unique<BinaryOperationNode>
-                        ('+', std::move(realNode), std::move(imagNode));
-                } 
-                else if (value.real()) { // Если только реальная часть ненулевая, заменяем значение на реальное.
-
-                    if (value.real() < 0) 
-                        return std::make_unique<UnaryOperationNode>
-                            ('-', std::make_unique<NumberNode>
-                                (std::complex<long double>(-value.real(), 0)));
-                    else
-                        return std::make_unique<NumberNode>
-                            (std::complex<long double>(value.real(), 0));
-                } 
-                else { // Если только мнимая часть ненулевая, заменяем значение на мнимое.
-
-                    if (value.imag() < 0) 
-                        return std::make_unique<UnaryOperationNode>
-                            ('-', std::make_unique<NumberNode>
-                                (std::complex<long double>(0, -value.imag())));
-                    else
-                        return std::make_unique<NumberNode>
-                            (std::complex<long double>(0, value.imag()));
-                }
-            } 
-            else if constexpr (std::is_same_v<T, long double>) {
+        switch (unaryOpNode->operation) {
+            case '-': return {-arg.fast, -arg.wide, arg.widened};
+            default:
+                throw std::runtime_error("Unknown unary operator");
+        }
+    }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) { // Сокращение проверяется на каждом звене.
+
+        std::vector<MixedValue> terms;
+        terms.reserve(sumNode->terms.size());
+        terms.push_back(evaluateMixedHelper(sumNode->terms[0].second.get()));
+        Fast result = terms[0].fast;
+        bool illConditioned = false, widened = terms[0].widened;
+        for (size_t i = 1; i < sumNode->terms.size(); i++) {
+            terms.push_back(evaluateMixedHelper(sumNode->terms[i].second.get()));
+            Fast value = terms[i].fast;
+            Fast sum = sumNode->terms[i].first == '-' ? result - value : result + value;
+            illConditioned = illConditioned || std::abs(sum) < CANCELLATION * (std::abs(result) + std::abs(value));
+            widened = widened || terms[i].widened;
+            result = sum;
+        }
 
-                if (it->second >= 0)
-                    return std::make_unique<NumberNode>(it->second);
-                else
-                    return std::make_unique<UnaryOperationNode>
-                        ('-', std::make_unique<NumberNode>(-it->second));
+        return finish(result, illConditioned, widened, [&] {
+            Wide sum = wide(terms[0], sumNode->terms[0].second.get());
+            for (size_t i = 1; i < terms.size(); i++) {
+                Wide value = wide(terms[i], sumNode->terms[i].second.get());
+                sum = sumNode->terms[i].first == '-' ? sum - value : sum + value;
             }
-        }
-    } 
-    else if (auto* binOpNode = dynamic_cast<BinaryOperationNode*>(node.get())) { // Узел бинарной операции?
-        binOpNode->left = subsVarHelper(std::move(binOpNode->left), varMap);
-        binOpNode->right = subsVarHelper(std::move(binOpNode->right), varMap);
-    } 
-    else if (auto* funcNode = dynamic_cast<FunctionNode*>(node.get())) { // Узел функции?
-        funcNode->arg = subsVarHelper(std::move(funcNode->arg), varMap);
+            return sum;
+        });
     }
-    else if (auto* unaryOpNode = dynamic_cast<UnaryOperationNode*>(node.get())) { // Узел унарной операции?
-        unaryOpNode->arg = subsVarHelper(std::move(unaryOpNode->arg), varMap);
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+
+        std::vector<MixedValue> factors;
+        factors.reserve(productNode->factors.size());
+        Fast result = 1;
+        bool widened = false;
+        for (const auto& factor : productNode->factors) {
+            factors.push_back(evaluateMixedHelper(factor.get()));
+            result = factors.size() == 1 ? factors[0].fast : result * factors.back().fast;
+            widened = widened || factors.back().widened;
+        }
+
+        return finish(result, false, widened, [&] {
+            Wide product = wide(factors[0], productNode->factors[0].get());
+            for (size_t i = 1; i < factors.size(); i++)
+                product = product * wide(factors[i], productNode->factors[i].get());
+            return product;
+        });
     }
 
-    return node;
+    throw std::runtime_error("Invalid node type in evaluation");
 }
 
 // --------------------------------------------------------------- //
 
 /*
-Тело функции для вычисления выражения.
+Тело функции пакетного вычисления.
+Результат левого (или единственного) потомка переиспользуется как буфер для результата узла.
 */
 template <typename T>
-T Expression<T>::evaluateHelper(const Node* node) const {
+typename Expression<T>::Batch 
+Expression<T>::evaluateBatchHelper(const Node* node, const std::unordered_map<std::string, Batch>& vars, 
+                                   size_t n, Accuracy accuracy) const {
+
+    using R = RealOf<T>;
 
     if (const auto* numNode = dynamic_cast<const NumberNode*>(node)) {
-        return numNode->value;
+
+        Batch result;
+        if constexpr (isComplex<T>) {
+            result.re.assign(n, numNode->value.real());
+            result.im.assign(n, numNode->value.imag());
+        }
+        else {
+            result.re.assign(n, numNode->value);
+        }
+        return result;
     }
-    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+    else if (const auto* varNode = dynamic_cast<const VariableNode*>(node)) {
 
-        T leftValue = evaluateHelper(binOpNode->left.get());
-        T rightValue = evaluateHelper(binOpNode->right.get());
-        
-        switch (binOpNode->operation) {
+        auto it = vars.find(varNode->name);
+        if (it == vars.end())
+            throw std::runtime_error("Unbound variable: " + varNode->name);
+        return it->second;
+    }
+    else if (const auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
 
-            case '+': return leftValue + rightValue;
+        Batch left = evaluateBatchHelper(binOpNode->left.get(), vars, n, accuracy);
+        const ExponentClass& cls = binOpNode->exponent;
+        bool skipRight = binOpNode->operation == '^' && cls.kind != ExponentClass::General && 
+                         cls.kind != ExponentClass::OddRoot; // Показатель не нужен.
+        Batch right = skipRight ? Batch() : evaluateBatchHelper(binOpNode->right.get(), vars, n, accuracy);
+        R* ar = left.re.data();
+        R* ai = left.im.data();
+        const R* br = right.re.data();
+        const R* bi = right.im.data();
 
-            case '-': return leftValue - rightValue;
+        switch (binOpNode->operation) {
 
-            case '*': return leftValue * rightValue;
+            case '+': 
+                binaryKernel(ar, br, n, [](R a, R b) { return a + b; });
+                if constexpr (isComplex<T>) 
+                    binaryKernel(ai, bi, n, [](R a, R b) { return a + b; });
+                return left;
+
+            case '-': 
+                binaryKernel(ar, br, n, [](R a, R b) { return a - b; });
+                if constexpr (isComplex<T>) 
+                    binaryKernel(ai, bi, n, [](R a, R b) { return a - b; });
+                return left;
+
+            case '*': 
+                if constexpr (isComplex<T>) 
+                    complexMultiply(ar, ai, br, bi, n);
+                else
+                    binaryKernel(ar, br, n, [](R a, R b) { return a * b; });
+                return left;
 
             case '/': 
-                if (rightValue == static_cast<T>(0))
-                    throw std::runtime_error("Division by zero");
-                return leftValue / rightValue;
+                for (size_t i = 0; i < n; i++) {
+                    if (br[i] == 0 && (!isComplex<T> || bi[i] == 0))
+                        throw std::runtime_error("Division by zero");
+                }
+                if constexpr (isComplex<T>) 
+                    complexDivide(ar, ai, br, bi, n);
+                else
+                    binaryKernel(ar, br, n, [](R a, R b) { return a / b; });
+                return left;
 
             case '^': 
-                if constexpr (std::is_same_v<T, long double>) {
-                    long double intPart;
-                    if (std::abs(rightValue) < 1 && std::modf(1 / std::abs(rightValue), &intPart) == 0.0L && (int)(1 / std::abs(rightValue)) % 2 == 0 && leftValue < 0)
-                        throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+                if (cls.kind != ExponentClass::General) {
+                    powerKernel<T>(ar, ai, br, n, cls);
                 }
-                return std::pow(leftValue, rightValue);
+                else if constexpr (isComplex<T>) {
+                    complexPow(ar, ai, br, bi, n);
+                }
+                else {
+                    for (size_t i = 0; i < n; i++) {
+                        if (isEvenRootOfNegative(ar[i], br[i]))
+                            throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+                    }
+                    binaryKernel(ar, br, n, [](R a, R b) { return std::pow(a, b); });
+                }
+                return left;
 
             default: throw std::runtime_error("Unknown binary operator");
         }
     }
     else if (const auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
 
-        T argValue = evaluateHelper(funcNode->arg.get());
+        Batch arg = evaluateBatchHelper(funcNode->args[0].get(), vars, n, accuracy);
+        Batch second = funcNode->arity > 1 ? evaluateBatchHelper(funcNode->args[1].get(), vars, n, accuracy) : Batch();
+        R* re = arg.re.data();
+        R* im = arg.im.data();
+        const R* br = second.re.data();
+        const R* bi = second.im.data();
+
+        // Пользовательская функция: ядро batch по столбцам аргументов или scalar поэлементно.
+        if (funcNode->id >= static_cast<uint16_t>(Function::BUILTINS)) {
+
+            const FunctionDefinition& definition = functionDefinition(funcNode->id);
+            std::vector<T> columns[FunctionNode::MAX_ARITY];
+            const T* pointers[FunctionNode::MAX_ARITY] = {};
+            for (unsigned k = 0; k < funcNode->arity; k++) {
+                const Batch& column = k == 0 ? arg : second;
+                if constexpr (isComplex<T>) {
+                    columns[k].resize(n);
+                    for (size_t i = 0; i < n; i++) 
+                        columns[k][i] = T(column.re[i], column.im[i]);
+                    pointers[k] = columns[k].data();
+                }
+                else {
+                    pointers[k] = column.re.data();
+                }
+            }
+
+            std::vector<T> result(n);
+            if (definition.batch) {
+                definition.batch(pointers, n, result.data());
+            }
+            else {
+                for (size_t i = 0; i < n; i++) {
+                    T values[FunctionNode::MAX_ARITY] = {pointers[0][i], funcNode->arity > 1 ? pointers[1][i] : T()};
+                    result[i] = definition.scalar(values);
+                }
+            }
 
-        if (funcNode->function == "sin")
-            return std::sin(argValue);
+            if constexpr (isComplex<T>) {
+                for (size_t i = 0; i < n; i++) {
+                    re[i] = result[i].real();
+                    im[i] = result[i].imag();
+                }
+            }
+            else {
+                arg.re.swap(result);
+            }
+            return arg;
+        }
 
-        else if (funcNode->function == "cos")
-            return std::cos(argValue);
+        Function function = static_cast<Function>(funcNode->id);
 
-        else if (funcNode->function == "ln") {
-            if (argValue == static_cast<T>(0)) 
-                throw std::runtime_error("Argument of ln <= 0 is not allowed");
-            if constexpr (std::is_same_v<T, long double>)  {
-                if (argValue <= 0.0) 
-                    throw std::runtime_error("Argument of ln <= 0 is not allowed");
+        // Область определения проверяется до ядра, чтобы циклы ядер векторизовались.
+        auto check = [&](auto invalid, const char* message) {
+            for (size_t i = 0; i < n; i++) {
+                if (invalid(i))
+                    throw std::runtime_error(message);
             }
-            return std::log(argValue);
+        };
+        if (function == Function::Ln || function == Function::Log10) {
+            const char* message = function == Function::Ln ? "Argument of ln <= 0 is not allowed" : 
+                                                              "Argument of log10 <= 0 is not allowed";
+            check([&](size_t i) { return isComplex<T> ? (re[i] == 0 && im[i] == 0) : re[i] <= 0; }, message);
         }
-        else if (funcNode->function == "exp") 
-            return std::exp(argValue);
 
-        else
-            throw std::runtime_error("Unknown function: " + funcNode->function);
-    
+        if constexpr (isComplex<T>) {
+            switch (function) {
+                case Function::Sin: complexSin(re, im, n); break;
+                case Function::Cos: complexCos(re, im, n); break;
+                case Function::Ln: complexLog(re, im, n); break;
+                case Function::Exp: complexExp(re, im, n); break;
+                default:
+                    for (size_t i = 0; i < n; i++) {
+                        T z(re[i], im[i]);
+                        T w = applyFunction(function, z, funcNode->arity > 1 ? T(br[i], bi[i]) : z);
+                        re[i] = w.real();
+                        im[i] = w.imag();
+                    }
+            }
+        }
+        else if (funcNode->id <= static_cast<uint16_t>(Function::Exp) && accuracy != Accuracy::Exact) {
+            approximateArray(accuracy, function, re, n);
+        }
+        else {
+            switch (function) {
+                case Function::Sin: unaryKernel(re, n, [](R a) { return std::sin(a); }); break;
+                case Function::Cos: unaryKernel(re, n, [](R a) { return std::cos(a); }); break;
+                case Function::Ln: unaryKernel(re, n, [](R a) { return std::log(a); }); break;
+                case Function::Exp: unaryKernel(re, n, [](R a) { return std::exp(a); }); break;
+                case Function::Tan: unaryKernel(re, n, [](R a) { return std::tan(a); }); break;
+                case Function::Sqrt: 
+                    check([&](size_t i) { return re[i] < 0; }, 
+                          "Argument of sqrt < 0 and even sqrt power is not allowed");
+                    unaryKernel(re, n, [](R a) { return std::sqrt(a); }); 
+                    break;
+                case Function::Abs: unaryKernel(re, n, [](R a) { return std::fabs(a); }); break;
+                case Function::Sign: unaryKernel(re, n, [](R a) { return signOf(a); }); break;
+                case Function::Atan: unaryKernel(re, n, [](R a) { return std::atan(a); }); break;
+                case Function::Sinh: unaryKernel(re, n, [](R a) { return std::sinh(a); }); break;
+                case Function::Cosh: unaryKernel(re, n, [](R a) { return std::cosh(a); }); break;
+                case Function::Tanh: unaryKernel(re, n, [](R a) { return std::tanh(a); }); break;
+                case Function::Log10: unaryKernel(re, n, [](R a) { return std::log10(a); }); break;
+                case Function::Erf: unaryKernel(re, n, [](R a) { return std::erf(a); }); break;
+                case Function::Min: binaryKernel(re, br, n, [](R a, R b) { return std::min(a, b); }); break;
+                case Function::Max: binaryKernel(re, br, n, [](R a, R b) { return std::max(a, b); }); break;
+                default: throw std::runtime_error("Unknown function");
+            }
+        }
+        return arg;
     }
     else if (const auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
 
-        T argValue = evaluateHelper(unaryOpNode->arg.get());
+        Batch arg = evaluateBatchHelper(unaryOpNode->arg.get(), vars, n, accuracy);
 
         switch (unaryOpNode->operation) {
-            case '-': return -argValue;
+            case '-': 
+                unaryKernel(arg.re.data(), n, [](R a) { return -a; });
+                if constexpr (isComplex<T>) 
+                    unaryKernel(arg.im.data(), n, [](R a) { return -a; });
+                return arg;
             default:
                 throw std::runtime_error("Unknown unary operator");
         }
     }
+    else if (const auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+
+        Batch sum = evaluateBatchHelper(sumNode->terms[0].second.get(), vars, n, accuracy);
+        for (size_t i = 1; i < sumNode->terms.size(); i++) {
+            Batch term = evaluateBatchHelper(sumNode->terms[i].second.get(), vars, n, accuracy);
+            if (sumNode->terms[i].first == '-') {
+                binaryKernel(sum.re.data(), term.re.data(), n, [](R a, R b) { return a - b; });
+                if constexpr (isComplex<T>) 
+                    binaryKernel(sum.im.data(), term.im.data(), n, [](R a, R b) { return a - b; });
+            }
+            else {
+                binaryKernel(sum.re.data(), term.re.data(), n, [](R a, R b) { return a + b; });
+                if constexpr (isComplex<T>) 
+                    binaryKernel(sum.im.data(), term.im.data(), n, [](R a, R b) { return a + b; });
+            }
+        }
+        return sum;
+    }
+    else if (const auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+
+        Batch product = evaluateBatchHelper(productNode->factors[0].get(), vars, n, accuracy);
+        for (size_t i = 1; i < productNode->factors.size(); i++) {
+            Batch factor = evaluateBatchHelper(productNode->factors[i].get(), vars, n, accuracy);
+            if constexpr (isComplex<T>) 
+                complexMultiply(product.re.data(), product.im.data(), factor.re.data(), factor.im.data(), n);
+            else
+                binaryKernel(product.re.data(), factor.re.data(), n, [](R a, R b) { return a * b; });
+        }
+        return product;
+    }
 
     throw std::runtime_error("Invalid node type in evaluation");
 }
@@ -925,8 +3476,7 @@ Expression<T>::differentiateHelper(const Node* node, const std::string& var) con
             case '/': { // (f / g)' = (f' * g - f * g') / g^2
                 auto leftCopy = copyTree(binOpNode->left.get());
                 auto rightCopy = copyTree(binOpNode->right.get());
-                auto rightSquared = std::make_unique<BinaryOperationNode>
-                    ('^', copyTree(binOpNode->right.get()), std::make_unique<NumberNode>(2));
+                auto rightSquared = powerNode(copyTree(binOpNode->right.get()), std::make_unique<NumberNode>(2));
                 return std::make_unique<BinaryOperationNode>
                     ('/', std::make_unique<BinaryOperationNode>
                         ('-', std::make_unique<BinaryOperationNode>
@@ -937,10 +3487,38 @@ Expression<T>::differentiateHelper(const Node* node, const std::string& var) con
                 );
             }
             case '^': {
+                // Постоянный показатель g = p / q: (f^g)' = g * f^((p - q) / q) * f'. Без ln(f) и деления
+                // на f производная определена там же, где и f^g (x^3 и x^(1/3) при x < 0, x^3 при x = 0).
+                const ExponentClass& cls = binOpNode->exponent;
+                if (cls.kind != ExponentClass::General) {
+                    if (cls.kind == ExponentClass::Integer && cls.numerator == 0)
+                        return std::make_unique<NumberNode>(0);
+                    long p = cls.kind == ExponentClass::SquareRoot ? 1 : cls.numerator;
+                    long q = cls.kind == ExponentClass::SquareRoot ? 2 : cls.denominator;
+
+                    // f^0 = 1 и f^1 = f без степени; отрицательный показатель — через valueNode (унарный минус).
+                    std::unique_ptr<Node> power;
+                    if (p == q)
+                        power = std::make_unique<NumberNode>(1);
+                    else if (p - q == q)
+                        power = copyTree(binOpNode->left.get());
+                    else {
+                        std::unique_ptr<Node> exponent = valueNode(static_cast<T>(p - q));
+                        if (q != 1)
+                            exponent = std::make_unique<BinaryOperationNode>
+                                ('/', std::move(exponent), std::make_unique<NumberNode>(static_cast<T>(q)));
+                        power = powerNode(copyTree(binOpNode->left.get()), std::move(exponent));
+                    }
+                    return std::make_unique<BinaryOperationNode>
+                        ('*', std::make_unique<BinaryOperationNode>
+                            ('*', copyTree(binOpNode->right.get()), std::move(power)),
+                        std::move(dLeft));
+                }
+
                 // (f^g)' = f^g * (g' * ln(f) + g * f' / f)
                 auto leftCopy = copyTree(binOpNode->left.get());
                 auto rightCopy = copyTree(binOpNode->right.get());
-                auto lnLeft = std::make_unique<FunctionNode>("ln", copyTree(binOpNode->left.get()));
+                auto lnLeft = std::make_unique<FunctionNode>(Function::Ln, copyTree(binOpNode->left.get()));
                 auto term1 = std::make_unique<BinaryOperationNode>
                     ('*', std::move(dRight), std::move(lnLeft));
                 auto term2 = std::make_unique<BinaryOperationNode>
@@ -957,34 +3535,98 @@ Expression<T>::differentiateHelper(const Node* node, const std::string& var) con
     }
     else if (auto* funcNode = dynamic_cast<const FunctionNode*>(node)) { // Производная для функций.
         
-        auto dArg = differentiateHelper(funcNode->arg.get(), var);
-        if (funcNode->function == "sin") { // (sin(f))' = cos(f) * f'
-            auto cosArg = std::make_unique<FunctionNode>
-                ("cos", copyTree(funcNode->arg.get()));
-            return std::make_unique<BinaryOperationNode>
-                ('*', std::move(cosArg), std::move(dArg));
-        }
-        else if (funcNode->function == "cos") {  // (cos(f))' = -sin(f) * f'
-           
-            auto sinArg = std::make_unique<FunctionNode>
-                ("sin", copyTree(funcNode->arg.get()));
-            auto negSinArg = std::make_unique<BinaryOperationNode>
-                ('*', std::make_unique<NumberNode>(-1), std::move(sinArg));
-            return std::make_unique<BinaryOperationNode>
-                ('*', std::move(negSinArg), std::move(dArg));
-        }
-        else if (funcNode->function == "ln") { // (ln(f))' = f' / f
-            return std::make_unique<BinaryOperationNode>
-                ('/', std::move(dArg), copyTree(funcNode->arg.get()));
-        }
-        else if (funcNode->function == "exp") { // (exp(f))' = exp(f) * f'
-            auto expArg = std::make_unique<FunctionNode>
-                ("exp", copyTree(funcNode->arg.get()));
-            return std::make_unique<BinaryOperationNode>
-                ('*', std::move(expArg), std::move(dArg));
+        auto arg = [&](unsigned k) { return copyTree(funcNode->args[k].get()); };
+        auto call = [](Function function, std::unique_ptr<Node> a) { 
+            return std::make_unique<FunctionNode>(function, std::move(a)); };
+        auto op = [](char operation, std::unique_ptr<Node> a, std::unique_ptr<Node> b) -> std::unique_ptr<Node> { 
+            if (operation == '^') return powerNode(std::move(a), std::move(b));
+            return std::make_unique<BinaryOperationNode>(operation, std::move(a), std::move(b)); };
+        auto number = [](T value) { return std::make_unique<NumberNode>(value); };
+
+        // Пользовательская функция: сумма частных производных, умноженных на производные аргументов.
+        if (funcNode->id >= static_cast<uint16_t>(Function::BUILTINS)) {
+
+            const FunctionDefinition& definition = functionDefinition(funcNode->id);
+            if (!definition.partials)
+                throw std::runtime_error("Function " + definition.name + " has no derivative rule");
+
+            std::vector<Expression<T>> args(funcNode->arity);
+            for (unsigned k = 0; k < funcNode->arity; k++)
+                args[k].root = arg(k);
+            std::vector<Expression<T>> partials = definition.partials(args);
+            if (partials.size() != funcNode->arity)
+                throw std::runtime_error("Function " + definition.name + " must have one partial per argument");
+
+            std::unique_ptr<Node> result;
+            for (unsigned k = 0; k < funcNode->arity; k++) {
+                auto term = op('*', std::move(partials[k].root), differentiateHelper(funcNode->args[k].get(), var));
+                result = result ? op('+', std::move(result), std::move(term)) : std::move(term);
+            }
+            return result;
         }
-        else {
-            throw std::runtime_error("Unknown function: " + funcNode->function);
+
+        auto dArg = differentiateHelper(funcNode->args[0].get(), var);
+        switch (static_cast<Function>(funcNode->id)) {
+
+            case Function::Sin: // (sin(f))' = cos(f) * f'
+                return op('*', call(Function::Cos, arg(0)), std::move(dArg));
+
+            case Function::Cos: // (cos(f))' = -sin(f) * f'
+                return op('*', op('*', number(-1), call(Function::Sin, arg(0))), std::move(dArg));
+
+            case Function::Ln: // (ln(f))' = f' / f
+                return op('/', std::move(dArg), arg(0));
+
+            case Function::Exp: // (exp(f))' = exp(f) * f'
+                return op('*', call(Function::Exp, arg(0)), std::move(dArg));
+
+            case Function::Tan: // (tan(f))' = f' / cos(f) ^ 2
+                return op('/', std::move(dArg), op('^', call(Function::Cos, arg(0)), number(2)));
+
+            case Function::Sqrt: // (sqrt(f))' = f' / (2 * sqrt(f))
+                return op('/', std::move(dArg), op('*', number(2), call(Function::Sqrt, arg(0))));
+
+            case Function::Abs: // (|f|)' = f' * sign(f)
+                return op('*', std::move(dArg), call(Function::Sign, arg(0)));
+
+            case Function::Sign: // Кусочно-постоянная функция.
+                return number(0);
+
+            case Function::Atan: // (atan(f))' = f' / (1 + f ^ 2)
+                return op('/', std::move(dArg), op('+', number(1), op('^', arg(0), number(2))));
+
+            case Function::Sinh: // (sinh(f))' = cosh(f) * f'
+                return op('*', call(Function::Cosh, arg(0)), std::move(dArg));
+
+            case Function::Cosh: // (cosh(f))' = sinh(f) * f'
+                return op('*', call(Function::Sinh, arg(0)), std::move(dArg));
+
+            case Function::Tanh: // (tanh(f))' = f' / cosh(f) ^ 2
+                return op('/', std::move(dArg), op('^', call(Function::Cosh, arg(0)), number(2)));
+
+            case Function::Log10: // (log10(f))' = f' / (f * ln(10))
+                return op('/', std::move(dArg), op('*', arg(0), call(Function::Ln, number(10))));
+
+            case Function::Erf: // (erf(f))' = 2 / sqrt(pi) * exp(-f ^ 2) * f'
+                return op('*', op('*', number(static_cast<T>(1.1283791670955125738961589031215452L)), 
+                    call(Function::Exp, std::make_unique<UnaryOperationNode>('-', op('^', arg(0), number(2))))), 
+                    std::move(dArg));
+
+            case Function::Min: // (min(f, g))' = ((1 - s) * f' + (1 + s) * g') / 2, s = sign(f - g)
+            case Function::Max: // (max(f, g))' = ((1 + s) * f' + (1 - s) * g') / 2
+            {   // Множители 0 и 2 выбирают одну производную без вычитания f' - g', которое 
+                // теряло меньшую производную на фоне большой.
+                auto dSecond = differentiateHelper(funcNode->args[1].get(), var);
+                auto weight = [&](char operation) { 
+                    return op(operation, number(1), call(Function::Sign, op('-', arg(0), arg(1)))); };
+                bool min = static_cast<Function>(funcNode->id) == Function::Min;
+                auto first = op('*', weight(min ? '-' : '+'), std::move(dArg));
+                auto second = op('*', weight(min ? '+' : '-'), std::move(dSecond));
+                return op('/', op('+', std::move(first), std::move(second)), number(2));
+            }
+
+            default:
+                throw std::runtime_error("Unknown function");
         }
     }
     else if (auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
@@ -999,12 +3641,233 @@ Expression<T>::differentiateHelper(const Node* node, const std::string& var) con
                 throw std::runtime_error("Unknown unary operator");
         }
     }
+    else if (auto* sumNode = dynamic_cast<const SumNode*>(node)) { // (f + g - h)' = f' + g' - h'
+
+        std::vector<SignedTerm> terms;
+        terms.reserve(sumNode->terms.size());
+        for (const auto& [sign, term] : sumNode->terms)
+            terms.emplace_back(sign, differentiateHelper(term.get(), var));
+        return std::make_unique<SumNode>(std::move(terms));
+    }
+    else if (auto* productNode = dynamic_cast<const ProductNode*>(node)) { // (f * g * h)' = f' * g * h + 
+                                                                           // f * g' * h + f * g * h'
+        const auto& factors = productNode->factors;
+        std::vector<SignedTerm> terms;
+        for (size_t i = 0; i < factors.size(); i++) {
+
+            auto dFactor = differentiateHelper(factors[i].get(), var);
+            const auto* numNode = dynamic_cast<const NumberNode*>(dFactor.get());
+            if (numNode && numNode->value == static_cast<T>(0)) // Множитель без var: слагаемое равно нулю.
+                continue;
+
+            std::vector<std::unique_ptr<Node>> product;
+            product.reserve(factors.size());
+            for (size_t j = 0; j < factors.size(); j++)
+                product.push_back(j == i ? std::move(dFactor) : copyTree(factors[j].get()));
+            terms.emplace_back('+', std::make_unique<ProductNode>(std::move(product)));
+        }
+
+        if (terms.empty())
+            return std::make_unique<NumberNode>(0);
+        if (terms.size() == 1)
+            return std::move(terms[0].second);
+        return std::make_unique<SumNode>(std::move(terms));
+    }
 
     throw std::runtime_error("Unknown node type in differentiation");
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Тело функции статистики. Сигнатура узла — вид узла и номера его потомков, поэтому поддеревья
+с одинаковой сигнатурой совпадают целиком. Числа записываются в шестнадцатеричном виде,
+чтобы различались все значения.
+*/
+template <typename T>
+size_t Expression<T>::statisticsHelper(const Node* node, size_t depth, Statistics& stats,
+                                       std::unordered_map<std::string, size_t>& subtrees,
+                                       std::unordered_set<std::string>& names) const {
+
+    std::ostringstream signature;
+    signature << std::hexfloat;
+    typename Profile::Kind kind;
+    size_t links = 1; // Звеньев n-арного узла (у остальных узлов одна операция).
+
+    stats.nodes++;
+    stats.depth = std::max(stats.depth, depth);
+
+    if (auto* numNode = dynamic_cast<const NumberNode*>(node)) {
+        stats.numbers++;
+        kind = Profile::Number;
+        if constexpr (isComplex<T>)
+            signature << "n" << static_cast<long double>(numNode->value.real()) 
+                      << "," << static_cast<long double>(numNode->value.imag());
+        else
+            signature << "n" << static_cast<long double>(numNode->value);
+    }
+    else if (auto* varNode = dynamic_cast<const VariableNode*>(node)) {
+        stats.variables++;
+        names.insert(varNode->name);
+        kind = Profile::Variable;
+        signature << "v" << varNode->name;
+    }
+    else if (auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+        stats.binaryOperations++;
+        switch (binOpNode->operation) {
+            case '+': kind = Profile::Add; break;
+            case '-': kind = Profile::Subtract; break;
+            case '*': kind = Profile::Multiply; break;
+            case '/': kind = Profile::Divide; break;
+            default: kind = Profile::Power; break;
+        }
+        size_t left = statisticsHelper(binOpNode->left.get(), depth + 1, stats, subtrees, names);
+        size_t right = statisticsHelper(binOpNode->right.get(), depth + 1, stats, subtrees, names);
+        signature << binOpNode->operation << left << "," << right;
+    }
+    else if (auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
+        stats.functions++;
+        switch (static_cast<Function>(funcNode->id)) {
+            case Function::Sin: kind = Profile::Sin; break;
+            case Function::Cos: kind = Profile::Cos; break;
+            case Function::Ln: kind = Profile::Ln; break;
+            case Function::Exp: kind = Profile::Exp; break;
+            default: kind = Profile::Function; break;
+        }
+        signature << "f" << funcNode->id;
+        for (unsigned i = 0; i < funcNode->arity; i++)
+            signature << "," << statisticsHelper(funcNode->args[i].get(), depth + 1, stats, subtrees, names);
+    }
+    else if (auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
+        stats.unaryOperations++;
+        kind = Profile::Negate;
+        signature << "u" << unaryOpNode->operation
+                  << statisticsHelper(unaryOpNode->arg.get(), depth + 1, stats, subtrees, names);
+    }
+    else if (auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+        stats.naryOperations++;
+        kind = Profile::Sum;
+        links = sumNode->terms.size() - 1;
+        signature << "S";
+        for (const auto& [sign, term] : sumNode->terms)
+            signature << sign << statisticsHelper(term.get(), depth + 1, stats, subtrees, names);
+    }
+    else if (auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+        stats.naryOperations++;
+        kind = Profile::Product;
+        links = productNode->factors.size() - 1;
+        signature << "P";
+        for (const auto& factor : productNode->factors)
+            signature << "," << statisticsHelper(factor.get(), depth + 1, stats, subtrees, names);
+    }
+    else {
+        throw std::runtime_error("Unknown node type in statistics");
+    }
+
+    stats.estimatedCost += NODE_COST[isComplex<T>][kind] * links;
+    return subtrees.emplace(signature.str(), subtrees.size()).first->second;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Размер блока, выделенного под объект (на glibc — с учетом округления аллокатора).
+*/
+static size_t heapBlockSize(const void* memory, size_t requested) {
+
+#if defined(__GLIBC__)
+    return malloc_usable_size(const_cast<void*>(memory));
+#else
+    (void)memory;
+    return requested;
+#endif
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Буфер строки в куче (короткие строки хранятся внутри объекта и памяти не занимают).
+*/
+static void stringMemory(const std::string& str, size_t& requested, size_t& heap) {
+
+    static const size_t INLINE_CAPACITY = std::string().capacity();
+    if (str.capacity() > INLINE_CAPACITY) {
+        requested += str.capacity() + 1;
+        heap += heapBlockSize(str.data(), str.capacity() + 1);
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Буфер вектора (по емкости, а не по размеру).
+*/
+template <typename V>
+static void vectorMemory(const V& vec, size_t& requested, size_t& heap) {
+
+    if (vec.capacity() > 0) {
+        size_t size = vec.capacity() * sizeof(typename V::value_type);
+        requested += size;
+        heap += heapBlockSize(vec.data(), size);
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Тело функции учета памяти.
+*/
+template <typename T>
+void Expression<T>::memoryHelper(const Node* node, MemoryUsage& usage) {
+
+    if (!node) return;
+
+    usage.nodes++;
+    size_t size = 0;
+
+    if (dynamic_cast<const NumberNode*>(node)) {
+        size = sizeof(NumberNode);
+    }
+    else if (auto* varNode = dynamic_cast<const VariableNode*>(node)) {
+        size = sizeof(VariableNode);
+        stringMemory(varNode->name, usage.stringBytes, usage.heapBytes);
+    }
+    else if (auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node)) {
+        size = sizeof(BinaryOperationNode);
+        memoryHelper(binOpNode->left.get(), usage);
+        memoryHelper(binOpNode->right.get(), usage);
+    }
+    else if (auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
+        size = sizeof(FunctionNode);
+        for (unsigned i = 0; i < funcNode->arity; i++)
+            memoryHelper(funcNode->args[i].get(), usage);
+    }
+    else if (auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
+        size = sizeof(UnaryOperationNode);
+        memoryHelper(unaryOpNode->arg.get(), usage);
+    }
+    else if (auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+        size = sizeof(SumNode);
+        vectorMemory(sumNode->terms, usage.linkBytes, usage.heapBytes);
+        for (const auto& term : sumNode->terms)
+            memoryHelper(term.second.get(), usage);
+    }
+    else if (auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+        size = sizeof(ProductNode);
+        vectorMemory(productNode->factors, usage.linkBytes, usage.heapBytes);
+        for (const auto& factor : productNode->factors)
+            memoryHelper(factor.get(), usage);
+    }
+    else {
+        throw std::runtime_error("Unknown node type in memory usage");
+    }
+
+    usage.nodeBytes += size;
+    usage.heapBytes += heapBlockSize(node, size);
+}
+
+// --------------------------------------------------------------- //
+
 /*
 Копирование дерева.
 */
@@ -1023,25 +3886,74 @@ std::unique_ptr<typename Expression<T>::Node> Expression<T>::copyTree(const Node
         
         auto left = copyTree(binOpNode->left.get());
         auto right = copyTree(binOpNode->right.get());
-        return std::make_unique<BinaryOperationNode>
+        auto copy = std::make_unique<BinaryOperationNode>
             (binOpNode->operation, std::move(left), std::move(right));
+        copy->chain = binOpNode->chain;
+        copy->exponent = binOpNode->exponent;
+        return copy;
     }
     else if (auto* funcNode = dynamic_cast<const FunctionNode*>(node)) {
-        auto func_arg = copyTree(funcNode->arg.get());
+        auto func_arg = copyTree(funcNode->args[0].get());
         return std::make_unique<FunctionNode>
-            (funcNode->function, std::move(func_arg));
+            (funcNode->id, std::move(func_arg), funcNode->arity > 1 ? copyTree(funcNode->args[1].get()) : nullptr);
     }
     else if (auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node)) {
         auto arg = copyTree(unaryOpNode->arg.get());
         return std::make_unique<UnaryOperationNode>
             (unaryOpNode->operation, std::move(arg));
     }
+    else if (auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+        std::vector<SignedTerm> terms;
+        terms.reserve(sumNode->terms.size());
+        for (const auto& [sign, term] : sumNode->terms)
+            terms.emplace_back(sign, copyTree(term.get()));
+        return std::make_unique<SumNode>(std::move(terms));
+    }
+    else if (auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+        std::vector<std::unique_ptr<Node>> factors;
+        factors.reserve(productNode->factors.size());
+        for (const auto& factor : productNode->factors)
+            factors.push_back(copyTree(factor.get()));
+        return std::make_unique<ProductNode>(std::move(factors));
+    }
 
     throw std::runtime_error("Unknown node type in copy");
 }
 
 // --------------------------------------------------------------- //
 
+/*
+Подсчет узлов поддерева.
+*/
+template <typename T>
+size_t Expression<T>::countNodes(const Node* node) {
+
+    if (!node) return 0;
+
+    if (auto* binOpNode = dynamic_cast<const BinaryOperationNode*>(node))
+        return 1 + countNodes(binOpNode->left.get()) + countNodes(binOpNode->right.get());
+    else if (auto* funcNode = dynamic_cast<const FunctionNode*>(node))
+        return 1 + countNodes(funcNode->args[0].get()) + (funcNode->arity > 1 ? countNodes(funcNode->args[1].get()) : 0);
+    else if (auto* unaryOpNode = dynamic_cast<const UnaryOperationNode*>(node))
+        return 1 + countNodes(unaryOpNode->arg.get());
+    else if (auto* sumNode = dynamic_cast<const SumNode*>(node)) {
+        size_t count = 1;
+        for (const auto& term : sumNode->terms)
+            count += countNodes(term.second.get());
+        return count;
+    }
+    else if (auto* productNode = dynamic_cast<const ProductNode*>(node)) {
+        size_t count = 1;
+        for (const auto& factor : productNode->factors)
+            count += countNodes(factor.get());
+        return count;
+    }
+
+    return 1;
+}
+
+// --------------------------------------------------------------- //
+
 /*
 Конвертация числа в строку.
 Одновременно обрезает все конечные и ведущие нули.
@@ -1094,9 +4006,20 @@ std::complex<long double> Expression<T>::interpretComplex(const std::string& str
 // ЯВНАЯ ИНСТАНТИЗАЦИЯ (ПОТОМУ ЧТО В ТЗ ПОПРОСИЛИ РАЗДЕЛЯТЬ НА .HPP И .CPP)
 // ---------------------------------------------------------------------------------------------------- //
 
+template class Expression<float>;
+template class Expression<double>;
 template class Expression<long double>;
+template class Expression<std::complex<double>>;
 template class Expression<std::complex<long double>>;
 
+template float Expression<float>::callFunction(uint16_t, const float&, const float&);
+template double Expression<double>::callFunction(uint16_t, const double&, const double&);
+template long double Expression<long double>::callFunction(uint16_t, const long double&, const long double&);
+template std::complex<double> Expression<std::complex<double>>::callFunction(
+    uint16_t, const std::complex<double>&, const std::complex<double>&);
+template std::complex<long double> Expression<std::complex<long double>>::callFunction(
+    uint16_t, const std::complex<long double>&, const std::complex<long double>&);
+
 
 
 
@@ -1139,6 +4062,22 @@ void Expression<T>::BinaryOperationNode::print(int indent) const {
     right->print(indent + 2);
 }
 
+template <typename T>
+void Expression<T>::SumNode::print(int indent) const { 
+    std::cout << std::string(indent, ' ') << "Sum: " << terms.size() << " terms\n";
+    for (const auto& [sign, term] : terms) {
+        std::cout << std::string(indent + 2, ' ') << "Term: " << sign << "\n";
+        term->print(indent + 4);
+    }
+}
+
+template <typename T>
+void Expression<T>::ProductNode::print(int indent) const { 
+    std::cout << std::string(indent, ' ') << "Product: " << factors.size() << " factors\n";
+    for (const auto& factor : factors)
+        factor->print(indent + 2);
+}
+
 template <typename T>
 void Expression<T>::UnaryOperationNode::print(int indent) const {
     std::cout << std::string(indent, ' ') << "UnaryOp: " << operation << "\n";
@@ -1147,8 +4086,9 @@ void Expression<T>::UnaryOperationNode::print(int indent) const {
 
 template <typename T>
 void Expression<T>::FunctionNode::print(int indent) const { 
-    std::cout << std::string(indent, ' ') << "Function: " << function << "\n";
-    arg->print(indent + 2);
+    std::cout << std::string(indent, ' ') << "Function: " << functionName(id) << "\n";
+    for (unsigned i = 0; i < arity; i++)
+        args[i]->print(indent + 2);
 }
 
 template <typename T>
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <cctype>
@@ -13,6 +14,164 @@
 #include <complex>
 #include <type_traits>
 #include <sstream>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <deque>
+#include <shared_mutex>
+#include "Interval.hpp"
+#include "Functions.hpp"
+#include "FastMath.hpp"
+
+/*
+Признак комплексного типа и тип его вещественной части (для if constexpr в шаблонах).
+*/
+template <typename T> struct IsComplex : std::false_type { using Real = T; };
+template <typename T> struct IsComplex<std::complex<T>> : std::true_type { using Real = T; };
+template <typename T> inline constexpr bool isComplex = IsComplex<T>::value;
+template <typename T> using RealOf = typename IsComplex<T>::Real;
+
+/*
+Проверка области определения '^' для вещественных чисел: 
+корень четной степени из отрицательного числа запрещен.
+*/
+template <typename R>
+inline bool isEvenRootOfNegative(R base, R exponent) {
+
+    R intPart;
+    return std::abs(exponent) < 1 && std::modf(1 / std::abs(exponent), &intPart) == 0 && 
+           (int)(1 / std::abs(exponent)) % 2 == 0 && base < 0;
+}
+
+/*
+Вид показателя степени в узле '^'. Определяется один раз при построении узла по константному
+показателю (не зависящему от переменных) и выбирает способ вычисления:
+Integer — возведение в квадрат и умножения (|n| <= 16), SquareRoot — sqrt, CubeRoot — cbrt,
+OddRoot — p / q с нечетным q (только вещественные типы: корень нечетной степени из отрицательного
+числа вещественен), General — pow.
+*/
+struct ExponentClass {
+
+    enum Kind : uint8_t { General, Integer, SquareRoot, CubeRoot, OddRoot };
+
+    Kind kind = General;
+    long numerator = 0;     // Integer — показатель; CubeRoot и OddRoot — числитель p.
+    long denominator = 1;   // CubeRoot и OddRoot — нечетный знаменатель q.
+};
+
+/*
+x ^ n через возведение в квадрат (по битам n от младшего), для отрицательного n — 1 / x ^ |n|.
+x ^ 1 = x и x ^ 2 = x * x без лишних умножений на 1. Погрешность растет примерно как n округлений,
+поэтому используется только для небольших n.
+*/
+template <typename U>
+inline U integerPower(U base, long exponent) {
+
+    unsigned long bits = exponent < 0 ? -static_cast<unsigned long>(exponent) : exponent;
+    if (bits == 0)
+        return static_cast<U>(1);
+
+    for (; !(bits & 1); bits >>= 1)
+        base *= base;
+    U result = base;
+    while (bits >>= 1) {
+        base *= base;
+        if (bits & 1) result *= base;
+    }
+    return exponent < 0 ? static_cast<U>(1) / result : result;
+}
+
+/*
+|x| ^ (p / q) со знаком x для нечетного p (q нечетно): x ^ (1/3), x ^ (5/3) и т.п. для x < 0.
+*/
+template <typename R>
+inline R rationalPower(R base, R exponent, bool oddNumerator) {
+
+    R magnitude = std::pow(std::abs(base), exponent);
+    return oddNumerator && base < 0 ? -magnitude : magnitude;
+}
+
+/*
+base ^ exponent по виду показателя. Для Integer, SquareRoot и CubeRoot значение exponent
+не используется (его можно не вычислять). Проверка области определения — как у pow:
+корень четной степени из отрицательного числа запрещен.
+*/
+template <typename U>
+inline U raisePower(const U& base, const U& exponent, const ExponentClass& cls) {
+
+    if (cls.kind == ExponentClass::Integer)
+        return integerPower(base, cls.numerator);
+
+    if constexpr (std::is_floating_point_v<U>) {
+        switch (cls.kind) {
+            case ExponentClass::SquareRoot:
+                if (base < 0)
+                    throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+                return std::sqrt(base);
+            case ExponentClass::CubeRoot:
+                return std::cbrt(base);
+            case ExponentClass::OddRoot:
+                return rationalPower(base, exponent, cls.numerator % 2 != 0);
+            default:
+                if (isEvenRootOfNegative(base, exponent))
+                    throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+                return std::pow(base, exponent);
+        }
+    }
+    else {
+        if (cls.kind == ExponentClass::SquareRoot)
+            return std::sqrt(base);
+        return std::pow(base, exponent);
+    }
+}
+
+/*
+Ошибка разбора строки: код, смещение в байтах от начала строки и длина ошибочного фрагмента.
+Сообщение строится только по запросу, поэтому отказ на некорректной строке не выделяет память.
+*/
+struct ParseError {
+
+    enum Code : uint8_t {
+        None,
+        UnexpectedEnd,          // Строка закончилась там, где ожидался операнд.
+        UnexpectedToken,        // Вместо операнда оператор, ')' или посторонний символ.
+        ExpectedParenthesis,    // Нет закрывающей скобки.
+        UnknownFunction,        // За идентификатором, не являющимся функцией, следует '(' — "x(...)".
+        InvalidNumber,          // Число вида "1.2.3", "." или "2II".
+        TrailingInput,          // После полного выражения остались символы — "(a)(b)", "x y".
+        ArgumentCount           // Число аргументов не совпадает с арностью функции — "pow(x)", "sin(x, y)".
+    };
+
+    Code code = None;
+    size_t offset = 0;
+    size_t length = 0;
+
+    const char* description() const {
+
+        static const char* const DESCRIPTIONS[] = {
+            "No error", "Unexpected end of expression", "Unexpected token", "Expected ')'",
+            "Unknown function identifier", "Invalid number",
+            "Invalid expression", "Wrong number of function arguments"
+        };
+        return DESCRIPTIONS[code];
+    }
+
+    /*
+    Сообщение с фрагментом исходной строки: Unexpected token ')' at offset 4.
+    */
+    std::string toString(std::string_view source) const {
+
+        std::string message = description();
+        if (length > 0 && offset + length <= source.size())
+            message += " '" + std::string(source.substr(offset, length)) + "'";
+        return message + " at offset " + std::to_string(offset);
+    }
+};
+
+template <typename T> class Program;
+template <typename T> class Polynomial;
+template <typename T> class ParseResult;
+template <typename T> class LazyDerivative;
 
 template <typename T>
 class Expression {
@@ -46,6 +205,28 @@ public:
     Конструктор перемещения.
     */
     Expression(Expression<T>&& other) noexcept;
+
+    /*
+    Представление цепочек a + b - c + ... и a * b * c * ... при разборе. Binary — цепочка бинарных 
+    узлов глубины n; Nary — один узел суммы (произведения) с n потомками: меньше узлов и памяти, 
+    производная произведения k множителей — сумма k слагаемых вместо вложенных пар. Значения 
+    совпадают точно (звенья считаются в том же порядке). '/' и '^' остаются бинарными.
+    */
+    enum class Chains { Binary, Nary };
+
+    /*
+    Разбор строки без исключений: выражение или ошибка с кодом и смещением. 
+    Конструктор из строки — то же самое (в режиме Chains::Binary), но при ошибке бросает std::runtime_error.
+    */
+    static ParseResult<T> parse(std::string_view, Chains = Chains::Binary);
+
+    /*
+    Параллельный разбор очень длинной строки (суммы многих слагаемых): строка режется по '+' и '-' 
+    верхнего уровня на куски, куски разбираются на threads потоках (0 — по числу аппаратных), 
+    слагаемые соединяются сбалансированным деревом вместо цепочки. Значение то же, что у parse, 
+    с точностью до порядка сложения; при ошибке — та же ошибка, что у parse.
+    */
+    static ParseResult<T> parseParallel(std::string_view, unsigned threads = 0);
     
     // ---------------------------------------------------------------------------------------------------- //
     // ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
@@ -66,6 +247,38 @@ public:
     */
     T evaluate() const;
 
+    /*
+    Вычислить значение выражения при заданных значениях переменных (дерево не изменяется).
+    accuracy — точность sin, cos, exp и ln (см. FastMath.hpp); у комплексных выражений 
+    функции всегда точные.
+    */
+    T evaluate(const std::unordered_map<std::string, T>&, Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Вычислить значение выражения в смешанной точности: узлы считаются в double,
+    а плохо обусловленные (сокращение разрядов, большие показатели степени и т.п.)
+    пересчитываются в long double.
+    */
+    T evaluateMixed() const;
+
+    /*
+    Пакетное вычисление выражения: каждой переменной сопоставлен столбец значений 
+    (все столбцы одной длины), результат — столбец значений выражения. accuracy — как у evaluate.
+    */
+    std::vector<T> evaluateBatch(const std::unordered_map<std::string, std::vector<T>>&, 
+                                 Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Интервальное вычисление: каждой переменной сопоставлен отрезок [lo, hi], результат — отрезок, 
+    гарантированно содержащий все значения выражения (только для вещественных типов).
+    */
+    Interval<RealOf<T>> evaluateInterval(const std::unordered_map<std::string, Interval<RealOf<T>>>&) const;
+
+    /*
+    Количество узлов в дереве.
+    */
+    size_t nodeCount() const;
+
     /*
     Продифференцировать по переменной.
     */
@@ -76,6 +289,239 @@ public:
     */
     void debugAST() const;
 
+    // ---------------------------------------------------------------------------------------------------- //
+    // СТАТИСТИКА И ПРОФИЛИРОВАНИЕ
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Статический состав дерева.
+    */
+    struct Statistics {
+
+        size_t nodes = 0;
+        size_t numbers = 0;
+        size_t variables = 0;           // Узлов-переменных (с повторами).
+        size_t binaryOperations = 0;
+        size_t unaryOperations = 0;
+        size_t naryOperations = 0;      // Узлов n-арных сумм и произведений.
+        size_t functions = 0;
+        size_t depth = 0;               // Глубина дерева (у листа 0).
+        size_t uniqueSubtrees = 0;      // Различных поддеревьев (одинаковые считаются один раз).
+        size_t distinctVariables = 0;   // Различных имен переменных.
+        double estimatedCost = 0;       // Оценка стоимости одного вычисления в условных тактах.
+
+        std::string toString() const;
+    };
+
+    /*
+    Профиль вычисления: для каждого вида узла — число вызовов и собственное время (без потомков),
+    из которого отдельно выделено время внутри sin, cos, exp, log и pow. Время — в тактах rdtsc
+    на x86 и в наносекундах steady_clock на остальных платформах. Профиль накапливается
+    при повторных вызовах evaluateProfiled.
+    */
+    struct Profile {
+
+        enum Kind { Number, Variable, Add, Subtract, Multiply, Divide, Power, Negate, Sin, Cos, Ln, Exp, Sum, Product, 
+                    Function, KINDS }; // Function — остальные встроенные и пользовательские функции.
+
+        struct Counter {
+
+            size_t calls = 0;
+            uint64_t ticks = 0;         // Собственное время узлов этого вида.
+            uint64_t mathTicks = 0;     // Из него — время в библиотечной функции.
+        };
+
+        std::array<Counter, KINDS> counters{};
+        size_t evaluations = 0;
+        uint64_t totalTicks = 0;        // Полное время всех вычислений.
+        uint64_t lastTicks = 0;         // Полное время последнего вычисленного узла (служебное).
+
+        static const char* kindName(size_t kind);
+        static const char* tickUnit();
+        std::string toString() const;
+    };
+
+    /*
+    Статистика дерева.
+    */
+    Statistics statistics() const;
+
+    /*
+    Вычисление с профилированием. Обычный evaluate() собирается из того же шаблона с выключенными
+    замерами, поэтому профилирование не замедляет его.
+    */
+    T evaluateProfiled(Profile&) const;
+    T evaluateProfiled(Profile&, const std::unordered_map<std::string, T>&) const;
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // УЧЕТ ПАМЯТИ
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Память, которую занимает выражение. Запрошенные байты — размеры объектов узлов, буферов строк
+    (имена переменных длиннее встроенного буфера std::string) и массивов потомков n-арных
+    узлов (по их емкости). Фактические байты — размеры блоков, выданных аллокатором 
+    (malloc_usable_size на glibc, иначе равны запрошенным).
+    */
+    struct MemoryUsage {
+
+        size_t nodes = 0;
+        size_t nodeBytes = 0;       // Объекты узлов.
+        size_t stringBytes = 0;     // Буферы строк в VariableNode.
+        size_t linkBytes = 0;       // Массивы потомков в SumNode и ProductNode.
+        size_t objectBytes = 0;     // Сам объект Expression.
+        size_t heapBytes = 0;       // Фактически выделено аллокатором под узлы, строки и массивы.
+
+        size_t bytes() const { return objectBytes + nodeBytes + stringBytes + linkBytes; }
+        std::string toString() const;
+    };
+
+    /*
+    Выделения памяти, сделанные одной операцией.
+    */
+    struct OperationAllocations {
+
+        std::string operation;
+        size_t allocations = 0;
+        size_t bytes = 0;
+    };
+
+    /*
+    Память, занимаемая выражением.
+    */
+    MemoryUsage memoryUsage() const;
+
+    /*
+    Выделения памяти каждой операцией над выражением formula: токенизация, разбор, копирование, 
+    подстановка subs, дифференцирование по var (если var не пусто) и печать в строку. 
+    Считаются через AllocCounter, поэтому другие потоки не должны выделять память во время замера.
+    */
+    static std::vector<OperationAllocations> 
+    allocationStatistics(const char* formula, const std::string& subs, const std::string& var);
+
+    static std::string allocationsToString(const std::vector<OperationAllocations>&);
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // ЧАСТИЧНОЕ ВЫЧИСЛЕНИЕ
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Отчет о специализации: сколько узлов и условной работы (Statistics::estimatedCost) осталось.
+    */
+    struct Specialization {
+
+        size_t nodes = 0;           // Узлов в исходном дереве.
+        size_t remainingNodes = 0;  // Узлов в специализированном дереве.
+        size_t foldedSubtrees = 0;  // Поддеревьев, замененных числом.
+        double cost = 0;            // Оценка стоимости одного вычисления до специализации.
+        double remainingCost = 0;   // И после нее.
+
+        /*
+        Доля работы, которую больше не нужно делать при каждом вычислении.
+        */
+        double eliminatedFraction() const;
+        std::string toString() const;
+    };
+
+    /*
+    Специализация по части переменных: каждое наибольшее поддерево, зависящее только от переменных
+    из bindings (например, sin(t + 1)), вычисляется один раз и заменяется числом, остальные вхождения
+    этих переменных тоже заменяются числами. Результат зависит только от свободных переменных, 
+    его значения совпадают с evaluate исходного выражения (с точностью до знака нулевых частей
+    комплексных чисел); для многократного вычисления 
+    его можно скомпилировать в Program. Поддерево, вычисление которого бросает исключение 
+    (например, ln(-1)), не сворачивается, и исключение бросит evaluate результата.
+    */
+    Expression<T> specialize(const std::unordered_map<std::string, T>& bindings, Specialization* report = nullptr) const;
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // ПЕРЕСТРОЙКА АССОЦИАТИВНЫХ ЦЕПОЧЕК
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Режимы rebalance (объединяются через |). KeepNotation — toString печатает перестроенные цепочки 
+    так же, как исходные: ((a + b) - c) + ... CompensatedSum — evaluate складывает цепочки '+' и '-'
+    с компенсацией погрешности (алгоритм Ноймайера); пакетное вычисление и Program считают
+    сбалансированное дерево как есть (это попарное суммирование).
+    */
+    enum Rebalance : unsigned { KeepNotation = 1, CompensatedSum = 2 };
+
+    /*
+    Копия, в которой длинные цепочки a + b - c + ... и a * b / c * ... (от 8 звеньев) 
+    перестроены в сбалансированные деревья: глубина log n вместо n, независимые половины считаются 
+    параллельно на уровне команд процессора. Значение то же с точностью до порядка операций.
+    */
+    Expression<T> rebalance(unsigned mode = 0) const;
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // СТРУКТУРНОЕ СРАВНЕНИЕ
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Структурный хэш: хранится в каждом узле и считается при его построении из хэшей потомков, 
+    поэтому чтение не обходит дерево. У одинаковых деревьев хэши равны; флаги перестроенных 
+    цепочек не учитываются.
+    */
+    size_t hash() const;
+
+    /*
+    Структурное равенство: те же узлы с теми же операциями, числами и именами. Разные хэши 
+    отвечают сразу, поддеревья с разными хэшами не обходятся; равные деревья сравниваются целиком.
+    В отличие от сравнения toString, ничего не печатается и не выделяется.
+    */
+    bool operator==(const Expression<T>&) const;
+    bool operator!=(const Expression<T>&) const;
+
+    /*
+    Каноническая копия: звенья цепочек a + b - c + ... и a * b / c * ..., слагаемые и множители 
+    n-арных узлов и аргументы min и max упорядочены по хэшу (сначала звенья со знаком '+' или '*'), 
+    поэтому x*y и y*x, a + b - c и -c + b + a дают одно и то же дерево и хэш. Цепочки строятся 
+    заново по левым потомкам. Значение то же с точностью до порядка операций.
+    */
+    Expression<T> canonicalize() const;
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // БИБЛИОТЕКА ФУНКЦИЙ
+    // ---------------------------------------------------------------------------------------------------- //
+
+    /*
+    Пользовательская функция. scalar — значение по массиву из arity аргументов; batch — пакетное 
+    значение: args[k][i] — i-й элемент столбца k-го аргумента, результат записывается в result
+    (не пересекается с args); если batch пуст, столбец считается поэлементно через scalar.
+    partials — частные производные по каждому аргументу, выраженные через выражения-аргументы 
+    (производная вызова строится по цепному правилу). Ядра должны быть чистыми функциями: 
+    Program сворачивает вызовы от констант.
+    */
+    struct FunctionDefinition {
+
+        std::string name;
+        unsigned arity = 1;     // 1 или 2.
+        std::function<T(const T* args)> scalar;
+        std::function<void(const T* const* args, size_t n, T* result)> batch;
+        std::function<std::vector<Expression<T>>(const std::vector<Expression<T>>& args)> partials;
+    };
+
+    /*
+    Регистрация функции для выражений типа T: после нее имя разбирается как вызов функции 
+    с arity аргументами через запятую. Возвращает номер функции. Имя — идентификатор 
+    (буквы и цифры, приводится к нижнему регистру), не совпадающий с уже известной функцией; 
+    иначе бросается std::runtime_error. Реестр защищен shared_mutex: регистрировать можно 
+    во время разбора и вычисления в других потоках.
+    */
+    static uint16_t registerFunction(FunctionDefinition);
+
+    /*
+    Снятие регистрации: имя перестает разбираться как функция и может быть зарегистрировано 
+    заново. Определение и номер остаются за уже построенными выражениями и Program, поэтому 
+    они продолжают вызывать прежнее ядро. Для встроенных и неизвестных имен — std::runtime_error.
+    */
+    static void unregisterFunction(const std::string& name);
+
+    /*
+    Выражение-вызов функции name (встроенной или зарегистрированной) от выражений args.
+    */
+    static Expression<T> call(const std::string& name, std::vector<Expression<T>> args);
+
     // ---------------------------------------------------------------------------------------------------- //
     // ОПЕРАТОРЫ ДЛЯ ТИПА EXPRESSION
     // ---------------------------------------------------------------------------------------------------- //
@@ -91,6 +537,11 @@ public:
 
 private:
 
+    template <typename> friend class Program; // Компилирует AST в последовательность инструкций.
+    template <typename> friend class Polynomial; // Переводит AST в многочлен и обратно.
+    template <typename> friend class LazyDerivative; // Считает производные обходом AST.
+    template <typename> friend class ExpressionGenerator; // Узнает число аргументов функций по имени.
+
     // ---------------------------------------------------------------------------------------------------- //
     // AST (АБСТРАКТНОЕ СИНТАКСИЧЕСКОЕ ДЕРЕВО)
     // ---------------------------------------------------------------------------------------------------- //
@@ -100,6 +551,7 @@ private:
     */
     struct Node {
 
+        size_t hash = 0; // Структурный хэш поддерева (rehash узла — из хэшей его потомков).
         virtual ~Node() = default;
         virtual std::string nodeToString() const = 0;
         virtual void print(int indent = 0) const = 0; // Для дебага.
@@ -111,7 +563,8 @@ private:
     struct NumberNode : Node {
 
         T value;
-        NumberNode(T value) : value{value} {}
+        NumberNode(T value) : value{value} { rehash(); }
+        void rehash();
         std::string nodeToString() const override;
         void print(int) const override; // Для дебага.
     };
@@ -122,11 +575,19 @@ private:
     struct VariableNode : Node {
 
         std::string name;
-        VariableNode(const std::string& name) : name{name} {}
+        VariableNode(const std::string& name) : name{name} { rehash(); }
+        void rehash();
         std::string nodeToString() const override;
         void print(int) const override; // Для дебага.
     };
 
+    /*
+    Флаги узла перестроенной цепочки: ChainNode — узел цепочки, ChainRoot — ее корень (дальше вверх 
+    цепочка не продолжается), ChainNotation — печатать цепочку в исходном виде, ChainCompensated — 
+    складывать с компенсацией.
+    */
+    enum ChainFlag : uint8_t { ChainNode = 1, ChainRoot = 2, ChainNotation = 4, ChainCompensated = 8 };
+
     /*
     Узел для бинарных операций.
     */
@@ -135,8 +596,11 @@ private:
         char operation;
         std::unique_ptr<Node> left;
         std::unique_ptr<Node> right;
+        uint8_t chain = 0;      // Флаги ChainFlag, если узел построен rebalance или parseParallel.
+        ExponentClass exponent; // Для '^': вид показателя right (задает powerNode, копии переносят).
         BinaryOperationNode(char operation, std::unique_ptr<Node> left, std::unique_ptr<Node> right) 
-            : operation{operation}, left{std::move(left)}, right{std::move(right)} {}
+            : operation{operation}, left{std::move(left)}, right{std::move(right)} { rehash(); }
+        void rehash();
         std::string nodeToString() const override;
         void print(int) const override; // Для дебага.
     };
@@ -149,24 +613,74 @@ private:
         char operation;
         std::unique_ptr<Node> arg;
         UnaryOperationNode(char operation, std::unique_ptr<Node> operand) 
-            : operation{operation}, arg{std::move(operand)} {}
+            : operation{operation}, arg{std::move(operand)} { rehash(); }
+        void rehash();
         std::string nodeToString() const override;
         void print(int) const override; // Для дебага.
     };
 
     /*
-    Узел для функций.
+    Узел для функций: номер функции (Function или пользовательской) и аргументы args[0, arity).
     */
     struct FunctionNode : Node { 
 
-        std::string function;
-        std::unique_ptr<Node> arg;
-        FunctionNode(const std::string& function, std::unique_ptr<Node> arg) 
-            : function{function}, arg{std::move(arg)} {}
+        static constexpr unsigned MAX_ARITY = 2;
+
+        uint16_t id;
+        uint8_t arity;
+        std::array<std::unique_ptr<Node>, MAX_ARITY> args;
+        FunctionNode(uint16_t id, std::unique_ptr<Node> arg, std::unique_ptr<Node> second = nullptr) 
+            : id{id}, arity{static_cast<uint8_t>(second ? 2 : 1)}, args{std::move(arg), std::move(second)} { rehash(); }
+        FunctionNode(Function function, std::unique_ptr<Node> arg, std::unique_ptr<Node> second = nullptr) 
+            : FunctionNode(static_cast<uint16_t>(function), std::move(arg), std::move(second)) {}
+        void rehash();
+        std::string nodeToString() const override;
+        void print(int) const override; // Для дебага.
+    };
+
+    /*
+    Слагаемое со знаком перед ним ('+' или '-'); в цепочке умножений — множитель и '*' или '/'.
+    */
+    using SignedTerm = std::pair<char, std::unique_ptr<Node>>;
+
+    /*
+    Узел n-арной суммы t0 + t1 - t2 + ...: слагаемые со знаками, у первого всегда '+'.
+    Считается слева направо, как цепочка бинарных узлов.
+    */
+    struct SumNode : Node {
+
+        std::vector<SignedTerm> terms;
+        SumNode(std::vector<SignedTerm> terms) : terms{std::move(terms)} { rehash(); }
+        void rehash();
+        void append(char sign, std::unique_ptr<Node> term); // Звено в конец (хэш дополняется, а не пересчитывается).
         std::string nodeToString() const override;
         void print(int) const override; // Для дебага.
     };
 
+    /*
+    Узел n-арного произведения f0 * f1 * f2 * ... (слева направо).
+    */
+    struct ProductNode : Node {
+
+        std::vector<std::unique_ptr<Node>> factors;
+        ProductNode(std::vector<std::unique_ptr<Node>> factors) : factors{std::move(factors)} { rehash(); }
+        void rehash();
+        void append(std::unique_ptr<Node> factor);
+        std::string nodeToString() const override;
+        void print(int) const override; // Для дебага.
+    };
+
+    /*
+    Столбец значений для пакетного вычисления. 
+    Вещественные и мнимые части хранятся в отдельных массивах, чтобы циклы по ним векторизовались
+    (для вещественного T массив im пуст).
+    */
+    struct Batch {
+
+        std::vector<RealOf<T>> re;
+        std::vector<RealOf<T>> im;
+    };
+
     /*
     Корень АСТ-дерева.
     */
@@ -177,61 +691,239 @@ private:
     // ---------------------------------------------------------------------------------------------------- //
 
     /*
-    Токенизация выражения для последующего парсинга.
+    Лексема: вид, символ оператора, смещение и длина в исходной строке (текст не копируется).
+    Неявное умножение ("2x", "3sin(x)") — оператор '*' нулевой длины.
+    */
+    struct Token {
+
+        enum Kind : uint8_t { End, Number, Identifier, Operator, Open, Close, Comma, Other };
+
+        Kind kind = End;
+        char symbol = 0;
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    /*
+    Состояние разбора: строка, позиция за текущей лексемой, текущая лексема, первая ошибка 
+    и режим Chains::Nary.
+    */
+    struct Cursor {
+
+        std::string_view source;
+        size_t pos = 0;
+        Token token;
+        ParseError error;
+        bool nary = false;
+    };
+
+    /*
+    Токенизация выражения для последующего парсинга (лексемы — строки; используется subsVar).
     */
     std::vector<std::string> tokenize(const std::string&);
 
+    /*
+    Следующая лексема строки.
+    */
+    static void nextToken(Cursor&);
+
     // ---------------------------------------------------------------------------------------------------- //
     // ПЕРВЫЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ ОПЕРАЦИЙ В СООТВЕТСВИИ С PEMDAS)
     // ---------------------------------------------------------------------------------------------------- //
 
     /*
-    Сложение и вычитание.
+    Разбор всей строки за один проход: корень дерева или nullptr и заполненная ошибка.
     */
-    std::unique_ptr<Node> parseExpression(const std::vector<std::string>&, size_t&);
+    static std::unique_ptr<Node> parseRoot(std::string_view, ParseError&, Chains = Chains::Binary);
 
     /*
-    Умножение и деление.
+    Бинарные операции с приоритетом не ниже minPrecedence (приоритеты — в таблице BINARY_OPERATORS).
+    В режиме Chains::Nary звенья '+', '-' и '*' добавляются в SumNode или ProductNode.
     */
-    std::unique_ptr<Node> parseTerm(const std::vector<std::string>&, size_t&);
+    static std::unique_ptr<Node> parseBinary(Cursor&, int minPrecedence);
 
     /*
-    Возведение в степень.
+    Операнд: унарный минус, скобки, число, переменная или функция.
     */
-    std::unique_ptr<Node> parseExponent(const std::vector<std::string>&, size_t&);
+    static std::unique_ptr<Node> parseOperand(Cursor&);
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // ВТОРОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ АТОМАРНЫХ ЭЛЕМЕНТОВ)
+    // ---------------------------------------------------------------------------------------------------- //
 
     /*
-    Скобки.
+    Числа.
     */
-    std::unique_ptr<Node> parseFactor(const std::vector<std::string>&, size_t&);
+    static std::unique_ptr<Node> parseNumber(Cursor&);
+
+    /*
+    Переменные и функции.
+    */
+    static std::unique_ptr<Node> parseIdentifier(Cursor&);
+
+    /*
+    Ошибка разбора в текущей лексеме (всегда nullptr).
+    */
+    static std::unique_ptr<Node> fail(Cursor&, ParseError::Code);
 
     // ---------------------------------------------------------------------------------------------------- //
-    // ВТОРОЙ ЭТАП ПАРСИНГА СТРОКИ В ВЫРАЖЕНИЕ (НА УРОВНЕ АТОМАРНЫХ ЭЛЕМЕНТОВ)
+    // ПАРАЛЛЕЛЬНЫЙ РАЗБОР
     // ---------------------------------------------------------------------------------------------------- //
 
     /*
-    Числа.
+    Кусок строки как сумма слагаемых: сбалансированное дерево со знаком или nullptr при ошибке.
     */
-    std::unique_ptr<Node> parseNumber(const std::vector<std::string>&, size_t&);
+    static SignedTerm parseTerms(std::string_view, char sign);
+
+    /*
+    Сбалансированное соединение звеньев [begin, end) цепочки '+'/'-' или '*'/'/': знак результата и 
+    дерево, узлы которого помечены флагами chain. Знак звена — операция перед ним.
+    */
+    static SignedTerm joinTerms(std::vector<SignedTerm>&, size_t begin, size_t end, uint8_t chain = 0);
+
+    // ---------------------------------------------------------------------------------------------------- //
+    // ПЕРЕСТРОЙКА АССОЦИАТИВНЫХ ЦЕПОЧЕК
+    // ---------------------------------------------------------------------------------------------------- //
 
     /*
-    Переменные.
+    Звенья цепочки с корнем node по порядку: (отрицательное ли звено — после '-' или '/', поддерево).
+    Обычная цепочка идет по левым потомкам (как ее строит разбор), перестроенная — по помеченным узлам.
     */
-    std::unique_ptr<Node> parseVariable(const std::vector<std::string>&, size_t&);
+    static void collectChain(const Node*, std::vector<std::pair<bool, const Node*>>&);
 
     /*
-    Функции.
+    Тело rebalance.
     */
-    std::unique_ptr<Node> parseFunction(const std::vector<std::string>&, size_t&);
+    std::unique_ptr<Node> rebalanceHelper(const Node*, unsigned mode) const;
 
     // ---------------------------------------------------------------------------------------------------- //
     // ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
     // ---------------------------------------------------------------------------------------------------- //
 
+    /*
+    Реестр функций типа T: номера по именам (встроенных, "pow" и пользовательских) и определения 
+    пользовательских функций (номер минус Function::BUILTINS). Имя ищется только при разборе.
+    Определения не удаляются и в deque не перемещаются, поэтому ссылка на определение, 
+    полученная под mutex, остается верной и после него.
+    */
+    struct FunctionRegistry {
+
+        std::unordered_map<std::string, uint16_t> ids;
+        std::deque<FunctionDefinition> definitions;
+        std::shared_mutex mutex;
+    };
+
+    static FunctionRegistry& functionRegistry();
+
+    /*
+    Номер "pow" в реестре: вызов pow(a, b) разбирается в узел a ^ b.
+    UNKNOWN_FUNCTION — результат functionId для имени, которого нет в реестре.
+    */
+    static constexpr uint16_t POW_ALIAS = UINT16_MAX;
+    static constexpr uint16_t UNKNOWN_FUNCTION = UINT16_MAX - 1;
+
+    /*
+    Номер функции по имени (в нижнем регистре) и определение пользовательской функции по номеру.
+    */
+    static uint16_t functionId(const std::string& name);
+    static const FunctionDefinition& functionDefinition(uint16_t id);
+
+    /*
+    Имя и число аргументов функции по номеру.
+    */
+    static const std::string& functionName(uint16_t id);
+    static unsigned functionArity(uint16_t id);
+
+    /*
+    Значение функции с номером id в типе U: встроенные — applyFunction, пользовательские — 
+    их ядро scalar (в типе T; для отрезков не определены).
+    */
+    template <typename U>
+    static U callFunction(uint16_t id, const U& first, const U& second);
+
     /*
     Вычисление значения выражения (основное тело).
+    Параметр шаблона — тип, в котором ведутся вычисления (по умолчанию T, но также 
+    другая точность или Interval). Значения переменных берутся из словаря, если он передан.
+    При Profiled = true время и число вызовов узлов записываются в profile, иначе замеры
+    отбрасываются при компиляции. accuracy учитывается только для вещественного U.
+    */
+    template <typename U = T, bool Profiled = false>
+    U evaluateHelper(const Node*, const std::unordered_map<std::string, U>* vars = nullptr, 
+                     Profile* profile = nullptr, Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Вид показателя степени: константный показатель (без переменных) вычисляется и сравнивается
+    с целыми числами и дробями p / q; показатель с переменными — General.
+    */
+    static ExponentClass classifyExponent(const Node*);
+
+    /*
+    Узел base ^ exponent с видом показателя. Вид определяется только здесь — при разборе и сборке
+    выражения из частей, — а копии узла (copyTree, rebalance, specialize и т.д.) переносят его 
+    без повторного вычисления показателя.
+    */
+    static std::unique_ptr<Node> powerNode(std::unique_ptr<Node> base, std::unique_ptr<Node> exponent);
+
+    /*
+    Статистика поддерева (основное тело). Возвращает номер поддерева: одинаковые поддеревья
+    получают один номер (по сигнатуре «вид узла + номера потомков»).
+    */
+    size_t statisticsHelper(const Node*, size_t depth, Statistics&, 
+                            std::unordered_map<std::string, size_t>& subtrees,
+                            std::unordered_set<std::string>& names) const;
+
+    /*
+    Значение узла при вычислении в смешанной точности: fast — в double; если в поддереве есть
+    плохо обусловленный узел (widened), то и wide — значение узла в long double.
+    */
+    struct MixedValue {
+
+        std::conditional_t<isComplex<T>, std::complex<double>, double> fast;
+        std::conditional_t<isComplex<T>, std::complex<long double>, long double> wide = 0;
+        bool widened = false;
+    };
+
+    /*
+    Вычисление значения выражения в смешанной точности (основное тело).
+    */
+    MixedValue evaluateMixedHelper(const Node*) const;
+
+    /*
+    Пакетное вычисление выражения (основное тело).
+    */
+    Batch evaluateBatchHelper(const Node*, const std::unordered_map<std::string, Batch>&, size_t, 
+                              Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Узел с числом (в виде, который toString печатает и парсер читает обратно).
+    */
+    static std::unique_ptr<Node> valueNode(const T&);
+
+    /*
+    Структурное равенство поддеревьев (тело operator==).
+    */
+    static bool equalNodes(const Node*, const Node*);
+
+    /*
+    Каноническая копия поддерева (тело canonicalize).
+    */
+    std::unique_ptr<Node> canonicalHelper(const Node*) const;
+
+    /*
+    Специализация (основное тело). bound — зависит ли поддерево только от связанных переменных;
+    такое поддерево сворачивает его родитель (или specialize для корня), чтобы сворачивались
+    только наибольшие поддеревья.
     */
-    T evaluateHelper(const Node*) const;
+    std::unique_ptr<Node> specializeHelper(const Node*, const std::unordered_map<std::string, T>& bindings, 
+                                           bool& bound, size_t& folded) const;
+
+    /*
+    Свертка связанного поддерева node в число (copy — его копия с подставленными значениями,
+    она возвращается, если сворачивать нечего или вычисление бросило исключение).
+    */
+    std::unique_ptr<Node> foldSubtree(const Node* node, std::unique_ptr<Node> copy,
+                                      const std::unordered_map<std::string, T>& bindings, size_t& folded) const;
 
     /*
     Замена переменных в выражении (основное тело).
@@ -243,11 +935,21 @@ private:
     */
     std::unique_ptr<Node> differentiateHelper(const Node*, const std::string&) const;
 
+    /*
+    Память поддерева (основное тело).
+    */
+    static void memoryHelper(const Node*, MemoryUsage&);
+
     /*
     Копирование дерева.
     */
     std::unique_ptr<Node> copyTree(const Node*) const;
 
+    /*
+    Подсчет узлов поддерева.
+    */
+    static size_t countNodes(const Node*);
+
     /*
     Конвертация числа в строку.
     */
@@ -259,6 +961,56 @@ private:
     static std::complex<long double> interpretComplex(const std::string& str);
 };
 
+/*
+Результат разбора строки в духе std::expected: выражение или ошибка.
+*/
+template <typename T>
+class ParseResult {
+public:
+
+    ParseResult(Expression<T>&& expression) : expression(std::move(expression)) {}
+
+    ParseResult(const ParseError& error) : parseError(error) {}
+
+    bool hasValue() const { return parseError.code == ParseError::None; }
+
+    explicit operator bool() const { return hasValue(); }
+
+    /*
+    Выражение (при ошибке бросает std::runtime_error с ее описанием).
+    */
+    Expression<T>& value() {
+
+        if (!hasValue())
+            throw std::runtime_error(parseError.toString({}));
+        return expression;
+    }
+
+    /*
+    Ошибка (фрагмент строки в сообщении — error().toString(source)).
+    */
+    const ParseError& error() const { return parseError; }
+
+private:
+
+    Expression<T> expression;
+    ParseError parseError;
+};
+
+/*
+Хэш выражения для unordered_map и unordered_set (Expression::hash).
+*/
+namespace std {
+
+template <typename T>
+struct hash<Expression<T>> {
+
+    size_t operator()(const Expression<T>& expr) const { return expr.hash(); }
+};
+
+}
+
 std::ostream& operator<<(std::ostream&, const std::complex<long double>&);
+std::ostream& operator<<(std::ostream&, const std::complex<double>&);
 
 #endif
@@ -0,0 +1,435 @@
+#ifndef EXPR_FAST_MATH_HPP
+#define EXPR_FAST_MATH_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include "Functions.hpp"
+
+/*
+Точность sin, cos, exp и ln при вычислении выражений:
+Exact  — функции libm в типе вычисления (как раньше);
+Ulp    — многочлены fdlibm в double, ошибка 1–3 ulp double (для long double — в несколько
+         раз быстрее libm, точность double);
+Fast   — многочлены меньшей степени, относительная ошибка порядка 1e-7;
+Coarse — относительная ошибка порядка 1e-4.
+Приближения считаются в double; вне области приведения аргумента (|x| > 1e5 у sin и cos,
+переполнение и денормализованные числа у exp и ln, inf и NaN) вызывается libm в double.
+*/
+enum class Accuracy : uint8_t { Exact, Ulp, Fast, Coarse };
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯДРА ДЛЯ ОДНОГО ЧИСЛА
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Константы приведения: pi / 2 и ln 2 суммами частей по 33 бита (Коди — Уэйт), поэтому k * часть
+вычисляется точно. Сдвиг 1.5 * 2^52 округляет до целого без ветвлений и вызовов.
+*/
+struct FastMathConstants {
+
+    static constexpr double TWO_OVER_PI = 6.36619772367581382433e-01;
+    static constexpr double PIO2_1 = 1.57079632673412561417e+00;
+    static constexpr double PIO2_2 = 6.07710050630396597660e-11;
+    static constexpr double PIO2_2T = 2.02226624879595063154e-21; // pi / 2 - PIO2_1 - PIO2_2.
+    static constexpr double PIO2_3 = 2.02226624871116645580e-21;
+    static constexpr double PIO2_3T = 8.47842766036889956997e-32; // pi / 2 - PIO2_1 - PIO2_2 - PIO2_3.
+    static constexpr double INV_LN2 = 1.44269504088896338700e+00;
+    static constexpr double LN2_HI = 6.93147180369123816490e-01;
+    static constexpr double LN2_LO = 1.90821492927058770002e-10;
+    static constexpr double SHIFTER = 6755399441055744.0;
+    static constexpr double TRIG_LIMIT = 1e5;
+    static constexpr double EXP_LOW = -708.0;
+    static constexpr double EXP_HIGH = 709.0;
+    static constexpr double LOG_LOW = 2.2250738585072014e-308;
+    static constexpr double LOG_HIGH = 1.7976931348623157e308;
+};
+
+/*
+Попадает ли аргумент в область приведения (NaN — нет).
+*/
+inline bool approxInRange(Function function, double x) {
+
+    using C = FastMathConstants;
+    switch (function) {
+        case Function::Sin: case Function::Cos: return std::fabs(x) <= C::TRIG_LIMIT;
+        case Function::Exp: return (x >= C::EXP_LOW) & (x <= C::EXP_HIGH);
+        default: return (x >= C::LOG_LOW) & (x <= C::LOG_HIGH);
+    }
+}
+
+/*
+sin(r) и cos(r) при |r| <= pi / 4 (многочлены fdlibm __kernel_sin и __kernel_cos для Ulp,
+отрезки ряда Тейлора для Fast и Coarse).
+*/
+template <Accuracy A>
+inline double sinPolynomial(double r) {
+
+    double z = r * r;
+    if constexpr (A == Accuracy::Ulp) {
+        double tail = 8.33333333332248946124e-03 + z * (-1.98412698298579493134e-04 + z * (2.75573137070700676789e-06 +
+                      z * (-2.50507602534068634195e-08 + z * 1.58969099521155010221e-10)));
+        return r + z * r * (-1.66666666666666324348e-01 + z * tail);
+    }
+    else if constexpr (A == Accuracy::Fast) {
+        return r + z * r * (-1.0 / 6 + z * (1.0 / 120 + z * (-1.0 / 5040 + z * (1.0 / 362880))));
+    }
+    else {
+        return r + z * r * (-1.0 / 6 + z * (1.0 / 120));
+    }
+}
+
+template <Accuracy A>
+inline double cosPolynomial(double r) {
+
+    double z = r * r;
+    if constexpr (A == Accuracy::Ulp) {
+        double tail = z * (4.16666666666666019037e-02 + z * (-1.38888888888741095749e-03 + z * (2.48015872894767294178e-05 +
+                      z * (-2.75573143513906633035e-07 + z * (2.08757232129817482790e-09 + z * -1.13596475577881948265e-11)))));
+        double half = 0.5 * z;
+        double w = 1.0 - half;
+        return w + (((1.0 - w) - half) + z * tail);
+    }
+    else if constexpr (A == Accuracy::Fast) {
+        return 1.0 - 0.5 * z + z * z * (1.0 / 24 + z * (-1.0 / 720 + z * (1.0 / 40320)));
+    }
+    else {
+        return 1.0 - 0.5 * z + z * z * (1.0 / 24 + z * (-1.0 / 720));
+    }
+}
+
+/*
+Приведение при |x| <= TRIG_LIMIT: x = k pi / 2 + r, |r| <= pi / 4; возвращает четверть k.
+Около нулей sin и cos r много меньше x, и вычитания теряют старшие биты, поэтому их ошибки
+округления собираются точно (TwoSum вместо проверки сокращения в __ieee754_rem_pio2 fdlibm —
+без ветвлений). Ulp вычитает pi / 2 до PIO2_3T, Fast и Coarse — до PIO2_2T; абсолютная ошибка r
+не больше 1e-32, то есть меньше ulp(r) при всех |x| <= TRIG_LIMIT.
+*/
+template <Accuracy A>
+inline int trigReduce(double x, double& r) {
+
+    using C = FastMathConstants;
+    double k = (x * C::TWO_OVER_PI + C::SHIFTER) - C::SHIFTER;
+    double t = x - k * C::PIO2_1;
+
+    // s + e = t - k PIO2_2 точно (k PIO2_2 точно: 33 бита на 17).
+    double w = k * C::PIO2_2;
+    double s = t - w;
+    double sw = t - s;
+    double e = (t - (s + sw)) + (sw - w);
+
+    double tail;
+    if constexpr (A == Accuracy::Ulp) {
+        w = k * C::PIO2_3;
+        double s3 = s - w;
+        double sw3 = s - s3;
+        tail = (e + ((s - (s3 + sw3)) + (sw3 - w))) - k * C::PIO2_3T;
+        s = s3;
+    }
+    else {
+        tail = e - k * C::PIO2_2T;
+    }
+    r = s + tail;
+    return static_cast<int>(k);
+}
+
+/*
+sin(k pi / 2 + r) = ±sin(r) или ±cos(r) по четверти k. Выбор без ветвлений (умножением на 0 и 1), 
+чтобы циклы над массивами векторизовались.
+*/
+inline double quadrantValue(int quadrant, double sinR, double cosR) {
+
+    double odd = static_cast<double>(quadrant & 1);
+    return (sinR * (1 - odd) + cosR * odd) * static_cast<double>(1 - (quadrant & 2));
+}
+
+/*
+sin(x) (Cos = false) или cos(x) (Cos = true) при |x| <= TRIG_LIMIT; cos(x) = sin(x + pi / 2).
+*/
+template <Accuracy A, bool Cos>
+inline double trigCore(double x) {
+
+    double r;
+    int quadrant = trigReduce<A>(x, r) + (Cos ? 1 : 0);
+    return quadrantValue(quadrant, sinPolynomial<A>(r), cosPolynomial<A>(r));
+}
+
+/*
+sin(x) и cos(x) вместе: одно приведение и одна пара многочленов (trigCore считает их же, 
+но возвращает одно значение).
+*/
+template <Accuracy A>
+inline void sinCosCore(double x, double& sinX, double& cosX) {
+
+    double r;
+    int quadrant = trigReduce<A>(x, r);
+    double sinR = sinPolynomial<A>(r), cosR = cosPolynomial<A>(r);
+    sinX = quadrantValue(quadrant, sinR, cosR);
+    cosX = quadrantValue(quadrant + 1, sinR, cosR);
+}
+
+/*
+exp(x) при EXP_LOW <= x <= EXP_HIGH: x = k ln 2 + r, |r| <= ln 2 / 2, exp(x) = 2^k exp(r);
+2^k собирается из битов показателя целочисленными сдвигами и сложениями (преобразования
+double в int64 в SSE2 нет). Ulp — рациональное приближение fdlibm, Fast и Coarse — ряд Тейлора
+до r^7 и r^4.
+*/
+template <Accuracy A>
+inline double expCore(double x) {
+
+    using C = FastMathConstants;
+    double shifted = x * C::INV_LN2 + C::SHIFTER;
+    double k = shifted - C::SHIFTER;
+    double hi = x - k * C::LN2_HI;
+    double lo = k * C::LN2_LO;
+    double r = hi - lo;
+
+    double value;
+    if constexpr (A == Accuracy::Ulp) {
+        double t = r * r;
+        double c = r - t * (1.66666666666666019037e-01 + t * (-2.77777777770155933842e-03 + t * (6.61375632143793436117e-05 +
+                   t * (-1.65339022054652515390e-06 + t * 4.13813679705723846039e-08))));
+        value = 1.0 - ((lo - (r * c) / (2.0 - c)) - hi);
+    }
+    else if constexpr (A == Accuracy::Fast) {
+        value = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120 +
+                r * (1.0 / 720 + r * (1.0 / 5040)))))));
+    }
+    else {
+        value = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24))));
+    }
+
+    uint64_t bits; // Младшие биты shifted — k в дополнительном коде.
+    std::memcpy(&bits, &shifted, sizeof bits);
+    bits = (bits + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &bits, sizeof scale);
+    return value * scale;
+}
+
+/*
+ln(x) при нормализованном положительном x: x = 2^e m, sqrt(2) / 2 <= m < sqrt(2),
+ln(x) = e ln 2 + ln(m), ln(m) через s = (m - 1) / (m + 1). Ulp — многочлен fdlibm e_log,
+Fast и Coarse — ряд 2s (1 + s^2 / 3 + s^4 / 5 + ...) до s^7 и s^5.
+*/
+template <Accuracy A>
+inline double logCore(double x) {
+
+    using C = FastMathConstants;
+    // Сдвиг на биты sqrt(2) / 2 переносит мантиссы от sqrt(2) в следующий показатель (как в musl).
+    constexpr uint64_t HALF_SQRT2 = 0x3FE6A09E667F3BCDull;
+    uint64_t bits;
+    std::memcpy(&bits, &x, sizeof bits);
+    bits += 0x3FF0000000000000ull - HALF_SQRT2;
+
+    uint64_t exponent;
+    std::memcpy(&exponent, &C::SHIFTER, sizeof exponent);
+    exponent |= bits >> 52;
+    double e;
+    std::memcpy(&e, &exponent, sizeof e);
+    e -= C::SHIFTER + 1023; // Смещенный показатель, дописанный в младшие биты SHIFTER.
+
+    bits = (bits & 0x000FFFFFFFFFFFFFull) + HALF_SQRT2;
+    double m;
+    std::memcpy(&m, &bits, sizeof m);
+
+    double f = m - 1.0;
+    if constexpr (A == Accuracy::Ulp) {
+        double s = f / (2.0 + f);
+        double z = s * s;
+        double w = z * z;
+        double odd = w * (3.999999999940941908e-01 + w * (2.222219843214978396e-01 + w * 1.531383769920937332e-01));
+        double even = z * (6.666666666666735130e-01 + w * (2.857142874366239149e-01 + w * (1.818357216161805012e-01 +
+                      w * 1.479819860511658591e-01)));
+        double half = 0.5 * f * f;
+        return e * C::LN2_HI - ((half - (s * (half + odd + even) + e * C::LN2_LO)) - f);
+    }
+    else {
+        double s = f / (2.0 + f);
+        double z = s * s;
+        double series = A == Accuracy::Fast ? 1.0 + z * (1.0 / 3 + z * (1.0 / 5 + z * (1.0 / 7)))
+                                            : 1.0 + z * (1.0 / 3 + z * (1.0 / 5));
+        return e * C::LN2_HI + (2 * s * series + e * C::LN2_LO);
+    }
+}
+
+/*
+Приближение без проверки области приведения.
+*/
+template <Accuracy A>
+inline double approxCore(Function function, double x) {
+
+    switch (function) {
+        case Function::Sin: return trigCore<A, false>(x);
+        case Function::Cos: return trigCore<A, true>(x);
+        case Function::Exp: return expCore<A>(x);
+        default: return logCore<A>(x);
+    }
+}
+
+/*
+Значение sin, cos, exp или ln с точностью accuracy (не Exact). Область определения ln
+проверяет вызывающий.
+*/
+inline double approximate(Accuracy accuracy, Function function, double x) {
+
+    if (!approxInRange(function, x)) {
+        switch (function) {
+            case Function::Sin: return std::sin(x);
+            case Function::Cos: return std::cos(x);
+            case Function::Exp: return std::exp(x);
+            default: return std::log(x);
+        }
+    }
+    switch (accuracy) {
+        case Accuracy::Ulp: return approxCore<Accuracy::Ulp>(function, x);
+        case Accuracy::Fast: return approxCore<Accuracy::Fast>(function, x);
+        default: return approxCore<Accuracy::Coarse>(function, x);
+    }
+}
+
+/*
+sin(x) и cos(x) с точностью accuracy (не Exact).
+*/
+inline void approximateSinCos(Accuracy accuracy, double x, double& sinX, double& cosX) {
+
+    if (!approxInRange(Function::Sin, x)) {
+        sinX = std::sin(x);
+        cosX = std::cos(x);
+        return;
+    }
+    switch (accuracy) {
+        case Accuracy::Ulp: sinCosCore<Accuracy::Ulp>(x, sinX, cosX); break;
+        case Accuracy::Fast: sinCosCore<Accuracy::Fast>(x, sinX, cosX); break;
+        default: sinCosCore<Accuracy::Coarse>(x, sinX, cosX); break;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯДРА ДЛЯ МАССИВОВ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+a[i] = f(a[i]) блоками по FAST_MATH_BLOCK элементов. У внутреннего цикла постоянная длина и нет
+ветвлений, поэтому компилятор векторизует его уже при -O2; блок, в котором есть аргумент вне
+области приведения, и остаток массива считаются по одному числу.
+*/
+constexpr size_t FAST_MATH_BLOCK = 8;
+
+template <Accuracy A, Function F, typename R>
+inline void approxBlocks(R* __restrict a, size_t n) {
+
+    size_t blocks = n - n % FAST_MATH_BLOCK;
+    for (size_t i = 0; i < blocks; i += FAST_MATH_BLOCK) {
+
+        R* __restrict block = a + i;
+        int outside = 0;
+        for (size_t j = 0; j < FAST_MATH_BLOCK; j++)
+            outside += !approxInRange(F, static_cast<double>(block[j]));
+
+        if (outside) {
+            for (size_t j = 0; j < FAST_MATH_BLOCK; j++)
+                block[j] = static_cast<R>(approximate(A, F, static_cast<double>(block[j])));
+            continue;
+        }
+        for (size_t j = 0; j < FAST_MATH_BLOCK; j++)
+            block[j] = static_cast<R>(approxCore<A>(F, static_cast<double>(block[j])));
+    }
+    for (size_t i = blocks; i < n; i++)
+        a[i] = static_cast<R>(approximate(A, F, static_cast<double>(a[i])));
+}
+
+/*
+Пакетное sin, cos, exp или ln с точностью accuracy (не Exact).
+*/
+template <typename R>
+inline void approximateArray(Accuracy accuracy, Function function, R* a, size_t n) {
+
+    auto run = [&](auto tag) {
+        constexpr Accuracy A = decltype(tag)::value;
+        switch (function) {
+            case Function::Sin: approxBlocks<A, Function::Sin>(a, n); break;
+            case Function::Cos: approxBlocks<A, Function::Cos>(a, n); break;
+            case Function::Exp: approxBlocks<A, Function::Exp>(a, n); break;
+            default: approxBlocks<A, Function::Ln>(a, n); break;
+        }
+    };
+    switch (accuracy) {
+        case Accuracy::Ulp: run(std::integral_constant<Accuracy, Accuracy::Ulp>()); break;
+        case Accuracy::Fast: run(std::integral_constant<Accuracy, Accuracy::Fast>()); break;
+        default: run(std::integral_constant<Accuracy, Accuracy::Coarse>()); break;
+    }
+}
+
+/*
+sinX[i] = sin(x[i]), cosX[i] = cos(x[i]) блоками, как в approxBlocks.
+*/
+template <Accuracy A, typename R>
+inline void sinCosBlocks(const R* __restrict x, R* __restrict sinX, R* __restrict cosX, size_t n) {
+
+    size_t blocks = n - n % FAST_MATH_BLOCK;
+    for (size_t i = 0; i < blocks; i += FAST_MATH_BLOCK) {
+
+        int outside = 0;
+        for (size_t j = 0; j < FAST_MATH_BLOCK; j++)
+            outside += !approxInRange(Function::Sin, static_cast<double>(x[i + j]));
+
+        if (outside) {
+            for (size_t j = i; j < i + FAST_MATH_BLOCK; j++) {
+                double s, c;
+                approximateSinCos(A, static_cast<double>(x[j]), s, c);
+                sinX[j] = static_cast<R>(s);
+                cosX[j] = static_cast<R>(c);
+            }
+            continue;
+        }
+        for (size_t j = 0; j < FAST_MATH_BLOCK; j++) {
+            double s, c;
+            sinCosCore<A>(static_cast<double>(x[i + j]), s, c);
+            sinX[i + j] = static_cast<R>(s);
+            cosX[i + j] = static_cast<R>(c);
+        }
+    }
+    for (size_t i = blocks; i < n; i++) {
+        double s, c;
+        approximateSinCos(A, static_cast<double>(x[i]), s, c);
+        sinX[i] = static_cast<R>(s);
+        cosX[i] = static_cast<R>(c);
+    }
+}
+
+/*
+Пакетные sin и cos одного столбца с точностью accuracy (не Exact).
+*/
+template <typename R>
+inline void approximateSinCosArray(Accuracy accuracy, const R* x, R* sinX, R* cosX, size_t n) {
+
+    switch (accuracy) {
+        case Accuracy::Ulp: sinCosBlocks<Accuracy::Ulp>(x, sinX, cosX, n); break;
+        case Accuracy::Fast: sinCosBlocks<Accuracy::Fast>(x, sinX, cosX, n); break;
+        default: sinCosBlocks<Accuracy::Coarse>(x, sinX, cosX, n); break;
+    }
+}
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef EXPR_FUNCTIONS_HPP
+#define EXPR_FUNCTIONS_HPP
+
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "Interval.hpp"
+
+/*
+Встроенные функции выражений. Номер функции определяется при разборе и хранится в узле дерева
+(и в инструкции Program), поэтому при вычислении имя не ищется. Пользовательские функции
+(Expression<T>::registerFunction) получают номера, начиная с BUILTINS.
+pow(a, b) — запись a ^ b и отдельной функцией не является.
+*/
+enum class Function : uint16_t {
+    Sin, Cos, Ln, Exp, Tan, Sqrt, Abs, Sign, Atan, Sinh, Cosh, Tanh, Log10, Erf, Min, Max, BUILTINS
+};
+
+/*
+Имя и число аргументов встроенной функции.
+*/
+struct FunctionInfo {
+
+    const char* name;
+    unsigned arity;
+};
+
+inline const FunctionInfo& functionInfo(Function function) {
+
+    static const FunctionInfo INFO[] = {
+        {"sin", 1}, {"cos", 1}, {"ln", 1}, {"exp", 1}, {"tan", 1}, {"sqrt", 1}, {"abs", 1}, {"sign", 1},
+        {"atan", 1}, {"sinh", 1}, {"cosh", 1}, {"tanh", 1}, {"log10", 1}, {"erf", 1}, {"min", 2}, {"max", 2}
+    };
+    return INFO[static_cast<size_t>(function)];
+}
+
+/*
+Знак вещественного числа: -1, 0 или 1 (для NaN — 0). Без ветвлений, чтобы циклы векторизовались.
+*/
+template <typename R>
+inline R signOf(R x) {
+    return static_cast<R>((x > 0) - (x < 0));
+}
+
+/*
+Значение встроенной функции; second — второй аргумент min и max (у остальных не используется).
+Проверки области определения те же, что у ln и x ^ 0.5: ln, log10 от неположительного
+и sqrt от отрицательного вещественного числа запрещены. У комплексных чисел нет порядка и
+вещественной erf в std, поэтому min, max и erf для них — ошибка; sign(z) = z / |z|.
+*/
+template <typename U>
+inline U applyFunction(Function function, const U& first, const U& second) {
+
+    using std::sin, std::cos, std::log, std::exp, std::tan, std::sqrt, std::atan, std::sinh, std::cosh,
+          std::tanh, std::log10;
+    constexpr bool real = std::is_floating_point_v<U>;
+
+    auto checkPositive = [&](const char* message) {
+        if (first == static_cast<U>(0))
+            throw std::runtime_error(message);
+        if constexpr (real) {
+            if (first <= 0)
+                throw std::runtime_error(message);
+        }
+    };
+    auto notComplex = [&]() -> U {
+        throw std::runtime_error(std::string("Function ") + functionInfo(function).name +
+                                 " is not defined for complex arguments");
+    };
+
+    switch (function) {
+
+        case Function::Sin: return sin(first);
+
+        case Function::Cos: return cos(first);
+
+        case Function::Ln:
+            checkPositive("Argument of ln <= 0 is not allowed");
+            return log(first);
+
+        case Function::Exp: return exp(first);
+
+        case Function::Tan: return tan(first);
+
+        case Function::Sqrt:
+            if constexpr (real) {
+                if (first < 0)
+                    throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+            }
+            return sqrt(first);
+
+        case Function::Abs: return static_cast<U>(std::abs(first));
+
+        case Function::Sign:
+            if constexpr (real) {
+                return signOf(first);
+            }
+            else {
+                auto modulus = std::abs(first);
+                return modulus == 0 ? static_cast<U>(0) : first / modulus;
+            }
+
+        case Function::Atan: return atan(first);
+
+        case Function::Sinh: return sinh(first);
+
+        case Function::Cosh: return cosh(first);
+
+        case Function::Tanh: return tanh(first);
+
+        case Function::Log10:
+            checkPositive("Argument of log10 <= 0 is not allowed");
+            return log10(first);
+
+        case Function::Erf:
+            if constexpr (real) return std::erf(first);
+            else return notComplex();
+
+        case Function::Min:
+            if constexpr (real) return std::min(first, second);
+            else return notComplex();
+
+        case Function::Max:
+            if constexpr (real) return std::max(first, second);
+            else return notComplex();
+
+        default: throw std::runtime_error("Unknown function");
+    }
+}
+
+/*
+Интервальное значение встроенной функции (функции отрезков — в Interval.hpp).
+*/
+template <typename R>
+inline Interval<R> applyFunction(Function function, const Interval<R>& first, const Interval<R>& second) {
+
+    switch (function) {
+
+        case Function::Sin: return sin(first);
+        case Function::Cos: return cos(first);
+
+        case Function::Ln:
+            if (first == Interval<R>(0))
+                throw std::runtime_error("Argument of ln <= 0 is not allowed");
+            return log(first);
+
+        case Function::Exp: return exp(first);
+        case Function::Tan: return tan(first);
+        case Function::Sqrt: return sqrt(first);
+        case Function::Abs: return abs(first);
+        case Function::Sign: return sign(first);
+        case Function::Atan: return atan(first);
+        case Function::Sinh: return sinh(first);
+        case Function::Cosh: return cosh(first);
+        case Function::Tanh: return tanh(first);
+        case Function::Log10: return log10(first);
+        case Function::Erf: return erf(first);
+        case Function::Min: return {std::min(first.lo, second.lo), std::min(first.hi, second.hi)};
+        case Function::Max: return {std::max(first.lo, second.lo), std::max(first.hi, second.hi)};
+
+        default: throw std::runtime_error("Unknown function");
+    }
+}
+
+#endif
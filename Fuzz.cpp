@@ -0,0 +1,892 @@
+#include "Expression.hpp"
+#include "Generator.hpp"
+#include "Program.hpp"
+#include "ThreadPool.hpp"
+#include <optional>
+#include <limits>
+#include <iomanip>
+#include <map>
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПАРАМЕТРЫ ЗАПУСКА
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Параметры дифференциального тестирования. Случай номер k порождается генератором с зерном
+seed + k, поэтому любой случай воспроизводится отдельно (--case k) независимо от числа потоков.
+*/
+struct FuzzOptions {
+
+    size_t cases = 20000;
+    uint64_t seed = 1;
+    long replay = -1;            // Номер единственного запускаемого случая (-1 — все).
+    bool complex = false;        // complex<double> вместо double.
+    size_t points = 4;           // Точек на одно выражение.
+    double ulps = 64;            // Допустимое расхождение с эталоном, ULP.
+    unsigned threads = 0;
+    size_t reports = 5;          // Сколько расхождений упрощать и печатать.
+    size_t depth = 6;
+    size_t width = 4;
+    size_t variables = 2;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПРОВЕРКИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Сравнение эталонного вычисления (evaluate, т.е. evaluateHelper в типе T) с оптимизированными
+путями на случайных выражениях и их производных по x. Погрешность проверяемого пути измеряется
+относительно значения, вычисленного в long double, с допуском, учитывающим обусловленность
+(см. exactOf). Каждая проверка получает текст выражения и набор точек и возвращает описание
+расхождения, если оно найдено.
+*/
+template <typename T>
+class Fuzzer {
+public:
+
+    using Real = RealOf<T>;
+    using Wide = std::conditional_t<isComplex<T>, std::complex<long double>, long double>;
+    using Point = std::unordered_map<std::string, T>;
+
+    /*
+    Счетчики одной проверки.
+    */
+    struct CheckStatistics {
+
+        size_t compared = 0;     // Сравнено значений.
+        size_t failed = 0;       // Случаев с расхождением.
+        size_t singular = 0;     // Пропущено особых точек (см. intermediatesOf).
+        double worst = 0;        // Наибольшая доля допуска, занятая погрешностью.
+    };
+
+    /*
+    Найденное расхождение: проверка, случай и все, что нужно для его повторения.
+    */
+    struct Failure {
+
+        std::string check;
+        uint64_t index = 0;
+        GeneratedNode expression;
+        bool derivative = false;
+        std::vector<Point> points;
+        std::string detail;
+    };
+
+    /*
+    Итог обработки набора случаев.
+    */
+    struct Summary {
+
+        size_t cases = 0;
+        size_t points = 0;
+        size_t undefined = 0;    // Точек, где эталон не определен (вне области определения, переполнение).
+        std::map<std::string, CheckStatistics> checks;
+        std::vector<Failure> failures;
+    };
+
+    using Check = std::optional<std::string> (Fuzzer::*)(const GeneratedNode&, bool, const std::vector<Point>&,
+                                                         CheckStatistics*) const;
+
+    explicit Fuzzer(const FuzzOptions& options) : options{options} {
+
+        generatorOptions.maxDepth = options.depth;
+        generatorOptions.maxWidth = options.width;
+        generatorOptions.variables = options.variables;
+
+        checks.emplace_back("batch", &Fuzzer::checkBatch);
+        checks.emplace_back("mixed", &Fuzzer::checkMixed);
+        checks.emplace_back("program", &Fuzzer::checkProgram);
+        checks.emplace_back("program-O2", &Fuzzer::checkOptimized);
+        if constexpr (!isComplex<T>) {
+            checks.emplace_back("interval", &Fuzzer::checkInterval);
+            checks.emplace_back("derivative", &Fuzzer::checkDerivative);
+            checks.emplace_back("accuracy", &Fuzzer::checkAccuracy);
+        }
+    }
+
+    /*
+    Случаи [from, to): выражение, его производная по x и все проверки для каждого.
+    */
+    Summary run(uint64_t from, uint64_t to) const {
+
+        Summary summary;
+
+        for (uint64_t index = from; index < to; index++) {
+
+            ExpressionGenerator<T> generator(generatorOptions, options.seed + index);
+            GeneratedNode expression = generator.expression();
+            std::vector<Point> points;
+            for (size_t i = 0; i < options.points; i++)
+                points.push_back(generator.point());
+
+            summary.cases++;
+
+            for (bool derivative : {false, true}) {
+
+                std::string text = expression.toString();
+                try {
+                    build<T>(text, derivative);
+                }
+                catch (const std::runtime_error& error) {
+                    summary.checks["parse"].failed++;
+                    summary.failures.push_back({"parse", index, expression, derivative, points, error.what()});
+                    break;
+                }
+
+                for (const auto& point : points) {
+                    summary.points++;
+                    if (!reference(text, derivative, point))
+                        summary.undefined++;
+                }
+
+                for (const auto& [name, check] : checks) {
+                    CheckStatistics& statistics = summary.checks[name];
+                    if (auto detail = (this->*check)(expression, derivative, points, &statistics)) {
+                        statistics.failed++;
+                        summary.failures.push_back({name, index, expression, derivative, points, *detail});
+                    }
+                }
+            }
+        }
+
+        return summary;
+    }
+
+    /*
+    Упрощение расхождения до минимального выражения, на котором та же проверка все еще не проходит.
+    */
+    Failure shrink(const Failure& failure) const {
+
+        Check check = findCheck(failure.check);
+        auto fails = [&](const GeneratedNode& candidate) {
+            return (this->*check)(candidate, failure.derivative, failure.points, nullptr).has_value();
+        };
+
+        Failure result = failure;
+        result.expression = failure.expression.shrink(fails);
+        result.detail = *(this->*check)(result.expression, failure.derivative, failure.points, nullptr);
+        return result;
+    }
+
+private:
+
+    FuzzOptions options;
+    typename ExpressionGenerator<T>::Options generatorOptions;
+    std::vector<std::pair<std::string, Check>> checks;
+
+    Check findCheck(const std::string& name) const {
+
+        for (const auto& [checkName, check] : checks)
+            if (checkName == name) return check;
+        throw std::runtime_error("Unknown check: " + name);
+    }
+
+    /*
+    Выражение (или его производная по x) в типе U.
+    */
+    template <typename U>
+    static Expression<U> build(const std::string& text, bool derivative) {
+
+        Expression<U> expr(text.c_str());
+        return derivative ? expr.differentiate("x") : expr;
+    }
+
+    /*
+    Эталонное значение в типе U; пусто, если вычисление невозможно или результат не конечен.
+    */
+    template <typename U>
+    static std::optional<U> referenceOf(const Expression<U>& expr, const std::unordered_map<std::string, U>& point) {
+
+        try {
+            U value = expr.evaluate(point);
+            if (std::isfinite(std::abs(value))) return value;
+        }
+        catch (const std::runtime_error&) {}
+        return std::nullopt;
+    }
+
+    std::optional<T> reference(const std::string& text, bool derivative, const Point& point) const {
+
+        return referenceOf(build<T>(text, derivative), point);
+    }
+
+    /*
+    Точное значение (вычисленное в long double и округленное до T) и допустимая абсолютная
+    погрешность проверяемого пути.
+    */
+    struct Exact {
+
+        T value;
+        T reference;
+        Real scale;         // max(|f|, 1): относительно него считаются ULP.
+        Real allowance;
+    };
+
+    /*
+    Допуск: ulps * eps * (max(|f|, 1) + чувствительность f к относительному возмущению переменных)
+    плюс удвоенная погрешность эталона. Чувствительность оценивается разностью в long double и
+    покрывает плохую обусловленность (sin большого аргумента, ln около 1, сокращение), при которой
+    оба пути теряют точность в равной мере, но каждый по-своему.
+    Если в long double значение не определено (например, деление на результат полного сокращения,
+    который в T лишь случайно не равен нулю), точка считается особой и не сравнивается.
+    */
+    std::optional<Exact> exactOf(const Expression<Wide>& wide, const Point& point, const T& reference) const {
+
+        const Real epsilon = std::numeric_limits<Real>::epsilon();
+        const long double DELTA = 0x1p-24L;
+
+        std::unordered_map<std::string, Wide> widePoint;
+        for (const auto& [name, value] : point)
+            widePoint[name] = static_cast<Wide>(value);
+
+        auto value = referenceOf(wide, widePoint);
+        if (!value || !std::isfinite(std::abs(static_cast<T>(*value))))
+            return std::nullopt;
+
+        std::vector<Wide> factors = {Wide(1 + DELTA)};
+        if constexpr (isComplex<T>)
+            factors.push_back(Wide(1, DELTA));
+
+        long double sensitivity = 0;
+        for (auto& [name, x] : widePoint) {
+            Wide saved = x;
+            for (const Wide& factor : factors) {
+                x = saved * factor;
+                if (auto shifted = referenceOf(wide, widePoint))
+                    sensitivity = std::max(sensitivity, std::abs(*shifted - *value) / DELTA);
+            }
+            x = saved;
+        }
+
+        T exact = static_cast<T>(*value);
+        Real scale = std::max<Real>(std::abs(exact), 1);
+        Real allowance = static_cast<Real>(options.ulps) * epsilon * (scale + static_cast<Real>(sensitivity))
+                       + 2 * std::abs(reference - exact);
+        return Exact{exact, reference, scale, allowance};
+    }
+
+    /*
+    Величина промежуточных значений в точке: наибольший модуль подвыражения исходного выражения
+    и признак особой точки — какое-то подвыражение в T потеряло больше 20 двоичных разрядов
+    (полное сокращение) или не определено (переполнение), либо аргумент ln или основание
+    степени лежит на разрезе (отрицательная полуось). В особой точке итог определяется шумом
+    округления, и пути вправе разойтись.
+    */
+    struct Intermediates {
+
+        Real magnitude = 0;
+        bool singular = false;
+    };
+
+    static void intermediatesOf(const GeneratedNode& node, const Point& point,
+                                const std::unordered_map<std::string, Wide>& widePoint, Intermediates& result) {
+
+        if (node.args.empty() || result.singular) return;
+
+        std::string text = node.toString();
+        auto value = referenceOf(Expression<T>(text.c_str()), point);
+        auto wide = referenceOf(Expression<Wide>(text.c_str()), widePoint);
+
+        if (!value || !wide || std::abs(static_cast<Wide>(*value) - *wide) > 0x1p-20L * std::abs(*wide)) {
+            result.singular = true;
+            return;
+        }
+        result.magnitude = std::max(result.magnitude, static_cast<Real>(std::abs(*wide)));
+
+        // Разрезы: у ln, log10, sqrt и степени — отрицательная вещественная полуось,
+        // у atan — мнимая ось вне [-i, i].
+        if constexpr (isComplex<T>) {
+            bool logarithmic = node.text == "ln" || node.text == "log10" || node.text == "sqrt" || node.text == "^";
+            if (logarithmic || node.text == "atan") {
+                std::string argument = node.args[0].toString();
+                auto base = referenceOf(Expression<Wide>(argument.c_str()), widePoint);
+                bool cut = base && (logarithmic 
+                    ? base->real() < 0 && std::abs(base->imag()) <= 0x1p-20L * std::abs(*base)
+                    : std::abs(base->imag()) > 1 && std::abs(base->real()) <= 0x1p-20L * std::abs(*base));
+                if (cut) {
+                    result.singular = true;
+                    return;
+                }
+            }
+        }
+
+        for (const auto& arg : node.args)
+            intermediatesOf(arg, point, widePoint, result);
+    }
+
+    static Intermediates intermediatesOf(const GeneratedNode& expression, const Point& point) {
+
+        std::unordered_map<std::string, Wide> widePoint;
+        for (const auto& [name, x] : point)
+            widePoint[name] = static_cast<Wide>(x);
+
+        Intermediates result;
+        intermediatesOf(expression, point, widePoint, result);
+        return result;
+    }
+
+    /*
+    Учет допустимого расхождения или описание недопустимого. Если допуск превышен, он расширяется
+    на величину промежуточных значений (сокращение больших слагаемых, в том числе в производной),
+    а особые точки пропускаются.
+    */
+    std::optional<std::string> compare(const T& value, const Exact& exact, const GeneratedNode& expression,
+                                       const Point& point, CheckStatistics* statistics) const {
+
+        const Real epsilon = std::numeric_limits<Real>::epsilon();
+        Real error = std::abs(value - exact.value);
+        Real allowance = exact.allowance;
+
+        if (!std::isfinite(std::abs(value)) || error > allowance) {
+
+            Intermediates intermediates = intermediatesOf(expression, point);
+            if (intermediates.singular) {
+                if (statistics) statistics->singular++;
+                return std::nullopt;
+            }
+            allowance += static_cast<Real>(options.ulps) * epsilon * intermediates.magnitude;
+        }
+
+        if (!std::isfinite(std::abs(value)) || error > allowance) {
+            std::ostringstream out;
+            out << std::setprecision(std::numeric_limits<Real>::max_digits10)
+                << "at " << ExpressionGenerator<T>::pointToString(point)
+                << "exact " << exact.value << ", evaluate " << exact.reference << ", got " << value
+                << " (" << error / (epsilon * exact.scale) << " ulps, allowed "
+                << allowance / (epsilon * exact.scale) << ")";
+            return out.str();
+        }
+
+        if (statistics) {
+            statistics->compared++;
+            if (allowance > 0)
+                statistics->worst = std::max(statistics->worst, static_cast<double>(error / allowance));
+        }
+        return std::nullopt;
+    }
+
+    /*
+    evaluateBatch по всем точкам, где эталон определен. Ядра для комплексных чисел считают exp, sin
+    и т.п. по своим формулам, поэтому сравнение идет с точным значением, а не с evaluate.
+    */
+    std::optional<std::string> checkBatch(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                          CheckStatistics* statistics) const {
+
+        std::string text = expression.toString();
+        Expression<T> expr = build<T>(text, derivative);
+
+        std::vector<const Point*> defined;
+        std::vector<T> references;
+        for (const auto& point : points) {
+            if (auto value = referenceOf(expr, point)) {
+                defined.push_back(&point);
+                references.push_back(*value);
+            }
+        }
+        if (defined.empty()) return std::nullopt;
+
+        std::unordered_map<std::string, std::vector<T>> columns;
+        for (const Point* point : defined)
+            for (const auto& [name, value] : *point)
+                columns[name].push_back(value);
+
+        std::vector<T> values;
+        try {
+            values = expr.evaluateBatch(columns);
+        }
+        catch (const std::runtime_error& error) {
+            for (const Point* point : defined) {
+                if (intermediatesOf(expression, *point).singular) {
+                    if (statistics) statistics->singular++;
+                    return std::nullopt;
+                }
+            }
+            return std::string("evaluateBatch threw \"") + error.what() + "\" where evaluate did not";
+        }
+
+        Expression<Wide> wide = build<Wide>(text, derivative);
+        for (size_t i = 0; i < defined.size(); i++) {
+            auto exact = exactOf(wide, *defined[i], references[i]);
+            if (!exact) continue;
+            if (auto detail = compare(values[i], *exact, expression, *defined[i], statistics))
+                return detail;
+        }
+        return std::nullopt;
+    }
+
+    /*
+    evaluateMixed после subsVar против точного значения.
+    */
+    std::optional<std::string> checkMixed(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                          CheckStatistics* statistics) const {
+
+        std::string text = expression.toString();
+        Expression<T> expr = build<T>(text, derivative);
+        Expression<Wide> wide = build<Wide>(text, derivative);
+
+        for (const auto& point : points) {
+
+            auto plain = referenceOf(expr, point);
+            auto exact = plain ? exactOf(wide, point, *plain) : std::nullopt;
+            if (!exact) continue;
+
+            Expression<T> substituted = expr;
+            substituted.subsVar(ExpressionGenerator<T>::pointToString(point));
+
+            T mixed;
+            try {
+                mixed = substituted.evaluateMixed();
+            }
+            catch (const std::runtime_error& error) {
+                if (intermediatesOf(expression, point).singular) {
+                    if (statistics) statistics->singular++;
+                    continue;
+                }
+                return std::string("evaluateMixed threw \"") + error.what() + "\" where evaluate did not";
+            }
+
+            if (auto detail = compare(mixed, *exact, expression, point, statistics))
+                return detail;
+        }
+        return std::nullopt;
+    }
+
+    /*
+    Program из выражения и его производной по x: инструкции выполняют те же операции, что и
+    evaluate, поэтому выходы должны совпадать с evaluate каждого выражения точно, а исключение
+    бросаться тогда и только тогда, когда хотя бы одно из выражений не вычисляется.
+    */
+    std::optional<std::string> checkProgram(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                            CheckStatistics* statistics) const {
+
+        std::string text = expression.toString();
+        Expression<T> expr = build<T>(text, derivative);
+        std::vector<Expression<T>> outputs = {expr, expr.differentiate("x")};
+        Program<T> program(outputs);
+
+        for (const auto& point : points) {
+
+            std::vector<T> expected;
+            bool undefined = false;
+            try {
+                for (const auto& output : outputs)
+                    expected.push_back(output.evaluate(point));
+            }
+            catch (const std::runtime_error&) {
+                undefined = true;
+            }
+
+            std::ostringstream out;
+            out << std::setprecision(std::numeric_limits<Real>::max_digits10)
+                << "at " << ExpressionGenerator<T>::pointToString(point);
+
+            std::vector<T> values;
+            try {
+                values = program.evaluate(point);
+            }
+            catch (const std::runtime_error& error) {
+                if (undefined) continue;
+                out << "Program threw \"" << error.what() << "\" where evaluate did not";
+                return out.str();
+            }
+            if (undefined) {
+                out << "Program returned a value where evaluate threw";
+                return out.str();
+            }
+
+            // Совпадение по компонентам (NaN совпадает с NaN).
+            auto same = [](Real a, Real b) { return a == b || (std::isnan(a) && std::isnan(b)); };
+
+            for (size_t i = 0; i < values.size(); i++) {
+                bool equal;
+                if constexpr (isComplex<T>)
+                    equal = same(values[i].real(), expected[i].real()) && same(values[i].imag(), expected[i].imag());
+                else
+                    equal = same(values[i], expected[i]);
+                if (!equal) {
+                    out << "output " << i << ": evaluate " << expected[i] << ", Program " << values[i];
+                    return out.str();
+                }
+            }
+
+            if (statistics) statistics->compared += values.size();
+        }
+        return std::nullopt;
+    }
+
+    /*
+    Program с оптимизациями уровня 2 (свертка, степени через умножения, обратные константы)
+    против точного значения: замены меняют округления, поэтому сравнение с допуском.
+    */
+    std::optional<std::string> checkOptimized(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                              CheckStatistics* statistics) const {
+
+        std::string text = expression.toString();
+        Expression<T> expr = build<T>(text, derivative);
+        Expression<Wide> wide = build<Wide>(text, derivative);
+        Program<T> program({expr}, 2);
+
+        for (const auto& point : points) {
+
+            auto plain = referenceOf(expr, point);
+            auto exact = plain ? exactOf(wide, point, *plain) : std::nullopt;
+            if (!exact) continue;
+
+            T value;
+            try {
+                value = program.evaluate(point)[0];
+            }
+            catch (const std::runtime_error& error) {
+                if (intermediatesOf(expression, point).singular) {
+                    if (statistics) statistics->singular++;
+                    continue;
+                }
+                return std::string("optimized Program threw \"") + error.what() + "\" where evaluate did not";
+            }
+
+            if (auto detail = compare(value, *exact, expression, point, statistics))
+                return detail;
+        }
+        return std::nullopt;
+    }
+
+    /*
+    evaluateInterval на точечных отрезках должен содержать значение evaluate (только вещественные типы).
+    */
+    std::optional<std::string> checkInterval(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                             CheckStatistics* statistics) const {
+
+        if constexpr (isComplex<T>) {
+            return std::nullopt;
+        }
+        else {
+            std::string text = expression.toString();
+            Expression<T> expr = build<T>(text, derivative);
+
+            for (const auto& point : points) {
+
+                auto value = referenceOf(expr, point);
+                if (!value) continue;
+
+                std::unordered_map<std::string, Interval<Real>> box;
+                for (const auto& [name, x] : point)
+                    box.emplace(name, Interval<Real>(x));
+
+                std::ostringstream out;
+                out << std::setprecision(std::numeric_limits<Real>::max_digits10)
+                    << "at " << ExpressionGenerator<T>::pointToString(point) << "reference " << *value;
+
+                try {
+                    Interval<Real> result = expr.evaluateInterval(box);
+                    if (!result.contains(*value)) {
+                        out << " is outside [" << result.lo << ", " << result.hi << "]";
+                        return out.str();
+                    }
+                }
+                catch (const std::runtime_error& error) {
+                    out << ", but evaluateInterval threw \"" << error.what() << "\"";
+                    return out.str();
+                }
+
+                if (statistics) statistics->compared++;
+            }
+            return std::nullopt;
+        }
+    }
+
+    /*
+    Правила дифференцирования (в том числе функций библиотеки и кусочных abs, sign, min, max)
+    против центральной разности в long double с шагами h и h / 2 (только вещественные типы,
+    только исходное выражение). Если разности расходятся между собой, рядом излом, разрыв или
+    полюс, а если функция меняется на шаге больше чем на 0.1%, шаг не разрешает колебания 
+    (cos(cosh(80x))) — в обоих случаях точка считается особой.
+    */
+    std::optional<std::string> checkDerivative(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                               CheckStatistics* statistics) const {
+
+        if constexpr (isComplex<T>) {
+            return std::nullopt;
+        }
+        else {
+            if (derivative) return std::nullopt;
+
+            std::string text = expression.toString();
+            Expression<Wide> wide = build<Wide>(text, false);
+            Expression<Wide> wideDerivative = build<Wide>(text, true);
+            const long double TOLERANCE = 1e-6L;
+
+            for (const auto& point : points) {
+
+                std::unordered_map<std::string, Wide> widePoint;
+                for (const auto& [name, x] : point)
+                    widePoint[name] = static_cast<Wide>(x);
+
+                auto value = referenceOf(wide, widePoint);
+                auto exact = referenceOf(wideDerivative, widePoint);
+                if (!value || !exact) continue;
+
+                long double x = widePoint["x"];
+                long double h = 0x1p-16L * std::max(1.0L, std::abs(x));
+                auto difference = [&](long double step) -> std::optional<long double> {
+                    widePoint["x"] = x + step;
+                    auto forward = referenceOf(wide, widePoint);
+                    widePoint["x"] = x - step;
+                    auto backward = referenceOf(wide, widePoint);
+                    widePoint["x"] = x;
+                    if (!forward || !backward) return std::nullopt;
+                    return (*forward - *backward) / (2 * step);
+                };
+                auto coarse = difference(h);
+                auto fine = difference(h / 2);
+
+                long double scale = 1 + std::abs(*exact) + std::abs(*value);
+                bool resolved = std::abs(*exact) * h <= 1e-3L * (1 + std::abs(*value));
+                if (!resolved || !coarse || !fine || std::abs(*coarse - *fine) > TOLERANCE * scale) {
+                    if (statistics) statistics->singular++;
+                    continue;
+                }
+
+                long double error = std::abs(*exact - *fine);
+                if (error > TOLERANCE * scale && intermediatesOf(expression, point).singular) {
+                    if (statistics) statistics->singular++;
+                    continue;
+                }
+                if (error > TOLERANCE * scale) {
+                    std::ostringstream out;
+                    out << std::setprecision(std::numeric_limits<long double>::max_digits10)
+                        << "at " << ExpressionGenerator<T>::pointToString(point) << "d/dx " << *exact
+                        << ", central difference " << *fine;
+                    return out.str();
+                }
+
+                if (statistics) {
+                    statistics->compared++;
+                    statistics->worst = std::max(statistics->worst, static_cast<double>(error / (TOLERANCE * scale)));
+                }
+            }
+            return std::nullopt;
+        }
+    }
+
+    /*
+    Приближенные sin, cos, ln и exp (Accuracy::Ulp, Fast и Coarse) в evaluate и evaluateBatch
+    против значения в long double на аргументах, которые эти функции получают в выражении:
+    относительная ошибка не больше заявленной в FastMath.hpp — 3 ulp double, 1e-7 и 1e-4.
+    Результаты, которые в T переполняются или денормализованы, не сравниваются (там вызывается libm).
+    Только вещественные типы и исходное выражение.
+    */
+    std::optional<std::string> checkAccuracy(const GeneratedNode& expression, bool derivative, const std::vector<Point>& points,
+                                             CheckStatistics* statistics) const {
+
+        if constexpr (isComplex<T>) {
+            return std::nullopt;
+        }
+        else {
+            if (derivative) return std::nullopt;
+
+            struct Mode { Accuracy accuracy; const char* name; double bound; };
+            static const Mode MODES[] = {{Accuracy::Ulp, "Ulp", 3 * std::numeric_limits<double>::epsilon()},
+                                         {Accuracy::Fast, "Fast", 1e-7}, {Accuracy::Coarse, "Coarse", 1e-4}};
+
+            std::vector<const GeneratedNode*> calls;
+            std::function<void(const GeneratedNode&)> collect = [&](const GeneratedNode& node) {
+                if (node.kind == GeneratedNode::Kind::Function && 
+                    (node.text == "sin" || node.text == "cos" || node.text == "ln" || node.text == "exp"))
+                    calls.push_back(&node);
+                for (const auto& arg : node.args)
+                    collect(arg);
+            };
+            collect(expression);
+
+            for (const GeneratedNode* call : calls) {
+
+                Expression<T> argument(call->args[0].toString().c_str());
+                Expression<T> single((call->text + "(t)").c_str());
+                Expression<Wide> wide((call->text + "(t)").c_str());
+
+                std::vector<T> arguments;
+                std::vector<Wide> exacts;
+                for (const auto& point : points) {
+                    auto a = referenceOf(argument, point);
+                    auto exact = a ? referenceOf(wide, {{"t", static_cast<Wide>(*a)}}) : std::nullopt;
+                    if (!exact || (!std::isnormal(static_cast<T>(*exact)) && *exact != 0)) continue;
+                    arguments.push_back(*a);
+                    exacts.push_back(*exact);
+                }
+                if (arguments.empty()) continue;
+
+                for (const Mode& mode : MODES) {
+
+                    std::vector<T> batch = single.evaluateBatch({{"t", arguments}}, mode.accuracy);
+                    for (size_t i = 0; i < arguments.size(); i++) {
+
+                        T value = single.evaluate({{"t", arguments[i]}}, mode.accuracy);
+                        long double allowed = mode.bound * std::abs(exacts[i]);
+                        long double error = std::max(std::abs(value - exacts[i]), std::abs(batch[i] - exacts[i]));
+
+                        if (!(error <= allowed)) {
+                            std::ostringstream out;
+                            out << std::setprecision(std::numeric_limits<Real>::max_digits10)
+                                << call->text << "(" << arguments[i] << ") with Accuracy::" << mode.name 
+                                << ": exact " << exacts[i] << ", evaluate " << value << ", evaluateBatch " << batch[i]
+                                << " (relative error " << error / std::abs(exacts[i]) << ", allowed " << mode.bound << ")";
+                            return out.str();
+                        }
+
+                        if (statistics) {
+                            statistics->compared++;
+                            if (allowed > 0)
+                                statistics->worst = std::max(statistics->worst, static_cast<double>(error / allowed));
+                        }
+                    }
+                }
+            }
+            return std::nullopt;
+        }
+    }
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЗАПУСК
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Все случаи блоками по потокам, затем сводка и упрощенные примеры первых расхождений.
+Возвращает код завершения: 0, если расхождений нет.
+*/
+template <typename T>
+int fuzz(const FuzzOptions& options) {
+
+    using Summary = typename Fuzzer<T>::Summary;
+
+    Fuzzer<T> fuzzer(options);
+    uint64_t from = options.replay >= 0 ? options.replay : 0;
+    uint64_t to = options.replay >= 0 ? from + 1 : options.cases;
+
+    std::cout << "Fuzzing " << (to - from) << (options.complex ? " complex" : " real") << " cases: seed " << options.seed
+              << ", depth " << options.depth << ", width " << options.width << ", " << options.variables
+              << " variables, " << options.points << " points, tolerance " << options.ulps << " ulps" << std::endl;
+
+    const uint64_t BLOCK = 64;
+    ThreadPool pool(options.threads);
+    std::vector<std::future<Summary>> futures;
+    for (uint64_t start = from; start < to; start += BLOCK)
+        futures.push_back(pool.submit([&, start] { return fuzzer.run(start, std::min(start + BLOCK, to)); }));
+
+    Summary total;
+    for (auto& future : futures) {
+        Summary summary = future.get();
+        total.cases += summary.cases;
+        total.points += summary.points;
+        total.undefined += summary.undefined;
+        for (const auto& [name, statistics] : summary.checks) {
+            auto& sum = total.checks[name];
+            sum.compared += statistics.compared;
+            sum.failed += statistics.failed;
+            sum.singular += statistics.singular;
+            sum.worst = std::max(sum.worst, statistics.worst);
+        }
+        for (auto& failure : summary.failures)
+            total.failures.push_back(std::move(failure));
+    }
+
+    std::cout << total.cases << " expressions (and their derivatives), " << total.points << " points, "
+              << total.undefined << " outside the domain\n\n"
+              << std::left << std::setw(12) << "check" << std::right << std::setw(12) << "compared"
+              << std::setw(12) << "singular" << std::setw(12) << "worst" << std::setw(12) << "failures" << "\n";
+    for (const auto& [name, statistics] : total.checks)
+        std::cout << std::left << std::setw(12) << name << std::right << std::setw(12) << statistics.compared
+                  << std::setw(12) << statistics.singular << std::setw(12) << std::setprecision(3) << statistics.worst << std::setw(12) << statistics.failed << "\n";
+
+    for (size_t i = 0; i < std::min(options.reports, total.failures.size()); i++) {
+
+        const auto& failure = total.failures[i];
+        auto minimal = fuzzer.shrink(failure);
+        std::cout << "\nFAIL " << failure.check << " (case " << failure.index
+                  << (failure.derivative ? ", derivative by x" : "") << ")\n"
+                  << "  original: " << failure.expression.toString() << "\n"
+                  << "  minimal:  " << minimal.expression.toString() << "\n"
+                  << "  " << minimal.detail << "\n"
+                  << "  replay:   ./fuzzer --seed " << options.seed << " --case " << failure.index
+                  << " --depth " << options.depth << " --width " << options.width << " --variables " << options.variables
+                  << " --points " << options.points << " --ulps " << options.ulps
+                  << (options.complex ? " --complex" : "") << "\n";
+    }
+
+    std::cout << std::endl << (total.failures.empty() ? "OK" : "FAILED") << std::endl;
+    return total.failures.empty() ? 0 : 1;
+}
+
+// --------------------------------------------------------------- //
+
+int main(int argc, char* argv[]) {
+
+    FuzzOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string flag = argv[i];
+        if (flag == "--complex") { options.complex = true; continue; }
+        if (i + 1 >= argc) {
+            std::cout << "Missing value for " << flag << std::endl;
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (flag == "--cases") options.cases = std::stoull(value);
+        else if (flag == "--seed") options.seed = std::stoull(value);
+        else if (flag == "--case") options.replay = std::stol(value);
+        else if (flag == "--points") options.points = std::stoull(value);
+        else if (flag == "--ulps") options.ulps = std::stod(value);
+        else if (flag == "--threads") options.threads = std::stoul(value);
+        else if (flag == "--reports") options.reports = std::stoull(value);
+        else if (flag == "--depth") options.depth = std::stoull(value);
+        else if (flag == "--width") options.width = std::stoull(value);
+        else if (flag == "--variables") options.variables = std::stoull(value);
+        else {
+            std::cout << "Unknown flag: " << flag << std::endl;
+            return 2;
+        }
+    }
+
+    return options.complex ? fuzz<std::complex<double>>(options) : fuzz<double>(options);
+}
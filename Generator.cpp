@@ -0,0 +1,433 @@
+#include "Generator.hpp"
+#include <iomanip>
+#include <algorithm>
+
+// ---------------------------------------------------------------------------------------------------- //
+// ДЕРЕВО СГЕНЕРИРОВАННОГО ВЫРАЖЕНИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Печать узла. Бинарные операции берутся в скобки, поэтому строка разбирается парсером
+ровно в это же дерево; у корня и у аргументов функции внешние скобки опускаются.
+*/
+static std::string render(const GeneratedNode& node, bool bare) {
+
+    switch (node.kind) {
+
+        case GeneratedNode::Kind::Number:
+        case GeneratedNode::Kind::Variable:
+            return node.text;
+
+        case GeneratedNode::Kind::Negation:
+            return "-" + render(node.args[0], false);
+
+        case GeneratedNode::Kind::Function: {
+            std::string call = node.text + "(" + render(node.args[0], true);
+            for (size_t i = 1; i < node.args.size(); i++)
+                call += ", " + render(node.args[i], true);
+            return call + ")";
+        }
+
+        case GeneratedNode::Kind::Operation: {
+            std::string body = render(node.args[0], false) + " " + node.text + " " + render(node.args[1], false);
+            return bare ? body : "(" + body + ")";
+        }
+    }
+
+    return "";
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Выражение в строку.
+*/
+std::string GeneratedNode::toString() const {
+
+    return render(*this, true);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Количество узлов.
+*/
+size_t GeneratedNode::size() const {
+
+    size_t result = 1;
+    for (const auto& arg : args)
+        result += arg.size();
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Глубина дерева (у листа 0).
+*/
+size_t GeneratedNode::depth() const {
+
+    size_t result = 0;
+    for (const auto& arg : args)
+        result = std::max(result, arg.depth() + 1);
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Упрощения на один шаг: сначала замены всего дерева, затем упрощения внутри потомков.
+*/
+std::vector<GeneratedNode> GeneratedNode::shrinkCandidates() const {
+
+    std::vector<GeneratedNode> result;
+
+    for (const auto& arg : args)
+        result.push_back(arg);
+
+    if (kind != Kind::Number || text != "1")
+        result.push_back(GeneratedNode{Kind::Number, "1", {}});
+
+    for (size_t i = 0; i < args.size(); i++) {
+        for (auto& candidate : args[i].shrinkCandidates()) {
+            GeneratedNode copy = *this;
+            copy.args[i] = std::move(candidate);
+            result.push_back(std::move(copy));
+        }
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Жадное упрощение. Каждый шаг уменьшает либо число узлов, либо число листьев, отличных от 1,
+поэтому процесс конечен.
+*/
+GeneratedNode GeneratedNode::shrink(const std::function<bool(const GeneratedNode&)>& fails) const {
+
+    GeneratedNode current = *this;
+
+    for (bool progress = true; progress; ) {
+
+        progress = false;
+        for (auto& candidate : current.shrinkCandidates()) {
+            if (fails(candidate)) {
+                current = std::move(candidate);
+                progress = true;
+                break;
+            }
+        }
+    }
+
+    return current;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР
+// ---------------------------------------------------------------------------------------------------- //
+
+template <typename T>
+ExpressionGenerator<T>::ExpressionGenerator(const Options& options, uint64_t seed)
+    : options{options}, generator{seed} {
+
+    static const char* NAMES[] = {"x", "y", "z", "u", "v", "w"};
+    for (size_t i = 0; i < std::min<size_t>(options.variables, 6); i++)
+        names.push_back(NAMES[i]);
+
+    for (const auto& function : options.functions) {
+        uint16_t id = Expression<T>::functionId(function);
+        if (id == Expression<T>::UNKNOWN_FUNCTION)
+            throw std::runtime_error("Unknown function: " + function);
+        arities.push_back(id == Expression<T>::POW_ALIAS ? 2 : Expression<T>::functionArity(id));
+    }
+}
+
+// --------------------------------------------------------------- //
+
+template <typename T>
+std::vector<std::string> ExpressionGenerator<T>::builtinFunctions() {
+
+    std::vector<std::string> result;
+    for (uint16_t id = 0; id < static_cast<uint16_t>(Function::BUILTINS); id++) {
+        Function function = static_cast<Function>(id);
+        if (isComplex<T> && (function == Function::Erf || function == Function::Min || function == Function::Max))
+            continue;
+        result.push_back(functionInfo(function).name);
+    }
+    return result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Очередное случайное выражение.
+*/
+template <typename T>
+GeneratedNode ExpressionGenerator<T>::expression() {
+
+    return node(0);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Очередная случайная точка.
+*/
+template <typename T>
+std::unordered_map<std::string, T> ExpressionGenerator<T>::point() {
+
+    long range = static_cast<long>(options.valueRange * 1024);
+    std::uniform_int_distribution<long> steps(-range, range);
+    std::unordered_map<std::string, T> result;
+
+    for (const auto& name : names) {
+        if constexpr (isComplex<T>)
+            result[name] = T(static_cast<Real>(steps(generator)) / 1024, static_cast<Real>(steps(generator)) / 1024);
+        else
+            result[name] = static_cast<T>(steps(generator)) / 1024;
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Имена переменных генератора.
+*/
+template <typename T>
+const std::vector<std::string>& ExpressionGenerator<T>::variableNames() const {
+
+    return names;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Точка в строку для subsVar. Десяти знаков после запятой достаточно, чтобы значения вида k / 1024
+напечатались точно.
+*/
+template <typename T>
+std::string ExpressionGenerator<T>::pointToString(const std::unordered_map<std::string, T>& point) {
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(10);
+
+    for (const auto& [name, value] : point) {
+        out << name << '=';
+        if constexpr (isComplex<T>) {
+            out << static_cast<long double>(value.real())
+                << (value.imag() < 0 ? '-' : '+') << std::abs(static_cast<long double>(value.imag())) << 'I';
+        }
+        else {
+            out << static_cast<long double>(value);
+        }
+        out << ' ';
+    }
+
+    return out.str();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Поддерево. Вероятность листа растет с глубиной (у корня — 0), на глубине maxDepth — только лист.
+Цепочки + и * строятся сразу из нескольких операндов (до maxWidth), как их разбирает парсер.
+*/
+template <typename T>
+GeneratedNode ExpressionGenerator<T>::node(size_t depth) {
+
+    using Kind = GeneratedNode::Kind;
+
+    if (depth >= options.maxDepth || uniform(1, options.maxDepth) <= depth)
+        return leaf();
+
+    std::discrete_distribution<int> kinds({
+        static_cast<double>(options.addWeight), static_cast<double>(options.mulWeight),
+        static_cast<double>(options.divWeight), static_cast<double>(options.powWeight),
+        static_cast<double>(options.negWeight),
+        static_cast<double>(options.functions.empty() ? 0 : options.functionWeight)
+    });
+
+    int kind = kinds(generator);
+
+    switch (kind) {
+
+        case 0:
+        case 1: {
+            bool additive = kind == 0;
+            size_t width = uniform(2, std::max<size_t>(2, options.maxWidth));
+            GeneratedNode chain = node(depth + 1);
+            for (size_t i = 1; i < width; i++) {
+                std::string operation = additive ? (uniform(0, 1) ? "+" : "-") : "*";
+                chain = GeneratedNode{Kind::Operation, operation, {std::move(chain), node(depth + 1)}};
+            }
+            return chain;
+        }
+
+        case 2: {
+            GeneratedNode numerator = node(depth + 1);
+            return GeneratedNode{Kind::Operation, "/", {std::move(numerator), node(depth + 1)}};
+        }
+
+        case 3: {
+            GeneratedNode base = node(depth + 1);
+            GeneratedNode exponent = options.integerExponents
+                ? GeneratedNode{Kind::Number, std::to_string(uniform(1, 4)), {}}
+                : node(depth + 1);
+            return GeneratedNode{Kind::Operation, "^", {std::move(base), std::move(exponent)}};
+        }
+
+        case 4:
+            return GeneratedNode{Kind::Negation, "-", {node(depth + 1)}};
+
+        default: {
+            size_t index = uniform(0, options.functions.size() - 1);
+            GeneratedNode call{Kind::Function, options.functions[index], {}};
+            for (unsigned i = 0; i < arities[index]; i++)
+                call.args.push_back(node(depth + 1));
+            return call;
+        }
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Лист: переменная (с вероятностью 2/3, если переменные есть) или число.
+*/
+template <typename T>
+GeneratedNode ExpressionGenerator<T>::leaf() {
+
+    if (!names.empty() && uniform(0, 2) > 0)
+        return GeneratedNode{GeneratedNode::Kind::Variable, names[uniform(0, names.size() - 1)], {}};
+    return number();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Число вида k / 4 от 0.25 до 10 (двоично-рациональное, печатается точно).
+*/
+template <typename T>
+GeneratedNode ExpressionGenerator<T>::number() {
+
+    size_t quarters = uniform(1, 40);
+    std::string text = std::to_string(quarters / 4);
+    static const char* FRACTIONS[] = {"", ".25", ".5", ".75"};
+    text += FRACTIONS[quarters % 4];
+
+    if constexpr (isComplex<T>) {
+        if (uniform(0, 3) == 0)
+            text += 'I';
+    }
+
+    return GeneratedNode{GeneratedNode::Kind::Number, text, {}};
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Равномерное целое из [lo, hi].
+*/
+template <typename T>
+size_t ExpressionGenerator<T>::uniform(size_t lo, size_t hi) {
+
+    return std::uniform_int_distribution<size_t>(lo, hi)(generator);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class ExpressionGenerator<float>;
+template class ExpressionGenerator<double>;
+template class ExpressionGenerator<long double>;
+template class ExpressionGenerator<std::complex<double>>;
+template class ExpressionGenerator<std::complex<long double>>;
@@ -0,0 +1,131 @@
+#ifndef EXPR_GENERATOR_HPP
+#define EXPR_GENERATOR_HPP
+
+#include "Expression.hpp"
+#include <random>
+#include <functional>
+#include <cstdint>
+
+/*
+Дерево сгенерированного выражения. Хранится отдельно от AST Expression, чтобы его можно было
+печатать в строку и упрощать (shrink) при поиске минимального примера расхождения.
+*/
+struct GeneratedNode {
+
+    enum class Kind { Number, Variable, Negation, Operation, Function };
+
+    Kind kind = Kind::Number;
+    std::string text;                // Число, имя переменной, знак операции или имя функции.
+    std::vector<GeneratedNode> args;
+
+    /*
+    Строка, которую принимает конструктор Expression (бинарные операции берутся в скобки).
+    */
+    std::string toString() const;
+
+    /*
+    Количество узлов и глубина дерева.
+    */
+    size_t size() const;
+    size_t depth() const;
+
+    /*
+    Все деревья, получающиеся из этого одним упрощением: заменой узла на одного из потомков
+    или на число 1, заменой числа на 1. Более сильные упрощения идут первыми.
+    */
+    std::vector<GeneratedNode> shrinkCandidates() const;
+
+    /*
+    Жадное упрощение: пока какое-то упрощение сохраняет свойство fails, оно применяется.
+    Результат — локально минимальное дерево, на котором fails все еще истинно.
+    */
+    GeneratedNode shrink(const std::function<bool(const GeneratedNode&)>& fails) const;
+};
+
+/*
+Генератор случайных выражений с заданным зерном: одинаковые параметры и зерно дают одинаковые
+выражения и точки. Используется для дифференциального тестирования (fuzz) и как источник
+нагрузки для бенчмарков.
+*/
+template <typename T>
+class ExpressionGenerator {
+public:
+
+    using Real = RealOf<T>;
+
+    /*
+    Параметры генерации. Веса задают относительную частоту видов внутренних узлов.
+    */
+    struct Options {
+
+        size_t maxDepth = 6;            // Вложенность операций (цепочка + или * — один уровень).
+        size_t maxWidth = 4;            // Наибольшая длина цепочки слагаемых или множителей.
+        size_t variables = 2;           // Переменные x, y, z, u, v, w.
+        unsigned addWeight = 4;         // + и -
+        unsigned mulWeight = 4;         // *
+        unsigned divWeight = 2;         // /
+        unsigned powWeight = 2;         // ^
+        unsigned negWeight = 1;         // унарный минус
+        unsigned functionWeight = 3;    // Вызовы функций из functions.
+        std::vector<std::string> functions = builtinFunctions(); // Встроенные или зарегистрированные.
+        bool integerExponents = true;   // Показатель степени — целое число от 1 до 4.
+        Real valueRange = 2;            // Значения переменных из [-valueRange, valueRange].
+    };
+
+    /*
+    Неизвестное имя в options.functions — std::runtime_error.
+    */
+    explicit ExpressionGenerator(const Options& options = Options(), uint64_t seed = 1);
+
+    /*
+    Имена всех встроенных функций, определенных для T (erf, min и max — только для вещественных).
+    */
+    static std::vector<std::string> builtinFunctions();
+
+    /*
+    Очередное случайное выражение.
+    */
+    GeneratedNode expression();
+
+    /*
+    Очередная случайная точка: значения всех переменных. Значения двоично-рациональные (k / 1024),
+    поэтому точно представимы во всех типах и точно печатаются в десятичном виде.
+    */
+    std::unordered_map<std::string, T> point();
+
+    /*
+    Имена переменных генератора.
+    */
+    const std::vector<std::string>& variableNames() const;
+
+    /*
+    Точка в виде строки для Expression::subsVar ("x=0.5 y=-1.25+0.75I").
+    */
+    static std::string pointToString(const std::unordered_map<std::string, T>&);
+
+private:
+
+    Options options;
+    std::mt19937_64 generator;
+    std::vector<std::string> names;
+    std::vector<unsigned> arities;      // Число аргументов функций options.functions.
+
+    /*
+    Поддерево, корень которого находится на глубине depth.
+    */
+    GeneratedNode node(size_t depth);
+
+    /*
+    Лист: переменная или число.
+    */
+    GeneratedNode leaf();
+
+    /*
+    Число вида k / 4 (для комплексного T — иногда мнимое).
+    */
+    GeneratedNode number();
+
+    size_t uniform(size_t lo, size_t hi);
+};
+
+#endif
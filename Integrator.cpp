@@ -0,0 +1,390 @@
+#include "Integrator.hpp"
+#include "ThreadPool.hpp"
+#include <random>
+#include <algorithm>
+
+// ---------------------------------------------------------------------------------------------------- //
+// УЗЛЫ И ВЕСА КВАДРАТУРЫ ГАУССА–КРОНРОДА (G7/K15, КАК В QUADPACK)
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Узлы K15 на [-1, 1] и веса правил Кронрода и Гаусса (у узлов, не входящих в G7, вес Гаусса 0).
+*/
+static const long double GK_NODES[15] = {
+    -0.991455371120812639206854697526329L, -0.949107912342758524526189684047851L,
+    -0.864864423359769072789712788640926L, -0.741531185599394439863864773280788L,
+    -0.586087235467691130294144845693013L, -0.405845151377397166906606412076961L,
+    -0.207784955007898467600689403773245L,  0.0L,
+     0.207784955007898467600689403773245L,  0.405845151377397166906606412076961L,
+     0.586087235467691130294144845693013L,  0.741531185599394439863864773280788L,
+     0.864864423359769072789712788640926L,  0.949107912342758524526189684047851L,
+     0.991455371120812639206854697526329L
+};
+
+static const long double KRONROD_WEIGHTS[15] = {
+    0.022935322010529224963732008058970L, 0.063092092629978553290700663189204L,
+    0.104790010322250183839876322541518L, 0.140653259715525918745189590510238L,
+    0.169004726639267902826583426598550L, 0.190350578064785409913256402421014L,
+    0.204432940075298892414161999234649L, 0.209482141084727828012999174891714L,
+    0.204432940075298892414161999234649L, 0.190350578064785409913256402421014L,
+    0.169004726639267902826583426598550L, 0.140653259715525918745189590510238L,
+    0.104790010322250183839876322541518L, 0.063092092629978553290700663189204L,
+    0.022935322010529224963732008058970L
+};
+
+static const long double GAUSS_WEIGHTS[15] = {
+    0.0L, 0.129484966168869693270611432679082L, 0.0L, 0.279705391489276667901467771423780L,
+    0.0L, 0.381830050505118944950369775488975L, 0.0L, 0.417959183673469387755102040816327L,
+    0.0L, 0.381830050505118944950369775488975L, 0.0L, 0.279705391489276667901467771423780L,
+    0.0L, 0.129484966168869693270611432679082L, 0.0L
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР
+// ---------------------------------------------------------------------------------------------------- //
+
+template <typename T>
+Integrator<T>::Integrator(const Expression<T>& expr) : integrand{expr} {}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Одномерный случай тензорной кубатуры.
+*/
+template <typename T>
+typename Integrator<T>::Result
+Integrator<T>::gaussKronrod(const std::string& var, Real a, Real b, const Options& options,
+                            const std::unordered_map<std::string, T>& params) const {
+
+    if (b < a) {
+        Result result = gaussKronrod(var, b, a, options, params);
+        result.value = -result.value;
+        return result;
+    }
+
+    return cubature({var}, {Interval<Real>(a, b)}, options, params);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Адаптивная кубатура. На каждом шаге подобласти с наибольшей погрешностью (по одной на поток,
+но не меньше четырех) делятся пополам вдоль самой широкой (относительно исходной области) стороны,
+и все новые подобласти вычисляются параллельно.
+*/
+template <typename T>
+typename Integrator<T>::Result
+Integrator<T>::cubature(const std::vector<std::string>& vars, const std::vector<Interval<Real>>& box,
+                        const Options& options, const std::unordered_map<std::string, T>& params) const {
+
+    size_t dims = vars.size();
+    if (dims == 0 || dims > 3 || box.size() != dims)
+        throw std::runtime_error("Cubature supports 1 to 3 dimensions with one interval per variable");
+
+    size_t pointsPerRegion = 1;
+    for (size_t d = 0; d < dims; d++) pointsPerRegion *= 15;
+
+    // Результат и подобласти объявлены до пула: задачи ссылаются на них, и при исключении
+    // деструктор пула, дорабатывающий очередь, должен выполниться раньше, чем они будут уничтожены.
+    Result result;
+    std::vector<Region> regions(1);
+    regions[0].box = box;
+
+    ThreadPool pool(options.threads);
+    size_t width = std::max<size_t>(4, pool.size());
+
+    auto evaluateParallel = [&](size_t from, size_t to) {
+
+        size_t chunk = (to - from + pool.size() - 1) / pool.size();
+        std::vector<std::future<void>> futures;
+        for (size_t start = from; start < to; start += chunk)
+            futures.push_back(pool.submit([&, start] {
+                evaluateRegions(regions, start, std::min(start + chunk, to), vars, params);
+            }));
+
+        // Дождаться всех задач (они ссылаются на chunk и to) и только затем передать первую ошибку.
+        std::exception_ptr error;
+        for (auto& future : futures) {
+            try {
+                future.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error)
+            std::rethrow_exception(error);
+        result.evaluations += (to - from) * pointsPerRegion;
+    };
+
+    evaluateParallel(0, 1);
+
+    for (;;) {
+
+        result.value = 0;
+        result.error = 0;
+        for (const Region& region : regions) {
+            result.value += region.value;
+            result.error += region.error;
+        }
+
+        result.converged = result.error <= std::max(options.absTolerance, options.relTolerance * std::abs(result.value));
+        if (result.converged || result.evaluations + 2 * width * pointsPerRegion > options.maxEvaluations)
+            break;
+
+        // Худшие подобласти переносятся в конец и заменяются своими половинами.
+        size_t split = std::min(width, regions.size());
+        std::nth_element(regions.begin(), regions.end() - split, regions.end(),
+            [](const Region& a, const Region& b) { return a.error < b.error; });
+
+        size_t first = regions.size() - split;
+        for (size_t i = first; i < first + split; i++) {
+
+            size_t widest = 0;
+            for (size_t d = 1; d < dims; d++) {
+                if (regions[i].box[d].width() / box[d].width() > regions[i].box[widest].width() / box[widest].width())
+                    widest = d;
+            }
+
+            Region half = regions[i];
+            Real middle = (regions[i].box[widest].lo + regions[i].box[widest].hi) / 2;
+            regions[i].box[widest].hi = middle;
+            half.box[widest].lo = middle;
+            regions.push_back(std::move(half));
+        }
+
+        evaluateParallel(first, regions.size());
+    }
+
+    result.regions = regions.size();
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Метод Монте-Карло. Выборка делится на блоки с собственными генераторами (seed + номер блока),
+поэтому результат не зависит от числа потоков.
+*/
+template <typename T>
+typename Integrator<T>::Result
+Integrator<T>::monteCarlo(const std::vector<std::string>& vars, const std::vector<Interval<Real>>& box,
+                          const Options& options, const std::unordered_map<std::string, T>& params) const {
+
+    if (vars.empty() || box.size() != vars.size())
+        throw std::runtime_error("Monte Carlo integration needs one interval per variable");
+    if (options.samples == 0)
+        throw std::runtime_error("Monte Carlo integration needs at least one sample");
+
+    const size_t BLOCK = 8192;
+    size_t blocks = (options.samples + BLOCK - 1) / BLOCK;
+
+    struct Sums {
+        T sum = 0;
+        Real squares = 0;
+    };
+
+    ThreadPool pool(options.threads);
+    std::vector<std::future<Sums>> futures;
+
+    for (size_t block = 0; block < blocks; block++) {
+
+        futures.push_back(pool.submit([&, block] {
+
+            size_t n = std::min(BLOCK, options.samples - block * BLOCK);
+            std::mt19937_64 generator(options.seed + block);
+            std::uniform_real_distribution<double> uniform(0, 1);
+
+            std::unordered_map<std::string, std::vector<T>> columns;
+            for (const auto& [name, value] : params)
+                columns[name].assign(n, value);
+            for (size_t d = 0; d < vars.size(); d++) {
+                std::vector<T>& column = columns[vars[d]];
+                column.resize(n);
+                for (size_t i = 0; i < n; i++)
+                    column[i] = static_cast<T>(box[d].lo + box[d].width() * static_cast<Real>(uniform(generator)));
+            }
+
+            Sums sums;
+            for (const T& value : integrand.evaluateBatch(columns)) {
+                sums.sum += value;
+                sums.squares += std::norm(value);
+            }
+            return sums;
+        }));
+    }
+
+    Sums total;
+    for (auto& future : futures) {
+        Sums sums = future.get();
+        total.sum += sums.sum;
+        total.squares += sums.squares;
+    }
+
+    Real volume = 1;
+    for (const auto& side : box) volume *= side.width();
+
+    Real n = static_cast<Real>(options.samples);
+    T mean = total.sum / n;
+    Real variance = std::max(Real(0), total.squares / n - std::norm(mean));
+
+    Result result;
+    result.value = mean * volume;
+    result.error = volume * std::sqrt(variance / n);
+    result.evaluations = options.samples;
+    result.regions = 1;
+    result.converged = result.error <= std::max(options.absTolerance, options.relTolerance * std::abs(result.value));
+    return result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Оценки для подобластей regions[from..to): узлы тензорной сетки K15 всех подобластей
+собираются в один пакет, затем суммируются с весами Кронрода и Гаусса.
+*/
+template <typename T>
+void Integrator<T>::evaluateRegions(std::vector<Region>& regions, size_t from, size_t to,
+                                    const std::vector<std::string>& vars,
+                                    const std::unordered_map<std::string, T>& params) const {
+
+    size_t dims = vars.size();
+    size_t pointsPerRegion = 1;
+    for (size_t d = 0; d < dims; d++) pointsPerRegion *= 15;
+    size_t n = (to - from) * pointsPerRegion;
+
+    std::unordered_map<std::string, std::vector<T>> columns;
+    for (const auto& [name, value] : params)
+        columns[name].assign(n, value);
+    for (const auto& var : vars)
+        columns[var].resize(n);
+
+    for (size_t r = from; r < to; r++) {
+        for (size_t p = 0; p < pointsPerRegion; p++) {
+            size_t index = p;
+            for (size_t d = 0; d < dims; d++, index /= 15) {
+                const Interval<Real>& side = regions[r].box[d];
+                Real center = (side.lo + side.hi) / 2, half = side.width() / 2;
+                columns[vars[d]][(r - from) * pointsPerRegion + p] =
+                    static_cast<T>(center + half * static_cast<Real>(GK_NODES[index % 15]));
+            }
+        }
+    }
+
+    std::vector<T> values = integrand.evaluateBatch(columns);
+
+    for (size_t r = from; r < to; r++) {
+
+        Real scale = 1;
+        for (size_t d = 0; d < dims; d++) scale *= regions[r].box[d].width() / 2;
+
+        T kronrod = 0, gauss = 0;
+        for (size_t p = 0; p < pointsPerRegion; p++) {
+            Real wK = 1, wG = 1;
+            size_t index = p;
+            for (size_t d = 0; d < dims; d++, index /= 15) {
+                wK *= static_cast<Real>(KRONROD_WEIGHTS[index % 15]);
+                wG *= static_cast<Real>(GAUSS_WEIGHTS[index % 15]);
+            }
+            T value = values[(r - from) * pointsPerRegion + p];
+            kronrod += wK * value;
+            gauss += wG * value;
+        }
+
+        regions[r].value = kronrod * scale;
+        regions[r].error = std::abs(kronrod - gauss) * scale;
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class Integrator<float>;
+template class Integrator<double>;
+template class Integrator<long double>;
+template class Integrator<std::complex<double>>;
+template class Integrator<std::complex<long double>>;
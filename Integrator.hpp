@@ -0,0 +1,91 @@
+#ifndef EXPR_INTEGRATOR_HPP
+#define EXPR_INTEGRATOR_HPP
+
+#include "Expression.hpp"
+#include <limits>
+#include <cstdint>
+
+/*
+Численное интегрирование выражения по отрезку или прямоугольной области (1–3 измерения).
+Узлы квадратур вычисляются пакетно (evaluateBatch), а подобласти распределяются по потокам.
+*/
+template <typename T>
+class Integrator {
+public:
+
+    using Real = RealOf<T>;
+
+    /*
+    Параметры интегрирования. Адаптивный процесс останавливается, когда оценка погрешности
+    не превышает max(absTolerance, relTolerance * |I|) или исчерпан лимит вычислений.
+    */
+    struct Options {
+
+        Real absTolerance = 1e-10;
+        Real relTolerance = 1e-10;
+        size_t maxEvaluations = 10000000;
+        unsigned threads = 0;              // 0 — по числу аппаратных потоков.
+        size_t samples = 1000000;          // Для метода Монте-Карло.
+        uint64_t seed = 1;                 // Для метода Монте-Карло.
+    };
+
+    /*
+    Значение интеграла, оценка погрешности и затраты.
+    */
+    struct Result {
+
+        T value = 0;
+        Real error = 0;
+        size_t evaluations = 0;     // Вычислено значений подынтегральной функции.
+        size_t regions = 0;         // Подобластей в итоговом разбиении.
+        bool converged = false;     // Достигнута ли требуемая точность.
+    };
+
+    /*
+    Интегратор для подынтегрального выражения expr.
+    */
+    explicit Integrator(const Expression<T>& expr);
+
+    /*
+    Адаптивная квадратура Гаусса–Кронрода (G7/K15) по отрезку [a, b] переменной var.
+    Остальные переменные выражения задаются в params.
+    */
+    Result gaussKronrod(const std::string& var, Real a, Real b, const Options& options,
+                        const std::unordered_map<std::string, T>& params = {}) const;
+
+    /*
+    Адаптивная тензорная кубатура G7/K15 по прямоугольной области (1–3 измерения):
+    vars[i] пробегает box[i].
+    */
+    Result cubature(const std::vector<std::string>& vars, const std::vector<Interval<Real>>& box,
+                    const Options& options, const std::unordered_map<std::string, T>& params = {}) const;
+
+    /*
+    Метод Монте-Карло по прямоугольной области любой размерности (options.samples точек).
+    Погрешность — одно стандартное отклонение оценки.
+    */
+    Result monteCarlo(const std::vector<std::string>& vars, const std::vector<Interval<Real>>& box,
+                      const Options& options, const std::unordered_map<std::string, T>& params = {}) const;
+
+private:
+
+    /*
+    Подобласть адаптивного разбиения вместе с оценками по Кронроду и погрешности.
+    */
+    struct Region {
+
+        std::vector<Interval<Real>> box;
+        T value = 0;
+        Real error = 0;
+    };
+
+    Expression<T> integrand;
+
+    /*
+    Вычисление оценок для набора подобластей одним пакетом.
+    */
+    void evaluateRegions(std::vector<Region>&, size_t, size_t, const std::vector<std::string>&,
+                         const std::unordered_map<std::string, T>&) const;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef EXPR_INTERVAL_HPP
+#define EXPR_INTERVAL_HPP
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+/*
+Отрезок [lo, hi] для интервального вычисления выражений.
+Каждая операция возвращает отрезок, гарантированно содержащий все возможные результаты:
+границы округляются наружу (на 1 ulp для арифметики, на несколько ulp для функций libm).
+*/
+template <typename R>
+struct Interval {
+
+    R lo;
+    R hi;
+
+    Interval() : lo{0}, hi{0} {}
+    explicit Interval(R value) : lo{value}, hi{value} {}
+    Interval(R lo, R hi) : lo{lo}, hi{hi} {}
+
+    bool contains(R value) const { return lo <= value && value <= hi; }
+    R width() const { return hi - lo; }
+};
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Округление границ наружу на заданное количество ulp.
+*/
+template <typename R>
+inline Interval<R> widen(Interval<R> x, int ulps = 1) {
+
+    for (int i = 0; i < ulps; i++) {
+        x.lo = std::nextafter(x.lo, -std::numeric_limits<R>::infinity());
+        x.hi = std::nextafter(x.hi, std::numeric_limits<R>::infinity());
+    }
+    return x;
+}
+
+/*
+Вся числовая прямая.
+*/
+template <typename R>
+inline Interval<R> entire() {
+    return {-std::numeric_limits<R>::infinity(), std::numeric_limits<R>::infinity()};
+}
+
+/*
+Произведение границ, в котором 0 * inf = 0 (граница 0 точна, бесконечность — лишь оценка).
+*/
+template <typename R>
+inline R boundProduct(R a, R b) {
+    return (a == 0 || b == 0) ? 0 : a * b;
+}
+
+/*
+Содержит ли отрезок (с запасом на погрешность вычисления pi) точку вида offset + k * period.
+*/
+template <typename R>
+inline bool containsPeriodicPoint(const Interval<R>& x, R offset, R period) {
+
+    R eps = 8 * std::numeric_limits<R>::epsilon() * (std::abs(x.lo) + std::abs(x.hi) + 1);
+    R k = std::ceil((x.lo - offset) / period) - 1;
+
+    for (int i = 0; i < 3; i++, k++) {
+        R point = offset + k * period;
+        if (x.lo - eps <= point && point <= x.hi + eps)
+            return true;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------------------------------------- //
+// АРИФМЕТИКА
+// ---------------------------------------------------------------------------------------------------- //
+
+template <typename R>
+inline bool operator==(const Interval<R>& a, const Interval<R>& b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+template <typename R>
+inline Interval<R> operator-(const Interval<R>& a) {
+    return {-a.hi, -a.lo};
+}
+
+template <typename R>
+inline Interval<R> operator+(const Interval<R>& a, const Interval<R>& b) {
+    return widen(Interval<R>{a.lo + b.lo, a.hi + b.hi});
+}
+
+template <typename R>
+inline Interval<R> operator-(const Interval<R>& a, const Interval<R>& b) {
+    return widen(Interval<R>{a.lo - b.hi, a.hi - b.lo});
+}
+
+template <typename R>
+inline Interval<R> operator*(const Interval<R>& a, const Interval<R>& b) {
+
+    R p[4] = {boundProduct(a.lo, b.lo), boundProduct(a.lo, b.hi),
+              boundProduct(a.hi, b.lo), boundProduct(a.hi, b.hi)};
+    return widen(Interval<R>{*std::min_element(p, p + 4), *std::max_element(p, p + 4)});
+}
+
+/*
+Деление. Если знаменатель содержит 0 (но не равен ему), результат — вся прямая.
+*/
+template <typename R>
+inline Interval<R> operator/(const Interval<R>& a, const Interval<R>& b) {
+
+    if (b.lo <= 0 && b.hi >= 0)
+        return entire<R>();
+
+    R q[4] = {a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi};
+    return widen(Interval<R>{*std::min_element(q, q + 4), *std::max_element(q, q + 4)});
+}
+
+// ---------------------------------------------------------------------------------------------------- //
+// ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+template <typename R>
+inline Interval<R> exp(const Interval<R>& x) {
+
+    Interval<R> result = widen(Interval<R>{std::exp(x.lo), std::exp(x.hi)}, 4);
+    result.lo = std::max(result.lo, R(0));
+    return result;
+}
+
+template <typename R>
+inline Interval<R> log(const Interval<R>& x) {
+
+    if (x.hi <= 0)
+        throw std::runtime_error("Argument of ln <= 0 is not allowed");
+
+    R lo = x.lo <= 0 ? -std::numeric_limits<R>::infinity() : std::log(x.lo);
+    return widen(Interval<R>{lo, std::log(x.hi)}, 4);
+}
+
+/*
+Синус: значения на концах плюс экстремумы +-1, если точки pi/2 + 2k*pi или -pi/2 + 2k*pi
+попадают в отрезок.
+*/
+template <typename R>
+inline Interval<R> sin(const Interval<R>& x) {
+
+    const R PI = std::acos(R(-1));
+
+    if (!(x.hi - x.lo < 2 * PI) || std::max(std::abs(x.lo), std::abs(x.hi)) > 1 / std::numeric_limits<R>::epsilon())
+        return {-1, 1};
+
+    R a = std::sin(x.lo), b = std::sin(x.hi);
+    Interval<R> result = widen(Interval<R>{std::min(a, b), std::max(a, b)}, 4);
+
+    if (containsPeriodicPoint(x, PI / 2, 2 * PI)) result.hi = 1;
+    if (containsPeriodicPoint(x, -PI / 2, 2 * PI)) result.lo = -1;
+
+    return {std::max(result.lo, R(-1)), std::min(result.hi, R(1))};
+}
+
+/*
+Косинус: экстремумы в точках 2k*pi (максимум) и pi + 2k*pi (минимум).
+*/
+template <typename R>
+inline Interval<R> cos(const Interval<R>& x) {
+
+    const R PI = std::acos(R(-1));
+
+    if (!(x.hi - x.lo < 2 * PI) || std::max(std::abs(x.lo), std::abs(x.hi)) > 1 / std::numeric_limits<R>::epsilon())
+        return {-1, 1};
+
+    R a = std::cos(x.lo), b = std::cos(x.hi);
+    Interval<R> result = widen(Interval<R>{std::min(a, b), std::max(a, b)}, 4);
+
+    if (containsPeriodicPoint(x, R(0), 2 * PI)) result.hi = 1;
+    if (containsPeriodicPoint(x, PI, 2 * PI)) result.lo = -1;
+
+    return {std::max(result.lo, R(-1)), std::min(result.hi, R(1))};
+}
+
+/*
+Возрастающая функция: значения на концах с запасом в 4 ulp.
+*/
+template <typename R, typename F>
+inline Interval<R> increasing(const Interval<R>& x, F f) {
+    return widen(Interval<R>{f(x.lo), f(x.hi)}, 4);
+}
+
+template <typename R>
+inline Interval<R> sqrt(const Interval<R>& x) {
+
+    if (x.hi < 0)
+        throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+
+    Interval<R> result = increasing(Interval<R>{std::max(x.lo, R(0)), x.hi}, [](R a) { return std::sqrt(a); });
+    result.lo = std::max(result.lo, R(0));
+    return result;
+}
+
+template <typename R>
+inline Interval<R> log10(const Interval<R>& x) {
+
+    if (x.hi <= 0)
+        throw std::runtime_error("Argument of log10 <= 0 is not allowed");
+
+    R lo = x.lo <= 0 ? -std::numeric_limits<R>::infinity() : std::log10(x.lo);
+    return widen(Interval<R>{lo, std::log10(x.hi)}, 4);
+}
+
+/*
+Тангенс: монотонен между полюсами pi/2 + k*pi; если полюс попадает в отрезок — вся прямая.
+*/
+template <typename R>
+inline Interval<R> tan(const Interval<R>& x) {
+
+    const R PI = std::acos(R(-1));
+
+    if (!(x.hi - x.lo < PI) || containsPeriodicPoint(x, PI / 2, PI))
+        return entire<R>();
+    return increasing(x, [](R a) { return std::tan(a); });
+}
+
+template <typename R>
+inline Interval<R> atan(const Interval<R>& x) {
+    return increasing(x, [](R a) { return std::atan(a); });
+}
+
+template <typename R>
+inline Interval<R> sinh(const Interval<R>& x) {
+    return increasing(x, [](R a) { return std::sinh(a); });
+}
+
+template <typename R>
+inline Interval<R> tanh(const Interval<R>& x) {
+
+    Interval<R> result = increasing(x, [](R a) { return std::tanh(a); });
+    return {std::max(result.lo, R(-1)), std::min(result.hi, R(1))};
+}
+
+template <typename R>
+inline Interval<R> erf(const Interval<R>& x) {
+
+    Interval<R> result = increasing(x, [](R a) { return std::erf(a); });
+    return {std::max(result.lo, R(-1)), std::min(result.hi, R(1))};
+}
+
+/*
+Гиперболический косинус: минимум 1 в нуле.
+*/
+template <typename R>
+inline Interval<R> cosh(const Interval<R>& x) {
+
+    R a = std::cosh(x.lo), b = std::cosh(x.hi);
+    Interval<R> result = widen(Interval<R>{std::min(a, b), std::max(a, b)}, 4);
+    if (x.contains(0)) result.lo = 1;
+    result.lo = std::max(result.lo, R(1));
+    return result;
+}
+
+/*
+Модуль и знак (абсолютные значения на концах точны).
+*/
+template <typename R>
+inline Interval<R> abs(const Interval<R>& x) {
+
+    if (x.lo >= 0) return x;
+    if (x.hi <= 0) return -x;
+    return {0, std::max(-x.lo, x.hi)};
+}
+
+template <typename R>
+inline Interval<R> sign(const Interval<R>& x) {
+
+    auto signOf = [](R a) { return static_cast<R>((a > 0) - (a < 0)); };
+    return {signOf(x.lo), signOf(x.hi)};
+}
+
+/*
+Степень. Целый точечный показатель обрабатывается отдельно (определен и для отрицательного основания),
+иначе a^b = exp(b * ln(a)), что требует неотрицательного основания 
+(нулевая граница основания дает ln = -inf, что корректно переходит в 0 или inf).
+*/
+template <typename R>
+inline Interval<R> pow(const Interval<R>& a, const Interval<R>& b) {
+
+    if (b.lo == b.hi && std::trunc(b.lo) == b.lo && std::abs(b.lo) < 0x1p31) {
+
+        long n = static_cast<long>(b.lo);
+        if (n == 0)
+            return Interval<R>(1);
+        if (n < 0)
+            return Interval<R>(1) / pow(a, Interval<R>(-b.lo));
+
+        R lo = std::pow(a.lo, b.lo), hi = std::pow(a.hi, b.lo);
+        if (n % 2)
+            return widen(Interval<R>{lo, hi}, 4);
+        if (a.contains(0))
+            return widen(Interval<R>{0, std::max(lo, hi)}, 4);
+        return widen(Interval<R>{std::min(lo, hi), std::max(lo, hi)}, 4);
+    }
+
+    if (a.lo < 0)
+        throw std::runtime_error("Interval power with possibly negative base and non-integer exponent");
+
+    return exp(b * log(a));
+}
+
+/*
+Степень p / q с нечетным q: определена и для отрицательного основания (при нечетном p — нечетная
+монотонная функция, при четном — четная). Значения на границах считаются так же, как при точечном
+вычислении (для 1 / 3 — cbrt).
+*/
+template <typename R>
+inline Interval<R> rootPower(const Interval<R>& a, long p, long q) {
+
+    if (p < 0)
+        return Interval<R>(1) / rootPower(a, -p, q);
+
+    R exponent = static_cast<R>(p) / q;
+    auto power = [&](R x) {
+        R magnitude = p == 1 && q == 3 ? std::cbrt(std::abs(x)) : std::pow(std::abs(x), exponent);
+        return p % 2 && x < 0 ? -magnitude : magnitude;
+    };
+
+    R lo = power(a.lo), hi = power(a.hi);
+    if (p % 2)
+        return widen(Interval<R>{lo, hi}, 4);
+    if (a.contains(0))
+        return widen(Interval<R>{0, std::max(lo, hi)}, 4);
+    return widen(Interval<R>{std::min(lo, hi), std::max(lo, hi)}, 4);
+}
+
+#endif
@@ -0,0 +1,719 @@
+#include "LazyDerivative.hpp"
+#include <algorithm>
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОРЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Производная порядка order по одной переменной.
+*/
+template <typename T>
+LazyDerivative<T>::LazyDerivative(const Expression<T>& expr, const std::string& var, unsigned order)
+    : LazyDerivative(&expr, {{var, order}}) {}
+
+// --------------------------------------------------------------- //
+
+/*
+Производная по списку переменных с порядками.
+*/
+template <typename T>
+LazyDerivative<T>::LazyDerivative(const Expression<T>* expr, std::vector<std::pair<std::string, unsigned>> orders)
+    : expr(expr), orders(std::move(orders)), shape(degreesOf(this->orders)) {}
+
+// --------------------------------------------------------------- //
+
+/*
+Порядки переменных — степени формы джета.
+*/
+template <typename T>
+std::vector<unsigned> LazyDerivative<T>::degreesOf(const std::vector<std::pair<std::string, unsigned>>& orders) {
+
+    std::vector<unsigned> degrees;
+    degrees.reserve(orders.size());
+    for (const auto& [var, order] : orders)
+        degrees.push_back(order);
+    return degrees;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Форма джета и тройки номеров для свертки. Тройки строятся один раз на производную.
+*/
+template <typename T>
+LazyDerivative<T>::Shape::Shape(std::vector<unsigned> degreeList, unsigned limit) : degrees(std::move(degreeList)) {
+
+    strides.assign(degrees.size(), 1);
+    for (size_t i = degrees.size(); i-- > 0;) {
+        strides[i] = size;
+        size *= degrees[i] + 1;
+        total += degrees[i];
+    }
+    total = std::min(total, limit);
+
+    auto digit = [&](size_t index, size_t i) { return (index / strides[i]) % (degrees[i] + 1); };
+    auto fits = [&](size_t b, size_t a) { // b <= a покомпонентно.
+        for (size_t i = 0; i < degrees.size(); i++)
+            if (digit(b, i) > digit(a, i))
+                return false;
+        return true;
+    };
+    for (size_t a = 0; a < size; a++) {
+        size_t degree = 0;
+        for (size_t i = 0; i < degrees.size(); i++)
+            degree += digit(a, i);
+        if (degree > total) continue; // Коэффициенты выше limit остаются нулевыми.
+        for (size_t b = 0; b <= a; b++)
+            if (fits(b, a))
+                pairs.push_back({static_cast<uint32_t>(a), static_cast<uint32_t>(b), static_cast<uint32_t>(a - b)});
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Производная производной: порядок переменной var увеличивается, дерево не строится.
+*/
+template <typename T>
+LazyDerivative<T> LazyDerivative<T>::differentiate(const std::string& var, unsigned order) const {
+
+    auto extended = orders;
+    auto it = std::find_if(extended.begin(), extended.end(), [&](const auto& entry) { return entry.first == var; });
+    if (it != extended.end())
+        it->second += order;
+    else
+        extended.emplace_back(var, order);
+    return LazyDerivative<T>(expr, std::move(extended));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Значение производной: старший коэффициент джета корня, умноженный на произведение n_i!.
+*/
+template <typename T>
+T LazyDerivative<T>::evaluate(const std::unordered_map<std::string, T>& vars) const {
+
+    std::vector<std::string> names;
+    names.reserve(orders.size());
+    for (const auto& [var, order] : orders)
+        names.push_back(var);
+
+    Jet jet = jetOf(expr->root.get(), Context{shape, vars, names});
+
+    T factorials = static_cast<T>(1);
+    for (unsigned degree : shape.degrees)
+        for (unsigned k = 2; k <= degree; k++)
+            factorials *= static_cast<T>(k);
+    return jet.back() * factorials;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Дерево производной.
+*/
+template <typename T>
+Expression<T> LazyDerivative<T>::materialize() const {
+
+    Expression<T> result(*expr);
+    for (const auto& [var, order] : orders)
+        for (unsigned k = 0; k < order; k++)
+            result = result.differentiate(var);
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Дерево производной в строку.
+*/
+template <typename T>
+std::string LazyDerivative<T>::toString() const {
+
+    return materialize().toString();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Полный порядок.
+*/
+template <typename T>
+unsigned LazyDerivative<T>::order() const {
+
+    return shape.total;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Переменные с порядками.
+*/
+template <typename T>
+const std::vector<std::pair<std::string, unsigned>>& LazyDerivative<T>::variables() const {
+
+    return orders;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// АРИФМЕТИКА ДЖЕТОВ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Есть ли у джета ненулевое приращение.
+*/
+template <typename T>
+bool LazyDerivative<T>::varies(const Jet& jet) {
+
+    for (size_t i = 1; i < jet.size(); i++)
+        if (jet[i] != static_cast<T>(0))
+            return true;
+    return false;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Произведение: c[a] = сумма x[b] * y[a - b] по b <= a.
+*/
+template <typename T>
+typename LazyDerivative<T>::Jet LazyDerivative<T>::multiply(const Jet& x, const Jet& y, const Shape& shape) {
+
+    Jet result(shape.size, static_cast<T>(0));
+    for (const auto& [a, b, c] : shape.pairs)
+        result[a] += x[b] * y[c];
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Частное q = x / y из x = q * y: q[a] = (x[a] - сумма q[b] * y[a - b] по b < a) / y[0].
+Тройки идут по возрастанию a, поэтому все q[b] при b < a к этому моменту посчитаны.
+*/
+template <typename T>
+typename LazyDerivative<T>::Jet LazyDerivative<T>::divide(const Jet& x, const Jet& y, const Shape& shape) {
+
+    if (y[0] == static_cast<T>(0))
+        throw std::runtime_error("Division by zero");
+
+    Jet result(x);
+    for (const auto& [a, b, c] : shape.pairs) {
+        if (b == a)
+            result[a] /= y[0];
+        else
+            result[a] -= result[b] * y[c];
+    }
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Композиция f(u) = сумма c[j] * du ^ j, du = u - u[0]. Степени du выше shape.total равны нулю,
+поэтому достаточно total + 1 коэффициентов.
+*/
+template <typename T>
+typename LazyDerivative<T>::Jet LazyDerivative<T>::compose(const Jet& u, const std::vector<T>& coefficients,
+                                                           const Shape& shape) {
+
+    Jet result(shape.size, static_cast<T>(0));
+    if (!varies(u)) {
+        result[0] = coefficients[0];
+        return result;
+    }
+
+    Jet delta(u);
+    delta[0] = static_cast<T>(0);
+    size_t degree = std::min<size_t>(shape.total, coefficients.size() - 1);
+
+    result[0] = coefficients[degree];
+    for (size_t j = degree; j-- > 0;) {
+        result = multiply(result, delta, shape);
+        result[0] += coefficients[j];
+    }
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Коэффициенты Тейлора встроенных функций в точке a: по циклам производных (sin, cos, sinh, cosh),
+по явным формулам (exp, ln, log10, корень) и по рекуррентным соотношениям для решений
+дифференциальных уравнений: tan' = 1 + tan^2, tanh' = 1 - tanh^2, atan' = 1 / (1 + x^2),
+erf' = 2 / sqrt(pi) * exp(-x^2). Производные |x| и sign(x) — как у Expression::differentiate.
+*/
+template <typename T>
+std::vector<T> LazyDerivative<T>::series(Function function, const T& a, const T& value, unsigned degree) {
+
+    using std::sin, std::cos, std::exp, std::log, std::sinh, std::cosh;
+
+    std::vector<T> c(degree + 1, static_cast<T>(0));
+    c[0] = value;
+    auto number = [](auto value) { return static_cast<T>(value); };
+
+    // Производные по циклу длины 2 или 4: c[j] = cycle[j % period] / j!.
+    auto cyclic = [&](std::array<T, 4> cycle, unsigned period) {
+        T factorial = number(1);
+        for (unsigned j = 1; j <= degree; j++) {
+            factorial *= number(j);
+            c[j] = cycle[j % period] / factorial;
+        }
+    };
+
+    // y' = 1 + sigma * y^2: j c[j] = [1 + sigma * y^2]_(j - 1).
+    auto squareRecurrence = [&](T sigma) {
+        for (unsigned j = 1; j <= degree; j++) {
+            T square = number(0);
+            for (unsigned i = 0; i < j; i++)
+                square += c[i] * c[j - 1 - i];
+            c[j] = ((j == 1 ? number(1) : number(0)) + sigma * square) / number(j);
+        }
+    };
+
+    switch (function) {
+
+        case Function::Sin: cyclic({sin(a), cos(a), -sin(a), -cos(a)}, 4); break;
+
+        case Function::Cos: cyclic({cos(a), -sin(a), -cos(a), sin(a)}, 4); break;
+
+        case Function::Sinh: cyclic({sinh(a), cosh(a), sinh(a), cosh(a)}, 2); break;
+
+        case Function::Cosh: cyclic({cosh(a), sinh(a), cosh(a), sinh(a)}, 2); break;
+
+        case Function::Exp: {
+            T factorial = number(1);
+            for (unsigned j = 1; j <= degree; j++) {
+                factorial *= number(j);
+                c[j] = value / factorial;
+            }
+            break;
+        }
+
+        case Function::Ln:
+        case Function::Log10: { // ln(a + s) = ln a + сумма (-1)^(j-1) s^j / (j a^j).
+            T scale = function == Function::Ln ? number(1) : number(1) / log(number(10));
+            T power = number(1);
+            for (unsigned j = 1; j <= degree; j++) {
+                power /= a;
+                c[j] = scale * power / number(j) * (j % 2 ? number(1) : number(-1));
+            }
+            break;
+        }
+
+        case Function::Sqrt: {
+            ExponentClass cls;
+            cls.kind = ExponentClass::SquareRoot;
+            c = powerSeries(a, number(0.5), cls, degree);
+            c[0] = value;
+            break;
+        }
+
+        case Function::Tan: squareRecurrence(number(1)); break;
+
+        case Function::Tanh: squareRecurrence(number(-1)); break;
+
+        case Function::Atan: { // q = 1 / (1 + (a + s)^2): (1 + a^2) q[k] = [k = 0] - 2a q[k-1] - q[k-2].
+            T denominator = number(1) + a * a;
+            if (denominator == number(0))
+                throw std::runtime_error("Division by zero");
+            std::vector<T> q(degree, number(0));
+            for (unsigned k = 0; k < degree; k++) {
+                T numerator = k == 0 ? number(1) : number(0);
+                if (k >= 1) numerator -= number(2) * a * q[k - 1];
+                if (k >= 2) numerator -= q[k - 2];
+                q[k] = numerator / denominator;
+            }
+            for (unsigned j = 1; j <= degree; j++)
+                c[j] = q[j - 1] / number(j);
+            break;
+        }
+
+        case Function::Erf: { // g = exp(-a^2) exp(h), h = -2a s - s^2: k e[k] = сумма i h[i] e[k-i].
+            std::vector<T> e(degree, number(0));
+            if (degree > 0) e[0] = number(1);
+            for (unsigned k = 1; k < degree; k++) {
+                e[k] = number(-2) * a * e[k - 1];
+                if (k >= 2) e[k] += number(-2) * e[k - 2];
+                e[k] /= number(k);
+            }
+            T scale = number(1.1283791670955125738961589031215452L) * exp(-a * a);
+            for (unsigned j = 1; j <= degree; j++)
+                c[j] = scale * e[j - 1] / number(j);
+            break;
+        }
+
+        case Function::Abs:
+            if (degree > 0) c[1] = applyFunction(Function::Sign, a, a);
+            break;
+
+        case Function::Sign:
+            break;
+
+        default:
+            throw std::runtime_error("Unknown function");
+    }
+    return c;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Коэффициенты a ^ p: C(p, j) * a ^ (p - j). Степень считается тем же способом, что и значение:
+целая — умножениями, корень нечетной степени из отрицательного — со знаком. Отрицательная
+степень нуля — деление на ноль (производные x ^ p при x = 0 для p < j не определены).
+*/
+template <typename T>
+std::vector<T> LazyDerivative<T>::powerSeries(const T& a, const T& p, const ExponentClass& cls, unsigned degree) {
+
+    using std::pow, std::real;
+
+    std::vector<T> c(degree + 1, static_cast<T>(0));
+    T binomial = static_cast<T>(1);
+
+    for (unsigned j = 0; j <= degree; j++) {
+
+        if (j > 0)
+            binomial = binomial * (p - static_cast<T>(j - 1)) / static_cast<T>(j);
+        if (binomial == static_cast<T>(0)) // Целый p >= 0: члены после p-го равны нулю.
+            break;
+
+        T shifted = p - static_cast<T>(j);
+        if (a == static_cast<T>(0)) {
+            if (real(shifted) < 0)
+                throw std::runtime_error("Division by zero");
+            c[j] = binomial * (shifted == static_cast<T>(0) ? static_cast<T>(1) : static_cast<T>(0));
+            continue;
+        }
+
+        T power;
+        if (cls.kind == ExponentClass::Integer) {
+            power = integerPower(a, cls.numerator - static_cast<long>(j));
+        }
+        else if constexpr (std::is_floating_point_v<T>) {
+            if (cls.kind == ExponentClass::CubeRoot || cls.kind == ExponentClass::OddRoot)
+                power = rationalPower(a, shifted, (cls.numerator - static_cast<long>(j) * cls.denominator) % 2 != 0);
+            else
+                power = pow(a, shifted);
+        }
+        else {
+            power = pow(a, shifted);
+        }
+        c[j] = binomial * power;
+    }
+    return c;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ОБХОД ДЕРЕВА
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Джет узла. Значение (нулевой коэффициент) каждого узла считается так же, как в evaluate, поэтому
+проверки области определения те же; у функций и степеней приращения добавляются, только если
+аргумент зависит от переменных дифференцирования.
+*/
+template <typename T>
+typename LazyDerivative<T>::Jet LazyDerivative<T>::jetOf(const Node* node, const Context& context) {
+
+    using Expr = Expression<T>;
+    const Shape& shape = context.shape;
+
+    auto constant = [&](const T& value) {
+        Jet jet(shape.size, static_cast<T>(0));
+        jet[0] = value;
+        return jet;
+    };
+    auto combine = [&](Jet x, const Jet& y, char operation) {
+        for (size_t i = 0; i < x.size(); i++)
+            x[i] = operation == '-' ? x[i] - y[i] : x[i] + y[i];
+        return x;
+    };
+
+    if (const auto* numNode = dynamic_cast<const typename Expr::NumberNode*>(node)) {
+        return constant(numNode->value);
+    }
+    else if (const auto* varNode = dynamic_cast<const typename Expr::VariableNode*>(node)) {
+
+        auto it = context.vars.find(varNode->name);
+        if (it == context.vars.end())
+            throw std::runtime_error("Unbound variable: " + varNode->name);
+
+        Jet jet = constant(it->second);
+        for (size_t i = 0; i < context.names.size(); i++)
+            if (context.names[i] == varNode->name && shape.degrees[i] > 0)
+                jet[shape.strides[i]] = static_cast<T>(1);
+        return jet;
+    }
+    else if (const auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node)) {
+
+        Jet left = jetOf(binOpNode->left.get(), context);
+        Jet right = jetOf(binOpNode->right.get(), context);
+
+        switch (binOpNode->operation) {
+
+            case '+':
+            case '-': return combine(std::move(left), right, binOpNode->operation);
+
+            case '*': return multiply(left, right, shape);
+
+            case '/': return divide(left, right, shape);
+
+            case '^': {
+                T value = raisePower(left[0], right[0], binOpNode->exponent);
+
+                if (!varies(right)) { // Постоянный показатель: ряд степени, без ln основания.
+                    if (!varies(left))
+                        return constant(value);
+                    std::vector<T> c = powerSeries(left[0], right[0], binOpNode->exponent, shape.total);
+                    c[0] = value;
+                    return compose(left, c, shape);
+                }
+
+                // f ^ g = exp(g * ln f).
+                T logarithm = applyFunction(Function::Ln, left[0], left[0]);
+                Jet exponent = multiply(right, compose(left, series(Function::Ln, left[0], logarithm, shape.total),
+                                                       shape), shape);
+                using std::exp;
+                Jet result = compose(exponent, series(Function::Exp, exponent[0], exp(exponent[0]), shape.total),
+                                     shape);
+                result[0] = value;
+                return result;
+            }
+
+            default: throw std::runtime_error("Unknown binary operator");
+        }
+    }
+    else if (const auto* funcNode = dynamic_cast<const typename Expr::FunctionNode*>(node)) {
+
+        std::vector<Jet> args;
+        for (unsigned k = 0; k < funcNode->arity; k++)
+            args.push_back(jetOf(funcNode->args[k].get(), context));
+        const Jet& first = args[0];
+        const Jet& second = args.back();
+
+        T value = Expr::template callFunction<T>(funcNode->id, first[0], second[0]);
+
+        bool dependent = false;
+        for (const Jet& arg : args)
+            dependent = dependent || varies(arg);
+        if (!dependent)
+            return constant(value);
+
+        if (funcNode->id >= static_cast<uint16_t>(Function::BUILTINS))
+            return userCall(funcNode->id, args, shape);
+
+        Function function = static_cast<Function>(funcNode->id);
+        if (function == Function::Min || function == Function::Max) { // ((1 +- s) * f + (1 -+ s) * g) / 2
+            T sign = applyFunction(Function::Sign, first[0] - second[0], first[0] - second[0]);
+            if (function == Function::Min) sign = -sign;
+            T one = static_cast<T>(1);
+            Jet result(shape.size);
+            for (size_t i = 0; i < shape.size; i++)
+                result[i] = ((one + sign) * first[i] + (one - sign) * second[i]) / static_cast<T>(2);
+            result[0] = value;
+            return result;
+        }
+
+        return compose(first, series(function, first[0], value, shape.total), shape);
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node)) {
+
+        if (unaryOpNode->operation != '-')
+            throw std::runtime_error("Unknown unary operator");
+        Jet jet = jetOf(unaryOpNode->arg.get(), context);
+        for (T& coefficient : jet)
+            coefficient = -coefficient;
+        return jet;
+    }
+    else if (const auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node)) {
+
+        Jet sum = jetOf(sumNode->terms[0].second.get(), context);
+        for (size_t i = 1; i < sumNode->terms.size(); i++)
+            sum = combine(std::move(sum), jetOf(sumNode->terms[i].second.get(), context), sumNode->terms[i].first);
+        return sum;
+    }
+    else if (const auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node)) {
+
+        Jet product = jetOf(productNode->factors[0].get(), context);
+        for (size_t i = 1; i < productNode->factors.size(); i++)
+            product = multiply(product, jetOf(productNode->factors[i].get(), context), shape);
+        return product;
+    }
+
+    throw std::runtime_error("Invalid node type in evaluation");
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Пользовательская функция f(u) или f(u, v). Ряд f в точке аргументов строится из частных
+производных: коэффициенты при s^i t^j с i > 0 — коэффициенты df/du (джет на порядок ниже по
+формальным аргументам #0 и #1, усеченный по полной степени), деленные на i; с i = 0 — то же
+для df/dv. Затем ряд подставляется в приращения аргументов. Рекурсия конечна: каждый уровень
+понижает полную степень на единицу.
+*/
+template <typename T>
+typename LazyDerivative<T>::Jet LazyDerivative<T>::userCall(uint16_t id, const std::vector<Jet>& args,
+                                                            const Shape& shape) {
+
+    using Expr = Expression<T>;
+    const auto& definition = Expr::functionDefinition(id);
+    if (!definition.partials)
+        throw std::runtime_error("Function " + definition.name + " has no derivative rule");
+
+    size_t arity = args.size();
+    unsigned degree = shape.total;
+    T value = Expr::template callFunction<T>(id, args[0][0], args.back()[0]);
+
+    // Частные производные по формальным аргументам (имена, которых нет в выражениях).
+    std::vector<std::string> names;
+    std::unordered_map<std::string, T> vars;
+    std::vector<Expr> formal(arity);
+    for (size_t k = 0; k < arity; k++) {
+        names.push_back("#" + std::to_string(k));
+        vars[names[k]] = args[k][0];
+        formal[k].root = std::make_unique<typename Expr::VariableNode>(names[k]);
+    }
+    std::vector<Expr> partials = definition.partials(formal);
+    if (partials.size() != arity)
+        throw std::runtime_error("Function " + definition.name + " must have one partial per argument");
+
+    Shape lower(std::vector<unsigned>(arity, degree - 1), degree - 1);
+    Context context{lower, vars, names};
+    std::vector<Jet> partialJets;
+    for (const Expr& partial : partials)
+        partialJets.push_back(jetOf(partial.root.get(), context));
+
+    if (arity == 1) {
+        std::vector<T> c(degree + 1);
+        c[0] = value;
+        for (unsigned j = 1; j <= degree; j++)
+            c[j] = partialJets[0][j - 1] / static_cast<T>(j);
+        return compose(args[0], c, shape);
+    }
+
+    // f(u, v) = сумма по i: du^i * (сумма по j: c[i][j] dv^j), i + j <= degree.
+    auto coefficient = [&](unsigned i, unsigned j) {
+        if (i == 0 && j == 0) return value;
+        if (i > 0) return partialJets[0][(i - 1) * lower.strides[0] + j] / static_cast<T>(i);
+        return partialJets[1][j - 1] / static_cast<T>(j);
+    };
+
+    Jet du(args[0]), dv(args[1]);
+    du[0] = dv[0] = static_cast<T>(0);
+    std::vector<Jet> powers(degree + 1);
+    powers[0].assign(shape.size, static_cast<T>(0));
+    powers[0][0] = static_cast<T>(1);
+    for (unsigned j = 1; j <= degree; j++)
+        powers[j] = multiply(powers[j - 1], dv, shape);
+
+    Jet result(shape.size, static_cast<T>(0)), duPower = powers[0];
+    for (unsigned i = 0; i <= degree; i++) {
+        Jet inner(shape.size, static_cast<T>(0));
+        for (unsigned j = 0; i + j <= degree; j++) {
+            T c = coefficient(i, j);
+            for (size_t k = 0; k < shape.size; k++)
+                inner[k] += c * powers[j][k];
+        }
+        Jet term = multiply(duPower, inner, shape);
+        for (size_t k = 0; k < shape.size; k++)
+            result[k] += term[k];
+        duPower = multiply(duPower, du, shape);
+    }
+    return result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class LazyDerivative<float>;
+template class LazyDerivative<double>;
+template class LazyDerivative<long double>;
+template class LazyDerivative<std::complex<double>>;
+template class LazyDerivative<std::complex<long double>>;
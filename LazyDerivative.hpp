@@ -0,0 +1,137 @@
+#ifndef EXPR_LAZY_DERIVATIVE_HPP
+#define EXPR_LAZY_DERIVATIVE_HPP
+
+#include "Expression.hpp"
+#include <climits>
+
+/*
+Ленивая производная: ссылка на исходное выражение и список переменных с порядками, без построения
+дерева производной. Значение считается одним обходом исходного дерева в прямом режиме: в каждом
+узле вместо числа — усеченный ряд Тейлора (джет) по переменным дифференцирования, d^n f / dx^n —
+его старший коэффициент, умноженный на n!. Память — один джет на уровень дерева, время —
+многочлен от порядка, тогда как дерево производной (Expression::differentiate) растет с порядком
+экспоненциально. Дерево строится только по запросу: materialize() и toString().
+*/
+template <typename T>
+class LazyDerivative {
+public:
+
+    /*
+    Производная порядка order выражения expr по переменной var. Выражение не копируется:
+    оно должно жить дольше производной.
+    */
+    LazyDerivative(const Expression<T>& expr, const std::string& var, unsigned order = 1);
+
+    /*
+    Производная этой производной порядка order по var (смешанная, если var — другая переменная).
+    */
+    LazyDerivative<T> differentiate(const std::string& var, unsigned order = 1) const;
+
+    /*
+    Значение производной при заданных значениях переменных. Ошибки области определения — как у
+    evaluate исходного выражения и его производных (ln от неположительного, деление на ноль и т.п.).
+    */
+    T evaluate(const std::unordered_map<std::string, T>&) const;
+
+    /*
+    Дерево производной (последовательные Expression::differentiate).
+    */
+    Expression<T> materialize() const;
+
+    /*
+    Дерево производной в строку (то же, что materialize().toString()).
+    */
+    std::string toString() const;
+
+    /*
+    Полный порядок производной.
+    */
+    unsigned order() const;
+
+    /*
+    Переменные дифференцирования с порядками (каждая переменная один раз, в порядке появления).
+    */
+    const std::vector<std::pair<std::string, unsigned>>& variables() const;
+
+private:
+
+    using Node = typename Expression<T>::Node;
+    using Jet = std::vector<T>;
+
+    /*
+    Форма джета: коэффициенты при x1^e1 * ... * xm^em, 0 <= ei <= degrees[i], хранятся подряд
+    (номер — сумма ei * strides[i], последняя переменная меняется быстрее всех). pairs — тройки
+    номеров (a, b, a - b) для всех b <= a покомпонентно, по возрастанию a: по ним считаются
+    произведение и частное джетов. Коэффициенты полной степени выше limit не считаются (остаются
+    нулевыми).
+    */
+    struct Shape {
+
+        std::vector<unsigned> degrees;
+        std::vector<size_t> strides;
+        size_t size = 1;
+        unsigned total = 0;         // min(сумма degrees, limit): степень, выше которой приращения не нужны.
+        std::vector<std::array<uint32_t, 3>> pairs;
+
+        explicit Shape(std::vector<unsigned> degrees, unsigned limit = UINT_MAX);
+    };
+
+    /*
+    Контекст обхода: форма джетов, значения переменных и имена переменных дифференцирования
+    (i-я из них — направление i формы).
+    */
+    struct Context {
+
+        const Shape& shape;
+        const std::unordered_map<std::string, T>& vars;
+        const std::vector<std::string>& names;
+    };
+
+    const Expression<T>* expr;
+    std::vector<std::pair<std::string, unsigned>> orders;
+    Shape shape;
+
+    LazyDerivative(const Expression<T>* expr, std::vector<std::pair<std::string, unsigned>> orders);
+
+    static std::vector<unsigned> degreesOf(const std::vector<std::pair<std::string, unsigned>>&);
+
+    /*
+    Джет поддерева (основное тело обхода).
+    */
+    static Jet jetOf(const Node*, const Context&);
+
+    /*
+    Произведение и частное джетов (свертка по shape.pairs).
+    */
+    static Jet multiply(const Jet&, const Jet&, const Shape&);
+    static Jet divide(const Jet&, const Jet&, const Shape&);
+
+    /*
+    Композиция f(u) по коэффициентам Тейлора f в точке u[0]: сумма c[j] * (u - u[0]) ^ j (схема Горнера).
+    */
+    static Jet compose(const Jet& u, const std::vector<T>& coefficients, const Shape&);
+
+    /*
+    Коэффициенты Тейлора встроенной функции одного аргумента в точке a до степени degree
+    (value — ее значение в a, уже проверенное на область определения).
+    */
+    static std::vector<T> series(Function, const T& a, const T& value, unsigned degree);
+
+    /*
+    Коэффициенты Тейлора a ^ p до степени degree для показателя вида cls.
+    */
+    static std::vector<T> powerSeries(const T& a, const T& p, const ExponentClass& cls, unsigned degree);
+
+    /*
+    Вызов пользовательской функции: коэффициенты Тейлора строятся по ее частным производным
+    (partials), которые сами считаются джетами на порядок ниже.
+    */
+    static Jet userCall(uint16_t id, const std::vector<Jet>& args, const Shape&);
+
+    /*
+    Зависит ли джет от переменных дифференцирования (есть ли ненулевое приращение).
+    */
+    static bool varies(const Jet&);
+};
+
+#endif
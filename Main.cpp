@@ -1,46 +1,103 @@
 #include "Expression.hpp"
 #include "Tests.hpp"
 
+/*
+Флаги отладки: --ast выводит AST-дерево, --profile — статистику дерева и профиль вычисления,
+--stats — занимаемую память и выделения памяти по операциям.
+*/
+struct DebugFlags {
+
+    bool ast = false;
+    bool profile = false;
+    bool stats = false;
+};
+
+/*
+Число повторов вычисления при профилировании (одно вычисление слишком короткое для замера).
+*/
+static const size_t PROFILE_REPEATS = 1000;
+
+template <typename T>
+static void evaluateCommand(const char* exprStr, const std::string& subsVars, const DebugFlags& flags) {
+
+    Expression<T> expr(exprStr);
+    if (flags.ast) expr.debugAST();
+    expr.subsVar(subsVars);
+
+    if (flags.profile) {
+
+        typename Expression<T>::Profile profile;
+        for (size_t i = 0; i < PROFILE_REPEATS; i++)
+            expr.evaluateProfiled(profile);
+
+        std::cout << "\nStatistics:\n" << expr.statistics().toString()
+                  << "\nProfile:\n" << profile.toString() << std::endl;
+    }
+
+    if (flags.stats) {
+        std::cout << "\nMemory:\n" << expr.memoryUsage().toString() << "\nAllocations:\n" 
+                  << Expression<T>::allocationsToString(Expression<T>::allocationStatistics(exprStr, subsVars, "")) 
+                  << std::endl;
+    }
+
+    std::cout << expr.evaluate() << std::endl;
+}
+
+template <typename T>
+static void differentiateCommand(const char* exprStr, const std::string& var, const DebugFlags& flags) {
+
+    Expression<T> expr(exprStr);
+    if (flags.ast) expr.debugAST();
+    Expression<T> derivative = expr.differentiate(var);
+
+    if (flags.profile) {
+        std::cout << "\nStatistics (expression):\n" << expr.statistics().toString()
+                  << "\nStatistics (derivative):\n" << derivative.statistics().toString() << std::endl;
+    }
+
+    if (flags.stats) {
+        std::cout << "\nMemory (expression):\n" << expr.memoryUsage().toString()
+                  << "\nMemory (derivative):\n" << derivative.memoryUsage().toString() << "\nAllocations:\n" 
+                  << Expression<T>::allocationsToString(Expression<T>::allocationStatistics(exprStr, "", var)) 
+                  << std::endl;
+    }
+
+    std::cout << derivative.toString() << std::endl;
+}
+
 int main(int argc, char* argv[]) {
 
-    if ((std::string)argv[1] == "test") Tests();
-    
-    else if (std::string(argv[1]) == "--eval") {
-        
+    DebugFlags flags;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--ast") flags.ast = true;
+        else if (arg == "--profile") flags.profile = true;
+        else if (arg == "--stats") flags.stats = true;
+        else args.push_back(arg);
+    }
+
+    if (!args.empty() && args[0] == "test") Tests();
+
+    else if (args.size() >= 2 && args[0] == "--eval") {
+
         std::string subs_vars;
-        for (int i = 3; i < argc; i++)
-            subs_vars += (' ' + std::string(argv[i]));
-        
-        if (std::string(argv[2]).find('I') != std::string::npos ||
-            subs_vars.find('I') != std::string::npos) {
-
-            Expression<std::complex<long double>> expr(argv[2]);
-            expr.subsVar(subs_vars);
-            expr.debugAST();
-            std::cout << expr.evaluate() << std::endl;
-        }
-        else {
-
-            Expression<long double> expr(argv[2]);
-            expr.debugAST();
-            expr.subsVar(subs_vars);
-            std::cout << expr.evaluate() << std::endl;
-        }
-    }
-
-    else if (std::string(argv[1]) == "--diff") {
-
-        if (std::string(argv[2]).find('I') != std::string::npos) {
-
-            Expression<std::complex<long double>> expr(argv[2]);
-            expr.debugAST();
-            std::cout << expr.differentiate(argv[4]).toString() << std::endl;
-        }
-        else {
-            Expression<long double> expr(argv[2]);
-            expr.debugAST();
-            std::cout << expr.differentiate(argv[4]).toString() << std::endl;
-        }
+        for (size_t i = 2; i < args.size(); i++)
+            subs_vars += (' ' + args[i]);
+
+        if (args[1].find('I') != std::string::npos ||
+            subs_vars.find('I') != std::string::npos)
+            evaluateCommand<std::complex<long double>>(args[1].c_str(), subs_vars, flags);
+        else
+            evaluateCommand<long double>(args[1].c_str(), subs_vars, flags);
+    }
+
+    else if (args.size() >= 4 && args[0] == "--diff") {
+
+        if (args[1].find('I') != std::string::npos)
+            differentiateCommand<std::complex<long double>>(args[1].c_str(), args[3], flags);
+        else
+            differentiateCommand<long double>(args[1].c_str(), args[3], flags);
     }
 
     else {
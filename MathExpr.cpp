@@ -0,0 +1,356 @@
+#include "MathExpr.h"
+#include "Program.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+/*
+Дескрипторы C-интерфейса.
+*/
+struct mathexpr_expression {
+
+    Expression<double> expr;
+};
+
+struct mathexpr_program {
+
+    Program<double> program;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ОШИБКИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Текст последней ошибки потока.
+*/
+static thread_local std::string lastError;
+
+/*
+Запомнить текст ошибки и вернуть ее код.
+*/
+static mathexpr_status fail(mathexpr_status status, const std::string& message) {
+
+    lastError = message;
+    return status;
+}
+
+/*
+Вызов body с переводом исключений в коды: ни одно исключение не выходит за границу C.
+*/
+template <typename F>
+static mathexpr_status guard(F&& body) {
+
+    try {
+        lastError.clear();
+        return body();
+    }
+    catch (const std::bad_alloc&) {
+        return fail(MATHEXPR_OUT_OF_MEMORY, "Out of memory");
+    }
+    catch (const std::runtime_error& error) {
+        static const char UNBOUND[] = "Unbound variable";
+        bool unbound = std::strncmp(error.what(), UNBOUND, sizeof(UNBOUND) - 1) == 0;
+        return fail(unbound ? MATHEXPR_UNBOUND_VARIABLE : MATHEXPR_EVALUATION_ERROR, error.what());
+    }
+    catch (const std::exception& error) {
+        return fail(MATHEXPR_INTERNAL_ERROR, error.what());
+    }
+    catch (...) {
+        return fail(MATHEXPR_INTERNAL_ERROR, "Unknown error");
+    }
+}
+
+/*
+Точность C-интерфейса в Accuracy.
+*/
+static Accuracy toAccuracy(mathexpr_accuracy accuracy) {
+
+    switch (accuracy) {
+        case MATHEXPR_ULP: return Accuracy::Ulp;
+        case MATHEXPR_FAST: return Accuracy::Fast;
+        case MATHEXPR_COARSE: return Accuracy::Coarse;
+        default: return Accuracy::Exact;
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Текст последней ошибки.
+*/
+const char* mathexpr_last_error(void) {
+
+    return lastError.c_str();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВЫРАЖЕНИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Разбор без исключений (Expression::parse).
+*/
+mathexpr_status mathexpr_parse(const char* text, size_t length, mathexpr_expression** out, size_t* error_offset) {
+
+    return guard([&] {
+
+        if (!text || !out)
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+        *out = nullptr;
+
+        std::string_view source(text, length);
+        auto parsed = Expression<double>::parse(source);
+        if (!parsed) {
+            if (error_offset) *error_offset = parsed.error().offset;
+            return fail(MATHEXPR_PARSE_ERROR, parsed.error().toString(source));
+        }
+
+        *out = new mathexpr_expression{std::move(parsed.value())};
+        return MATHEXPR_OK;
+    });
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Освобождение выражения.
+*/
+void mathexpr_free(mathexpr_expression* expression) {
+
+    delete expression;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Производная.
+*/
+mathexpr_status mathexpr_differentiate(const mathexpr_expression* expression, const char* variable,
+                                       mathexpr_expression** out) {
+
+    return guard([&] {
+
+        if (!expression || !variable || !out)
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+
+        *out = new mathexpr_expression{expression->expr.differentiate(variable)};
+        return MATHEXPR_OK;
+    });
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Выражение в строку.
+*/
+mathexpr_status mathexpr_to_string(const mathexpr_expression* expression, char* buffer, size_t capacity,
+                                   size_t* length) {
+
+    return guard([&] {
+
+        if (!expression || (!buffer && capacity > 0))
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+
+        std::string text = expression->expr.toString();
+        if (length) *length = text.size();
+        if (text.size() + 1 > capacity)
+            return fail(MATHEXPR_BUFFER_TOO_SMALL, "Buffer needs " + std::to_string(text.size() + 1) + " bytes");
+
+        std::memcpy(buffer, text.c_str(), text.size() + 1);
+        return MATHEXPR_OK;
+    });
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Вычисление дерева.
+*/
+mathexpr_status mathexpr_evaluate(const mathexpr_expression* expression, const char* const* names,
+                                  const double* values, size_t count, mathexpr_accuracy accuracy, double* result) {
+
+    return guard([&] {
+
+        if (!expression || !result || (count > 0 && (!names || !values)))
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+
+        std::unordered_map<std::string, double> vars;
+        for (size_t i = 0; i < count; i++)
+            vars[names[i]] = values[i];
+
+        *result = expression->expr.evaluate(vars, toAccuracy(accuracy));
+        return MATHEXPR_OK;
+    });
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПРОГРАММЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Компиляция выражений в программу.
+*/
+mathexpr_status mathexpr_compile(const mathexpr_expression* const* expressions, size_t count, unsigned level,
+                                 mathexpr_program** out) {
+
+    return guard([&] {
+
+        if (!expressions || !out || count == 0)
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument or no expressions");
+        *out = nullptr;
+
+        std::vector<Expression<double>> exprs;
+        exprs.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            if (!expressions[i])
+                return fail(MATHEXPR_INVALID_ARGUMENT, "Null expression " + std::to_string(i));
+            exprs.push_back(expressions[i]->expr);
+        }
+
+        *out = new mathexpr_program{Program<double>(exprs, level)};
+        return MATHEXPR_OK;
+    });
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Освобождение программы.
+*/
+void mathexpr_program_free(mathexpr_program* program) {
+
+    delete program;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Число переменных программы.
+*/
+size_t mathexpr_program_variable_count(const mathexpr_program* program) {
+
+    return program ? program->program.variables().size() : 0;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Имя переменной программы.
+*/
+const char* mathexpr_program_variable_name(const mathexpr_program* program, size_t index) {
+
+    if (!program || index >= program->program.variables().size())
+        return nullptr;
+    return program->program.variables()[index].c_str();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Число выходов программы.
+*/
+size_t mathexpr_program_output_count(const mathexpr_program* program) {
+
+    return program ? program->program.statistics().outputs : 0;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Вычисление программы в одной точке. Рабочие массивы хранятся в потоке, поэтому повторные 
+вызовы не выделяют память.
+*/
+mathexpr_status mathexpr_program_evaluate(const mathexpr_program* program, const double* values,
+                                          mathexpr_accuracy accuracy, double* outputs) {
+
+    return guard([&] {
+
+        if (!program || !outputs || (!values && mathexpr_program_variable_count(program) > 0))
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+
+        static thread_local std::vector<double> arguments, results, registers;
+        arguments.assign(values, values + mathexpr_program_variable_count(program));
+        program->program.evaluate(arguments, results, registers, toAccuracy(accuracy));
+        std::copy(results.begin(), results.end(), outputs);
+        return MATHEXPR_OK;
+    });
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Пакетное вычисление программы прямо в буферах вызывающего.
+*/
+mathexpr_status mathexpr_program_evaluate_batch(const mathexpr_program* program, const double* const* columns,
+                                                size_t n, mathexpr_accuracy accuracy, double* const* outputs) {
+
+    return guard([&] {
+
+        if (!program || !outputs || (!columns && mathexpr_program_variable_count(program) > 0))
+            return fail(MATHEXPR_INVALID_ARGUMENT, "Null argument");
+
+        program->program.evaluateBatch(columns, n, outputs, toAccuracy(accuracy));
+        return MATHEXPR_OK;
+    });
+}
@@ -0,0 +1,115 @@
+#ifndef MATHEXPR_H
+#define MATHEXPR_H
+
+/*
+C-интерфейс библиотеки (libmathexpr.a, libmathexpr.so) для встраивания в программы на C и
+других языках. Выражения и программы — непрозрачные дескрипторы над Expression<double> и
+Program<double>. Функции не бросают исключений: результат — код mathexpr_status, текст
+последней ошибки потока — mathexpr_last_error(). Результаты пишутся в буферы вызывающего;
+пакетное вычисление программы читает столбцы и пишет выходы на месте, без копирования.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define MATHEXPR_API __attribute__((visibility("default")))
+#else
+#define MATHEXPR_API
+#endif
+
+typedef struct mathexpr_expression mathexpr_expression;
+typedef struct mathexpr_program mathexpr_program;
+
+typedef enum {
+    MATHEXPR_OK = 0,
+    MATHEXPR_PARSE_ERROR,           /* Строка не разобрана (смещение ошибки — в error_offset). */
+    MATHEXPR_EVALUATION_ERROR,      /* Деление на ноль, аргумент вне области определения и т.п. */
+    MATHEXPR_UNBOUND_VARIABLE,      /* Значение переменной не передано. */
+    MATHEXPR_INVALID_ARGUMENT,      /* Пустой указатель, неверный номер и т.п. */
+    MATHEXPR_BUFFER_TOO_SMALL,      /* Буфер мал; нужный размер записан в length. */
+    MATHEXPR_OUT_OF_MEMORY,
+    MATHEXPR_INTERNAL_ERROR
+} mathexpr_status;
+
+/* Точность sin, cos, exp и ln (Accuracy в FastMath.hpp). */
+typedef enum {
+    MATHEXPR_EXACT = 0,
+    MATHEXPR_ULP,
+    MATHEXPR_FAST,
+    MATHEXPR_COARSE
+} mathexpr_accuracy;
+
+/*
+Текст последней ошибки в этом потоке (пустая строка, если ошибок не было). Указатель
+действителен до следующего вызова библиотеки в этом потоке.
+*/
+MATHEXPR_API const char* mathexpr_last_error(void);
+
+/*
+Разбор строки text длины length. error_offset (может быть NULL) получает смещение ошибки разбора.
+*/
+MATHEXPR_API mathexpr_status mathexpr_parse(const char* text, size_t length, mathexpr_expression** out,
+                                            size_t* error_offset);
+
+MATHEXPR_API void mathexpr_free(mathexpr_expression* expression);
+
+/*
+Производная по переменной variable (новый дескриптор).
+*/
+MATHEXPR_API mathexpr_status mathexpr_differentiate(const mathexpr_expression* expression, const char* variable,
+                                                    mathexpr_expression** out);
+
+/*
+Запись выражения в buffer емкости capacity (с завершающим нулем); length получает длину без нуля.
+*/
+MATHEXPR_API mathexpr_status mathexpr_to_string(const mathexpr_expression* expression, char* buffer,
+                                                size_t capacity, size_t* length);
+
+/*
+Значение выражения: count переменных с именами names и значениями values.
+*/
+MATHEXPR_API mathexpr_status mathexpr_evaluate(const mathexpr_expression* expression, const char* const* names,
+                                               const double* values, size_t count, mathexpr_accuracy accuracy,
+                                               double* result);
+
+/*
+Компиляция count выражений в одну программу (Program<double>) с уровнем оптимизации level (0–3).
+*/
+MATHEXPR_API mathexpr_status mathexpr_compile(const mathexpr_expression* const* expressions, size_t count,
+                                              unsigned level, mathexpr_program** out);
+
+MATHEXPR_API void mathexpr_program_free(mathexpr_program* program);
+
+MATHEXPR_API size_t mathexpr_program_variable_count(const mathexpr_program* program);
+
+/*
+Имя переменной номер index (NULL при неверном номере); значения передаются в этом порядке.
+*/
+MATHEXPR_API const char* mathexpr_program_variable_name(const mathexpr_program* program, size_t index);
+
+MATHEXPR_API size_t mathexpr_program_output_count(const mathexpr_program* program);
+
+/*
+Все выходы в одной точке: values — значения переменных в порядке mathexpr_program_variable_name,
+outputs — mathexpr_program_output_count чисел.
+*/
+MATHEXPR_API mathexpr_status mathexpr_program_evaluate(const mathexpr_program* program, const double* values,
+                                                       mathexpr_accuracy accuracy, double* outputs);
+
+/*
+Пакетное вычисление n точек: columns[i] — n значений переменной i, outputs[k] — буфер на n значений
+выхода k. Буферы вызывающего читаются и пишутся напрямую.
+*/
+MATHEXPR_API mathexpr_status mathexpr_program_evaluate_batch(const mathexpr_program* program,
+                                                             const double* const* columns, size_t n,
+                                                             mathexpr_accuracy accuracy, double* const* outputs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef EXPR_MPMC_QUEUE_HPP
+#define EXPR_MPMC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+
+/*
+Ограниченная очередь без блокировок для многих производителей и многих потребителей
+(кольцевой буфер Вьюкова). У каждой ячейки есть номер sequence: ячейка свободна для записи
+с номером pos, если sequence == pos, и готова к чтению, если sequence == pos + 1. Производители
+и потребители захватывают позиции compare_exchange на head и tail и не ждут друг друга,
+кроме случая, когда очередь пуста или полна. Элемент создается в ячейке только при push
+и уничтожается при pop, поэтому пустая очередь не держит ни одного V (и V не обязан иметь
+конструктор по умолчанию).
+*/
+template <typename V>
+class MpmcQueue {
+public:
+
+    /*
+    Очередь на capacity элементов (округляется вверх до степени двойки).
+    */
+    explicit MpmcQueue(size_t capacity) {
+
+        if (capacity == 0)
+            throw std::runtime_error("Queue capacity must be positive");
+
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+
+        cells.reset(new Cell[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /*
+    Добавить элемент; false, если очередь полна (value тогда не перемещается).
+    */
+    bool push(V& value) {
+
+        size_t position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+            if (difference == 0) {
+                if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value.emplace(std::move(value));
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*
+    Взять элемент; false, если очередь пуста.
+    */
+    bool pop(V& value) {
+
+        size_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+
+            Cell& cell = cells[position & mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position + 1);
+
+            if (difference == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = std::move(*cell.value);
+                    cell.value.reset();
+                    cell.sequence.store(position + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                return false;
+            }
+            else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*
+    Примерное число элементов (точное, только если очередь никто не меняет).
+    */
+    size_t size() const {
+
+        size_t first = head.load(std::memory_order_acquire), last = tail.load(std::memory_order_acquire);
+        return last > first ? last - first : 0;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+
+    struct Cell {
+
+        std::atomic<size_t> sequence;
+        std::optional<V> value;     // Пусто, пока ячейка свободна.
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+
+    // head и tail в разных строках кэша, чтобы производители и потребители не мешали друг другу.
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+#endif
@@ -0,0 +1,784 @@
+#include "Polynomial.hpp"
+#include <algorithm>
+
+/*
+Наибольший показатель степени и наибольшее число одночленов при раскрытии скобок
+(защита от (x + y + z)^1000).
+*/
+static const unsigned MAX_DEGREE = 4096;
+static const size_t MAX_TERMS = 100000;
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Многочлен из выражения: переменные упорядочиваются по имени, затем дерево раскрывается
+в сумму одночленов.
+*/
+template <typename T>
+Polynomial<T>::Polynomial(const Expression<T>& expr) {
+
+    if (!expr.root)
+        throw std::runtime_error("Expression tree is empty");
+
+    collectVariables(expr.root.get(), names);
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    for (auto& [exponents, coefficient] : convert(expr.root.get(), names))
+        monomials.push_back({coefficient, exponents});
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Проверка, является ли выражение многочленом.
+*/
+template <typename T>
+bool Polynomial<T>::isPolynomial(const Expression<T>& expr) {
+
+    try {
+        Polynomial<T> polynomial(expr);
+        return true;
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Замена поддеревьев-многочленов записью по схеме Горнера.
+*/
+template <typename T>
+Expression<T> Polynomial<T>::hornerize(const Expression<T>& expr) {
+
+    Expression<T> result;
+    if (!expr.root) return result;
+
+    bool polynomial = false;
+    result.root = hornerizeHelper(expr, expr.root.get(), polynomial);
+    if (polynomial)
+        result.root = replaceSubtree(expr, expr.root.get());
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Значение многочлена при значениях переменных из словаря.
+*/
+template <typename T>
+T Polynomial<T>::evaluate(const std::unordered_map<std::string, T>& vars, Scheme scheme) const {
+
+    std::vector<T> values(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        auto it = vars.find(names[i]);
+        if (it == vars.end())
+            throw std::runtime_error("Unbound variable: " + names[i]);
+        values[i] = it->second;
+    }
+
+    std::vector<T> scratch;
+    return evaluate(values, scheme, scratch);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Значение многочлена при значениях переменных в порядке variables().
+*/
+template <typename T>
+T Polynomial<T>::evaluate(const std::vector<T>& values, Scheme scheme, std::vector<T>& scratch) const {
+
+    if (values.size() != names.size())
+        throw std::runtime_error("Polynomial expects " + std::to_string(names.size()) + " variable values");
+
+    if (monomials.empty())
+        return static_cast<T>(0);
+    return evaluateHelper(0, 0, monomials.size(), values.data(), scheme, scratch);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Производная: у каждого одночлена с ненулевой степенью переменной коэффициент умножается
+на степень, а степень уменьшается на единицу. Порядок одночленов при этом сохраняется.
+*/
+template <typename T>
+Polynomial<T> Polynomial<T>::differentiate(const std::string& var) const {
+
+    Polynomial<T> result;
+    result.names = names;
+
+    auto it = std::lower_bound(names.begin(), names.end(), var);
+    if (it == names.end() || *it != var)
+        return result;
+    size_t index = it - names.begin();
+
+    for (const auto& term : monomials) {
+        if (term.exponents[index] == 0) continue;
+        Term derivative = term;
+        derivative.coefficient *= static_cast<T>(term.exponents[index]);
+        derivative.exponents[index]--;
+        result.monomials.push_back(std::move(derivative));
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Развернутый вид: c1 * x^a * y^b + c2 * ... (отрицательные коэффициенты после первого — через '-').
+*/
+template <typename T>
+Expression<T> Polynomial<T>::toExpression() const {
+
+    using Expr = Expression<T>;
+
+    Expr result;
+    if (monomials.empty()) {
+        result.root = Expr::valueNode(static_cast<T>(0));
+        return result;
+    }
+
+    for (size_t i = 0; i < monomials.size(); i++) {
+
+        T coefficient = monomials[i].coefficient;
+        bool negative;
+        if constexpr (isComplex<T>) negative = coefficient.imag() == 0 && coefficient.real() < 0;
+        else negative = coefficient < 0;
+        if (i > 0 && negative) coefficient = -coefficient;
+
+        std::unique_ptr<Node> monomial = monomialNode(monomials[i].exponents), term;
+        if (!monomial)
+            term = Expr::valueNode(coefficient);
+        else if (coefficient == static_cast<T>(1))
+            term = std::move(monomial);
+        else if (coefficient == static_cast<T>(-1))
+            term = std::make_unique<typename Expr::UnaryOperationNode>('-', std::move(monomial));
+        else
+            term = std::make_unique<typename Expr::BinaryOperationNode>('*', Expr::valueNode(coefficient), std::move(monomial));
+
+        if (i == 0)
+            result.root = std::move(term);
+        else
+            result.root = std::make_unique<typename Expr::BinaryOperationNode>
+                (negative ? '-' : '+', std::move(result.root), std::move(term));
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Запись по схеме Горнера.
+*/
+template <typename T>
+Expression<T> Polynomial<T>::toHornerExpression() const {
+
+    Expression<T> result;
+    result.root = monomials.empty() ? Expression<T>::valueNode(static_cast<T>(0))
+                                    : hornerHelper(0, 0, monomials.size());
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Развернутый вид в строку.
+*/
+template <typename T>
+std::string Polynomial<T>::toString() const {
+
+    return toExpression().toString();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Имена переменных.
+*/
+template <typename T>
+const std::vector<std::string>& Polynomial<T>::variables() const {
+
+    return names;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Одночлены.
+*/
+template <typename T>
+const std::vector<typename Polynomial<T>::Term>& Polynomial<T>::terms() const {
+
+    return monomials;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Полная степень.
+*/
+template <typename T>
+unsigned Polynomial<T>::degree() const {
+
+    unsigned result = 0;
+    for (const auto& term : monomials) {
+        unsigned sum = 0;
+        for (unsigned exponent : term.exponents) sum += exponent;
+        result = std::max(result, sum);
+    }
+    return result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Раскрытие поддерева. Константные поддеревья вычисляются (ошибки вроде деления на ноль
+бросаются как есть), остальные узлы должны быть операциями многочленов.
+*/
+template <typename T>
+typename Polynomial<T>::Monomials Polynomial<T>::convert(const Node* node, const std::vector<std::string>& names) {
+
+    using Expr = Expression<T>;
+
+    std::vector<unsigned> constant(names.size(), 0);
+    auto notPolynomial = [&] { return std::runtime_error("Expression is not a polynomial: " + node->nodeToString()); };
+    auto prune = [](Monomials& terms) {
+        for (auto it = terms.begin(); it != terms.end(); )
+            it = it->second == static_cast<T>(0) ? terms.erase(it) : std::next(it);
+    };
+
+    if (isConstant(node))
+        return {{constant, Expr().evaluateHelper(node)}};
+
+    if (const auto* varNode = dynamic_cast<const typename Expr::VariableNode*>(node)) {
+
+        std::vector<unsigned> exponents = constant;
+        exponents[std::lower_bound(names.begin(), names.end(), varNode->name) - names.begin()] = 1;
+        return {{exponents, static_cast<T>(1)}};
+    }
+    else if (const auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node)) {
+
+        switch (binOpNode->operation) {
+
+            case '+':
+            case '-': {
+                Monomials left = convert(binOpNode->left.get(), names);
+                for (const auto& [exponents, coefficient] : convert(binOpNode->right.get(), names)) {
+                    if (binOpNode->operation == '+') left[exponents] += coefficient;
+                    else left[exponents] -= coefficient;
+                }
+                prune(left);
+                return left;
+            }
+
+            case '*': {
+                Monomials product = multiply(convert(binOpNode->left.get(), names), convert(binOpNode->right.get(), names));
+                prune(product);
+                return product;
+            }
+
+            case '/': {
+                if (!isConstant(binOpNode->right.get()))
+                    throw notPolynomial();
+                T divisor = Expr().evaluateHelper(binOpNode->right.get());
+                if (divisor == static_cast<T>(0))
+                    throw std::runtime_error("Division by zero");
+                Monomials left = convert(binOpNode->left.get(), names);
+                for (auto& term : left) term.second /= divisor;
+                return left;
+            }
+
+            case '^': {
+                if (!isConstant(binOpNode->right.get()))
+                    throw notPolynomial();
+                T value = Expr().evaluateHelper(binOpNode->right.get());
+                RealOf<T> exponent;
+                if constexpr (isComplex<T>) {
+                    if (value.imag() != 0) throw notPolynomial();
+                    exponent = value.real();
+                }
+                else {
+                    exponent = value;
+                }
+                if (!(exponent >= 0 && exponent <= MAX_DEGREE) || std::trunc(exponent) != exponent)
+                    throw notPolynomial();
+
+                Monomials base = convert(binOpNode->left.get(), names), result = {{constant, static_cast<T>(1)}};
+                for (auto bits = static_cast<unsigned>(exponent); bits; bits >>= 1) {
+                    if (bits & 1) result = multiply(result, base);
+                    if (bits > 1) base = multiply(base, base);
+                }
+                prune(result);
+                return result;
+            }
+
+            default: throw notPolynomial();
+        }
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node)) {
+
+        if (unaryOpNode->operation != '-')
+            throw notPolynomial();
+        Monomials arg = convert(unaryOpNode->arg.get(), names);
+        for (auto& term : arg) term.second = -term.second;
+        return arg;
+    }
+    else if (const auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node)) {
+
+        Monomials sum;
+        for (const auto& [sign, term] : sumNode->terms) {
+            for (const auto& [exponents, coefficient] : convert(term.get(), names)) {
+                if (sign == '-') sum[exponents] -= coefficient;
+                else sum[exponents] += coefficient;
+            }
+        }
+        prune(sum);
+        return sum;
+    }
+    else if (const auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node)) {
+
+        Monomials product = convert(productNode->factors[0].get(), names);
+        for (size_t i = 1; i < productNode->factors.size(); i++) {
+            product = multiply(product, convert(productNode->factors[i].get(), names));
+            prune(product);
+        }
+        return product;
+    }
+
+    throw notPolynomial(); // Функция от переменной.
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Произведение: все пары одночленов, степени складываются, одинаковые одночлены объединяются.
+*/
+template <typename T>
+typename Polynomial<T>::Monomials Polynomial<T>::multiply(const Monomials& a, const Monomials& b) {
+
+    Monomials result;
+    std::vector<unsigned> exponents;
+
+    for (const auto& [left, leftCoefficient] : a) {
+        for (const auto& [right, rightCoefficient] : b) {
+            exponents = left;
+            for (size_t i = 0; i < exponents.size(); i++)
+                exponents[i] += right[i];
+            result[exponents] += leftCoefficient * rightCoefficient;
+        }
+        if (result.size() > MAX_TERMS)
+            throw std::runtime_error("Polynomial has too many terms");
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Проверка отсутствия переменных в поддереве.
+*/
+template <typename T>
+bool Polynomial<T>::isConstant(const Node* node) {
+
+    using Expr = Expression<T>;
+
+    if (dynamic_cast<const typename Expr::VariableNode*>(node))
+        return false;
+    if (const auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node))
+        return isConstant(binOpNode->left.get()) && isConstant(binOpNode->right.get());
+    if (const auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node))
+        return isConstant(unaryOpNode->arg.get());
+    if (const auto* funcNode = dynamic_cast<const typename Expr::FunctionNode*>(node))
+        return isConstant(funcNode->args[0].get()) && (funcNode->arity < 2 || isConstant(funcNode->args[1].get()));
+    if (const auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node))
+        return std::all_of(sumNode->terms.begin(), sumNode->terms.end(), 
+                           [](const auto& term) { return isConstant(term.second.get()); });
+    if (const auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node))
+        return std::all_of(productNode->factors.begin(), productNode->factors.end(), 
+                           [](const auto& factor) { return isConstant(factor.get()); });
+    return true;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Сбор имен переменных (с повторами).
+*/
+template <typename T>
+void Polynomial<T>::collectVariables(const Node* node, std::vector<std::string>& result) {
+
+    using Expr = Expression<T>;
+
+    if (const auto* varNode = dynamic_cast<const typename Expr::VariableNode*>(node)) {
+        result.push_back(varNode->name);
+    }
+    else if (const auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node)) {
+        collectVariables(binOpNode->left.get(), result);
+        collectVariables(binOpNode->right.get(), result);
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node)) {
+        collectVariables(unaryOpNode->arg.get(), result);
+    }
+    else if (const auto* funcNode = dynamic_cast<const typename Expr::FunctionNode*>(node)) {
+        for (unsigned i = 0; i < funcNode->arity; i++)
+            collectVariables(funcNode->args[i].get(), result);
+    }
+    else if (const auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node)) {
+        for (const auto& term : sumNode->terms)
+            collectVariables(term.second.get(), result);
+    }
+    else if (const auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node)) {
+        for (const auto& factor : productNode->factors)
+            collectVariables(factor.get(), result);
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Запись поддерева-многочлена по схеме Горнера; если раскрыть его не удалось (например,
+нецелый показатель), поддерево копируется как есть.
+*/
+template <typename T>
+std::unique_ptr<typename Polynomial<T>::Node> Polynomial<T>::replaceSubtree(const Expression<T>& expr, const Node* node) {
+
+    using Expr = Expression<T>;
+
+    bool operation = dynamic_cast<const typename Expr::BinaryOperationNode*>(node) ||
+                     dynamic_cast<const typename Expr::UnaryOperationNode*>(node) ||
+                     dynamic_cast<const typename Expr::SumNode*>(node) ||
+                     dynamic_cast<const typename Expr::ProductNode*>(node);
+    if (!operation || isConstant(node))
+        return expr.copyTree(node);
+
+    try {
+        Polynomial<T> polynomial;
+        collectVariables(node, polynomial.names);
+        std::sort(polynomial.names.begin(), polynomial.names.end());
+        polynomial.names.erase(std::unique(polynomial.names.begin(), polynomial.names.end()), polynomial.names.end());
+        for (auto& [exponents, coefficient] : convert(node, polynomial.names))
+            polynomial.monomials.push_back({coefficient, exponents});
+        return std::move(polynomial.toHornerExpression().root);
+    }
+    catch (const std::runtime_error&) {
+        return expr.copyTree(node);
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Тело hornerize. polynomial — может ли поддерево быть многочленом (по виду узлов); такое поддерево
+копируется как есть, а заменяет его родитель (или hornerize для корня), чтобы заменялись только
+наибольшие поддеревья. Потомки-многочлены узла, который сам не многочлен, заменяются здесь.
+*/
+template <typename T>
+std::unique_ptr<typename Polynomial<T>::Node>
+Polynomial<T>::hornerizeHelper(const Expression<T>& expr, const Node* node, bool& polynomial) {
+
+    using Expr = Expression<T>;
+
+    // Копия потомка: наибольшие поддеревья-многочлены заменяются, если сам узел не многочлен.
+    auto child = [&](const Node* arg, bool& argPolynomial) { return hornerizeHelper(expr, arg, argPolynomial); };
+    auto finish = [&](const Node* arg, std::unique_ptr<Node> copy, bool argPolynomial) {
+        return !polynomial && argPolynomial ? replaceSubtree(expr, arg) : std::move(copy);
+    };
+
+    if (const auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node)) {
+
+        bool leftPolynomial = false, rightPolynomial = false;
+        auto left = child(binOpNode->left.get(), leftPolynomial);
+        auto right = child(binOpNode->right.get(), rightPolynomial);
+
+        switch (binOpNode->operation) {
+            case '+': case '-': case '*': polynomial = leftPolynomial && rightPolynomial; break;
+            case '/': case '^': polynomial = leftPolynomial && isConstant(binOpNode->right.get()); break;
+            default: polynomial = false; break;
+        }
+
+        auto copy = std::make_unique<typename Expr::BinaryOperationNode>(binOpNode->operation,
+            finish(binOpNode->left.get(), std::move(left), leftPolynomial),
+            finish(binOpNode->right.get(), std::move(right), rightPolynomial));
+        copy->exponent = binOpNode->exponent;
+        return copy;
+    }
+    else if (const auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node)) {
+
+        bool argPolynomial = false;
+        auto arg = child(unaryOpNode->arg.get(), argPolynomial);
+        polynomial = argPolynomial && unaryOpNode->operation == '-';
+        return std::make_unique<typename Expr::UnaryOperationNode>(unaryOpNode->operation,
+            finish(unaryOpNode->arg.get(), std::move(arg), argPolynomial));
+    }
+    else if (const auto* funcNode = dynamic_cast<const typename Expr::FunctionNode*>(node)) {
+
+        std::unique_ptr<Node> args[Expr::FunctionNode::MAX_ARITY];
+        for (unsigned i = 0; i < funcNode->arity; i++) {
+            bool argPolynomial = false;
+            auto arg = child(funcNode->args[i].get(), argPolynomial);
+            args[i] = finish(funcNode->args[i].get(), std::move(arg), argPolynomial);
+        }
+        polynomial = isConstant(node);
+        return std::make_unique<typename Expr::FunctionNode>(funcNode->id, std::move(args[0]), std::move(args[1]));
+    }
+    else if (const auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node)) {
+
+        std::vector<typename Expr::SignedTerm> terms;
+        std::vector<char> termPolynomial(sumNode->terms.size(), false);
+        polynomial = true;
+        for (size_t i = 0; i < sumNode->terms.size(); i++) {
+            bool argPolynomial = false;
+            terms.emplace_back(sumNode->terms[i].first, child(sumNode->terms[i].second.get(), argPolynomial));
+            termPolynomial[i] = argPolynomial;
+            polynomial = polynomial && argPolynomial;
+        }
+        for (size_t i = 0; i < terms.size(); i++)
+            terms[i].second = finish(sumNode->terms[i].second.get(), std::move(terms[i].second), termPolynomial[i]);
+        return std::make_unique<typename Expr::SumNode>(std::move(terms));
+    }
+    else if (const auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node)) {
+
+        std::vector<std::unique_ptr<Node>> factors;
+        std::vector<char> factorPolynomial(productNode->factors.size(), false);
+        polynomial = true;
+        for (size_t i = 0; i < productNode->factors.size(); i++) {
+            bool argPolynomial = false;
+            factors.push_back(child(productNode->factors[i].get(), argPolynomial));
+            factorPolynomial[i] = argPolynomial;
+            polynomial = polynomial && argPolynomial;
+        }
+        for (size_t i = 0; i < factors.size(); i++)
+            factors[i] = finish(productNode->factors[i].get(), std::move(factors[i]), factorPolynomial[i]);
+        return std::make_unique<typename Expr::ProductNode>(std::move(factors));
+    }
+
+    polynomial = true; // Число или переменная.
+    return expr.copyTree(node);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Конец группы одночленов с одинаковой степенью переменной level.
+*/
+template <typename T>
+size_t Polynomial<T>::groupEnd(size_t level, size_t begin, size_t end) const {
+
+    size_t next = begin + 1;
+    while (next < end && monomials[next].exponents[level] == monomials[begin].exponents[level])
+        next++;
+    return next;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Вычисление по переменной level: группы одночленов с одинаковой степенью этой переменной дают
+коэффициенты (многочлены от следующих переменных), которые объединяются по схеме Горнера
+(пропуски степеней — через integerPower) или Эстрина (коэффициенты раскладываются в плотный
+массив в scratch, затем соседние пары сворачиваются с x, x^2, x^4, ...).
+*/
+template <typename T>
+T Polynomial<T>::evaluateHelper(size_t level, size_t begin, size_t end, const T* values,
+                                Scheme scheme, std::vector<T>& scratch) const {
+
+    if (level == names.size())
+        return monomials[begin].coefficient; // Степени всех переменных совпадают — одночлен один.
+
+    const T& x = values[level];
+    unsigned top = monomials[begin].exponents[level];
+
+    if (scheme == Scheme::Horner || top == 0) {
+
+        T result{};
+        unsigned previous = 0;
+        for (size_t group = begin; group < end; ) {
+            size_t next = groupEnd(level, group, end);
+            unsigned exponent = monomials[group].exponents[level];
+            T coefficient = evaluateHelper(level + 1, group, next, values, scheme, scratch);
+            result = group == begin ? coefficient : result * integerPower(x, previous - exponent) + coefficient;
+            previous = exponent;
+            group = next;
+        }
+        return previous ? result * integerPower(x, previous) : result;
+    }
+
+    size_t base = scratch.size(), count = top + 1;
+    scratch.resize(base + count, static_cast<T>(0));
+
+    for (size_t group = begin; group < end; ) {
+        size_t next = groupEnd(level, group, end);
+        T coefficient = evaluateHelper(level + 1, group, next, values, scheme, scratch);
+        scratch[base + monomials[group].exponents[level]] = coefficient;
+        group = next;
+    }
+
+    T power = x;
+    while (count > 1) {
+        size_t half = (count + 1) / 2;
+        for (size_t i = 0; i < half; i++) {
+            scratch[base + i] = 2 * i + 1 < count ? scratch[base + 2 * i] + scratch[base + 2 * i + 1] * power
+                                                  : scratch[base + 2 * i];
+        }
+        power *= power;
+        count = half;
+    }
+
+    T result = scratch[base];
+    scratch.resize(base);
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Запись по Горнеру: (((c_n) * x^(n - m) + c_m) * x^(m - k) + c_k) * x^k,
+где коэффициенты — записи по следующим переменным.
+*/
+template <typename T>
+std::unique_ptr<typename Polynomial<T>::Node> Polynomial<T>::hornerHelper(size_t level, size_t begin, size_t end) const {
+
+    using Expr = Expression<T>;
+
+    if (level == names.size())
+        return Expr::valueNode(monomials[begin].coefficient);
+
+    // x ^ k (x при k = 1).
+    auto power = [&](unsigned exponent) -> std::unique_ptr<Node> {
+        auto variable = std::make_unique<typename Expr::VariableNode>(names[level]);
+        if (exponent == 1) return variable;
+        return Expr::powerNode(std::move(variable), std::make_unique<typename Expr::NumberNode>(static_cast<T>(exponent)));
+    };
+
+    // node * x ^ k (просто x ^ k, если node — единица).
+    auto times = [&](std::unique_ptr<Node> node, unsigned exponent) -> std::unique_ptr<Node> {
+        const auto* numNode = dynamic_cast<const typename Expr::NumberNode*>(node.get());
+        if (numNode && numNode->value == static_cast<T>(1)) return power(exponent);
+        return std::make_unique<typename Expr::BinaryOperationNode>('*', std::move(node), power(exponent));
+    };
+
+    std::unique_ptr<Node> result;
+    unsigned previous = 0;
+    for (size_t group = begin; group < end; ) {
+        size_t next = groupEnd(level, group, end);
+        unsigned exponent = monomials[group].exponents[level];
+        auto coefficient = hornerHelper(level + 1, group, next);
+        if (!result)
+            result = std::move(coefficient);
+        else
+            result = std::make_unique<typename Expr::BinaryOperationNode>
+                ('+', times(std::move(result), previous - exponent), std::move(coefficient));
+        previous = exponent;
+        group = next;
+    }
+
+    return previous ? times(std::move(result), previous) : std::move(result);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Одночлен без коэффициента.
+*/
+template <typename T>
+std::unique_ptr<typename Polynomial<T>::Node> Polynomial<T>::monomialNode(const std::vector<unsigned>& exponents) const {
+
+    using Expr = Expression<T>;
+
+    std::unique_ptr<Node> result;
+    for (size_t i = 0; i < names.size(); i++) {
+
+        if (exponents[i] == 0) continue;
+
+        std::unique_ptr<Node> factor = std::make_unique<typename Expr::VariableNode>(names[i]);
+        if (exponents[i] > 1)
+            factor = Expr::powerNode(std::move(factor), std::make_unique<typename Expr::NumberNode>(static_cast<T>(exponents[i])));
+
+        result = result ? std::make_unique<typename Expr::BinaryOperationNode>('*', std::move(result), std::move(factor))
+                        : std::move(factor);
+    }
+    return result;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class Polynomial<float>;
+template class Polynomial<double>;
+template class Polynomial<long double>;
+template class Polynomial<std::complex<double>>;
+template class Polynomial<std::complex<long double>>;
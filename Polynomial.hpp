@@ -0,0 +1,157 @@
+#ifndef EXPR_POLYNOMIAL_HPP
+#define EXPR_POLYNOMIAL_HPP
+
+#include "Expression.hpp"
+#include <map>
+
+/*
+Разреженный многочлен от нескольких переменных: список одночленов (коэффициент и степени переменных).
+Строится из выражения, составленного из чисел, переменных, +, -, *, деления на константу и целых
+неотрицательных степеней; поддеревья без переменных (например, sin(2)) становятся коэффициентами.
+Производная берется точно (на коэффициентах), значение считается по схеме Горнера или Эстрина
+без вызовов pow. Одночлены с нулевым коэффициентом не хранятся.
+*/
+template <typename T>
+class Polynomial {
+public:
+
+    /*
+    Одночлен: коэффициент и степени переменных в порядке variables().
+    */
+    struct Term {
+
+        T coefficient;
+        std::vector<unsigned> exponents;
+    };
+
+    /*
+    Схема вычисления. Горнер — наименьшее число умножений; Эстрин — коэффициенты по парам
+    (c0 + c1 x) + (c2 + c3 x) x^2 + ..., цепочки умножений короче, и у процессора больше
+    независимых операций (выгоднее для плотных многочленов высокой степени).
+    */
+    enum class Scheme { Horner, Estrin };
+
+    /*
+    Многочлен из выражения. Если выражение не многочлен (функция от переменной, деление на
+    переменную, нецелый или отрицательный показатель), бросается исключение.
+    */
+    explicit Polynomial(const Expression<T>&);
+
+    /*
+    Является ли выражение многочленом.
+    */
+    static bool isPolynomial(const Expression<T>&);
+
+    /*
+    Копия выражения, в которой каждое наибольшее поддерево-многочлен (с переменными и хотя бы
+    одной операцией) заменено записью по схеме Горнера.
+    */
+    static Expression<T> hornerize(const Expression<T>&);
+
+    /*
+    Значение многочлена при заданных значениях переменных.
+    */
+    T evaluate(const std::unordered_map<std::string, T>&, Scheme = Scheme::Horner) const;
+
+    /*
+    Вычисление без выделений памяти: values — значения переменных в порядке variables(),
+    scratch — рабочий массив схемы Эстрина (растет при первых вызовах).
+    */
+    T evaluate(const std::vector<T>& values, Scheme, std::vector<T>& scratch) const;
+
+    /*
+    Точная производная по переменной.
+    */
+    Polynomial<T> differentiate(const std::string&) const;
+
+    /*
+    Выражение в развернутом виде: сумма одночленов по убыванию степеней.
+    */
+    Expression<T> toExpression() const;
+
+    /*
+    Выражение по схеме Горнера (вложенной по переменным).
+    */
+    Expression<T> toHornerExpression() const;
+
+    /*
+    Развернутый вид в строку.
+    */
+    std::string toString() const;
+
+    const std::vector<std::string>& variables() const;
+
+    const std::vector<Term>& terms() const;
+
+    /*
+    Полная степень (наибольшая сумма степеней одночлена).
+    */
+    unsigned degree() const;
+
+private:
+
+    using Node = typename Expression<T>::Node;
+
+    /*
+    Одночлены по убыванию степеней (лексикографически по variables()) при построении.
+    */
+    using Monomials = std::map<std::vector<unsigned>, T, std::greater<>>;
+
+    std::vector<std::string> names;
+    std::vector<Term> monomials; // В том же порядке, что и Monomials.
+
+    Polynomial() = default;
+
+    /*
+    Многочлен поддерева (бросает исключение, если поддерево не многочлен).
+    */
+    static Monomials convert(const Node*, const std::vector<std::string>& names);
+
+    /*
+    Произведение многочленов.
+    */
+    static Monomials multiply(const Monomials&, const Monomials&);
+
+    /*
+    Поддерево без переменных.
+    */
+    static bool isConstant(const Node*);
+
+    /*
+    Имена переменных поддерева.
+    */
+    static void collectVariables(const Node*, std::vector<std::string>&);
+
+    /*
+    Тело hornerize: копия поддерева с замененными многочленами; polynomial — может ли
+    само поддерево быть многочленом.
+    */
+    static std::unique_ptr<Node> hornerizeHelper(const Expression<T>&, const Node*, bool& polynomial);
+
+    /*
+    Поддерево-многочлен по схеме Горнера (копия, если раскрыть его не удалось).
+    */
+    static std::unique_ptr<Node> replaceSubtree(const Expression<T>&, const Node*);
+
+    /*
+    Значение одночленов [begin, end), у которых совпадают степени переменных до level.
+    */
+    T evaluateHelper(size_t level, size_t begin, size_t end, const T* values, Scheme, std::vector<T>& scratch) const;
+
+    /*
+    Запись одночленов [begin, end) по схеме Горнера по переменным начиная с level.
+    */
+    std::unique_ptr<Node> hornerHelper(size_t level, size_t begin, size_t end) const;
+
+    /*
+    Одночлен без коэффициента: x ^ a * y ^ b * ... (nullptr для константы).
+    */
+    std::unique_ptr<Node> monomialNode(const std::vector<unsigned>& exponents) const;
+
+    /*
+    Конец группы одночленов, начинающейся с begin, с одинаковой степенью переменной level.
+    */
+    size_t groupEnd(size_t level, size_t begin, size_t end) const;
+};
+
+#endif
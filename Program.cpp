@@ -0,0 +1,981 @@
+#include "Program.hpp"
+#include <algorithm>
+#include <optional>
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Компиляция: деревья обходятся по очереди, и каждое поддерево заменяется номером инструкции.
+Инструкции идут в порядке обхода, поэтому аргументы всегда вычисляются раньше.
+*/
+template <typename T>
+Program<T>::Program(const std::vector<Expression<T>>& exprs, unsigned level, bool fuse) {
+
+    for (const auto& expr : exprs) {
+
+        if (!expr.root)
+            throw std::runtime_error("Expression tree is empty");
+
+        results.push_back(compile(expr.root.get()));
+        stats.treeNodes += expr.nodeCount();
+    }
+
+    stats.outputs = results.size();
+    stats.unoptimized = code.size();
+    if (level > 0)
+        optimize(level);
+    if (fuse)
+        fuseSinCos();
+    stats.instructions = code.size();
+    known.clear();
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВЫПОЛНЕНИЕ ИНСТРУКЦИЙ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Длина блока пакетного вычисления. Постоянное число итераций (и __restrict) позволяет
+компилятору векторизовать циклы над блоком уже при -O2.
+*/
+static constexpr size_t PROGRAM_BLOCK = 256;
+
+/*
+out[i] = f(a[i], b[i]) над блоком.
+*/
+template <typename T, typename F>
+static void blockKernel(T* __restrict out, const T* __restrict a, const T* __restrict b, F f) {
+
+    for (size_t i = 0; i < PROGRAM_BLOCK; i++)
+        out[i] = f(a[i], b[i]);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Одна операция над значениями аргументов. Проверки области определения те же, что в
+Expression::evaluateHelper; для Sqrt — те же, что у x ^ 0.5, который она заменяет, 
+а степени считаются теми же функциями, что и raisePower.
+Используется и при вычислении, и при свертке констант, поэтому свертка дает ровно то же значение.
+*/
+template <typename T>
+inline T Program<T>::apply(Operation operation, const T& left, const T& right, uint16_t function) {
+
+    using std::pow, std::sin, std::cos, std::log, std::exp, std::sqrt;
+
+    switch (operation) {
+
+        case Operation::Add: return left + right;
+
+        case Operation::Subtract: return left - right;
+
+        case Operation::Multiply: return left * right;
+
+        case Operation::Divide:
+            if (right == static_cast<T>(0))
+                throw std::runtime_error("Division by zero");
+            return left / right;
+
+        case Operation::Power:
+            if constexpr (std::is_floating_point_v<T>) {
+                if (isEvenRootOfNegative(left, right))
+                    throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+            }
+            return pow(left, right);
+
+        case Operation::IntegerPower:
+            if constexpr (isComplex<T>)
+                return integerPower(left, static_cast<long>(right.real()));
+            else
+                return integerPower(left, static_cast<long>(right));
+
+        case Operation::OddRational:
+        case Operation::EvenRational:
+            if constexpr (std::is_floating_point_v<T>)
+                return rationalPower(left, right, operation == Operation::OddRational);
+            else
+                throw std::runtime_error("Invalid instruction");
+
+        case Operation::Negate: return -left;
+
+        case Operation::Sin: return sin(left);
+
+        case Operation::Cos: return cos(left);
+
+        case Operation::Ln:
+            if (left == static_cast<T>(0))
+                throw std::runtime_error("Argument of ln <= 0 is not allowed");
+            if constexpr (std::is_floating_point_v<T>) {
+                if (left <= 0.0)
+                    throw std::runtime_error("Argument of ln <= 0 is not allowed");
+            }
+            return log(left);
+
+        case Operation::Exp: return exp(left);
+
+        case Operation::Sqrt:
+            if constexpr (std::is_floating_point_v<T>) {
+                if (left < 0)
+                    throw std::runtime_error("Argument of sqrt < 0 and even sqrt power is not allowed");
+            }
+            return sqrt(left);
+
+        case Operation::Cbrt:
+            if constexpr (std::is_floating_point_v<T>)
+                return std::cbrt(left);
+            else
+                throw std::runtime_error("Invalid instruction");
+
+        case Operation::Min: return applyFunction(Function::Min, left, right);
+        case Operation::Max: return applyFunction(Function::Max, left, right);
+        case Operation::Tan: return applyFunction(Function::Tan, left, left);
+        case Operation::Abs: return applyFunction(Function::Abs, left, left);
+        case Operation::Sign: return applyFunction(Function::Sign, left, left);
+        case Operation::Atan: return applyFunction(Function::Atan, left, left);
+        case Operation::Sinh: return applyFunction(Function::Sinh, left, left);
+        case Operation::Cosh: return applyFunction(Function::Cosh, left, left);
+        case Operation::Tanh: return applyFunction(Function::Tanh, left, left);
+        case Operation::Log10: return applyFunction(Function::Log10, left, left);
+        case Operation::Erf: return applyFunction(Function::Erf, left, left);
+
+        case Operation::CallUnary: return Expression<T>::template callFunction<T>(function, left, left);
+        case Operation::CallBinary: return Expression<T>::template callFunction<T>(function, left, right);
+
+        default: throw std::runtime_error("Invalid instruction");
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+apply с приближенными sin, cos, exp и ln (FastMath.hpp) для вещественных типов.
+*/
+template <typename T>
+inline T Program<T>::apply(Operation operation, const T& left, const T& right, uint16_t function, 
+                           Accuracy accuracy) {
+
+    if constexpr (std::is_floating_point_v<T>) {
+        if (accuracy != Accuracy::Exact && operation >= Operation::Sin && operation <= Operation::Exp) {
+            if (operation == Operation::Ln && left <= 0)
+                throw std::runtime_error("Argument of ln <= 0 is not allowed");
+            auto approximated = static_cast<Function>(static_cast<int>(operation) - static_cast<int>(Operation::Sin));
+            return static_cast<T>(approximate(accuracy, approximated, static_cast<double>(left)));
+        }
+    }
+    return apply(operation, left, right, function);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Точные sin и cos одного аргумента: sincos из glibc делает одно приведение аргумента на двоих
+и дает те же биты, что sin и cos по отдельности. Без glibc — два вызова.
+*/
+static void exactSinCos(float x, float& sinX, float& cosX) {
+#ifdef __GLIBC__
+    ::sincosf(x, &sinX, &cosX);
+#else
+    sinX = std::sin(x);
+    cosX = std::cos(x);
+#endif
+}
+
+static void exactSinCos(double x, double& sinX, double& cosX) {
+#ifdef __GLIBC__
+    ::sincos(x, &sinX, &cosX);
+#else
+    sinX = std::sin(x);
+    cosX = std::cos(x);
+#endif
+}
+
+static void exactSinCos(long double x, long double& sinX, long double& cosX) {
+#ifdef __GLIBC__
+    ::sincosl(x, &sinX, &cosX);
+#else
+    sinX = std::sin(x);
+    cosX = std::cos(x);
+#endif
+}
+
+// --------------------------------------------------------------- //
+
+/*
+sin и cos одного аргумента. Комплексные программы SinCos не содержат (fuseSinCos их пропускает).
+*/
+template <typename T>
+void Program<T>::sinCos(const T& x, T& sinX, T& cosX, Accuracy accuracy) {
+
+    if constexpr (std::is_floating_point_v<T>) {
+        if (accuracy == Accuracy::Exact) {
+            exactSinCos(x, sinX, cosX);
+            return;
+        }
+        double s, c;
+        approximateSinCos(accuracy, static_cast<double>(x), s, c);
+        sinX = static_cast<T>(s);
+        cosX = static_cast<T>(c);
+    }
+    else {
+        sinX = std::sin(x);
+        cosX = std::cos(x);
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Вычисление всех выходов при заданных значениях переменных.
+*/
+template <typename T>
+std::vector<T> Program<T>::evaluate(const std::unordered_map<std::string, T>& vars, Accuracy accuracy) const {
+
+    std::vector<T> values(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        auto it = vars.find(names[i]);
+        if (it == vars.end())
+            throw std::runtime_error("Unbound variable: " + names[i]);
+        values[i] = it->second;
+    }
+
+    std::vector<T> outputs, registers;
+    evaluate(values, outputs, registers, accuracy);
+    return outputs;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Один проход по инструкциям. Проверки области определения те же, что в Expression::evaluateHelper.
+*/
+template <typename T>
+void Program<T>::evaluate(const std::vector<T>& values, std::vector<T>& outputs, std::vector<T>& registers,
+                          Accuracy accuracy) const {
+
+    if (values.size() != names.size())
+        throw std::runtime_error("Program expects " + std::to_string(names.size()) + " variable values");
+
+    registers.resize(code.size());
+    T* reg = registers.data();
+
+    for (size_t i = 0; i < code.size(); i++) {
+
+        const Instruction& instruction = code[i];
+
+        switch (instruction.operation) {
+            case Operation::Constant: reg[i] = constants[instruction.left]; break;
+            case Operation::Variable: reg[i] = values[instruction.left]; break;
+            case Operation::SinCos: sinCos(reg[instruction.left], reg[i], reg[instruction.right], accuracy); break;
+            case Operation::CosSin: sinCos(reg[instruction.left], reg[instruction.right], reg[i], accuracy); break;
+            case Operation::Paired: break; // Значение уже записано парной инструкцией.
+            default: 
+                reg[i] = apply(instruction.operation, reg[instruction.left], reg[instruction.right], 
+                               instruction.function, accuracy); 
+                break;
+        }
+    }
+
+    outputs.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++)
+        outputs[i] = reg[results[i]];
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Пакетное вычисление по словарю столбцов.
+*/
+template <typename T>
+std::vector<std::vector<T>> Program<T>::evaluateBatch(const std::unordered_map<std::string, std::vector<T>>& vars,
+                                                      Accuracy accuracy) const {
+
+    size_t n = vars.empty() ? 1 : vars.begin()->second.size();
+    std::vector<const T*> columns(names.size());
+
+    for (size_t i = 0; i < names.size(); i++) {
+        auto it = vars.find(names[i]);
+        if (it == vars.end())
+            throw std::runtime_error("Unbound variable: " + names[i]);
+        if (it->second.size() != n)
+            throw std::runtime_error("Batch columns have different sizes");
+        columns[i] = it->second.data();
+    }
+
+    std::vector<std::vector<T>> outputs(results.size(), std::vector<T>(n));
+    std::vector<T*> buffers;
+    for (auto& output : outputs)
+        buffers.push_back(output.data());
+
+    evaluateBatch(columns.data(), n, buffers.data(), accuracy);
+    return outputs;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Пакетное вычисление: столбцы переменных режутся на блоки по PROGRAM_BLOCK значений (последний 
+дополняется копиями первого значения блока, чтобы не породить ложных ошибок области определения),
+и каждая инструкция выполняется над целым блоком. Регистр — блок, а не одно число.
+*/
+template <typename T>
+void Program<T>::evaluateBatch(const T* const* columns, size_t n, T* const* outputs, Accuracy accuracy) const {
+
+    std::vector<T> registers(code.size() * PROGRAM_BLOCK);
+    auto block = [&](uint32_t index) { return registers.data() + static_cast<size_t>(index) * PROGRAM_BLOCK; };
+
+    for (size_t start = 0; start < n; start += PROGRAM_BLOCK) {
+
+        size_t count = std::min(PROGRAM_BLOCK, n - start);
+
+        for (size_t i = 0; i < code.size(); i++) {
+
+            const Instruction& instruction = code[i];
+            Operation operation = instruction.operation;
+            T* out = block(static_cast<uint32_t>(i));
+
+            if (operation == Operation::Constant) {
+                std::fill(out, out + PROGRAM_BLOCK, constants[instruction.left]);
+                continue;
+            }
+            if (operation == Operation::Variable) {
+                const T* column = columns[instruction.left] + start;
+                std::copy(column, column + count, out);
+                std::fill(out + count, out + PROGRAM_BLOCK, column[0]);
+                continue;
+            }
+
+            const T* a = block(instruction.left);
+            const T* b = block(instruction.right);
+
+            switch (operation) {
+
+                case Operation::Add: blockKernel(out, a, b, [](T x, T y) { return x + y; }); break;
+
+                case Operation::Subtract: blockKernel(out, a, b, [](T x, T y) { return x - y; }); break;
+
+                case Operation::Multiply: blockKernel(out, a, b, [](T x, T y) { return x * y; }); break;
+
+                case Operation::Divide:
+                    if (std::find(b, b + PROGRAM_BLOCK, static_cast<T>(0)) != b + PROGRAM_BLOCK)
+                        throw std::runtime_error("Division by zero");
+                    blockKernel(out, a, b, [](T x, T y) { return x / y; });
+                    break;
+
+                case Operation::Negate: blockKernel(out, a, a, [](T x, T) { return -x; }); break;
+
+                case Operation::SinCos:
+                case Operation::CosSin: {
+                    T* other = block(instruction.right);
+                    T* sines = operation == Operation::SinCos ? out : other;
+                    T* cosines = operation == Operation::SinCos ? other : out;
+                    if constexpr (std::is_floating_point_v<T>) {
+                        if (accuracy != Accuracy::Exact) {
+                            approximateSinCosArray(accuracy, a, sines, cosines, PROGRAM_BLOCK);
+                            break;
+                        }
+                    }
+                    for (size_t j = 0; j < PROGRAM_BLOCK; j++)
+                        sinCos(a[j], sines[j], cosines[j], Accuracy::Exact);
+                    break;
+                }
+
+                case Operation::Paired: break;
+
+                default:
+                    if constexpr (std::is_floating_point_v<T>) {
+                        if (accuracy != Accuracy::Exact && operation >= Operation::Sin && operation <= Operation::Exp) {
+                            if (operation == Operation::Ln && std::any_of(a, a + PROGRAM_BLOCK, [](T x) { return x <= 0; }))
+                                throw std::runtime_error("Argument of ln <= 0 is not allowed");
+                            std::copy(a, a + PROGRAM_BLOCK, out);
+                            approximateArray(accuracy, 
+                                             static_cast<Function>(static_cast<int>(operation) - static_cast<int>(Operation::Sin)),
+                                             out, PROGRAM_BLOCK);
+                            break;
+                        }
+                    }
+                    for (size_t j = 0; j < PROGRAM_BLOCK; j++)
+                        out[j] = apply(operation, a[j], b[j], instruction.function);
+                    break;
+            }
+        }
+
+        for (size_t k = 0; k < results.size(); k++)
+            std::copy(block(results[k]), block(results[k]) + count, outputs[k] + start);
+    }
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Имена переменных.
+*/
+template <typename T>
+const std::vector<std::string>& Program<T>::variables() const {
+
+    return names;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Инструкции программы.
+*/
+template <typename T>
+const std::vector<typename Program<T>::Instruction>& Program<T>::instructions() const {
+
+    return code;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Статистика компиляции.
+*/
+template <typename T>
+const typename Program<T>::Statistics& Program<T>::statistics() const {
+
+    return stats;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Доля общих узлов.
+*/
+template <typename T>
+double Program<T>::Statistics::sharedFraction() const {
+
+    return treeNodes ? 1.0 - static_cast<double>(instructions) / treeNodes : 0.0;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Компиляция поддерева. У '+' и '*' аргументы упорядочиваются, чтобы x * y и y * x давали
+одну инструкцию (результат в IEEE от порядка аргументов не зависит).
+*/
+template <typename T>
+uint32_t Program<T>::compile(const Node* node) {
+
+    using Expr = Expression<T>;
+
+    if (auto* numNode = dynamic_cast<const typename Expr::NumberNode*>(node)) {
+        return constant(numNode->value);
+    }
+    else if (auto* varNode = dynamic_cast<const typename Expr::VariableNode*>(node)) {
+
+        auto found = known.find({Operation::Variable, 0, 0, varNode->name, 0});
+        if (found != known.end()) return found->second;
+
+        names.push_back(varNode->name);
+        return emit(Operation::Variable, static_cast<uint32_t>(names.size() - 1), 0, varNode->name);
+    }
+    else if (auto* binOpNode = dynamic_cast<const typename Expr::BinaryOperationNode*>(node)) {
+
+        uint32_t left = compile(binOpNode->left.get());
+
+        if (binOpNode->operation == '^') { // Показатель нужен только для Power и p / q.
+            // Узлы, собранные не разбором (без вида показателя), классифицируются здесь, при компиляции.
+            ExponentClass cls = binOpNode->exponent.kind != ExponentClass::General ? binOpNode->exponent 
+                                                                                   : Expr::classifyExponent(binOpNode->right.get());
+            switch (cls.kind) {
+                case ExponentClass::Integer: 
+                    return emit(Operation::IntegerPower, left, constant(static_cast<T>(cls.numerator)));
+                case ExponentClass::SquareRoot: return emit(Operation::Sqrt, left, 0);
+                case ExponentClass::CubeRoot: return emit(Operation::Cbrt, left, 0);
+                case ExponentClass::OddRoot: 
+                    return emit(cls.numerator % 2 ? Operation::OddRational : Operation::EvenRational, 
+                                left, compile(binOpNode->right.get()));
+                default: break;
+            }
+        }
+
+        uint32_t right = compile(binOpNode->right.get());
+
+        switch (binOpNode->operation) {
+            case '+': return emit(Operation::Add, std::min(left, right), std::max(left, right));
+            case '-': return emit(Operation::Subtract, left, right);
+            case '*': return emit(Operation::Multiply, std::min(left, right), std::max(left, right));
+            case '/': return emit(Operation::Divide, left, right);
+            case '^': return emit(Operation::Power, left, right);
+            default: throw std::runtime_error("Unknown binary operator");
+        }
+    }
+    else if (auto* funcNode = dynamic_cast<const typename Expr::FunctionNode*>(node)) {
+
+        // Операции встроенных функций в порядке Function.
+        static const Operation BUILTINS[] = {
+            Operation::Sin, Operation::Cos, Operation::Ln, Operation::Exp, Operation::Tan, Operation::Sqrt,
+            Operation::Abs, Operation::Sign, Operation::Atan, Operation::Sinh, Operation::Cosh, Operation::Tanh,
+            Operation::Log10, Operation::Erf, Operation::Min, Operation::Max
+        };
+        static_assert(std::size(BUILTINS) == static_cast<size_t>(Function::BUILTINS));
+
+        uint32_t arg = compile(funcNode->args[0].get());
+        uint32_t second = funcNode->arity > 1 ? compile(funcNode->args[1].get()) : 0;
+
+        if (funcNode->id < static_cast<uint16_t>(Function::BUILTINS)) {
+            Operation operation = BUILTINS[funcNode->id];
+            if (operation == Operation::Min || operation == Operation::Max) // Симметричны, как '+' и '*'.
+                return emit(operation, std::min(arg, second), std::max(arg, second));
+            return emit(operation, arg, 0);
+        }
+        return emit(funcNode->arity > 1 ? Operation::CallBinary : Operation::CallUnary, arg, second, "", funcNode->id);
+    }
+    else if (auto* unaryOpNode = dynamic_cast<const typename Expr::UnaryOperationNode*>(node)) {
+
+        uint32_t arg = compile(unaryOpNode->arg.get());
+
+        switch (unaryOpNode->operation) {
+            case '-': return emit(Operation::Negate, arg, 0);
+            default: throw std::runtime_error("Unknown unary operator");
+        }
+    }
+    else if (auto* sumNode = dynamic_cast<const typename Expr::SumNode*>(node)) { // Цепочка Add и Subtract.
+
+        uint32_t sum = compile(sumNode->terms[0].second.get());
+        for (size_t i = 1; i < sumNode->terms.size(); i++) {
+            uint32_t term = compile(sumNode->terms[i].second.get());
+            sum = sumNode->terms[i].first == '-' ? emit(Operation::Subtract, sum, term)
+                                                 : emit(Operation::Add, std::min(sum, term), std::max(sum, term));
+        }
+        return sum;
+    }
+    else if (auto* productNode = dynamic_cast<const typename Expr::ProductNode*>(node)) {
+
+        uint32_t product = compile(productNode->factors[0].get());
+        for (size_t i = 1; i < productNode->factors.size(); i++) {
+            uint32_t factor = compile(productNode->factors[i].get());
+            product = emit(Operation::Multiply, std::min(product, factor), std::max(product, factor));
+        }
+        return product;
+    }
+
+    throw std::runtime_error("Invalid node type in compilation");
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Поиск инструкции с той же сигнатурой или добавление новой.
+*/
+template <typename T>
+uint32_t Program<T>::emit(Operation operation, uint32_t left, uint32_t right, const std::string& key, 
+                          uint16_t function) {
+
+    uint32_t leftKey = key.empty() ? left : 0; // У листов сигнатура — запись значения или имя.
+    auto [it, inserted] = known.emplace(std::make_tuple(operation, leftKey, right, key, function), 
+                                        static_cast<uint32_t>(code.size()));
+    if (inserted)
+        code.push_back({operation, function, left, right});
+    return it->second;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Константа. Числа различаются по шестнадцатеричной записи, т.е. точно.
+*/
+template <typename T>
+uint32_t Program<T>::constant(const T& value) {
+
+    std::ostringstream key;
+    key << std::hexfloat;
+    if constexpr (isComplex<T>)
+        key << static_cast<long double>(value.real()) << ',' << static_cast<long double>(value.imag());
+    else
+        key << static_cast<long double>(value);
+
+    auto found = known.find({Operation::Constant, 0, 0, key.str(), 0});
+    if (found != known.end()) return found->second;
+
+    constants.push_back(value);
+    return emit(Operation::Constant, static_cast<uint32_t>(constants.size() - 1), 0, key.str());
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Значение константной инструкции.
+*/
+template <typename T>
+const T* Program<T>::constantValue(uint32_t index) const {
+
+    return code[index].operation == Operation::Constant ? &constants[code[index].left] : nullptr;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Оптимизация. Старые инструкции переносятся в новую программу по порядку через simplify,
+renamed[i] — номер инструкции новой программы со значением старой инструкции i.
+*/
+template <typename T>
+void Program<T>::optimize(unsigned level) {
+
+    std::vector<Instruction> old = std::move(code);
+    std::vector<T> oldConstants = std::move(constants);
+    code.clear();
+    constants.clear();
+    known.clear();
+
+    std::vector<uint32_t> renamed(old.size());
+
+    for (size_t i = 0; i < old.size(); i++) {
+
+        const Instruction& instruction = old[i];
+
+        switch (instruction.operation) {
+            case Operation::Constant:
+                renamed[i] = constant(oldConstants[instruction.left]);
+                break;
+            case Operation::Variable:
+                renamed[i] = emit(Operation::Variable, instruction.left, 0, names[instruction.left]);
+                break;
+            default:
+                renamed[i] = simplify(instruction.operation, renamed[instruction.left], renamed[instruction.right], 
+                                      level, instruction.function);
+                break;
+        }
+    }
+
+    for (auto& result : results)
+        result = renamed[result];
+
+    eliminateDeadCode();
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Правила оптимизации. Свертка пропускает операции, которые бросают исключение (деление на ноль
+и т.п.): они остаются в программе и бросают его при вычислении, как и evaluate.
+*/
+template <typename T>
+uint32_t Program<T>::simplify(Operation operation, uint32_t left, uint32_t right, unsigned level, 
+                              uint16_t function) {
+
+    using Real = RealOf<T>;
+
+    bool unary = operation >= Operation::Negate;
+    if (unary) right = 0;
+
+    const T* a = constantValue(left);
+    const T* b = unary ? nullptr : constantValue(right);
+
+    // Целое вещественное значение константы (пусто для остальных).
+    auto integerOf = [](const T* value) -> std::optional<long> {
+        if (!value) return std::nullopt;
+        Real re;
+        if constexpr (isComplex<T>) {
+            if (value->imag() != 0) return std::nullopt;
+            re = value->real();
+        }
+        else {
+            re = *value;
+        }
+        if (std::trunc(re) != re) return std::nullopt;
+        return static_cast<long>(re);
+    };
+
+    // Обратное к константе и признак того, что оно точное (константа — степень двойки).
+    auto reciprocalOf = [](const T& value, bool& exact) -> std::optional<T> {
+        Real re, im = 0;
+        if constexpr (isComplex<T>) { re = value.real(); im = value.imag(); }
+        else re = value;
+        T inverse = static_cast<T>(1) / value;
+        if (!std::isfinite(std::abs(inverse)) || inverse == static_cast<T>(0)) return std::nullopt;
+        int exponent;
+        exact = im == 0 && std::isnormal(re) && std::frexp(std::abs(re), &exponent) == static_cast<Real>(0.5);
+        return inverse;
+    };
+
+    // Свертка константных поддеревьев.
+    if (a && (unary || b)) {
+        try {
+            T value = apply(operation, *a, unary ? *a : *b, function);
+            stats.rewrites["fold"]++;
+            return constant(value);
+        }
+        catch (const std::runtime_error&) {}
+    }
+
+    auto one = static_cast<T>(1), zero = static_cast<T>(0);
+
+    // Ноль с заданным знаком (у комплексных — в обеих частях).
+    auto isZero = [](const T& value, bool negative) {
+        if constexpr (isComplex<T>)
+            return value.real() == 0 && value.imag() == 0 &&
+                   std::signbit(value.real()) == negative && std::signbit(value.imag()) == negative;
+        else
+            return value == 0 && std::signbit(value) == negative;
+    };
+
+    // Тождества.
+    switch (operation) {
+        case Operation::Multiply:
+            if (b && *b == one) { stats.rewrites["identity"]++; return left; }
+            if (a && *a == one) { stats.rewrites["identity"]++; return right; }
+            break;
+        case Operation::Add:
+            // Только -0: x + (+0) при x = -0 дает +0, а не x.
+            if (b && isZero(*b, true)) { stats.rewrites["identity"]++; return left; }
+            if (a && isZero(*a, true)) { stats.rewrites["identity"]++; return right; }
+            break;
+        case Operation::Subtract:
+            // Только +0: x - (-0) = x + (+0).
+            if (b && isZero(*b, false)) { stats.rewrites["identity"]++; return left; }
+            break;
+        case Operation::Divide:
+            if (b && *b == one) { stats.rewrites["identity"]++; return left; }
+            break;
+        case Operation::IntegerPower:
+            if (b && *b == one) { stats.rewrites["identity"]++; return left; }
+            if (b && *b == zero) { stats.rewrites["identity"]++; return constant(one); }
+            break;
+        case Operation::Negate:
+            if (code[left].operation == Operation::Negate) { stats.rewrites["identity"]++; return code[left].left; }
+            break;
+        default:
+            break;
+    }
+
+    // Степени.
+    if (operation == Operation::IntegerPower) {
+        auto n = integerOf(b);
+        if (n && *n == 2) {
+            stats.rewrites["power"]++;
+            return power(left, 2);
+        }
+        if (level >= 2 && n && *n >= 3 && *n <= 16) {
+            stats.rewrites["power"]++;
+            return power(left, static_cast<unsigned>(*n));
+        }
+    }
+
+    // Деление на константу.
+    if (operation == Operation::Divide && b) {
+        bool exact = false;
+        if (auto inverse = reciprocalOf(*b, exact); inverse && (exact || level >= 2)) {
+            stats.rewrites["reciprocal"]++;
+            uint32_t factor = constant(*inverse);
+            return emit(Operation::Multiply, std::min(left, factor), std::max(left, factor));
+        }
+    }
+
+    // exp(a) * exp(b) и exp(a) / exp(b): погрешность округления a + b умножается на exp, поэтому только на уровне 3.
+    if (level >= 3 && (operation == Operation::Multiply || operation == Operation::Divide) &&
+        code[left].operation == Operation::Exp && code[right].operation == Operation::Exp) {
+        stats.rewrites["exp"]++;
+        uint32_t sum = simplify(operation == Operation::Multiply ? Operation::Add : Operation::Subtract,
+                                code[left].left, code[right].left, level);
+        return simplify(Operation::Exp, sum, 0, level);
+    }
+
+    if (operation == Operation::Add || operation == Operation::Multiply || 
+        operation == Operation::Min || operation == Operation::Max)
+        return emit(operation, std::min(left, right), std::max(left, right));
+    return emit(operation, left, right, "", function);
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Возведение в целую степень через квадраты: x^n = (x^(n/2))^2 * x^(n mod 2), 
+не больше 2 log2(n) умножений.
+*/
+template <typename T>
+uint32_t Program<T>::power(uint32_t base, unsigned exponent) {
+
+    if (exponent == 1) return base;
+
+    uint32_t half = power(base, exponent / 2);
+    uint32_t square = emit(Operation::Multiply, half, half);
+    if (exponent % 2 == 0) return square;
+    return emit(Operation::Multiply, std::min(square, base), std::max(square, base));
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Удаление ненужных инструкций: отмечаются инструкции, от которых зависят выходы (обходом с конца,
+так как аргументы всегда раньше), затем программа сжимается, а константы перенумеровываются.
+*/
+template <typename T>
+void Program<T>::eliminateDeadCode() {
+
+    std::vector<bool> live(code.size(), false);
+    for (uint32_t result : results)
+        live[result] = true;
+
+    for (size_t i = code.size(); i-- > 0; ) {
+        if (!live[i]) continue;
+        Operation operation = code[i].operation;
+        if (operation == Operation::Constant || operation == Operation::Variable) continue;
+        live[code[i].left] = true;
+        if (operation < Operation::Negate)
+            live[code[i].right] = true;
+    }
+
+    std::vector<uint32_t> renamed(code.size());
+    std::vector<Instruction> compact;
+    std::vector<T> usedConstants;
+
+    for (size_t i = 0; i < code.size(); i++) {
+
+        if (!live[i]) {
+            stats.eliminated++;
+            continue;
+        }
+
+        Instruction instruction = code[i];
+        if (instruction.operation == Operation::Constant) {
+            usedConstants.push_back(constants[instruction.left]);
+            instruction.left = static_cast<uint32_t>(usedConstants.size() - 1);
+        }
+        else if (instruction.operation != Operation::Variable) {
+            instruction.left = renamed[instruction.left];
+            if (instruction.operation < Operation::Negate)
+                instruction.right = renamed[instruction.right];
+        }
+
+        renamed[i] = static_cast<uint32_t>(compact.size());
+        compact.push_back(instruction);
+    }
+
+    code = std::move(compact);
+    constants = std::move(usedConstants);
+    for (auto& result : results)
+        result = renamed[result];
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Слияние sin и cos. Одинаковые инструкции уже объединены, поэтому у аргумента не больше одного
+Sin и одного Cos. Раньше стоящая из пары становится SinCos (CosSin) и записывает оба значения,
+вторая — Paired; аргумент стоит раньше обеих, так что порядок вычисления не нарушается.
+*/
+template <typename T>
+void Program<T>::fuseSinCos() {
+
+    if constexpr (std::is_floating_point_v<T>) {
+
+        std::unordered_map<uint32_t, uint32_t> sines;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (code[i].operation == Operation::Sin)
+                sines.emplace(code[i].left, static_cast<uint32_t>(i));
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+
+            if (code[i].operation != Operation::Cos) continue;
+            auto found = sines.find(code[i].left);
+            if (found == sines.end()) continue;
+
+            uint32_t cosine = static_cast<uint32_t>(i), sine = found->second;
+            uint32_t first = std::min(sine, cosine), second = std::max(sine, cosine);
+            code[first].operation = first == sine ? Operation::SinCos : Operation::CosSin;
+            code[first].right = second;
+            code[second].operation = Operation::Paired;
+            code[second].right = first;
+            stats.fusedSinCos++;
+        }
+    }
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class Program<float>;
+template class Program<double>;
+template class Program<long double>;
+template class Program<std::complex<double>>;
+template class Program<std::complex<long double>>;
@@ -0,0 +1,200 @@
+#ifndef EXPR_PROGRAM_HPP
+#define EXPR_PROGRAM_HPP
+
+#include "Expression.hpp"
+#include <map>
+#include <tuple>
+
+/*
+Программа вычисления сразу нескольких выражений (например, f и всех ее частных производных).
+Деревья всех выражений сливаются в одну последовательность инструкций, в которой каждое
+поддерево встречается один раз (одинаковые поддеревья разных выражений и одного выражения
+вычисляются однократно), и за один проход по ней вычисляются все выходы.
+Производные особенно выигрывают: правило для '^' в differentiate копирует исходное поддерево
+целиком, а производные по разным переменным повторяют одни и те же множители.
+*/
+template <typename T>
+class Program {
+public:
+
+    /*
+    Операция инструкции. Аргументы — номера предыдущих инструкций (для Constant — номер
+    константы, для Variable — номер переменной). Степень выбирается по виду показателя
+    (ExponentClass): IntegerPower — целая константа, Sqrt и Cbrt — 1/2 и 1/3, 
+    OddRational и EvenRational — p / q с нечетным q и нечетным или четным p, Power — остальные.
+    Встроенные функции — отдельные операции (sqrt — Sqrt), пользовательские — CallUnary и 
+    CallBinary с номером функции в function. Операции начиная с Negate — унарные.
+    SinCos и CosSin появляются после слияния sin и cos одного аргумента (fuseSinCos): инструкция 
+    получает sin (cos) аргумента, а инструкция right — cos (sin); та помечена Paired и при 
+    вычислении пропускается.
+    */
+    enum class Operation : uint8_t { Constant, Variable, Add, Subtract, Multiply, Divide, Power, 
+                                     IntegerPower, OddRational, EvenRational, Min, Max, CallBinary,
+                                     Negate, Sin, Cos, Ln, Exp, Sqrt, Cbrt, Tan, Abs, Sign, Atan, 
+                                     Sinh, Cosh, Tanh, Log10, Erf, CallUnary, SinCos, CosSin, Paired };
+
+    struct Instruction {
+
+        Operation operation;
+        uint16_t function = 0;  // Номер пользовательской функции для CallUnary и CallBinary.
+        uint32_t left = 0;
+        uint32_t right = 0;
+    };
+
+    /*
+    Размер программы по сравнению с исходными деревьями.
+    */
+    struct Statistics {
+
+        size_t outputs = 0;
+        size_t treeNodes = 0;       // Узлов во всех деревьях вместе.
+        size_t instructions = 0;    // Инструкций после объединения одинаковых поддеревьев и оптимизации.
+        size_t unoptimized = 0;     // Инструкций до оптимизации.
+        size_t eliminated = 0;      // Удалено инструкций, ставших ненужными после оптимизации.
+        size_t fusedSinCos = 0;     // Пар sin и cos одного аргумента, вычисляемых вместе.
+        std::map<std::string, size_t> rewrites; // Срабатывания каждого правила оптимизации.
+
+        /*
+        Доля узлов, которые вычислять не нужно (они совпали с уже имеющимися инструкциями).
+        */
+        double sharedFraction() const;
+    };
+
+    /*
+    Компиляция набора выражений. Выход i программы — значение exprs[i].
+    Уровень оптимизации (как -O0/-O1/-O2 у компилятора):
+    0 — только объединение одинаковых поддеревьев, результаты совпадают с evaluate бит в бит;
+    1 — свертка константных поддеревьев, тождества (x * 1, x + (-0), x - 0, x ^ 1, x ^ 0, x / 1, -(-x)), 
+        x ^ 2 → x * x, деление на степень двойки → умножение на обратное (все эти замены точны; 
+        x + 0 не заменяется: при x = -0 сумма равна +0);
+    2 — дополнительно целые степени от 3 до 16 → общие для всей программы умножения, 
+        деление на любую константу → умножение на обратное (результаты могут отличаться от evaluate 
+        в пределах нескольких ULP);
+    3 — дополнительно небезопасные замены exp(a) * exp(b) → exp(a + b), exp(a) / exp(b) → exp(a - b):
+        ошибка округления a + b умножается на exp, и при больших |a + b| результат отличается 
+        на сотни ULP (как -ffast-math у компилятора).
+    x ^ 0.5 и x ^ (1/3) на всех уровнях вычисляются через sqrt и cbrt, как и в evaluate.
+    fuse — вычислять sin и cos одного аргумента одной операцией (только вещественные типы; 
+    точный sincos дает те же биты, что sin и cos по отдельности, поэтому уровень 0 остается точным).
+    */
+    explicit Program(const std::vector<Expression<T>>& exprs, unsigned level = 0, bool fuse = true);
+
+    /*
+    Вычисление всех выходов. Значения переменных берутся из словаря; если какой-то выход
+    не определен (деление на ноль, ln вне области определения), бросается то же исключение,
+    что и в Expression::evaluate. accuracy — точность sin, cos, exp и ln, как у Expression::evaluate.
+    */
+    std::vector<T> evaluate(const std::unordered_map<std::string, T>& vars, 
+                            Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Вычисление без выделений памяти: values — значения переменных в порядке variables(),
+    registers — рабочий массив (подгоняется по размеру при первом вызове), результат в outputs.
+    */
+    void evaluate(const std::vector<T>& values, std::vector<T>& outputs, std::vector<T>& registers,
+                  Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Пакетное вычисление: каждой переменной сопоставлен столбец значений (все столбцы одной длины),
+    результат — столбец значений каждого выхода. Инструкции выполняются над блоками постоянной 
+    длины, поэтому циклы арифметики и (при accuracy, отличной от Exact) sin, cos, exp и ln 
+    векторизуются.
+    */
+    std::vector<std::vector<T>> evaluateBatch(const std::unordered_map<std::string, std::vector<T>>& vars,
+                                              Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Пакетное вычисление без копирования столбцов: columns[i] — n значений переменной i (в порядке 
+    variables()), outputs[k] — буфер на n значений выхода k.
+    */
+    void evaluateBatch(const T* const* columns, size_t n, T* const* outputs, Accuracy accuracy = Accuracy::Exact) const;
+
+    /*
+    Имена переменных в порядке, в котором evaluate ожидает их значения.
+    */
+    const std::vector<std::string>& variables() const;
+
+    const std::vector<Instruction>& instructions() const;
+
+    const Statistics& statistics() const;
+
+private:
+
+    using Node = typename Expression<T>::Node;
+
+    std::vector<Instruction> code;
+    std::vector<T> constants;
+    std::vector<std::string> names;
+    std::vector<uint32_t> results;     // Номера инструкций со значениями выходов.
+    Statistics stats;
+
+    /*
+    Номера уже построенных инструкций по сигнатуре: операция, аргументы, (для листьев)
+    запись константы или имя переменной и номер пользовательской функции.
+    */
+    std::map<std::tuple<Operation, uint32_t, uint32_t, std::string, uint16_t>, uint32_t> known;
+
+    /*
+    Компиляция поддерева; возвращает номер инструкции с его значением.
+    */
+    uint32_t compile(const Node*);
+
+    /*
+    Инструкция-константа.
+    */
+    uint32_t constant(const T&);
+
+    /*
+    Оптимизация: инструкции пересобираются по порядку, и к каждой применяются правила
+    уровня level (аргументы к этому моменту уже оптимизированы), затем удаляются ненужные.
+    */
+    void optimize(unsigned level);
+
+    /*
+    Инструкция operation(left, right) после применения правил уровня level.
+    */
+    uint32_t simplify(Operation, uint32_t left, uint32_t right, unsigned level, uint16_t function = 0);
+
+    /*
+    x ^ n для целого n >= 1 через возведение в квадрат.
+    */
+    uint32_t power(uint32_t base, unsigned exponent);
+
+    /*
+    Удаление инструкций, от которых не зависит ни один выход.
+    */
+    void eliminateDeadCode();
+
+    /*
+    Слияние sin(a) и cos(a) в SinCos или CosSin (выполняется последним: номера инструкций 
+    после него не меняются).
+    */
+    void fuseSinCos();
+
+    /*
+    Значение константной инструкции (пусто, если инструкция не константа).
+    */
+    const T* constantValue(uint32_t) const;
+
+    /*
+    Выполнение одной операции с проверками области определения (как в Expression::evaluateHelper).
+    */
+    static T apply(Operation, const T& left, const T& right, uint16_t function = 0);
+
+    /*
+    apply для sin, cos, exp и ln с точностью accuracy (остальные операции — точно).
+    */
+    static T apply(Operation, const T& left, const T& right, uint16_t function, Accuracy accuracy);
+
+    /*
+    sin и cos одного аргумента (SinCos) с точностью accuracy.
+    */
+    static void sinCos(const T& x, T& sinX, T& cosX, Accuracy accuracy);
+
+    /*
+    Инструкция с данной сигнатурой (новая, только если такой еще нет).
+    */
+    uint32_t emit(Operation, uint32_t left, uint32_t right, const std::string& key = "", uint16_t function = 0);
+};
+
+#endif
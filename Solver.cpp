@@ -0,0 +1,267 @@
+#include "Solver.hpp"
+
+// ---------------------------------------------------------------------------------------------------- //
+// КОНСТРУКТОР
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Производные строятся один раз: f' для Ньютона, f' и f'' для Галлея.
+*/
+template <typename T>
+Solver<T>::Solver(const Expression<T>& expr, const std::string& var, Method method)
+    : function{expr}, firstDerivative{expr.differentiate(var)}, var{var}, method{method} {
+
+    if (method == Method::Halley)
+        secondDerivative = firstDerivative.differentiate(var);
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ПОЛЬЗОВАТЕЛЬСКИЕ МЕТОДЫ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Итерации Ньютона (x -= f / f') или Галлея (x -= 2ff' / (2f'^2 - ff'')) по всем еще
+не сошедшимся точкам одновременно.
+*/
+template <typename T>
+typename Solver<T>::Result
+Solver<T>::solve(const std::vector<T>& starts, const Options& options,
+                 const std::unordered_map<std::string, T>& params) const {
+
+    bool halley = method == Method::Halley;
+
+    size_t n = starts.size();
+    Result result;
+    result.roots = starts;
+    result.converged.assign(n, false);
+    result.iterations.assign(n, 0);
+    Statistics& stats = result.statistics;
+
+    // Вилки для страховки бисекцией (только для вещественных типов).
+    bool bracketed = false;
+    std::vector<Real> lo, hi;
+    Real signLo = 0;
+
+    if constexpr (!isComplex<T>) {
+        if (options.useBracket) {
+
+            std::vector<T> ends = evaluateAt(function, {options.bracketLo, options.bracketHi}, params);
+            if (!(ends[0] * ends[1] <= 0))
+                throw std::runtime_error("Bracket endpoints must have function values of opposite signs");
+
+            bracketed = true;
+            signLo = ends[0] < 0 ? -1 : 1;
+            lo.assign(n, std::min(options.bracketLo, options.bracketHi));
+            hi.assign(n, std::max(options.bracketLo, options.bracketHi));
+            if (options.bracketHi < options.bracketLo) signLo = -signLo;
+
+            for (auto& x : result.roots) {
+                if (!(lo[0] <= x && x <= hi[0]))
+                    x = (lo[0] + hi[0]) / 2;
+            }
+        }
+    }
+
+    std::vector<size_t> active(n);
+    for (size_t i = 0; i < n; i++) active[i] = i;
+
+    for (size_t iteration = 0; iteration < options.maxIterations && !active.empty(); iteration++) {
+
+        std::vector<T> xs(active.size());
+        for (size_t k = 0; k < active.size(); k++)
+            xs[k] = result.roots[active[k]];
+
+        std::vector<T> f = evaluateAt(function, xs, params);
+        std::vector<T> df = evaluateAt(firstDerivative, xs, params);
+        std::vector<T> ddf = halley ? evaluateAt(secondDerivative, xs, params) : std::vector<T>();
+        stats.batches += halley ? 3 : 2;
+
+        std::vector<size_t> stillActive;
+
+        for (size_t k = 0; k < active.size(); k++) {
+
+            size_t i = active[k];
+            T x = xs[k];
+            result.iterations[i]++;
+
+            if (f[k] == static_cast<T>(0)) {
+                result.converged[i] = true;
+                continue;
+            }
+
+            T step = halley ? T(2) * f[k] * df[k] / (T(2) * df[k] * df[k] - f[k] * ddf[k]) : f[k] / df[k];
+            T next = x - step;
+            bool finite = std::isfinite(std::abs(next)) && std::isfinite(std::abs(f[k]));
+
+            if constexpr (!isComplex<T>) {
+                if (bracketed && std::isfinite(f[k])) {
+
+                    if ((f[k] < 0 ? -1 : 1) == signLo) lo[i] = x;
+                    else hi[i] = x;
+
+                    if (!finite || !(lo[i] < next && next < hi[i])) {
+                        next = (lo[i] + hi[i]) / 2;
+                        finite = true;
+                        stats.bisections++;
+                    }
+                }
+            }
+
+            if (!finite) // f' = 0 или вычисление вне области определения.
+                continue;
+
+            result.roots[i] = next;
+            if (std::abs(next - x) <= options.tolerance * (1 + std::abs(next)))
+                result.converged[i] = true;
+            else
+                stillActive.push_back(i);
+        }
+
+        active.swap(stillActive);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        stats.iterations += result.iterations[i];
+        stats.maxIterations = std::max(stats.maxIterations, result.iterations[i]);
+        if (result.converged[i]) stats.converged++;
+        else stats.failed++;
+    }
+
+    return result;
+}
+
+// --------------------------------------------------------------- //
+
+/*
+Различные сошедшиеся корни.
+*/
+template <typename T>
+std::vector<T> Solver<T>::Result::uniqueRoots(Real tolerance) const {
+
+    std::vector<T> unique;
+
+    for (size_t i = 0; i < roots.size(); i++) {
+
+        if (!converged[i]) continue;
+
+        bool seen = false;
+        for (const T& root : unique)
+            seen |= std::abs(root - roots[i]) <= tolerance * (1 + std::abs(root));
+
+        if (!seen) unique.push_back(roots[i]);
+    }
+
+    return unique;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ВСПОМОГАТЕЛЬНЫЕ ФУНКЦИИ
+// ---------------------------------------------------------------------------------------------------- //
+
+/*
+Пакетное вычисление в точках xs. Если пакет целиком вычислить нельзя (исключение из-за одной
+из точек), точки вычисляются по одной, а невычислимые получают NaN.
+*/
+template <typename T>
+std::vector<T> Solver<T>::evaluateAt(const Expression<T>& expr, const std::vector<T>& xs,
+                                     const std::unordered_map<std::string, T>& params) const {
+
+    std::unordered_map<std::string, std::vector<T>> columns;
+    for (const auto& [name, value] : params)
+        columns[name].assign(xs.size(), value);
+    columns[var] = xs;
+
+    try {
+        return expr.evaluateBatch(columns);
+    }
+    catch (const std::runtime_error&) {}
+
+    const Real NaN = std::numeric_limits<Real>::quiet_NaN();
+    std::vector<T> values(xs.size());
+    std::unordered_map<std::string, std::vector<T>> single;
+    for (const auto& [name, value] : params)
+        single[name] = {value};
+
+    for (size_t i = 0; i < xs.size(); i++) {
+
+        single[var] = {xs[i]};
+        try {
+            values[i] = expr.evaluateBatch(single)[0];
+        }
+        catch (const std::runtime_error&) {
+            values[i] = static_cast<T>(NaN);
+        }
+    }
+
+    return values;
+}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+// ---------------------------------------------------------------------------------------------------- //
+// ЯВНАЯ ИНСТАНТИЗАЦИЯ
+// ---------------------------------------------------------------------------------------------------- //
+
+template class Solver<float>;
+template class Solver<double>;
+template class Solver<long double>;
+template class Solver<std::complex<double>>;
+template class Solver<std::complex<long double>>;
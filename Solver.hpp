@@ -0,0 +1,91 @@
+#ifndef EXPR_SOLVER_HPP
+#define EXPR_SOLVER_HPP
+
+#include "Expression.hpp"
+#include <limits>
+
+/*
+Поиск корней уравнения f(x) = 0 методами Ньютона и Галлея сразу из многих начальных точек.
+Производные строятся один раз в конструкторе, а на каждой итерации f, f' (и f'') вычисляются
+пакетно (evaluateBatch) только для еще не сошедшихся точек.
+*/
+template <typename T>
+class Solver {
+public:
+
+    using Real = RealOf<T>;
+
+    enum class Method { Newton, Halley };
+
+    /*
+    Параметры поиска. Отрезок [bracketLo, bracketHi] (только для вещественных типов) включает
+    страховку бисекцией: если на его концах f разного знака, шаг, выводящий точку за пределы
+    текущей вилки, заменяется делением вилки пополам.
+    */
+    struct Options {
+
+        size_t maxIterations = 100;
+        Real tolerance = 64 * std::numeric_limits<Real>::epsilon();
+        bool useBracket = false;
+        Real bracketLo = 0;
+        Real bracketHi = 0;
+    };
+
+    /*
+    Статистика итераций по всем точкам.
+    */
+    struct Statistics {
+
+        size_t converged = 0;       // Сошлось точек.
+        size_t failed = 0;          // Не сошлось (предел итераций, f' = 0, выход из области определения).
+        size_t iterations = 0;      // Суммарное число итераций.
+        size_t maxIterations = 0;   // Наибольшее число итераций для одной точки.
+        size_t bisections = 0;      // Шагов бисекции вместо шага метода.
+        size_t batches = 0;         // Пакетных вычислений f, f', f''.
+    };
+
+    /*
+    Результат: для каждой начальной точки — найденное значение, признак сходимости и число итераций.
+    */
+    struct Result {
+
+        std::vector<T> roots;
+        std::vector<bool> converged;
+        std::vector<size_t> iterations;
+        Statistics statistics;
+
+        /*
+        Различные сошедшиеся корни (совпадающие с точностью до tolerance объединяются).
+        */
+        std::vector<T> uniqueRoots(Real tolerance) const;
+    };
+
+    /*
+    Решатель для уравнения expr = 0 относительно переменной var методом method (для Галлея
+    в конструкторе строится и f'').
+    */
+    Solver(const Expression<T>& expr, const std::string& var, Method method = Method::Newton);
+
+    /*
+    Запуск из набора начальных точек. Остальные переменные выражения задаются в params.
+    */
+    Result solve(const std::vector<T>& starts, const Options& options,
+                 const std::unordered_map<std::string, T>& params = {}) const;
+
+private:
+
+    Expression<T> function;
+    Expression<T> firstDerivative;
+    Expression<T> secondDerivative; // Пусто для метода Ньютона.
+    std::string var;
+    Method method;
+
+    /*
+    Пакетное вычисление выражения в точках xs. Точки, в которых вычисление невозможно
+    (деление на ноль, ln <= 0 и т.п.), получают NaN вместо исключения для всего пакета.
+    */
+    std::vector<T> evaluateAt(const Expression<T>&, const std::vector<T>&,
+                              const std::unordered_map<std::string, T>&) const;
+};
+
+#endif
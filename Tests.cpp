@@ -1,5 +1,15 @@
 #include "Expression.hpp"
 #include "Tests.hpp"
+#include "Solver.hpp"
+#include "Integrator.hpp"
+#include "Generator.hpp"
+#include "Program.hpp"
+#include "Polynomial.hpp"
+#include "EvaluationServer.hpp"
+#include "LazyDerivative.hpp"
+#include "MathExpr.h"
+#include "AllocCounter.hpp"
+#include <cstring>
 
 void TEST_CASE(std::string name, bool expr) {
     if (expr) std::cout  << name << " [ OK ] " << std::endl; 
@@ -33,14 +43,14 @@ void Tests() {
     res_2 = expr_2.differentiate("x");
     // std::cout << std::endl << res_2.toString() << std::endl;
     TEST_CASE("Test 1 (complex derivative): ", 
-        res_2.toString() == "((((((-0I) * (x^2)) + ((-6) * ((x^2) * ((0I * ln(x)) + (2 * (1 / x)))))) - ((0I * (x^x)) + (4 * ((x^x) * ((1 * ln(x)) + (x * (1 / x))))))) + 0I) + (((cos(y) * 0I) * exp((((-12I) + 3) * x))) + (sin(y) * (exp((((-12I) + 3) * x)) * ((((-0I) + 0I) * x) + (((-12I) + 3) * 1))))))");
+        res_2.toString() == "((((((-0I) * (x^2)) + ((-6) * ((2 * x) * 1))) - ((0I * (x^x)) + (4 * ((x^x) * ((1 * ln(x)) + (x * (1 / x))))))) + 0I) + (((cos(y) * 0I) * exp((((-12I) + 3) * x))) + (sin(y) * (exp((((-12I) + 3) * x)) * ((((-0I) + 0I) * x) + (((-12I) + 3) * 1))))))");
 
 
     expr_1 = "-6x^2 -4x^x + 10 +      sin(y) * exp((-12x + 3) * x)";
     res_1 = expr_1.differentiate("x");
     // std::cout << std::endl << res_1.toString() << std::endl;
     TEST_CASE("Test 2 (long double derivative): ", 
-        res_1.toString() == "((((((-0) * (x^2)) + ((-6) * ((x^2) * ((0 * ln(x)) + (2 * (1 / x)))))) - ((0 * (x^x)) + (4 * ((x^x) * ((1 * ln(x)) + (x * (1 / x))))))) + 0) + (((cos(y) * 0) * exp(((((-12) * x) + 3) * x))) + (sin(y) * (exp(((((-12) * x) + 3) * x)) * ((((((-0) * x) + ((-12) * 1)) + 0) * x) + ((((-12) * x) + 3) * 1))))))");
+        res_1.toString() == "((((((-0) * (x^2)) + ((-6) * ((2 * x) * 1))) - ((0 * (x^x)) + (4 * ((x^x) * ((1 * ln(x)) + (x * (1 / x))))))) + 0) + (((cos(y) * 0) * exp(((((-12) * x) + 3) * x))) + (sin(y) * (exp(((((-12) * x) + 3) * x)) * ((((((-0) * x) + ((-12) * 1)) + 0) * x) + ((((-12) * x) + 3) * 1))))))");
 
 
     expr_2 = "  -sin(x) *         y";
@@ -85,4 +95,752 @@ void Tests() {
         areActuallyEqual(expr_2_2_2.evaluate().real(), 0.000042446137086360141047899158628566L) &&
         areActuallyEqual(expr_2_2_2.evaluate().imag(), -0.000019545452948635391955159727883452L)
     );
+
+
+    Expression<double> expr_3 = "-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x)";
+    Expression<float> expr_4 = "-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x)";
+    Expression<std::complex<double>> expr_5 = "-6x^2 -4x^x + 10 + sin(y) * exp((-12I + 3) * x)";
+    expr_3.subsVar("x = 0.5 y = 2");
+    expr_4.subsVar("x = 0.5 y = 2");
+    expr_5.subsVar("x = 0.5 y = 2");
+    expr_1 = "1.000000000001 - 1";
+    TEST_CASE("Test 8.1 (double instantiation): ", 
+        areActuallyEqual(expr_3.evaluate(), 5.874464555723979L));
+    TEST_CASE("Test 8.2 (float instantiation): ", 
+        areActuallyEqual(expr_4.evaluate(), 5.874464555723979L, 1e-5));
+    TEST_CASE("Test 8.3 (complex double instantiation): ", 
+        areActuallyEqual(expr_5.evaluate().real(), 9.584447631337289L) &&
+        areActuallyEqual(expr_5.evaluate().imag(), 1.138670780133382L));
+    TEST_CASE("Test 8.4 (mixed precision evaluation): ", 
+        areActuallyEqual(expr_1.evaluateMixed(), 1e-12L, 1e-18L));
+
+
+    expr_2 = Expression<std::complex<long double>> ("   0014.05ln   (4   y+1    )") / Expression<std::complex<long double>> ("exp(y*0.145x^2)");
+    expr_2_2 = Expression<std::complex<long double>> ("-001.012   sin(t+1)") * Expression<std::complex<long double>> ("-cos(x^2)");
+    expr_2_2_2 = expr_2 ^ expr_2_2;
+    auto batch_2 = expr_2_2_2.evaluateBatch({
+        {"x", {{-1, 1}, {0.5, 0}}}, {"y", {{12, -3}, {2, 1}}}, {"t", {{11, 0}, {-1, 2}}}});
+    expr_2_2_2.subsVar("x = 0.5 y = 2 + I t = -1 + 2I");
+    expr_1 = "-6x^2 -4x^x + 10 + sin(y) * exp((-12x + 3) * x)";
+    auto batch_1 = expr_1.evaluateBatch({{"x", {0.5, 1.5}}, {"y", {2, -1}}});
+    expr_1.subsVar("x = 1.5 y = -1");
+    // Числитель a*c + b*d переполняется, хотя частное конечно: столбец делится через std::complex.
+    auto batch_3 = Expression<std::complex<double>>("x / y").evaluateBatch({
+        {"x", {{1e300, 1e300}, {1, 2}}}, {"y", {{1e10, 1e10}, {3, 4}}}});
+    TEST_CASE("Test 9.1 (batch evaluation of a complex expression): ", 
+        areActuallyEqual(batch_2[0].real(), 0.000042446137086360141047899158628566L) &&
+        areActuallyEqual(batch_2[0].imag(), -0.000019545452948635391955159727883452L) &&
+        areActuallyEqual(batch_2[1].real(), expr_2_2_2.evaluate().real()) &&
+        areActuallyEqual(batch_2[1].imag(), expr_2_2_2.evaluate().imag()));
+    TEST_CASE("Test 9.2 (batch evaluation of a real expression): ", 
+        areActuallyEqual(batch_1[0], 5.874464555723979L) &&
+        areActuallyEqual(batch_1[1], expr_1.evaluate()));
+    TEST_CASE("Test 9.3 (batch complex division without intermediate overflow): ", 
+        std::abs(batch_3[0] - 1e290) < 1e276 && std::abs(batch_3[1] - std::complex<double>(0.44, 0.08)) < 1e-15);
+
+
+    expr_1 = "x*x - x + sin(4y)";
+    Interval<long double> range_1 = expr_1.evaluateInterval({{"x", {0, 1}}, {"y", {0, 1}}});
+    expr_1 = "exp(-x^2) * cos(x) / (ln(y) + 2)";
+    Interval<long double> range_2 = expr_1.evaluateInterval({{"x", {-0.5, 0.25}}, {"y", {1, 2}}});
+    TEST_CASE("Test 10.1 (interval evaluation of a polynomial with sin): ", 
+        range_1.lo <= -1 + std::sin(4.0L) && range_1.lo > -1.0001L + std::sin(4.0L) &&
+        range_1.hi >= 2 && range_1.hi < 2.0001L);
+    TEST_CASE("Test 10.2 (interval evaluation of a quotient with exp, cos and ln): ", 
+        range_2.contains(0.5L) && range_2.contains(std::exp(0.25L) * std::cos(0.5L) / (std::log(2.0L) + 2)) &&
+        range_2.lo > 0.3258L && range_2.hi < 0.6421L);
+
+
+    Solver<long double> solver_1(Expression<long double>("x^3 - 2x - 5"), "x", Solver<long double>::Method::Halley);
+    Solver<long double>::Options options_1;
+    auto roots_1 = solver_1.solve({-3, 1, 2, 10}, options_1);
+    Solver<long double> solver_2(Expression<long double>("exp(x) - 10"), "x");
+    Solver<long double>::Options options_2;
+    options_2.useBracket = true;
+    options_2.bracketLo = 0;
+    options_2.bracketHi = 3;
+    auto roots_2 = solver_2.solve({0.1L, 2.9L}, options_2);
+    Solver<std::complex<long double>> solver_3(Expression<std::complex<long double>>("x^2 + a"), "x");
+    auto roots_3 = solver_3.solve({{1, 1}, {1, -1}}, {}, {{"a", 1}});
+    TEST_CASE("Test 11.1 (Halley iterations from several starting points): ", 
+        roots_1.uniqueRoots(1e-12L).size() == 1 && roots_1.statistics.converged == 4 && 
+        roots_1.statistics.failed == 0 &&
+        areActuallyEqual(roots_1.roots[1], 2.0945514815423265914823865405793L));
+    TEST_CASE("Test 11.2 (Newton iterations safeguarded by a bracket): ", 
+        roots_2.statistics.converged == 2 && roots_2.statistics.bisections > 0 &&
+        areActuallyEqual(roots_2.roots[0], 2.3025850929940456840179914546844L));
+    TEST_CASE("Test 11.3 (complex roots with a bound parameter): ", 
+        areActuallyEqual(roots_3.roots[0].imag(), 1) && areActuallyEqual(roots_3.roots[1].imag(), -1) &&
+        areActuallyEqual(roots_3.roots[0].real(), 0));
+
+
+    Integrator<long double>::Options options_3;
+    auto integral_1 = Integrator<long double>(Expression<long double>("sin(x)")).gaussKronrod("x", 0, 3.14159265358979323846L, options_3);
+    auto integral_2 = Integrator<long double>(Expression<long double>("x*y*exp(x) + a")).cubature(
+        {"x", "y"}, {{0, 1}, {0, 1}}, options_3, {{"a", 1}});
+    options_3.samples = 200000;
+    auto integral_3 = Integrator<long double>(Expression<long double>("x + y + z")).monteCarlo(
+        {"x", "y", "z"}, {{0, 1}, {0, 1}, {0, 1}}, options_3);
+    auto integral_4 = Integrator<std::complex<long double>>(Expression<std::complex<long double>>("exp(I*x)")).gaussKronrod(
+        "x", 0, 1, Integrator<std::complex<long double>>::Options());
+    Integrator<long double>::Options options_pole;
+    options_pole.threads = 4;
+    bool pole_thrown = false, no_samples_thrown = false;
+    try { Integrator<long double>(Expression<long double>("1 / (x - 0.125)")).gaussKronrod("x", 0, 1, options_pole); }
+    catch (const std::runtime_error&) { pole_thrown = true; }
+    options_pole.samples = 0;
+    try { Integrator<long double>(Expression<long double>("x")).monteCarlo({"x"}, {{0, 1}}, options_pole); }
+    catch (const std::runtime_error&) { no_samples_thrown = true; }
+    TEST_CASE("Test 12.1 (adaptive Gauss-Kronrod integration): ", 
+        integral_1.converged && areActuallyEqual(integral_1.value, 2));
+    TEST_CASE("Test 12.2 (cubature with a bound parameter): ", 
+        integral_2.converged && areActuallyEqual(integral_2.value, 1.5L));
+    TEST_CASE("Test 12.3 (Monte Carlo integration): ", 
+        areActuallyEqual(integral_3.value, 1.5L, 5 * integral_3.error) && integral_3.error < 0.01L);
+    TEST_CASE("Test 12.4 (Gauss-Kronrod integration of a complex function): ", 
+        integral_4.converged && areActuallyEqual(integral_4.value.real(), std::sin(1.0L)) &&
+        areActuallyEqual(integral_4.value.imag(), 1 - std::cos(1.0L)));
+    TEST_CASE("Test 12.5 (errors from a pole and from zero samples): ", pole_thrown && no_samples_thrown);
+
+
+    ExpressionGenerator<long double>::Options options_4;
+    options_4.maxDepth = 5;
+    options_4.functions = {"sin", "cos", "exp"};
+    ExpressionGenerator<long double> generator_1(options_4, 42), generator_2(options_4, 42);
+    GeneratedNode generated_1 = generator_1.expression();
+    GeneratedNode generated_2 = generator_2.expression();
+    auto point_1 = generator_1.point();
+    Expression<long double> expr_gen(generated_1.toString().c_str());
+    Expression<long double> expr_gen_subs = expr_gen;
+    expr_gen_subs.subsVar(ExpressionGenerator<long double>::pointToString(point_1));
+    GeneratedNode minimal_1 = generated_1.shrink([](const GeneratedNode& node) { 
+        return node.toString().find('x') != std::string::npos; 
+    });
+    ExpressionGenerator<long double>::Options options_5;
+    options_5.functions = {"min"};
+    options_5.functionWeight = 100;
+    GeneratedNode generated_3 = ExpressionGenerator<long double>(options_5, 7).expression();
+    bool unknown_generator_thrown = false;
+    options_5.functions = {"nosuchfunction"};
+    try { ExpressionGenerator<long double> generator(options_5); } 
+    catch (const std::runtime_error&) { unknown_generator_thrown = true; }
+    TEST_CASE("Test 13.1 (seeded random expression generator): ", 
+        generated_1.toString() == generated_2.toString() && generated_1.size() > 1 &&
+        expr_gen.nodeCount() == generated_1.size() &&
+        areActuallyEqual(expr_gen.evaluate(point_1), expr_gen_subs.evaluate()));
+    TEST_CASE("Test 13.2 (shrinking of a generated expression): ", minimal_1.toString() == "x");
+    TEST_CASE("Test 13.3 (generated calls of built-in functions of any arity): ", 
+        ExpressionGenerator<long double>::builtinFunctions().size() == static_cast<size_t>(Function::BUILTINS) &&
+        ExpressionGenerator<std::complex<double>>::builtinFunctions().size() == static_cast<size_t>(Function::BUILTINS) - 3 &&
+        generated_3.kind == GeneratedNode::Kind::Function && generated_3.args.size() == 2 &&
+        Expression<long double>(generated_3.toString().c_str()).nodeCount() == generated_3.size() &&
+        unknown_generator_thrown);
+
+
+    Expression<long double> expr_stats("x*y + x*y + sin(x)");
+    auto stats_1 = expr_stats.statistics();
+    Expression<long double>::Profile profile_1;
+    long double profiled_1 = 0;
+    for (int i = 0; i < 3; i++)
+        profiled_1 = expr_stats.evaluateProfiled(profile_1, {{"x", 1}, {"y", 2}});
+    uint64_t self_ticks_1 = 0;
+    for (const auto& counter : profile_1.counters) self_ticks_1 += counter.ticks;
+    TEST_CASE("Test 14.1 (tree statistics): ", 
+        stats_1.nodes == 10 && stats_1.variables == 5 && stats_1.binaryOperations == 4 && 
+        stats_1.functions == 1 && stats_1.depth == 3 && stats_1.uniqueSubtrees == 6 && 
+        stats_1.distinctVariables == 2 && stats_1.estimatedCost > 0);
+    TEST_CASE("Test 14.2 (profiled evaluation): ", 
+        areActuallyEqual(profiled_1, expr_stats.evaluate({{"x", 1}, {"y", 2}})) &&
+        profile_1.evaluations == 3 && profile_1.counters[Expression<long double>::Profile::Multiply].calls == 6 &&
+        profile_1.counters[Expression<long double>::Profile::Sin].calls == 3 &&
+        profile_1.counters[Expression<long double>::Profile::Variable].calls == 15 &&
+        self_ticks_1 <= profile_1.totalTicks);
+
+
+    Expression<long double> expr_memory_1("x + sin(y)");
+    Expression<long double> expr_memory_2("averyveryverylongvariablename * 2");
+    Expression<long double> expr_memory_3 = expr_memory_2;
+    auto memory_1 = expr_memory_1.memoryUsage();
+    auto memory_2 = expr_memory_2.memoryUsage();
+    auto memory_3 = expr_memory_3.memoryUsage();
+    auto allocations_1 = Expression<long double>::allocationStatistics("x*y + sin(y) * cos(x)", "x=1 y=2", "x");
+    auto allocationsOf = [&](const std::string& operation) {
+        for (const auto& entry : allocations_1)
+            if (entry.operation == operation) return entry.allocations;
+        return size_t(-1);
+    };
+    TEST_CASE("Test 15.1 (memory usage of an expression): ", 
+        memory_1.nodes == 4 && memory_1.stringBytes == 0 && memory_1.nodeBytes >= 4 * sizeof(void*) &&
+        memory_1.heapBytes >= memory_1.nodeBytes && memory_1.bytes() > memory_1.nodeBytes);
+    TEST_CASE("Test 15.2 (memory usage of long variable names and copies): ", 
+        memory_2.stringBytes > std::string("averyveryverylongvariablename").size() &&
+        memory_3.bytes() == memory_2.bytes());
+    TEST_CASE("Test 15.3 (allocations per operation): ", 
+        allocationsOf("copyTree") == Expression<long double>("x*y + sin(y) * cos(x)").nodeCount() && 
+        allocationsOf("toString") > 0 &&
+        allocationsOf("differentiate") > 0 && allocationsOf("tokenize") > 0 &&
+        allocationsOf("parse") == allocationsOf("copyTree"));
+    TEST_CASE("Test 15.4 (allocations without differentiation): ", 
+        Expression<long double>::allocationStatistics("x*y", "x=1 y=2", "").size() == allocations_1.size() - 1);
+
+
+    Expression<long double> expr_program("x^2*y + sin(x*y) + y*x");
+    std::vector<Expression<long double>> outputs_1 = {expr_program, expr_program.differentiate("x"), expr_program.differentiate("y")};
+    Program<long double> program_1(outputs_1);
+    std::unordered_map<std::string, long double> point_2 = {{"x", 0.75L}, {"y", -1.5L}};
+    auto values_1 = program_1.evaluate(point_2);
+    Program<std::complex<long double>> program_2({Expression<std::complex<long double>>("x/(x - x)")});
+    bool division_thrown = false;
+    try { program_2.evaluate({{"x", {1, 1}}}); } catch (const std::runtime_error&) { division_thrown = true; }
+    TEST_CASE("Test 16.1 (multi-output program values): ", 
+        values_1.size() == 3 && values_1[0] == outputs_1[0].evaluate(point_2) &&
+        values_1[1] == outputs_1[1].evaluate(point_2) && values_1[2] == outputs_1[2].evaluate(point_2));
+    TEST_CASE("Test 16.2 (common subexpressions shared between outputs): ", 
+        program_1.variables().size() == 2 && program_1.statistics().sharedFraction() > 0.5 &&
+        program_1.statistics().instructions < program_1.statistics().treeNodes);
+    TEST_CASE("Test 16.3 (division by zero in a program): ", division_thrown);
+
+
+    Expression<long double> expr_optimized("x^2 + (2 + 3) * x^0.5 + y/4 + exp(x) * exp(y) + x^5 * 1");
+    std::unordered_map<std::string, long double> point_3 = {{"x", 1.25L}, {"y", -0.5L}};
+    Program<long double> program_O0({expr_optimized}), program_O1({expr_optimized}, 1), program_O2({expr_optimized}, 2);
+    Program<long double> program_O3({expr_optimized}, 3);
+    auto rewrites_1 = program_O1.statistics().rewrites, rewrites_2 = program_O2.statistics().rewrites;
+    auto rewrites_3 = program_O3.statistics().rewrites;
+    Program<double> program_signed_zero({Expression<double>("x + 0"), Expression<double>("x - 0")}, 2);
+    std::vector<double> signed_zero = program_signed_zero.evaluate({{"x", -0.0}});
+    Program<long double> program_3({Expression<long double>("x + 1/0")}, 2);
+    bool folded_division_thrown = false;
+    try { program_3.evaluate({{"x", 1}}); } catch (const std::runtime_error&) { folded_division_thrown = true; }
+    TEST_CASE("Test 17.1 (rewrites at each optimization level): ", 
+        program_O0.statistics().rewrites.empty() &&
+        rewrites_1["fold"] == 1 && rewrites_1["reciprocal"] == 1 && rewrites_1["identity"] == 1 && 
+        rewrites_1["power"] == 1 && rewrites_1["exp"] == 0 &&
+        rewrites_2["power"] == 2 && rewrites_2["exp"] == 0 && rewrites_3["exp"] == 1);
+    TEST_CASE("Test 17.2 (optimized programs keep values): ", 
+        program_O1.statistics().instructions < program_O0.statistics().instructions &&
+        program_O1.statistics().eliminated > 0 &&
+        areActuallyEqual(program_O1.evaluate(point_3)[0], expr_optimized.evaluate(point_3)) &&
+        areActuallyEqual(program_O2.evaluate(point_3)[0], expr_optimized.evaluate(point_3)) &&
+        areActuallyEqual(program_O3.evaluate(point_3)[0], expr_optimized.evaluate(point_3)));
+    TEST_CASE("Test 17.3 (signed zeros are not folded away): ", 
+        !std::signbit(signed_zero[0]) && std::signbit(signed_zero[1]));
+    TEST_CASE("Test 17.4 (folded division by zero): ", folded_division_thrown);
+
+
+    Expression<long double> expr_roots("x^(1/3) + x^(2/3) + x^(-3/5)");
+    Expression<long double> expr_powers("x^3 - x^(-2) + x^(5/3)");
+    Program<long double> program_powers({expr_roots, expr_powers});
+    auto powers_values = program_powers.evaluate({{"x", -1.7L}});
+    auto cube_roots = Expression<long double>("x^(1/3)").evaluateBatch({{"x", {-8, 27}}});
+    Interval<long double> cube_range = Expression<long double>("x^(1/3)").evaluateInterval({{"x", {-8, -1}}});
+    bool even_root_thrown = false;
+    try { Expression<long double>("x^0.5").evaluate({{"x", -4}}); } catch (const std::runtime_error&) { even_root_thrown = true; }
+    std::unordered_map<std::string, long double> point_negative = {{"x", -1.7L}};
+    long double roots_derivative = expr_roots.differentiate("x").evaluate(point_negative);
+    long double powers_derivative = expr_powers.differentiate("x").evaluate(point_negative);
+    TEST_CASE("Test 18.1 (integer powers and odd roots of negative numbers): ", 
+        Expression<long double>("(-8)^(1/3)").evaluate() == -2 && 
+        areActuallyEqual(expr_roots.evaluate({{"x", -32}}), -std::cbrt(32.0L) + std::cbrt(32.0L) * std::cbrt(32.0L) - 0.125) &&
+        Expression<long double>("x^3").evaluate({{"x", -2}}) == -8 &&
+        Expression<long double>("x^(-2)").evaluate({{"x", 4}}) == 0.0625 &&
+        Expression<std::complex<long double>>("(1+I)^2").evaluate() == std::complex<long double>(0, 2));
+    TEST_CASE("Test 18.2 (classified powers in programs, batches and intervals): ", 
+        powers_values[0] == expr_roots.evaluate({{"x", -1.7L}}) && 
+        powers_values[1] == expr_powers.evaluate({{"x", -1.7L}}) &&
+        cube_roots[0] == -2 && cube_roots[1] == 3 && 
+        cube_range.contains(-2) && cube_range.contains(-1));
+    TEST_CASE("Test 18.3 (even root of a negative number): ", even_root_thrown);
+    TEST_CASE("Test 18.4 (power rule for constant exponents): ", 
+        areActuallyEqual(Expression<long double>("x^(1/3)").differentiate("x").evaluate({{"x", -8}}), 1.0L / 12) &&
+        Expression<long double>("x^3").differentiate("x").evaluate({{"x", -3}}) == 27 &&
+        Expression<long double>("x^3").differentiate("x").evaluate({{"x", 0}}) == 0 &&
+        areActuallyEqual(roots_derivative, LazyDerivative<long double>(expr_roots, "x").evaluate(point_negative), 1e-15L) &&
+        areActuallyEqual(powers_derivative, LazyDerivative<long double>(expr_powers, "x").evaluate(point_negative), 1e-15L));
+    TEST_CASE("Test 18.5 (printed derivative of a negative power parses back): ", 
+        Expression<long double>("x^(-2)").differentiate("x").toString() == "(((-2) * (x^(-3))) * 1)" &&
+        Expression<long double>(Expression<long double>("x^(-2)").differentiate("x").toString().c_str()).toString() == "(((-2) * (x^(-3))) * 1)");
+
+
+    using Poly = Polynomial<long double>;
+    Expression<long double> expr_cubic("(x + y)^3 - x*y/2");
+    Poly poly_1(Expression<long double>("-6x^2 - 4x + 10")), poly_2(expr_cubic);
+    std::unordered_map<std::string, long double> point_4 = {{"x", 1.5L}, {"y", -0.5L}};
+    Expression<long double> expr_mixed("sin(x^2 + 3x + 1) + exp(y) * (y^3 - y)");
+    TEST_CASE("Test 19.1 (univariate polynomial): ", 
+        poly_1.terms().size() == 3 && poly_1.degree() == 2 && 
+        poly_1.evaluate({{"x", 2}}) == -22 && poly_1.evaluate({{"x", 2}}, Poly::Scheme::Estrin) == -22 &&
+        poly_1.differentiate("x").toString() == "(((-12) * x) - 4)" &&
+        Poly(poly_1.toExpression()).toString() == poly_1.toString());
+    TEST_CASE("Test 19.2 (bivariate polynomial with Horner and Estrin evaluation): ", 
+        poly_2.terms().size() == 5 && poly_2.degree() == 3 && poly_2.variables().size() == 2 &&
+        areActuallyEqual(poly_2.evaluate(point_4), expr_cubic.evaluate(point_4)) &&
+        areActuallyEqual(poly_2.evaluate(point_4, Poly::Scheme::Estrin), expr_cubic.evaluate(point_4)) &&
+        areActuallyEqual(poly_2.toHornerExpression().evaluate(point_4), expr_cubic.evaluate(point_4)) &&
+        areActuallyEqual(poly_2.differentiate("y").evaluate(point_4), expr_cubic.differentiate("y").evaluate(point_4)));
+    TEST_CASE("Test 19.3 (recognition of polynomials): ", 
+        !Poly::isPolynomial(Expression<long double>("x/y")) && !Poly::isPolynomial(Expression<long double>("sin(x) + 1")) &&
+        !Poly::isPolynomial(Expression<long double>("x^0.5")) && Poly::isPolynomial(Expression<long double>("x/2 + sin(1)")));
+    TEST_CASE("Test 19.4 (Horner form of polynomial subtrees): ", 
+        areActuallyEqual(Poly::hornerize(expr_mixed).evaluate(point_4), expr_mixed.evaluate(point_4)));
+
+
+    Expression<long double> expr_sweep("14ln(4y+1) / exp(y*x^2) * sin(t+1) * cos(x^2) + t*x");
+    Expression<long double>::Specialization report;
+    Expression<long double> expr_specialized = expr_sweep.specialize({{"t", 11}, {"y", 12}}, &report);
+    Expression<long double> expr_domain = Expression<long double>("x + ln(y)").specialize({{"y", -1}});
+    bool domain_thrown = false;
+    try { expr_domain.evaluate({{"x", 1}}); } catch (const std::runtime_error&) { domain_thrown = true; }
+    TEST_CASE("Test 20.1 (specialization for a subset of bound variables): ", 
+        expr_specialized.evaluate({{"x", 0.3L}}) == expr_sweep.evaluate({{"x", 0.3L}, {"t", 11}, {"y", 12}}) &&
+        expr_specialized.toString().find('t') == std::string::npos && 
+        expr_specialized.toString().find('y') == std::string::npos);
+    TEST_CASE("Test 20.2 (specialization report): ", 
+        report.foldedSubtrees == 2 && report.remainingNodes < report.nodes && 
+        report.eliminatedFraction() > 0.2);
+    TEST_CASE("Test 20.3 (domain errors are kept until evaluation): ", domain_thrown);
+
+
+    auto errorOf = [](const char* formula) { return Expression<long double>::parse(formula).error(); };
+    auto isError = [&](const char* formula, ParseError::Code code, size_t offset) {
+        ParseError error = errorOf(formula);
+        return error.code == code && error.offset == offset;
+    };
+    auto parsed_1 = Expression<long double>::parse("2^3^2 - 2^-1 - -x^2");
+    bool message_thrown = false;
+    try { Expression<long double>("sin(x) + x(2)"); } 
+    catch (const std::runtime_error& error) { message_thrown = std::string(error.what()) == "Unknown function identifier 'x' at offset 9"; }
+    TEST_CASE("Test 21.1 (single-pass parser precedence): ", 
+        parsed_1 && parsed_1.value().evaluate({{"x", 3}}) == 512 - 0.5 - 9 &&
+        Expression<long double>("2x^2/4*3").evaluate({{"x", 2}}) == 6);
+    TEST_CASE("Test 21.2 (parser error codes and offsets): ", 
+        isError("x(1)", ParseError::UnknownFunction, 0) && isError("sin x", ParseError::TrailingInput, 4) &&
+        isError("(x + 1", ParseError::ExpectedParenthesis, 6) && isError("(a)(b)", ParseError::TrailingInput, 3) &&
+        isError("x + ", ParseError::UnexpectedEnd, 4) && isError("x * / y", ParseError::UnexpectedToken, 4) &&
+        isError("1.2.3 + x", ParseError::InvalidNumber, 0) && isError("x + 2II", ParseError::InvalidNumber, 4) &&
+        isError("", ParseError::UnexpectedEnd, 0) && isError("x = 1", ParseError::TrailingInput, 2) &&
+        !Expression<long double>::parse(")").hasValue());
+    TEST_CASE("Test 21.3 (parser error message): ", message_thrown);
+
+
+    std::string huge_sum = "-x";
+    for (int i = 1; i <= 30000; i++)
+        huge_sum += std::string(i % 3 ? " + " : " - ") + std::to_string(i % 17) + ".5x*y^" + std::to_string(i % 4) + 
+                    (i % 5 ? " * sin(x - y)" : " / (x - 2 - y)");
+    std::unordered_map<std::string, long double> point_5 = {{"x", 0.7L}, {"y", -0.3L}};
+    auto sequential_1 = Expression<long double>::parse(huge_sum);
+    auto parallel_1 = Expression<long double>::parseParallel(huge_sum, 4);
+    auto parallel_2 = Expression<long double>::parseParallel(huge_sum, 1);
+    std::string broken_sum = huge_sum.substr(0, huge_sum.size() / 2) + ")" + huge_sum.substr(huge_sum.size() / 2);
+    auto broken_1 = Expression<long double>::parseParallel(broken_sum, 4);
+    auto broken_2 = Expression<long double>::parse(broken_sum);
+    TEST_CASE("Test 22.1 (parallel parsing of a large sum): ", 
+        huge_sum.size() > 600000 && sequential_1 && parallel_1 && parallel_2 &&
+        parallel_1.value().nodeCount() == sequential_1.value().nodeCount() && 
+        parallel_1.value().toString() == parallel_2.value().toString() &&
+        areActuallyEqual(parallel_1.value().evaluate(point_5), sequential_1.value().evaluate(point_5), 1e-9L));
+    TEST_CASE("Test 22.2 (balanced tree from parallel parsing): ", parallel_1.value().statistics().depth < 40);
+    TEST_CASE("Test 22.3 (parallel parsing of a short sum): ", 
+        Expression<long double>::parseParallel("2 - x + 3*x^2 - -1 + 5/x", 4).value().toString() == 
+            Expression<long double>("2 - x + 3*x^2 - -1 + 5/x").toString() &&
+        Expression<long double>::parseParallel("2 - x + 3*x^2 - -1", 4).value().evaluate({{"x", 2}}) == 13);
+    TEST_CASE("Test 22.4 (parallel parsing errors): ", 
+        !broken_1 && broken_1.error().code == broken_2.error().code && broken_1.error().offset == broken_2.error().offset);
+
+
+    std::string long_chain = "x";
+    for (int i = 1; i < 300; i++)
+        long_chain += std::string(i % 4 ? " + " : " - ") + "0." + std::to_string(i) + "x*y" + 
+                      (i % 50 ? "" : " * (x*y*x*y*x*y*x*y*x/y/2)");
+    Expression<long double> expr_chain(long_chain.c_str());
+    Expression<long double> expr_balanced = expr_chain.rebalance();
+    Expression<long double> expr_notation = expr_chain.rebalance(Expression<long double>::KeepNotation);
+    Expression<double> expr_cancel("10000000000000000 + 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1 - 10000000000000000");
+    Expression<double> expr_compensated = expr_cancel.rebalance(Expression<double>::CompensatedSum);
+    TEST_CASE("Test 23.1 (rebalancing of associative chains): ", 
+        expr_balanced.statistics().depth < 20 && expr_chain.statistics().depth > 290 &&
+        expr_balanced.nodeCount() == expr_chain.nodeCount() && expr_balanced.toString() != expr_chain.toString() &&
+        areActuallyEqual(expr_balanced.evaluate({{"x", 0.9L}, {"y", 1.1L}}), expr_chain.evaluate({{"x", 0.9L}, {"y", 1.1L}}), 1e-12L) &&
+        Expression<long double>(expr_balanced).evaluate({{"x", 0.9L}, {"y", 1.1L}}) == expr_balanced.evaluate({{"x", 0.9L}, {"y", 1.1L}}));
+    TEST_CASE("Test 23.2 (rebalancing that keeps the notation): ", 
+        expr_notation.toString() == expr_chain.toString() &&
+        expr_notation.rebalance().toString() == expr_balanced.toString());
+    TEST_CASE("Test 23.3 (compensated summation): ", 
+        expr_cancel.evaluate() == 0 && expr_compensated.evaluate() == 8 && 
+        expr_compensated.toString() != expr_cancel.toString());
+
+
+    using Chains = Expression<long double>::Chains;
+    std::string wide_sum = "x*y*sin(x)*(x + 1)*y*x";
+    for (int i = 1; i < 60; i++)
+        wide_sum += std::string(i % 3 ? " + " : " - ") + std::to_string(i % 7) + ".25x*y*x" + (i % 10 ? "" : "/(y - 3)*cos(x*y*x)");
+    std::unordered_map<std::string, long double> point_6 = {{"x", 0.6L}, {"y", -1.3L}};
+    auto nary_1 = Expression<long double>::parse(wide_sum, Chains::Nary);
+    Expression<long double> binary_1(wide_sum.c_str());
+    Expression<long double> nary_dx = nary_1.value().differentiate("x"), binary_dx = binary_1.differentiate("x");
+    Expression<long double> nary_product = Expression<long double>::parse("x*x*y*x*x*y*x*x", Chains::Nary).value();
+    Expression<long double> binary_product("x*x*y*x*x*y*x*x");
+    Expression<long double> nary_subs(nary_1.value());
+    nary_subs.subsVar("y = -1.3");
+    TEST_CASE("Test 24.1 (n-ary sum and product nodes): ", 
+        nary_1 && nary_1.value().evaluate(point_6) == binary_1.evaluate(point_6) &&
+        nary_1.value().nodeCount() < binary_1.nodeCount() && 
+        nary_1.value().statistics().depth < 6 && binary_1.statistics().depth > 60 &&
+        nary_1.value().statistics().naryOperations > 60 &&
+        nary_1.value().memoryUsage().bytes() < binary_1.memoryUsage().bytes());
+    TEST_CASE("Test 24.2 (printing and parsing n-ary nodes back): ", 
+        Expression<long double>(nary_1.value().toString().c_str()).evaluate(point_6) == binary_1.evaluate(point_6) &&
+        Expression<long double>::parse(nary_1.value().toString(), Chains::Nary).value().toString() == nary_1.value().toString() &&
+        Expression<long double>::parse("1 - 2 - 3", Chains::Nary).value().toString() == "(1 - 2 - 3)");
+    TEST_CASE("Test 24.3 (derivatives of n-ary nodes): ", 
+        areActuallyEqual(nary_dx.evaluate(point_6), binary_dx.evaluate(point_6), 1e-12L) &&
+        nary_dx.nodeCount() < binary_dx.nodeCount() &&
+        areActuallyEqual(nary_product.differentiate("x").evaluate({{"x", 1.5L}, {"y", 2}}), 6 * 7.59375L * 4, 1e-15L) &&
+        nary_product.differentiate("x").nodeCount() < binary_product.differentiate("x").nodeCount());
+    TEST_CASE("Test 24.4 (n-ary nodes in programs, substitution and polynomials): ", 
+        Program<long double>({nary_1.value()}).evaluate(point_6)[0] == binary_1.evaluate(point_6) &&
+        areActuallyEqual(nary_subs.evaluate({{"x", 0.6L}}), binary_1.evaluate(point_6), 1e-15L) &&
+        Polynomial<long double>(Expression<long double>::parse("(x - y)*(x + y)*x - x*x*x", Chains::Nary).value()).toString() == 
+            Polynomial<long double>(Expression<long double>("(x - y)*(x + y)*x - x*x*x")).toString());
+    TEST_CASE("Test 24.5 (n-ary products in powers): ", 
+        Expression<long double>::parse("(x*y*x)^(1*2*1)", Chains::Nary).value().evaluate({{"x", 2}, {"y", 3}}) == 144 &&
+        Expression<long double>::parse("2^(1*2*1)*x", Chains::Nary).value().evaluate({{"x", 1}}) == 4);
+
+
+    using LD = Expression<long double>;
+    LD expr_library("tan(x) + sqrt(y) + abs(x - y) + atan(x*y) + sinh(x) + cosh(y) + tanh(x) + log10(y) + "
+                    "erf(x) + min(x, y)*max(x, y^2) + pow(x, 3) + sign(x - y)");
+    long double lx = 0.4L, ly = 1.7L;
+    long double library_value = std::tan(lx) + std::sqrt(ly) + std::fabs(lx - ly) + std::atan(lx*ly) + std::sinh(lx) + 
+        std::cosh(ly) + std::tanh(lx) + std::log10(ly) + std::erf(lx) + lx*ly*ly + lx*lx*lx - 1;
+    std::unordered_map<std::string, long double> point_7 = {{"x", lx}, {"y", ly}};
+    auto library_batch = expr_library.evaluateBatch({{"x", {lx, -0.8L, 2.5L}}, {"y", {ly, 0.3L, 1.1L}}});
+    Interval<long double> library_interval = expr_library.evaluateInterval({{"x", {0.39L, 0.41L}}, {"y", {1.69L, 1.71L}}});
+    LD library_dx = expr_library.differentiate("x"), library_dy = expr_library.differentiate("y");
+    auto numeric = [&](const std::string& var) {
+        long double h = 1e-6L;
+        auto shifted = point_7;
+        shifted[var] += h;
+        long double forward = expr_library.evaluate(shifted);
+        shifted[var] -= 2 * h;
+        return (forward - expr_library.evaluate(shifted)) / (2 * h);
+    };
+
+    // Пользовательские функции регистрируются в каждом тесте заново и снимаются после него.
+    const LD::FunctionDefinition hyp_definition = {"hyp", 2, 
+        [](const long double* args) { return std::hypot(args[0], args[1]); },
+        [](const long double* const* args, size_t n, long double* result) { 
+            for (size_t i = 0; i < n; i++) result[i] = std::hypot(args[0][i], args[1][i]); },
+        [](const std::vector<LD>& args) { 
+            LD norm = LD::call("hyp", args);
+            return std::vector<LD>{LD(args[0]) / norm, LD(args[1]) / norm}; }};
+    uint16_t hyp_id = LD::registerFunction(hyp_definition);
+    LD::registerFunction({"twice", 1, [](const long double* args) { return 2 * args[0]; }, {}, {}});
+    bool duplicate_thrown = false, builtin_thrown = false, derivative_thrown = false;
+    try { LD::registerFunction({"hyp", 1, [](const long double* args) { return args[0]; }, {}, {}}); } 
+    catch (const std::runtime_error&) { duplicate_thrown = true; }
+    try { LD::registerFunction({"Sin", 1, [](const long double* args) { return args[0]; }, {}, {}}); } 
+    catch (const std::runtime_error&) { builtin_thrown = true; }
+    try { LD("twice(x)").differentiate("x"); } catch (const std::runtime_error&) { derivative_thrown = true; }
+    LD expr_user("hyp(3x, 4y) + twice(x)*y");
+    auto user_batch = expr_user.evaluateBatch({{"x", {1, 2}}, {"y", {1, 0.5L}}});
+    long double user_dx = LD("hyp(3x, 4y) + 2x*y").differentiate("x").evaluate({{"x", 1}, {"y", 1}});
+    LD::unregisterFunction("twice");
+    bool builtin_unregister_thrown = false;
+    try { LD::unregisterFunction("sin"); } catch (const std::runtime_error&) { builtin_unregister_thrown = true; }
+    bool unregistered = isError("twice(x)", ParseError::UnknownFunction, 0) && 
+        LD("twice + 1").evaluate({{"twice", 1}}) == 2 && expr_user.evaluate({{"x", 1}, {"y", 1}}) == 7 &&
+        builtin_unregister_thrown;
+    TEST_CASE("Test 25.1 (built-in functions in evaluate, batches, programs and intervals): ", 
+        areActuallyEqual(expr_library.evaluate(point_7), library_value, 1e-15L) &&
+        library_batch[0] == expr_library.evaluate(point_7) &&
+        library_batch[1] == expr_library.evaluate({{"x", -0.8L}, {"y", 0.3L}}) &&
+        library_batch[2] == expr_library.evaluate({{"x", 2.5L}, {"y", 1.1L}}) &&
+        Program<long double>({expr_library}).evaluate(point_7)[0] == expr_library.evaluate(point_7) &&
+        areActuallyEqual(Program<long double>({expr_library}, 2).evaluate(point_7)[0], library_value, 1e-15L) &&
+        library_interval.lo <= library_value && library_value <= library_interval.hi &&
+        LD(expr_library.toString().c_str()).evaluate(point_7) == expr_library.evaluate(point_7) &&
+        LD("pow(x, 2)").toString() == LD("x^2").toString());
+    TEST_CASE("Test 25.2 (derivatives of built-in functions): ", 
+        areActuallyEqual(library_dx.evaluate(point_7), numeric("x"), 1e-8L) &&
+        areActuallyEqual(library_dy.evaluate(point_7), numeric("y"), 1e-8L) &&
+        LD("max(x, 1) - min(1, x)").differentiate("x").evaluate({{"x", 3}}) == 1);
+    TEST_CASE("Test 25.3 (min and max derivatives next to a large derivative): ", 
+        LD("min(exp(60x), x)").differentiate("x").evaluate({{"x", 1.5L}}) == 1 &&
+        LazyDerivative<long double>(LD("max(x, sinh(-60x))"), "x").evaluate({{"x", -1.5L}}) == -60 * std::cosh(90.0L) &&
+        LazyDerivative<long double>(LD("max(sinh(-60x), x)"), "x").evaluate({{"x", 1.5L}}) == 1);
+    TEST_CASE("Test 25.4 (function argument errors): ", 
+        isError("pow(x) + 1", ParseError::ArgumentCount, 5) && isError("1 + sin(x, y)", ParseError::ArgumentCount, 9) &&
+        isError("min(x y)", ParseError::ExpectedParenthesis, 6));
+    TEST_CASE("Test 25.5 (function names as variables): ", 
+        LD("abs + min * sign(erf)").evaluate({{"abs", 1}, {"min", 2}, {"erf", -3}}) == -1 &&
+        LD("max^2 + sin(sin)").differentiate("max").evaluate({{"max", 3}, {"sin", 0}}) == 6);
+    TEST_CASE("Test 25.6 (registration errors): ", 
+        hyp_id >= static_cast<uint16_t>(Function::BUILTINS) && duplicate_thrown && builtin_thrown && derivative_thrown);
+    TEST_CASE("Test 25.7 (user-registered functions): ", 
+        expr_user.evaluate({{"x", 1}, {"y", 1}}) == 7 && user_batch[0] == 7 && user_batch[1] == 2 + std::hypot(6.0L, 2.0L) &&
+        areActuallyEqual(user_dx, 9.0L / 5 + 2, 1e-15L) &&
+        Program<long double>({expr_user}, 2).evaluate({{"x", 1}, {"y", 1}})[0] == 7 &&
+        LD("hyp(3, 4) * x").toString() == "(hyp(3, 4) * x)" &&
+        Program<long double>({LD("hyp(3, 4) * x")}, 1).instructions().size() == 3);
+    TEST_CASE("Test 25.8 (unregistration of user functions): ", unregistered);
+    LD::unregisterFunction("hyp");
+
+
+    Expression<double> expr_transcendental("sin(3x) * cos(y) + exp(x - y) + ln(y) - sin(1000000x)");
+    Expression<long double> expr_transcendental_ld("sin(3x) * cos(y) + exp(x - y) + ln(y)");
+    std::unordered_map<std::string, std::vector<double>> columns_1 = {{"x", {}}, {"y", {}}};
+    for (int i = 0; i < 37; i++) {
+        columns_1["x"].push_back(-20 + 1.1 * i);
+        columns_1["y"].push_back(0.05 + 0.7 * i);
+    }
+    auto worstError = [&](Accuracy accuracy) {
+        auto exact = expr_transcendental.evaluateBatch(columns_1);
+        auto approximate = expr_transcendental.evaluateBatch(columns_1, accuracy);
+        double worst = 0;
+        for (size_t i = 0; i < exact.size(); i++) {
+            std::unordered_map<std::string, double> point = {{"x", columns_1["x"][i]}, {"y", columns_1["y"][i]}};
+            if (expr_transcendental.evaluate(point, accuracy) != approximate[i]) return 1.0;
+            worst = std::max(worst, std::abs(approximate[i] - exact[i]) / std::max(1.0, std::abs(exact[i])));
+        }
+        return worst;
+    };
+    bool approximate_domain_thrown = false, approximate_batch_thrown = false;
+    try { Expression<double>("ln(x)").evaluate({{"x", -1.0}}, Accuracy::Coarse); } 
+    catch (const std::runtime_error&) { approximate_domain_thrown = true; }
+    try { Expression<double>("ln(x)").evaluateBatch({{"x", std::vector<double>(20, -1.0)}}, Accuracy::Fast); } 
+    catch (const std::runtime_error&) { approximate_batch_thrown = true; }
+    std::unordered_map<std::string, long double> point_8 = {{"x", 0.37L}, {"y", 2.9L}};
+    std::unordered_map<std::string, std::complex<double>> point_9 = {{"x", {0.3, 0.2}}};
+    Expression<std::complex<double>> expr_complex_trig("sin(x) * exp(x)");
+    TEST_CASE("Test 26.1 (error of each accuracy mode): ", 
+        worstError(Accuracy::Ulp) < 1e-15 && worstError(Accuracy::Fast) < 1e-6 && worstError(Accuracy::Coarse) < 1e-3 &&
+        worstError(Accuracy::Fast) > 0 && worstError(Accuracy::Coarse) > worstError(Accuracy::Fast));
+    TEST_CASE("Test 26.2 (approximations for long double and float): ", 
+        areActuallyEqual(expr_transcendental_ld.evaluate(point_8, Accuracy::Ulp), expr_transcendental_ld.evaluate(point_8), 1e-15L) &&
+        expr_transcendental_ld.evaluateBatch({{"x", {0.37L}}, {"y", {2.9L}}}, Accuracy::Ulp)[0] == 
+            expr_transcendental_ld.evaluate(point_8, Accuracy::Ulp) &&
+        Expression<float>("cos(x)").evaluate({{"x", 0.5f}}, Accuracy::Ulp) == std::cos(0.5f));
+    TEST_CASE("Test 26.3 (libm outside the approximation range and for complex numbers): ", 
+        Expression<double>("sin(x) + exp(y)").evaluate({{"x", 3e6}, {"y", 800}}, Accuracy::Coarse) == std::sin(3e6) + std::exp(800.0) &&
+        expr_complex_trig.evaluate(point_9, Accuracy::Coarse) == expr_complex_trig.evaluate(point_9));
+    TEST_CASE("Test 26.4 (domain errors with approximations): ", approximate_domain_thrown && approximate_batch_thrown);
+
+    Expression<double> expr_trig("sin(x*y) * cos(x*y) + exp(cos(t)) / (2 + sin(t))");
+    std::vector<Expression<double>> outputs_trig = {expr_trig, expr_trig.differentiate("x"), 
+                                                    expr_trig.differentiate("y"), expr_trig.differentiate("t")};
+    Program<double> program_fused(outputs_trig), program_unfused(outputs_trig, 0, false), program_fused_O2(outputs_trig, 2);
+    std::unordered_map<std::string, std::vector<double>> columns_trig = {{"x", {}}, {"y", {}}, {"t", {}}};
+    for (int i = 0; i < 300; i++) { // Больше блока пакетного вычисления и не кратно ему.
+        columns_trig["x"].push_back(0.01 * i - 1.3);
+        columns_trig["y"].push_back(std::sqrt(i + 0.5));
+        columns_trig["t"].push_back(40.0 - 0.27 * i);
+    }
+    auto batch_exact = program_fused.evaluateBatch(columns_trig);
+    auto batch_ulp = program_fused_O2.evaluateBatch(columns_trig, Accuracy::Ulp);
+    bool fused_exact = true, fused_batch = true, fused_ulp = true;
+    for (size_t i = 0; i < 300; i++) {
+        std::unordered_map<std::string, double> point = {{"x", columns_trig["x"][i]}, {"y", columns_trig["y"][i]}, 
+                                                         {"t", columns_trig["t"][i]}};
+        auto fused = program_fused.evaluate(point), unfused = program_unfused.evaluate(point);
+        auto ulp = program_fused_O2.evaluate(point, Accuracy::Ulp);
+        for (size_t k = 0; k < outputs_trig.size(); k++) {
+            fused_exact = fused_exact && fused[k] == unfused[k] && fused[k] == outputs_trig[k].evaluate(point);
+            fused_batch = fused_batch && batch_exact[k][i] == fused[k] && batch_ulp[k][i] == ulp[k];
+            fused_ulp = fused_ulp && areActuallyEqual(ulp[k], fused[k], 1e-12L * (1 + std::abs(fused[k])));
+        }
+    }
+    bool fused_batch_thrown = false;
+    try { Program<double>({Expression<double>("cos(x) / sin(x)")}).evaluateBatch({{"x", {0.3, 0.0, 1.5}}}); }
+    catch (const std::runtime_error&) { fused_batch_thrown = true; }
+    TEST_CASE("Test 27.1 (fusion of sin and cos of one argument): ", 
+        program_fused.statistics().fusedSinCos >= 2 && program_unfused.statistics().fusedSinCos == 0 &&
+        program_fused.statistics().instructions == program_unfused.statistics().instructions &&
+        Program<std::complex<double>>({Expression<std::complex<double>>("sin(x) * cos(x)")}).statistics().fusedSinCos == 0);
+    TEST_CASE("Test 27.2 (fused values match unfused and batch values): ", fused_exact && fused_batch);
+    TEST_CASE("Test 27.3 (fused approximations): ", fused_ulp);
+    TEST_CASE("Test 27.4 (domain errors in fused batches): ", fused_batch_thrown);
+
+    MpmcQueue<int> queue_small(3);
+    int queue_item = 1;
+    bool queue_ok = queue_small.capacity() == 4 && queue_small.push(queue_item) && queue_small.size() == 1 &&
+                    queue_small.pop(queue_item) && queue_item == 1 && !queue_small.pop(queue_item);
+    for (int i = 0; i < 4; i++) queue_ok = queue_ok && queue_small.push(i);
+    queue_ok = queue_ok && !queue_small.push(queue_item);
+
+    std::vector<Expression<double>> server_exprs = {Expression<double>("sin(x) * y + exp(x / y)"), Expression<double>("ln(x)")};
+    Program<double> server_reference({server_exprs[0]}, 2);
+    EvaluationServer<double>::Options server_options;
+    server_options.maxBatch = 16;
+    server_options.maxLatency = std::chrono::microseconds(500);
+    std::vector<std::future<double>> server_futures[4];
+    std::atomic<int> server_callbacks{0}, server_callback_errors{0};
+    bool server_values = true, server_domain_thrown = false, server_size_thrown = false;
+    EvaluationServer<double>::Statistics server_stats;
+    size_t server_idle_allocations = allocationCounters().allocations;
+    {
+        EvaluationServer<double> server_idle(server_exprs); // Очередь на 65536 запросов.
+        server_idle_allocations = allocationCounters().allocations - server_idle_allocations;
+    }
+    {
+        EvaluationServer<double> server(server_exprs, server_options);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < 4; p++) {
+            producers.emplace_back([&, p] {
+                for (int i = 0; i < 250; i++) {
+                    server_futures[p].push_back(server.submit(0, {0.01 * i, 1.0 + p}));
+                    server.submit(1, {i % 10 == 0 ? -1.0 : 1.0 + i}, [&](const double&, std::exception_ptr error) {
+                        server_callbacks++;
+                        if (error) server_callback_errors++;
+                    });
+                }
+            });
+        }
+        for (auto& producer : producers) producer.join();
+        for (int p = 0; p < 4; p++) {
+            for (int i = 0; i < 250; i++) {
+                std::vector<double> point = {0.01 * i, 1.0 + p}, output, registers;
+                server_reference.evaluate(point, output, registers);
+                server_values = server_values && server_futures[p][i].get() == output[0];
+            }
+        }
+        try { server.submit(1, {0.0}).get(); } catch (const std::runtime_error&) { server_domain_thrown = true; }
+        try { server.submit(0, {1.0}); } catch (const std::runtime_error&) { server_size_thrown = true; }
+        server_stats = server.statistics();
+    } // Деструктор досчитывает оставшиеся запросы.
+    TEST_CASE("Test 28.1 (bounded multi-producer multi-consumer queue): ", queue_ok);
+    TEST_CASE("Test 28.2 (server results through futures and callbacks): ", 
+        server_values && server_callbacks == 1000 && server_callback_errors == 100);
+    TEST_CASE("Test 28.3 (server errors): ", server_domain_thrown && server_size_thrown);
+    TEST_CASE("Test 28.4 (request batching): ", 
+        server_stats.requests == 2001 && 
+        server_stats.largestBatch <= 16 && server_stats.batches * 16 >= server_stats.completed);
+    TEST_CASE("Test 28.5 (idle server allocations): ", server_idle_allocations < 1000);
+
+    const char* c_source = "sin(x) * y + 1 / x";
+    const char* c_bad = "sin(x) + (y";
+    mathexpr_expression *c_expr = nullptr, *c_derivative = nullptr, *c_failed = nullptr;
+    mathexpr_program* c_program = nullptr;
+    size_t c_offset = 0, c_length = 0;
+    char c_small[4], c_text[256];
+    const char* c_names[] = {"x", "y"};
+    double c_point[] = {0.5, 3}, c_value = 0, c_zero[] = {0, 1};
+    bool c_ok = mathexpr_parse(c_source, std::strlen(c_source), &c_expr, nullptr) == MATHEXPR_OK &&
+                mathexpr_parse(c_bad, std::strlen(c_bad), &c_failed, &c_offset) == MATHEXPR_PARSE_ERROR && 
+                !c_failed && c_offset == 11 && std::string(mathexpr_last_error()).find("offset 11") != std::string::npos &&
+                mathexpr_to_string(c_expr, c_small, sizeof(c_small), &c_length) == MATHEXPR_BUFFER_TOO_SMALL &&
+                mathexpr_to_string(c_expr, c_text, sizeof(c_text), &c_length) == MATHEXPR_OK &&
+                std::string(c_text) == Expression<double>(c_source).toString() && c_length == std::strlen(c_text) &&
+                mathexpr_evaluate(c_expr, c_names, c_point, 2, MATHEXPR_EXACT, &c_value) == MATHEXPR_OK &&
+                c_value == Expression<double>(c_source).evaluate({{"x", 0.5}, {"y", 3}}) &&
+                mathexpr_evaluate(c_expr, c_names, c_point, 1, MATHEXPR_EXACT, &c_value) == MATHEXPR_UNBOUND_VARIABLE &&
+                mathexpr_evaluate(c_expr, c_names, c_zero, 2, MATHEXPR_EXACT, &c_value) == MATHEXPR_EVALUATION_ERROR &&
+                mathexpr_evaluate(nullptr, c_names, c_point, 2, MATHEXPR_EXACT, &c_value) == MATHEXPR_INVALID_ARGUMENT &&
+                mathexpr_differentiate(c_expr, "x", &c_derivative) == MATHEXPR_OK;
+
+    bool c_program_ok = false;
+    if (c_ok) {
+        const mathexpr_expression* c_outputs[] = {c_expr, c_derivative};
+        std::vector<Expression<double>> cpp_outputs = {Expression<double>(c_source), Expression<double>(c_source).differentiate("x")};
+        Program<double> cpp_program(cpp_outputs, 2);
+        std::vector<double> c_x(300), c_y(300), c_f(300), c_dfdx(300);
+        for (size_t i = 0; i < 300; i++) { c_x[i] = 0.1 + 0.01 * i; c_y[i] = 2 - 0.005 * i; }
+        c_program_ok = mathexpr_compile(c_outputs, 2, 2, &c_program) == MATHEXPR_OK &&
+                       mathexpr_program_variable_count(c_program) == 2 && mathexpr_program_output_count(c_program) == 2 &&
+                       std::string(mathexpr_program_variable_name(c_program, 0)) == cpp_program.variables()[0] &&
+                       !mathexpr_program_variable_name(c_program, 2);
+        if (c_program_ok) {
+            bool x_first = cpp_program.variables()[0] == "x";
+            const double* c_columns[] = {x_first ? c_x.data() : c_y.data(), x_first ? c_y.data() : c_x.data()};
+            double* c_results[] = {c_f.data(), c_dfdx.data()};
+            auto cpp_results = cpp_program.evaluateBatch({{"x", c_x}, {"y", c_y}});
+            double c_single[2], c_values[] = {c_columns[0][7], c_columns[1][7]};
+            c_program_ok = mathexpr_program_evaluate_batch(c_program, c_columns, 300, MATHEXPR_EXACT, c_results) == MATHEXPR_OK &&
+                           c_f == cpp_results[0] && c_dfdx == cpp_results[1] &&
+                           mathexpr_program_evaluate(c_program, c_values, MATHEXPR_EXACT, c_single) == MATHEXPR_OK &&
+                           c_single[0] == c_f[7] && c_single[1] == c_dfdx[7];
+            c_x[5] = 0;
+            c_program_ok = c_program_ok && 
+                           mathexpr_program_evaluate_batch(c_program, c_columns, 300, MATHEXPR_ULP, c_results) == MATHEXPR_EVALUATION_ERROR;
+        }
+    }
+    mathexpr_program_free(c_program);
+    mathexpr_free(c_derivative);
+    mathexpr_free(c_expr);
+    TEST_CASE("Test 29.1 (C API for expressions): ", c_ok);
+    TEST_CASE("Test 29.2 (C API for compiled programs): ", c_program_ok);
+
+    LD::registerFunction(hyp_definition);
+    LD expr_lazy("sin(x) * exp(x^2/10) / (1 + x^2) + atan(x*y) - tanh(x) * sqrt(x + y) + erf(x) * cosh(y) + "
+                 "ln(x) * y^3 + x^x + min(x, y) + hyp(x, y^2) + x^(1/3) * log10(y) + abs(x - 2) / tan(x) + x^(-2)");
+    LD expr_lazy_nary = LD::parse("x*y*sin(x) + exp(y)*x - x*x*x*y", LD::Chains::Nary).value();
+    std::unordered_map<std::string, long double> point_lazy = {{"x", 0.7L}, {"y", 1.3L}};
+    auto lazyMatches = [&](const LD& expr, const LazyDerivative<long double>& lazy) {
+        long double eager = lazy.materialize().evaluate(point_lazy);
+        return areActuallyEqual(lazy.evaluate(point_lazy), eager, 1e-12L * (1 + std::abs(eager)));
+    };
+    bool lazy_ok = true;
+    LD eager_lazy = expr_lazy;
+    for (unsigned order = 1; order <= 4; order++) {
+        eager_lazy = eager_lazy.differentiate("x");
+        LazyDerivative<long double> lazy(expr_lazy, "x", order);
+        lazy_ok = lazy_ok && lazy.order() == order && lazyMatches(expr_lazy, lazy) && 
+                  areActuallyEqual(lazy.evaluate(point_lazy), eager_lazy.evaluate(point_lazy), 
+                                   1e-12L * (1 + std::abs(eager_lazy.evaluate(point_lazy))));
+    }
+    LazyDerivative<long double> lazy_mixed = LazyDerivative<long double>(expr_lazy, "x", 2).differentiate("y");
+    LazyDerivative<long double> lazy_nary = LazyDerivative<long double>(expr_lazy_nary, "y").differentiate("x", 2);
+    lazy_ok = lazy_ok && lazyMatches(expr_lazy, lazy_mixed) && lazyMatches(expr_lazy_nary, lazy_nary) &&
+              lazy_mixed.order() == 3 && lazy_mixed.variables().size() == 2 &&
+              lazy_mixed.differentiate("x").variables()[0].second == 3 &&
+              lazy_mixed.toString() == expr_lazy.differentiate("x").differentiate("x").differentiate("y").toString() &&
+              LazyDerivative<long double>(LD("x^3 * y"), "z", 2).evaluate(point_lazy) == 0;
+    bool lazy_domain_thrown = false, lazy_unbound_thrown = false;
+    try { LazyDerivative<long double>(LD("ln(x)"), "x", 3).evaluate({{"x", -1}}); } 
+    catch (const std::runtime_error&) { lazy_domain_thrown = true; }
+    try { LazyDerivative<long double>(LD("x * y"), "x").evaluate({{"x", 1}}); } 
+    catch (const std::runtime_error&) { lazy_unbound_thrown = true; }
+    using CD = std::complex<double>;
+    Expression<CD> expr_lazy_complex("sin(z) * exp(z^2) / (z + 2)");
+    std::unordered_map<std::string, CD> point_lazy_complex = {{"z", CD(0.3, -0.4)}};
+    CD lazy_complex = LazyDerivative<CD>(expr_lazy_complex, "z", 3).evaluate(point_lazy_complex);
+    CD eager_complex = expr_lazy_complex.differentiate("z").differentiate("z").differentiate("z").evaluate(point_lazy_complex);
+    TEST_CASE("Test 30.1 (lazy high-order derivatives): ", lazy_ok);
+    TEST_CASE("Test 30.2 (lazy derivative errors): ", lazy_domain_thrown && lazy_unbound_thrown);
+    TEST_CASE("Test 30.3 (lazy derivatives of complex expressions): ", 
+        std::abs(lazy_complex - eager_complex) < 1e-10 * (1 + std::abs(eager_complex)));
+    TEST_CASE("Test 30.4 (lazy derivatives of a power beyond its degree): ", 
+        LazyDerivative<double>(Expression<double>("x^5"), "x", 5).evaluate({{"x", 3.0}}) == 120 &&
+        LazyDerivative<double>(Expression<double>("x^5"), "x", 6).evaluate({{"x", -3.0}}) == 0);
+    LD::unregisterFunction("hyp");
+
+    LD expr_hash_1("x*y + sin(x) / (1 + x)"), expr_hash_2("x*y + sin(x) / (1 + x)"), expr_hash_3("y*x + sin(x) / (x + 1)");
+    LD expr_hash_subs("x*y + min(y, x)");
+    expr_hash_subs.subsVar("x = 2");
+    LD expr_hash_nary = LD::parse("a*b*c + b - c*a + 2", LD::Chains::Nary).value();
+    LD derivative_hash = expr_hash_1.differentiate("x");
+    std::unordered_set<LD> hash_set = {expr_hash_1, expr_hash_2, expr_hash_3, expr_hash_3.canonicalize(),
+                                       expr_hash_1.canonicalize()};
+    Expression<std::complex<double>> expr_hash_complex("2I * z + 1");
+    TEST_CASE("Test 31.1 (structural hashing and equality): ",
+        expr_hash_1 == expr_hash_2 && expr_hash_1.hash() == expr_hash_2.hash() && expr_hash_1 != expr_hash_3 &&
+        expr_hash_1.hash() != expr_hash_3.hash() && LD(expr_hash_1) == expr_hash_1 &&
+        hash_set.size() == 3 && LD() == LD() && LD() != expr_hash_1);
+    TEST_CASE("Test 31.2 (canonical operand order): ",
+        expr_hash_1.canonicalize() == expr_hash_3.canonicalize() &&
+        expr_hash_1.canonicalize().hash() == expr_hash_3.canonicalize().hash() &&
+        expr_hash_1.canonicalize().canonicalize() == expr_hash_1.canonicalize() &&
+        LD("b + a - c").canonicalize() == LD("a - c + b").canonicalize() &&
+        LD("a / b * c").canonicalize() == LD("c / b * a").canonicalize() && LD("a - b").canonicalize() != LD("b - a").canonicalize() &&
+        LD("x^y").canonicalize() != LD("y^x").canonicalize() &&
+        LD("x + y + z").rebalance().canonicalize() == LD("z + y + x").canonicalize() &&
+        areActuallyEqual(expr_hash_3.canonicalize().evaluate(point_lazy), expr_hash_1.evaluate(point_lazy), 1e-15L));
+    TEST_CASE("Test 31.3 (hashes after substitution and differentiation): ",
+        expr_hash_subs == LD("2*y + min(y, 2)") && expr_hash_subs.hash() == LD("2*y + min(y, 2)").hash() &&
+        derivative_hash == expr_hash_2.differentiate("x") && derivative_hash != expr_hash_1.differentiate("y"));
+    TEST_CASE("Test 31.4 (hashes of n-ary and complex expressions): ",
+        LD(expr_hash_nary) == expr_hash_nary && expr_hash_nary != LD("a*b*c + b - c*a + 2") &&
+        LD::parse("b - c*a + a*b*c + 2", LD::Chains::Nary).value().canonicalize() == expr_hash_nary.canonicalize() &&
+        expr_hash_complex == Expression<std::complex<double>>("2I * z + 1") &&
+        expr_hash_complex != Expression<std::complex<double>>("2 * z + 1"));
 }
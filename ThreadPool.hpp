@@ -0,0 +1,95 @@
+#ifndef EXPR_THREAD_POOL_HPP
+#define EXPR_THREAD_POOL_HPP
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/*
+Простой пул потоков с фиксированным числом рабочих и общей очередью задач.
+submit() возвращает std::future с результатом задачи (исключения тоже передаются через него).
+*/
+class ThreadPool {
+public:
+
+    /*
+    Пул из threads потоков (0 — по числу аппаратных потоков).
+    */
+    explicit ThreadPool(unsigned threads = 0) {
+
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    /*
+    Поставить задачу в очередь.
+    */
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task())> {
+
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged] { (*packaged)(); });
+        }
+        ready.notify_one();
+        return future;
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    /*
+    Цикл рабочего потока: брать задачи, пока пул не остановлен и очередь не пуста.
+    */
+    void work() {
+
+        for (;;) {
+
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+#endif